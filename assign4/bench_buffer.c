@@ -0,0 +1,375 @@
+/*
+ * bench_buffer.c
+ *
+ *  Benchmark of the buffer manager under synthetic workloads. Each workload
+ *  is run against every replacement strategy and a range of pool sizes on a
+ *  scratch page file, and throughput, hit ratio and pin latency percentiles
+ *  are reported. Workloads:
+ *   uniform  - pages picked uniformly at random
+ *   zipf     - pages picked by Zipf's law, a few pages get most pins
+ *   loop     - sequential scans looping over a bit more pages than the pool
+ *   mixed    - zipf point pins with an occasional short scan
+ *   zipf-mt  - zipf with several threads pinning at once
+ *  One in WRITE_EVERY pins marks its page dirty, so write back is included.
+ *
+ *  Usage: bench_buffer [pins per thread [page file pages]]
+ */
+
+#include "buffer_mgr.h"
+#include "storage_mgr.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PRIVATE static
+
+#define BENCH_FILE "bench_buffer.bin"
+#define DEFAULT_PINS 100000
+#define DEFAULT_FILE_PAGES 4096
+
+//Pool sizes, in 1/1000 of page file pages
+#define NUM_POOL_SIZES 3
+PRIVATE const int poolSizes[NUM_POOL_SIZES] = { 16, 125, 500 };
+
+//Thread counts the zipf-mt workload runs with
+#define NUM_THREAD_COUNTS 3
+PRIVATE const int threadCounts[NUM_THREAD_COUNTS] = { 2, 4, 8 };
+
+//Every WRITE_EVERY-th pin marks its page dirty
+#define WRITE_EVERY 10
+
+//Length of the short scans of the mixed workload, and how often they run
+#define MIXED_SCAN_LENGTH 64
+#define MIXED_SCAN_EVERY 1000
+
+typedef enum Workload {
+	WL_UNIFORM = 0, WL_ZIPF = 1, WL_LOOP = 2, WL_MIXED = 3
+} Workload;
+
+PRIVATE const char *workloadNames[] = { "uniform", "zipf", "loop", "mixed" };
+
+PRIVATE const char *strategyNames[BM_NUM_STRATEGIES] = { "FIFO", "LRU",
+		"CLOCK", "LFU", "LRU-K", "AUTO" };
+
+//Shared by the threads of a run
+typedef struct BenchRun {
+	BM_BufferPool bm;
+	Workload workload;
+	int numPins;	// pins per thread
+	int filePages;
+	int loopPages;	// pages a loop scan cycles through
+	double *zipfCdf;	// cumulative probability of pages ranked by hotness
+} BenchRun;
+
+//State and results of one thread
+typedef struct BenchThread {
+	BenchRun *run;
+	pthread_t thread;
+	uint64_t seed;
+	uint32_t *latencies;	// ns each pin took
+	int numLatencies;
+	long failedPins;
+} BenchThread;
+
+PRIVATE void *benchMain(void *);
+PRIVATE RC runBench(BenchRun * const, const ReplacementStrategy, const int,
+		const int);
+PRIVATE inline uint64_t nextRandom(uint64_t * const);
+PRIVATE inline PageNumber zipfPage(BenchRun * const, uint64_t * const);
+PRIVATE inline void benchPin(BenchThread * const, const PageNumber,
+		const int);
+PRIVATE double *makeZipfCdf(const int);
+PRIVATE int compareLatency(const void *, const void *);
+
+int main(int argc, char *argv[]) {
+
+	BenchRun run;
+	SM_FileHandle fh;
+	int w, s, p, t;
+
+	run.numPins = argc > 1 && atoi(argv[1]) > 0 ? atoi(argv[1]) : DEFAULT_PINS;
+	run.filePages = argc > 2 && atoi(argv[2]) > 0 ?
+			atoi(argv[2]) : DEFAULT_FILE_PAGES;
+
+	//Every page exists up front, so misses are real reads
+	if (createPageFile(BENCH_FILE) != RC_OK
+			|| openPageFile(BENCH_FILE, &fh) != RC_OK) {
+		fprintf(stderr, "Couldn't create %s\n", BENCH_FILE);
+		return 1;
+	}
+	RC ret = ensureCapacity(run.filePages, &fh);
+	closePageFile(&fh);
+	run.zipfCdf = makeZipfCdf(run.filePages);
+	if (ret != RC_OK || run.zipfCdf == NULL) {
+		fprintf(stderr, "Couldn't set up benchmark\n");
+		destroyPageFile(BENCH_FILE);
+		return 1;
+	}
+
+	printf("%d pins per thread, %d pages in page file\n", run.numPins,
+			run.filePages);
+	printf("%-8s %7s %-8s %7s %12s %9s %8s %8s %8s\n", "workload", "threads",
+			"strategy", "pages", "pins/s", "hit ratio", "p50 ns", "p99 ns",
+			"failed");
+
+	//Single threaded workloads, then zipf with more and more threads
+	for (w = WL_UNIFORM; w <= WL_MIXED + NUM_THREAD_COUNTS; w++) {
+		run.workload = w <= WL_MIXED ? (Workload) w : WL_ZIPF;
+		t = w <= WL_MIXED ? 1 : threadCounts[w - WL_MIXED - 1];
+		for (s = 0; s < BM_NUM_STRATEGIES; s++) {
+			for (p = 0; p < NUM_POOL_SIZES; p++) {
+				int numPages = run.filePages * poolSizes[p] / 1000;
+				if (numPages < t + 1) {
+					numPages = t + 1;
+				}
+				if (runBench(&run, (ReplacementStrategy) s, numPages, t)
+						!= RC_OK) {
+					printf("%-8s %7d %-8s %7d failed: %s\n",
+							w <= WL_MIXED ? workloadNames[w] : "zipf-mt", t,
+							strategyNames[s], numPages, RC_message);
+				}
+			}
+		}
+	}
+
+	free(run.zipfCdf);
+	destroyPageFile(BENCH_FILE);
+	return 0;
+}
+
+/**
+ * Private utility function to run the workload of run with numThreads
+ * threads on a fresh pool of numPages pages with strategy, and print its
+ * results.
+ *
+ * run = benchmark run
+ * strategy = replacement strategy of the pool
+ * numPages = size of the pool
+ * numThreads = no of threads pinning pages
+ */
+PRIVATE RC runBench(BenchRun * const run, const ReplacementStrategy strategy,
+		const int numPages, const int numThreads) {
+
+	int i, numLatencies = 0;
+	long failedPins = 0;
+	BM_PoolStats stats;
+
+	RC ret = initBufferPool(&run->bm, BENCH_FILE, numPages, strategy, NULL);
+	if (ret != RC_OK) {
+		return ret;
+	}
+	//Loop scans just don't fit, the worst case for LRU and FIFO
+	run->loopPages = numPages + numPages / 4;
+	if (run->loopPages > run->filePages) {
+		run->loopPages = run->filePages;
+	}
+
+	BenchThread *threads = (BenchThread *) calloc(numThreads,
+			sizeof(BenchThread));
+	if (threads == NULL) {
+		shutdownBufferPool(&run->bm);
+		THROW(RC_NOT_ENOUGH_MEMORY,
+				"Not enough memory available for resource allocation");
+	}
+
+	uint64_t start = statClock();
+	for (i = 0; i < numThreads; i++) {
+		threads[i].run = run;
+		threads[i].seed = 0x9E3779B97F4A7C15ull * (i + 1);
+		pthread_create(&threads[i].thread, NULL, benchMain, &threads[i]);
+	}
+	for (i = 0; i < numThreads; i++) {
+		pthread_join(threads[i].thread, NULL);
+	}
+	uint64_t elapsed = statClock() - start;
+
+	getPoolStats(&run->bm, &stats);
+	shutdownBufferPool(&run->bm);
+
+	//Percentiles over pins of all threads
+	for (i = 0; i < numThreads; i++) {
+		numLatencies += threads[i].numLatencies;
+		failedPins += threads[i].failedPins;
+	}
+	uint32_t *latencies = (uint32_t *) malloc(
+			(numLatencies + 1) * sizeof(uint32_t));
+	numLatencies = 0;
+	for (i = 0; i < numThreads; i++) {
+		if (latencies != NULL) {
+			memcpy(latencies + numLatencies, threads[i].latencies,
+					threads[i].numLatencies * sizeof(uint32_t));
+			numLatencies += threads[i].numLatencies;
+		}
+		free(threads[i].latencies);
+	}
+	free(threads);
+	if (latencies == NULL) {
+		THROW(RC_NOT_ENOUGH_MEMORY,
+				"Not enough memory available for resource allocation");
+	}
+	qsort(latencies, numLatencies, sizeof(uint32_t), compareLatency);
+
+	//Failed pins count as misses
+	uint64_t pins = stats.pinRequests + failedPins;
+	printf("%-8s %7d %-8s %7d %12.0f %9.4f %8u %8u %8ld\n",
+			numThreads == 1 ? workloadNames[run->workload] : "zipf-mt",
+			numThreads, strategyNames[strategy], numPages,
+			elapsed == 0 ? 0 : pins * 1e9 / elapsed,
+			pins == 0 ? 0 : (double) stats.hits / pins,
+			numLatencies == 0 ? 0 : latencies[numLatencies / 2],
+			numLatencies == 0 ? 0 : latencies[numLatencies * 99 / 100],
+			failedPins);
+	free(latencies);
+
+	//All OK
+	return RC_OK;
+}
+
+/**
+ * Private utility function run by each benchmark thread: pins and unpins
+ * pages of the workload of its run.
+ *
+ * arg = benchmark thread
+ */
+PRIVATE void *benchMain(void *arg) {
+
+	BenchThread *thread = (BenchThread *) arg;
+	BenchRun *run = thread->run;
+	int i = 0, j;
+
+	thread->latencies = (uint32_t *) malloc(
+			(run->numPins + 1) * sizeof(uint32_t));
+	if (thread->latencies == NULL) {
+		return NULL;
+	}
+
+	//Each thread starts its scans somewhere else
+	PageNumber scanPos = nextRandom(&thread->seed) % run->loopPages;
+
+	while (i < run->numPins) {
+		switch (run->workload) {
+		case WL_UNIFORM:
+			benchPin(thread, nextRandom(&thread->seed) % run->filePages, i++);
+			break;
+		case WL_ZIPF:
+			benchPin(thread, zipfPage(run, &thread->seed), i++);
+			break;
+		case WL_LOOP:
+			benchPin(thread, scanPos, i++);
+			scanPos = (scanPos + 1) % run->loopPages;
+			break;
+		case WL_MIXED:
+			if (nextRandom(&thread->seed) % MIXED_SCAN_EVERY != 0) {
+				benchPin(thread, zipfPage(run, &thread->seed), i++);
+				break;
+			}
+			scanPos = nextRandom(&thread->seed) % run->filePages;
+			for (j = 0; j < MIXED_SCAN_LENGTH && i < run->numPins; j++) {
+				benchPin(thread, (scanPos + j) % run->filePages, i++);
+			}
+			break;
+		}
+	}
+
+	return NULL;
+}
+
+/**
+ * Private utility function to pin and unpin page pageNum, timing the pin.
+ *
+ * thread = benchmark thread
+ * pageNum = page to be pinned
+ * i = no of pins the thread did so far
+ */
+PRIVATE inline void benchPin(BenchThread * const thread,
+		const PageNumber pageNum, const int i) {
+
+	BM_PageHandle page;
+
+	uint64_t start = statClock();
+	RC ret = pinPage(&thread->run->bm, &page, pageNum);
+	uint64_t nanos = statClock() - start;
+	thread->latencies[thread->numLatencies++] =
+			nanos > UINT32_MAX ? UINT32_MAX : nanos;
+
+	if (ret != RC_OK) {
+		thread->failedPins++;
+		return;
+	}
+	if (i % WRITE_EVERY == 0) {
+		markDirty(&thread->run->bm, &page);
+	}
+	unpinPage(&thread->run->bm, &page);
+}
+
+/**
+ * Private utility function to pick a page by Zipf's law. Ranks are spread
+ * over the page file, so hot pages aren't neighbours.
+ *
+ * run = benchmark run
+ * seed = random state of the calling thread
+ */
+PRIVATE inline PageNumber zipfPage(BenchRun * const run,
+		uint64_t * const seed) {
+
+	double u = (nextRandom(seed) >> 11) * (1.0 / 9007199254740992.0);
+	int low = 0, high = run->filePages - 1;
+
+	//First rank whose cumulative probability reaches u
+	while (low < high) {
+		int mid = (low + high) / 2;
+		if (run->zipfCdf[mid] < u) {
+			low = mid + 1;
+		} else {
+			high = mid;
+		}
+	}
+	return (PageNumber) (((uint64_t) low * 2654435761u) % run->filePages);
+}
+
+/**
+ * Private utility function to build the cumulative distribution of Zipf's
+ * law with exponent 1 over n ranks.
+ *
+ * n = no of ranks
+ */
+PRIVATE double *makeZipfCdf(const int n) {
+
+	int i;
+	double sum = 0;
+	double *cdf = (double *) malloc(n * sizeof(double));
+	if (cdf == NULL) {
+		return NULL;
+	}
+
+	for (i = 0; i < n; i++) {
+		sum += 1.0 / (i + 1);
+		cdf[i] = sum;
+	}
+	for (i = 0; i < n; i++) {
+		cdf[i] /= sum;
+	}
+	return cdf;
+}
+
+/**
+ * Private utility function returning the next number of a xorshift
+ * generator.
+ *
+ * seed = random state of the calling thread
+ */
+PRIVATE inline uint64_t nextRandom(uint64_t * const seed) {
+	*seed ^= *seed << 13;
+	*seed ^= *seed >> 7;
+	*seed ^= *seed << 17;
+	return *seed;
+}
+
+/**
+ * Private utility function to order pin latencies ascending
+ */
+PRIVATE int compareLatency(const void *a, const void *b) {
+	uint32_t x = *(const uint32_t *) a, y = *(const uint32_t *) b;
+	return x < y ? -1 : x > y;
+}
@@ -0,0 +1,409 @@
+/*
+ * bm_replay.c
+ *
+ *  Replays a buffer pool access trace, see buffer_mgr_trace.c, against every
+ *  replacement strategy and a range of pool sizes and reports hit ratio and
+ *  I/O counts of each run. Pages are replayed on scratch page files created
+ *  next to the trace, with page numbers remapped densely in order of first
+ *  access, so only as many pages as the trace touches are created.
+ *
+ *  Usage: bm_replay <trace file> [pool size ...]
+ *  Without sizes, powers of two from 16 up to the no of distinct pages of
+ *  the trace are replayed.
+ */
+
+#include "buffer_mgr.h"
+#include "storage_mgr.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PRIVATE static
+
+//Smallest pool size replayed by default
+#define MIN_POOL_SIZE 16
+
+//Most pool sizes replayed in one go
+#define MAX_POOL_SIZES 32
+
+//Distinct page of the trace
+typedef struct ReplayPage {
+	uint64_t key;	// page file slot and page number of the trace
+	int file;	// index of scratch page file
+	PageNumber pageNum;	// page number in scratch page file
+	int pins;	// pins held on the page during a run
+} ReplayPage;
+
+//Trace loaded for replay, events refer to pages by index
+typedef struct Replay {
+	int numEvents;
+	int *pageOf;
+	uint8_t *opOf;
+	int numPages;
+	ReplayPage *pages;
+	int numFiles;
+	int *filePages;	// no of pages in each scratch page file
+	char **fileNames;
+} Replay;
+
+//Outcome of one run
+typedef struct ReplayResult {
+	BM_PoolStats stats;
+	long failedPins;
+} ReplayResult;
+
+PRIVATE const char *strategyNames[BM_NUM_STRATEGIES] = { "FIFO", "LRU",
+		"CLOCK", "LFU", "LRU-K", "AUTO" };
+
+PRIVATE BM_TraceEvent *readTrace(const char * const, int * const);
+PRIVATE RC loadReplay(Replay * const, const char * const);
+PRIVATE void freeReplay(Replay * const);
+PRIVATE RC runReplay(Replay * const, const ReplacementStrategy, const int,
+		ReplayResult * const);
+
+int main(int argc, char *argv[]) {
+
+	Replay replay;
+	int sizes[MAX_POOL_SIZES];
+	int numSizes = 0, i, s;
+
+	if (argc < 2) {
+		fprintf(stderr, "usage: %s <trace file> [pool size ...]\n", argv[0]);
+		return 1;
+	}
+
+	if (loadReplay(&replay, argv[1]) != RC_OK) {
+		fprintf(stderr, "%s: %s\n", argv[1], RC_message);
+		return 1;
+	}
+
+	for (i = 2; i < argc && numSizes < MAX_POOL_SIZES; i++) {
+		if (atoi(argv[i]) > 0) {
+			sizes[numSizes++] = atoi(argv[i]);
+		}
+	}
+	if (numSizes == 0) {
+		for (s = MIN_POOL_SIZE; numSizes < MAX_POOL_SIZES; s *= 2) {
+			sizes[numSizes++] = s;
+			if (s >= replay.numPages) {
+				break;
+			}
+		}
+	}
+
+	printf("%d events, %d pages in %d page files\n", replay.numEvents,
+			replay.numPages, replay.numFiles);
+	printf("%-8s %8s %12s %12s %9s %12s %12s %10s\n", "strategy", "pages",
+			"pins", "hits", "hit ratio", "reads", "writes", "failed");
+
+	for (s = 0; s < BM_NUM_STRATEGIES; s++) {
+		for (i = 0; i < numSizes; i++) {
+			ReplayResult result;
+			if (runReplay(&replay, (ReplacementStrategy) s, sizes[i], &result)
+					!= RC_OK) {
+				printf("%-8s %8d failed: %s\n", strategyNames[s], sizes[i],
+						RC_message);
+				continue;
+			}
+			//Failed pins count as misses, a strategy that can't find
+			//victims doesn't get a better ratio from it
+			uint64_t pins = result.stats.pinRequests + result.failedPins;
+			printf("%-8s %8d %12llu %12llu %9.4f %12llu %12llu %10ld\n",
+					strategyNames[s], sizes[i], (unsigned long long) pins,
+					(unsigned long long) result.stats.hits,
+					pins == 0 ? 0 : (double) result.stats.hits / pins,
+					(unsigned long long) result.stats.reads,
+					(unsigned long long) result.stats.writes,
+					result.failedPins);
+		}
+	}
+
+	freeReplay(&replay);
+	return 0;
+}
+
+/**
+ * Private utility function to read events of trace file name in the order
+ * they were recorded. Returns NULL if it isn't a trace file.
+ *
+ * name = name of the trace file
+ * numEvents = set to no of events read
+ */
+PRIVATE BM_TraceEvent *readTrace(const char * const name,
+		int * const numEvents) {
+
+	BM_TraceHeader header;
+	FILE *fp = fopen(name, "rb");
+	if (fp == NULL) {
+		return NULL;
+	}
+	if (fread(&header, sizeof(BM_TraceHeader), 1, fp) != 1
+			|| header.magic != BM_TRACE_MAGIC
+			|| header.eventSize != sizeof(BM_TraceEvent)
+			|| header.capacity == 0) {
+		fclose(fp);
+		return NULL;
+	}
+
+	//Once the ring wrapped, the oldest event is the one written over next
+	uint64_t n = header.numEvents, first = 0;
+	if (n > header.capacity) {
+		first = n % header.capacity;
+		n = header.capacity;
+	}
+	BM_TraceEvent *events = (BM_TraceEvent *) malloc(
+			(n + 1) * sizeof(BM_TraceEvent));
+	if (events == NULL) {
+		fclose(fp);
+		return NULL;
+	}
+	uint64_t tail = n - first;
+	if (fseek(fp, sizeof(BM_TraceHeader) + first * sizeof(BM_TraceEvent),
+			SEEK_SET) != 0
+			|| fread(events, sizeof(BM_TraceEvent), tail, fp) != tail
+			|| fseek(fp, sizeof(BM_TraceHeader), SEEK_SET) != 0
+			|| fread(events + tail, sizeof(BM_TraceEvent), first, fp)
+					!= first) {
+		free(events);
+		fclose(fp);
+		return NULL;
+	}
+	fclose(fp);
+
+	*numEvents = n;
+	return events;
+}
+
+/**
+ * Private utility function to load trace file name for replay and create its
+ * scratch page files.
+ *
+ * replay = replay to be set up
+ * name = name of the trace file
+ */
+PRIVATE RC loadReplay(Replay * const replay, const char * const name) {
+
+	int numEvents, i;
+	BM_TraceEvent *events = readTrace(name, &numEvents);
+	if (events == NULL) {
+		THROW(RC_READ_FAILED, "Couldn't read trace file");
+	}
+
+	memset(replay, 0, sizeof(Replay));
+	replay->numEvents = numEvents;
+	replay->pageOf = (int *) malloc((numEvents + 1) * sizeof(int));
+	replay->opOf = (uint8_t *) malloc(numEvents + 1);
+	replay->pages = (ReplayPage *) malloc(
+			(numEvents + 1) * sizeof(ReplayPage));
+
+	//Open addressing table from trace page to its index in pages
+	int tableSize = 1;
+	while (tableSize < 2 * numEvents + 2) {
+		tableSize *= 2;
+	}
+	int *table = (int *) malloc(tableSize * sizeof(int));
+	int *fileOf = (int *) malloc(65536 * sizeof(int));
+	if (replay->pageOf == NULL || replay->opOf == NULL
+			|| replay->pages == NULL || table == NULL || fileOf == NULL) {
+		free(events);
+		free(table);
+		free(fileOf);
+		freeReplay(replay);
+		THROW(RC_NOT_ENOUGH_MEMORY,
+				"Not enough memory available for resource allocation");
+	}
+	memset(table, -1, tableSize * sizeof(int));
+	memset(fileOf, -1, 65536 * sizeof(int));
+
+	for (i = 0; i < numEvents; i++) {
+		uint64_t key = ((uint64_t) events[i].file << 32)
+				| (uint32_t) events[i].pageNum;
+		unsigned int slot = (unsigned int) ((key * 0x9E3779B97F4A7C15ull)
+				>> 32) & (tableSize - 1);
+		while (table[slot] != -1 && replay->pages[table[slot]].key != key) {
+			slot = (slot + 1) & (tableSize - 1);
+		}
+		if (table[slot] == -1) {
+			//First access of the page, give it the next page of its file
+			if (fileOf[events[i].file] == -1) {
+				fileOf[events[i].file] = replay->numFiles++;
+			}
+			ReplayPage *page = &replay->pages[replay->numPages];
+			page->key = key;
+			page->file = fileOf[events[i].file];
+			page->pageNum = 0;
+			page->pins = 0;
+			table[slot] = replay->numPages++;
+		}
+		replay->pageOf[i] = table[slot];
+		replay->opOf[i] = events[i].op;
+	}
+	free(events);
+	free(table);
+	free(fileOf);
+
+	replay->filePages = (int *) calloc(replay->numFiles + 1, sizeof(int));
+	replay->fileNames = (char **) calloc(replay->numFiles + 1,
+			sizeof(char *));
+	if (replay->filePages == NULL || replay->fileNames == NULL) {
+		freeReplay(replay);
+		THROW(RC_NOT_ENOUGH_MEMORY,
+				"Not enough memory available for resource allocation");
+	}
+	for (i = 0; i < replay->numPages; i++) {
+		replay->pages[i].pageNum = replay->filePages[replay->pages[i].file]++;
+	}
+
+	//Scratch page files hold every page up front, so misses are real reads
+	for (i = 0; i < replay->numFiles; i++) {
+		SM_FileHandle fh;
+		replay->fileNames[i] = (char *) malloc(strlen(name) + 32);
+		if (replay->fileNames[i] == NULL) {
+			freeReplay(replay);
+			THROW(RC_NOT_ENOUGH_MEMORY,
+					"Not enough memory available for resource allocation");
+		}
+		sprintf(replay->fileNames[i], "%s.replay%d", name, i);
+		if (createPageFile(replay->fileNames[i]) != RC_OK
+				|| openPageFile(replay->fileNames[i], &fh) != RC_OK) {
+			freeReplay(replay);
+			THROW(RC_WRITE_FAILED, "Couldn't create scratch page file");
+		}
+		RC ret = ensureCapacity(replay->filePages[i], &fh);
+		closePageFile(&fh);
+		if (ret != RC_OK) {
+			freeReplay(replay);
+			THROW(ret, "Couldn't create scratch page file");
+		}
+	}
+
+	//All OK
+	return RC_OK;
+}
+
+/**
+ * Private utility function to release a replay and remove its scratch page
+ * files.
+ *
+ * replay = replay to be released
+ */
+PRIVATE void freeReplay(Replay * const replay) {
+
+	int i;
+
+	for (i = 0; replay->fileNames != NULL && i < replay->numFiles; i++) {
+		if (replay->fileNames[i] != NULL) {
+			destroyPageFile(replay->fileNames[i]);
+			free(replay->fileNames[i]);
+		}
+	}
+	free(replay->fileNames);
+	free(replay->filePages);
+	free(replay->pages);
+	free(replay->opOf);
+	free(replay->pageOf);
+	memset(replay, 0, sizeof(Replay));
+}
+
+/**
+ * Private utility function to replay the trace single threaded on a pool of
+ * numPages pages with strategy. Traces of several page files are replayed
+ * on the shared pool. Pins failing because all frames are pinned are
+ * counted, and their unpins skipped. Pins still held at the end of the
+ * trace are dropped before the pool's counters are taken.
+ *
+ * replay = loaded trace
+ * strategy = replacement strategy to replay with
+ * numPages = size of the pool
+ * result = set to counters of the run
+ */
+PRIVATE RC runReplay(Replay * const replay, const ReplacementStrategy strategy,
+		const int numPages, ReplayResult * const result) {
+
+	int i;
+	RC ret = RC_OK;
+
+	BM_BufferPool *views = (BM_BufferPool *) calloc(replay->numFiles + 1,
+			sizeof(BM_BufferPool));
+	if (views == NULL) {
+		THROW(RC_NOT_ENOUGH_MEMORY,
+				"Not enough memory available for resource allocation");
+	}
+	if (replay->numFiles > 1) {
+		ret = initSharedBufferPool(numPages, strategy, NULL, NULL);
+		if (ret != RC_OK) {
+			free(views);
+			return ret;
+		}
+	}
+	for (i = 0; i < replay->numFiles && ret == RC_OK; i++) {
+		ret = initBufferPool(&views[i], replay->fileNames[i], numPages,
+				strategy, NULL);
+	}
+	if (ret != RC_OK) {
+		while (--i > 0) {
+			shutdownBufferPool(&views[i - 1]);
+		}
+		if (replay->numFiles > 1) {
+			shutdownSharedBufferPool();
+		}
+		free(views);
+		return ret;
+	}
+
+	result->failedPins = 0;
+	for (i = 0; i < replay->numPages; i++) {
+		replay->pages[i].pins = 0;
+	}
+
+	for (i = 0; i < replay->numEvents; i++) {
+		ReplayPage *page = &replay->pages[replay->pageOf[i]];
+		BM_PageHandle handle;
+		handle.pageNum = page->pageNum;
+		handle.frame = -1;
+
+		if (replay->opOf[i] == BM_TRACE_PIN) {
+			if (pinPage(&views[page->file], &handle, page->pageNum) == RC_OK) {
+				page->pins++;
+			} else {
+				result->failedPins++;
+			}
+		} else if (replay->opOf[i] == BM_TRACE_UNPIN) {
+			//Pin may have failed, or wrapped out of the trace
+			if (page->pins > 0) {
+				unpinPage(&views[page->file], &handle);
+				page->pins--;
+			}
+		} else if (replay->opOf[i] == BM_TRACE_DIRTY) {
+			if (page->pins > 0) {
+				markDirty(&views[page->file], &handle);
+			}
+		}
+	}
+
+	for (i = 0; i < replay->numPages; i++) {
+		BM_PageHandle handle;
+		handle.pageNum = replay->pages[i].pageNum;
+		handle.frame = -1;
+		while (replay->pages[i].pins > 0) {
+			unpinPage(&views[replay->pages[i].file], &handle);
+			replay->pages[i].pins--;
+		}
+	}
+
+	//Counters are taken before shutdown, its final flush isn't part of the
+	//trace
+	getPoolStats(&views[0], &result->stats);
+
+	for (i = 0; i < replay->numFiles; i++) {
+		shutdownBufferPool(&views[i]);
+	}
+	if (replay->numFiles > 1) {
+		shutdownSharedBufferPool();
+	}
+	free(views);
+
+	//All OK
+	return RC_OK;
+}
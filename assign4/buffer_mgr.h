@@ -6,13 +6,16 @@
 #include "storage_mgr.h"
 #include <sys/time.h>
 #include <pthread.h>
+#include <stdint.h>
+#include <sys/types.h>
 
 // Include bool DT
 #include "dt.h"
 
 // Replacement Strategies
 typedef enum ReplacementStrategy {
-	RS_FIFO = 0, RS_LRU = 1, RS_CLOCK = 2, RS_LFU = 3, RS_LRU_K = 4
+	RS_FIFO = 0, RS_LRU = 1, RS_CLOCK = 2, RS_LFU = 3, RS_LRU_K = 4,
+	RS_AUTO = 5
 } ReplacementStrategy;
 
 // Data Types and Structures
@@ -25,36 +28,442 @@ typedef struct BM_BufferPool {
 	ReplacementStrategy strategy;
 	void *mgmtData; // use this one to store the bookkeeping info your buffer
 	// manager needs for a buffer pool
+	int fileId; // slot of pageFile in file table of the pool
 } BM_BufferPool;
 
+// Handles may live anywhere, the caller's stack included. Pin calls fill in
+// frame, which lets later calls on the handle skip the page table lookup.
 typedef struct BM_PageHandle {
 	PageNumber pageNum;
 	char *data;
+	int frame;	// opaque reference to the frame the page is pinned in
 } BM_PageHandle;
 
+// Modes a pinned page can be latched in. Any number of threads may hold a
+// page shared, an exclusive holder has it to itself.
+typedef enum BM_LatchMode {
+	BM_LATCH_NONE = 0, BM_LATCH_SHARED = 1, BM_LATCH_EXCLUSIVE = 2
+} BM_LatchMode;
+
+// Retention class a pin gives its page, see pinPageHint(). Sticky pages are
+// evicted only if nothing else can be, evict-first pages before all others.
+// The class lasts until the page is evicted.
+typedef enum BM_RetentionHint {
+	BM_RETAIN_NORMAL = 0, BM_RETAIN_STICKY = 1, BM_RETAIN_EVICT_FIRST = 2
+} BM_RetentionHint;
+
+// Page file cached by a pool. A private pool caches exactly one page file,
+// the shared pool every page file one of its views is open on.
+typedef struct BM_File {
+	char *name;
+	int refCount;	// views open on the file, 0 if the slot is free
+	SM_FileHandle smFH;
+	bool newBlockRequested;
+	int actualPageFileCnt;
+	PageNumber lastBlockRequested;	// highest page pinned past end of file
+	bool appending;	// new blocks are appended with the pool latch released
+} BM_File;
+
+// Alignment of frame data in the frame arena, suitable for direct I/O
+#define BM_FRAME_ALIGNMENT 4096
+
+// Huge page size the frame arena is rounded up to when huge pages are used
+#define BM_HUGE_PAGE_SIZE (2 * 1024 * 1024)
+
+// How the frame arena of a pool is backed
+typedef enum BM_HugePageState {
+	BM_HUGEPAGE_OFF = 0,	// not requested, regular allocation
+	BM_HUGEPAGE_MAPPED = 1,	// mapped from explicit huge pages (MAP_HUGETLB)
+	BM_HUGEPAGE_ADVISED = 2,	// regular mapping, advised as MADV_HUGEPAGE
+	BM_HUGEPAGE_FAILED = 3	// requested, but kernel refused both
+} BM_HugePageState;
+
+// Page replacement policy of a pool, see buffer_mgr_policy.c for the
+// built-in ones. init sets up the policy's own state, which is passed to
+// all other callbacks, destroy releases it. Pool code tells the policy when
+// a frame is pinned (onAccess), loaded with a page (onLoad), unpinned
+// (onUnpin) and loses its page (onEvict), and asks it for a victim
+// (chooseVictim): a resident frame below numFrames with fix count 0, or -1
+// if there is none.
+// A victim stays the policy's until onEvict, its claim may still fail.
+// onAccess and onUnpin run on latch-free pins and unpins, so they may only
+// touch frame state with atomic operations, all other callbacks run under
+// the pool latch. onUnpin runs after the fix count went down, by then the
+// frame may have been evicted and loaded again. Callbacks other than
+// chooseVictim may be NULL. Frames in retention class BM_RETAIN_STICKY
+// should only be chosen if no other frame can be, evict-first frames are
+// taken by the pool before it asks.
+struct BM_Data;
+
+typedef struct BM_Policy {
+	const char *name;
+	RC (*init)(struct BM_Data * const data, void ** const state);
+	void (*destroy)(struct BM_Data * const data, void * const state);
+	void (*onAccess)(struct BM_Data * const data, void * const state,
+			const int frame);
+	void (*onLoad)(struct BM_Data * const data, void * const state,
+			const int frame);
+	void (*onUnpin)(struct BM_Data * const data, void * const state,
+			const int frame);
+	void (*onEvict)(struct BM_Data * const data, void * const state,
+			const int frame);
+	int (*chooseVictim)(struct BM_Data * const data, void * const state);
+} BM_Policy;
+
+// Optional buffer pool configuration, see initPoolOptions() for defaults
+typedef struct BM_PoolOptions {
+	bool useHugePages;
+	bool backgroundWriter;	// trickle dirty, unpinned frames to disk
+	int writerDirtyTarget;	// % of frames the writer lets stay dirty
+	int writerPagesPerSec;	// max pages the writer writes per second
+	bool prefetch;	// read ahead of sequential and strided pins
+	int prefetchMaxWindow;	// max pages read ahead of a stream
+	int maxPages;	// max pages the pool can be resized to, 0 for default
+	bool warmup;	// save hot pages on close, load them again on open
+	const char *traceFile;	// record page accesses to this file, NULL for none
+	int traceMaxEvents;	// events the trace file holds before it wraps
+	const BM_Policy *policy;	// replaces policy of strategy, NULL for none
+	size_t tierBytes;	// RAM for compressed evicted pages, 0 for none
+	const char *shmName;	// shared memory segment to live in, NULL for none
+} BM_PoolOptions;
+
+// Times a pool opened without maxPages may grow past its initial numPages,
+// unless it uses huge pages
+#define BM_DEFAULT_GROWTH 4
+
+// Interval between two rounds of the background writer
+#define BM_WRITER_INTERVAL_MS 100
+
+// Prefetch window bounds, largest stride still considered a stream and
+// capacity of the queue of pages waiting to be prefetched
+#define BM_PREFETCH_MIN_WINDOW 2
+#define BM_PREFETCH_MAX_STRIDE 16
+#define BM_PREFETCH_QUEUE_SIZE 256
+
+// Number of access streams the prefetcher follows at once
+#define BM_PREFETCH_STREAMS 8
+
+// One access stream followed by the prefetcher
+typedef struct BM_PrefetchStream {
+	int fileId;	// file slot of the stream's page file
+	PageNumber last;	// page last pinned by the stream
+	PageNumber next;	// next page to be queued for the stream
+	int stride;
+	int run;	// pins in a row at stride
+	unsigned long stamp;	// when the stream was last pinned, 0 if unused
+} BM_PrefetchStream;
+
+// Why a page was evicted from its frame
+typedef enum BM_EvictReason {
+	BM_EVICT_REPLACE = 0,	// victim of replacement strategy on a miss
+	BM_EVICT_RING = 1,	// recycled by an access ring
+	BM_EVICT_RESIZE = 2,	// frame retired by shrinking the pool
+	BM_EVICT_CLOSE = 3	// page file closed
+} BM_EvictReason;
+#define BM_EVICT_REASONS 4
+
+// Replacement strategies with their own victim counter
+#define BM_NUM_STRATEGIES 6
+
+// I/O latency histogram, bucket 0 counts I/Os faster than 1us, bucket i
+// those taking [2^(i-1), 2^i) us, the last bucket everything slower.
+// A vectored read or write of several pages counts as a single I/O.
+#define BM_LATENCY_BUCKETS 20
+
+// Counters of a pool, see getPoolStats(). All of them are 64 bit and
+// counted since the pool has been initialized.
+typedef struct BM_PoolStats {
+	uint64_t pinRequests;
+	uint64_t hits;
+	uint64_t misses;	// pins that had to read or create their page
+	uint64_t reads;
+	uint64_t writes;
+	uint64_t writerWrites;	// writes done by the background writer
+	uint64_t newBlocks;	// blocks appended to page files
+	uint64_t evictions[BM_EVICT_REASONS];
+	uint64_t dirtyEvictions;	// evictions that wrote their page back
+	uint64_t strategyVictims[BM_NUM_STRATEGIES];
+	uint64_t autoSwitches[BM_NUM_STRATEGIES];	// RS_AUTO switches to each one
+	uint64_t pinWaits;	// pins that waited on the latch or a frame in I/O
+	uint64_t pinWaitNanos;
+	uint64_t latchWaits;	// page latches that had to wait for their holders
+	uint64_t latchWaitNanos;
+	uint64_t readNanos;
+	uint64_t writeNanos;
+	uint64_t readLatency[BM_LATENCY_BUCKETS];
+	uint64_t writeLatency[BM_LATENCY_BUCKETS];
+	uint64_t prefetches;
+	uint64_t prefetchHits;
+	uint64_t prefetchWastes;
+	uint64_t tierStores;	// evicted pages kept in the compressed tier
+	uint64_t tierHits;	// misses served by the compressed tier
+} BM_PoolStats;
+
+// Suffix of the sidecar file a page file's hot pages are saved to
+#define BM_WARMUP_SUFFIX ".warm"
+
+// Page file waiting to be warmed up from its sidecar
+typedef struct BM_WarmupJob {
+	int fileId;
+	char *sidecar;
+	struct BM_WarmupJob *next;
+} BM_WarmupJob;
+
+// Page accesses a trace records, see buffer_mgr_trace.c
+typedef enum BM_TraceOp {
+	BM_TRACE_PIN = 0, BM_TRACE_UNPIN = 1, BM_TRACE_DIRTY = 2
+} BM_TraceOp;
+
+// Trace file: a BM_TraceHeader followed by a ring of capacity events. Once
+// numEvents exceeds capacity, the oldest event is at numEvents % capacity.
+#define BM_TRACE_MAGIC 0x424d5452
+#define BM_TRACE_BUFFER 1024
+
+typedef struct BM_TraceHeader {
+	uint32_t magic;
+	uint32_t eventSize;	// sizeof(BM_TraceEvent)
+	uint64_t capacity;
+	uint64_t numEvents;	// events recorded so far, wrapped ones included
+} BM_TraceHeader;
+
+typedef struct BM_TraceEvent {
+	uint64_t time;	// ns since tracing started
+	int32_t pageNum;
+	uint16_t file;	// slot of the page file in file table of the pool
+	uint8_t op;	// BM_TraceOp
+	uint8_t pad;
+} BM_TraceEvent;
+
+// Trace of a pool being recorded. Events are collected in buffer and go to
+// the file BM_TRACE_BUFFER at a time.
+typedef struct BM_Trace {
+	pthread_mutex_t lock;
+	int fd;
+	uint64_t start;	// statClock() when tracing started
+	uint64_t capacity;
+	uint64_t numEvents;
+	int numBuffered;
+	BM_TraceEvent buffer[BM_TRACE_BUFFER];
+} BM_Trace;
+
+// Compressed page kept by the compressed tier, see buffer_mgr_tier.c
+typedef struct BM_TierEntry {
+	struct BM_TierEntry *hashNext;
+	struct BM_TierEntry *older;	// entries in the order they were stored
+	struct BM_TierEntry *newer;
+	int file;	// slot of the page file in file table of the pool
+	PageNumber pageNum;
+	int size;	// size of data
+	char data[];
+} BM_TierEntry;
+
+// Largest a compressed page may be to be kept by the compressed tier
+#define BM_TIER_MAX_SIZE (PAGE_SIZE / 2)
+
+// Compressed tier of a pool, holding up to maxBytes of entries
+typedef struct BM_Tier {
+	size_t maxBytes;
+	size_t usedBytes;	// entries including their headers
+	int numBuckets;
+	BM_TierEntry **buckets;
+	BM_TierEntry *oldest;	// dropped first to make room
+	BM_TierEntry *newest;
+	char buffer[BM_TIER_MAX_SIZE];	// page being compressed
+} BM_Tier;
+
+// Clients, i.e. pools of any process, a shared memory pool takes at a time,
+// page files they may have open and longest page file name
+#define BM_SHM_MAX_CLIENTS 64
+#define BM_SHM_MAX_FILES 64
+#define BM_SHM_NAME_SIZE 256
+
+// Magic of a shared memory pool segment, set once it's initialized and
+// replaced by BM_SHM_DEAD once the last client has detached
+#define BM_SHM_MAGIC 0x424d5348
+#define BM_SHM_DEAD 0x424d5844
+
+// Latch event of a shared memory pool client beginning an upgrade of its
+// shared page latch, see noteShmLatch()
+#define BM_SHM_LATCH_UPGRADING 3
+
+// Page file slot of a shared memory pool
+typedef struct BM_ShmFile {
+	char name[BM_SHM_NAME_SIZE];	// empty if the slot is free
+	int refCount;	// clients open on the file
+	int totalNumPages;	// page count of the file, grown by any client
+	unsigned int generation;	// bumped whenever the slot is freed
+} BM_ShmFile;
+
+// Client slot of a shared memory pool
+typedef struct BM_ShmClient {
+	pid_t pid;	// 0 if the slot is free
+	int file;	// slot of the client's page file
+} BM_ShmClient;
+
+// Start of a shared memory pool segment, see buffer_mgr_shm.c for the rest
+typedef struct BM_ShmHeader {
+	uint32_t magic;
+	int numFrames;
+	int numBuckets;
+	size_t size;	// of the whole segment
+	pthread_mutex_t lock;	// robust and process-shared
+	int numClients;
+	int clockHand;
+	BM_ShmClient clients[BM_SHM_MAX_CLIENTS];
+	BM_ShmFile files[BM_SHM_MAX_FILES];
+} BM_ShmHeader;
+
+// Attachment of a pool to a shared memory pool segment, private to the
+// process. Page files are opened by each client on its own.
+typedef struct BM_Shm {
+	char *name;
+	BM_ShmHeader *header;
+	int client;	// slot of the pool in header->clients
+	int waits;	// for I/O of other clients, under the segment latch
+	int *buckets;
+	int *hashNext;
+	int *ioOwner;	// client doing the I/O of each frame
+	int *referenced;	// CLOCK reference bit of each frame
+	int *pins;	// pins of each client on each frame
+	int *latches;	// latches of each client on each frame, see noteShmLatch
+	SM_FileHandle handles[BM_SHM_MAX_FILES];	// mgmtInfo NULL if not open
+	unsigned int generations[BM_SHM_MAX_FILES];	// of the slot when opened
+} BM_Shm;
+
+// Private ring of frames a large sequential pass recycles on its misses,
+// instead of evicting the working set of the pool
+typedef struct BM_AccessRing {
+	int size;
+	int next;
+	int *frames;
+	PageNumber *pages;
+} BM_AccessRing;
+
+// Most frames a flush claims and writes at a time
+#define BM_FLUSH_BATCH 256
+
+// Default access ring size for table scans
+#define BM_SCAN_RING_SIZE 32
+
+// Number of independently latched partitions of the page table
+#define BM_PAGE_TABLE_SHARDS 16
+
+// One partition of the page table. Frames holding pages that hash to a
+// bucket are chained through BM_Data.hashNext.
+typedef struct BM_PageTableShard {
+	pthread_mutex_t lock;
+	int numBuckets;
+	int *buckets;
+} BM_PageTableShard;
+
+// Fix count of a frame claimed for eviction/load under the pool latch.
+// Latch-free pins never pin a frame in this state.
+#define FRAME_EVICTING -1
+
+// I/O state of a page frame. Disk I/O runs without the pool latch on a
+// claimed frame; pins of its page wait on the frame's condition meanwhile.
+#define FRAME_READY 0
+#define FRAME_READING 1
+#define FRAME_WRITING 2
+
+// Layout of the latch word of a frame: no of shared holders in the low bits,
+// plus flags for an exclusive holder, a shared holder waiting to upgrade and
+// exclusive latchers waiting, which hold off new shared latchers.
+#define BM_LATCH_SHARED_MASK 0x0fffffff
+#define BM_LATCH_EXCLUSIVE_BIT 0x10000000
+#define BM_LATCH_UPGRADING 0x20000000
+#define BM_LATCH_WAITING 0x40000000
+
 typedef struct BM_Data {
+	pthread_mutex_t poolLock;
+	int maxFrames;	// frame arrays are allocated for this many frames
+	int numFrames;	// frames replacement picks victims from
+	int numFramesUsed;	// frames that may hold pages, retired ones included
+	int numFramesInit;	// frames whose condition variables are initialized
+	int numShards;
+	BM_PageTableShard *shards;
+	int *hashNext;
 	int numDirtyPages;
 	int numPinnedPages;
-	int numReadIO;
-	int numWriteIO;
-	bool newBlockRequested;
-	int actualPageFileCnt;
-	int extraBlockReqCount;
-	struct timeval *pageInTime;
-	struct timeval *pageUsedTime;
+	unsigned long clock;
+	unsigned long *pageInTime;
+	unsigned long *pageUsedTime;
 	int *pageUsedCount;
-	float pageHit;
-	float pinReqCount;
-	float hitRatio;
-	SM_FileHandle smFH;
+	const BM_Policy *policy;	// replacement policy picking victims
+	void *policyState;	// private state of the policy
+	int numFramesLoaded;	// frames the policy knows to hold a page
+	int *retention;	// BM_RetentionHint of the page of each frame
+	int numEvictFirst;	// frames in retention class BM_RETAIN_EVICT_FIRST
+	int evictFirstHand;	// next frame looked at for an evict-first victim
+	BM_PoolStats stats;
+	bool shared;
+	BM_File **files;
+	int numFiles;
+	int *frameFile;
 	PageNumber *pageFrameIndexMap;
 	bool *dirtyFlags;
+	pthread_mutex_t dirtyLock;	// guards dirty flag changes and dirty list
+	int dirtyHead;	// most recently dirtied frame, -1 if none is dirty
+	int *dirtyNext;	// dirty frames are chained through these
+	int *dirtyPrev;
 	PageNumber *fixCount;
-	BM_PageHandle **pages;
+	int *frameState;
+	int *pageLatch;	// latch word of each frame, see BM_LATCH_*
+	pthread_cond_t *frameCond;
+	pthread_cond_t frameIdle;
+	int numFramesInIO;
+	BM_PageHandle *pages;
+	char *frameArena;
+	size_t arenaSize;
+	BM_HugePageState hugePageState;
+	bool writerRunning;
+	bool writerStop;
+	pthread_t writer;
+	pthread_cond_t writerCond;
+	int writerCursor;
+	int writerDirtyPercent;
+	int writerDirtyTarget;
+	int writerPagesPerRound;
+	bool prefetchRunning;
+	bool prefetchStop;
+	pthread_t prefetcher;
+	pthread_mutex_t prefetchLock;
+	pthread_cond_t prefetchCond;
+	PageNumber *prefetchQueue;
+	int *prefetchQueueFile;
+	int prefetchHead;
+	int prefetchTail;
+	BM_PrefetchStream prefetchStreams[BM_PREFETCH_STREAMS];
+	unsigned long prefetchClock;
+	int prefetchWindow;
+	int prefetchMaxWindow;
+	bool *prefetched;
+	bool warmupEnabled;
+	bool warmupRunning;
+	bool warmupStop;
+	bool warmupCancel;
+	pthread_t warmer;
+	pthread_mutex_t warmupLock;
+	pthread_cond_t warmupCond;
+	BM_WarmupJob *warmupJobs;
+	int warmupFile;
+	BM_Trace *trace;	// NULL unless accesses are traced
+	BM_Tier *tier;	// NULL unless evicted pages are kept compressed
+	BM_Shm *shm;	// NULL unless the pool lives in shared memory
 } BM_Data;
 
-pthread_mutex_t GLOBAL_LOCK;
-pthread_mutex_t PAGE_FRAME_LOCK;
+// atomic accessors for frame state touched outside the pool latch
+#define ATOMIC_LOAD(var)	__atomic_load_n(&(var), __ATOMIC_ACQUIRE)
+#define ATOMIC_STORE(var, val)	__atomic_store_n(&(var), (val), __ATOMIC_RELEASE)
+#define ATOMIC_INC(var)	__atomic_add_fetch(&(var), 1, __ATOMIC_ACQ_REL)
+#define ATOMIC_DEC(var)	__atomic_sub_fetch(&(var), 1, __ATOMIC_ACQ_REL)
+#define ATOMIC_XCHG(var, val)	__atomic_exchange_n(&(var), (val), __ATOMIC_ACQ_REL)
+#define ATOMIC_CAS(var, expected, desired)				\
+		__atomic_compare_exchange_n(&(var), &(expected), (desired), FALSE, \
+				__ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)
+
+// statistics counters need no ordering, only no lost updates
+#define STAT_ADD(var, n)	__atomic_add_fetch(&(var), (n), __ATOMIC_RELAXED)
 
 // convenience macros
 #define MAKE_POOL()					\
@@ -67,8 +476,24 @@ pthread_mutex_t PAGE_FRAME_LOCK;
 extern RC initBufferPool(BM_BufferPool * const bm,
 		const char * const pageFileName, const int numPages,
 		ReplacementStrategy strategy, void *stratData);
+extern RC initBufferPoolWithOptions(BM_BufferPool * const bm,
+		const char * const pageFileName, const int numPages,
+		ReplacementStrategy strategy, void *stratData,
+		const BM_PoolOptions * const options);
+extern void initPoolOptions(BM_PoolOptions * const options);
 extern RC shutdownBufferPool(BM_BufferPool * const bm);
 extern RC forceFlushPool(BM_BufferPool * const bm);
+extern RC resizeBufferPool(BM_BufferPool * const bm, const int newNumPages);
+extern RC backupPool(BM_BufferPool * const bm,
+		const char * const backupFileName);
+
+// Buffer Manager Interface Shared Pool
+// While the shared pool is up, initBufferPool returns a view on it instead
+// of a private pool: numPages and strategy are those of the shared pool and
+// its frames are balanced across the page files of all views.
+extern RC initSharedBufferPool(const int numPages, ReplacementStrategy strategy,
+		void *stratData, const BM_PoolOptions * const options);
+extern RC shutdownSharedBufferPool(void);
 
 // Buffer Manager Interface Access Pages
 extern RC markDirty(BM_BufferPool * const bm, BM_PageHandle * const page);
@@ -76,6 +501,34 @@ extern RC unpinPage(BM_BufferPool * const bm, BM_PageHandle * const page);
 extern RC forcePage(BM_BufferPool * const bm, BM_PageHandle * const page);
 extern RC pinPage(BM_BufferPool * const bm, BM_PageHandle * const page,
 		const PageNumber pageNum);
+extern RC pinPageHint(BM_BufferPool * const bm, BM_PageHandle * const page,
+		const PageNumber pageNum, const BM_RetentionHint hint);
+extern RC pinPages(BM_BufferPool * const bm, const PageNumber * const pageNums,
+		const int n, BM_PageHandle * const pages);
+extern RC unpinPages(BM_BufferPool * const bm, BM_PageHandle * const pages,
+		const int n);
+
+// Buffer Manager Interface Page Latches
+// A latch orders access to the contents of a pinned page. Latches aren't
+// reentrant and must be released before the page is unpinned.
+extern RC pinPageLatched(BM_BufferPool * const bm, BM_PageHandle * const page,
+		const PageNumber pageNum, const BM_LatchMode mode);
+extern RC unpinPageLatched(BM_BufferPool * const bm,
+		BM_PageHandle * const page);
+extern RC latchPage(BM_BufferPool * const bm, BM_PageHandle * const page,
+		const BM_LatchMode mode);
+extern RC tryLatchPage(BM_BufferPool * const bm, BM_PageHandle * const page,
+		const BM_LatchMode mode);
+extern RC upgradePageLatch(BM_BufferPool * const bm,
+		BM_PageHandle * const page);
+extern RC unlatchPage(BM_BufferPool * const bm, BM_PageHandle * const page);
+
+// Buffer Manager Interface Access Rings
+extern RC initAccessRing(BM_BufferPool * const bm, BM_AccessRing * const ring,
+		const int size);
+extern void freeAccessRing(BM_AccessRing * const ring);
+extern RC pinPageWithRing(BM_BufferPool * const bm, BM_AccessRing * const ring,
+		BM_PageHandle * const page, const PageNumber pageNum);
 
 // Statistics Interface
 PageNumber *getFrameContents(BM_BufferPool * const bm);
@@ -85,9 +538,102 @@ int getNumReadIO(BM_BufferPool * const bm);
 int getNumWriteIO(BM_BufferPool * const bm);
 float getPageHitCount(BM_BufferPool * const bm);
 float getPageHitRatio(BM_BufferPool * const bm);
+BM_HugePageState getHugePageState(BM_BufferPool * const bm);
+int getNumWriterWriteIO(BM_BufferPool * const bm);
+long getPrefetchCount(BM_BufferPool * const bm);
+long getPrefetchHitCount(BM_BufferPool * const bm);
+long getPrefetchWasteCount(BM_BufferPool * const bm);
+float getPrefetchHitRatio(BM_BufferPool * const bm);
+RC getPoolStats(BM_BufferPool * const bm, BM_PoolStats * const stats);
 
 extern void printIOStat(BM_BufferPool * const bm);
 extern bool writeNewBlocks(BM_BufferPool * const bm, PageNumber num);
 extern void printDebugInfo(BM_BufferPool * const bm);
+extern int getHandleFrameIndex(BM_BufferPool * const bm,
+		const BM_PageHandle * const page);
+extern bool setFrameDirty(BM_Data * const data, const int frame);
+extern bool clearFrameDirty(BM_Data * const data, const int frame);
+extern bool writeBackFrame(BM_BufferPool * const bm, const int num);
+extern int prefetchPages(BM_BufferPool * const bm,
+		const PageNumber * const pageNums, const int n);
+extern RC evictFilePages(BM_BufferPool * const bm);
+extern int flushFilePages(BM_BufferPool * const bm);
+extern uint64_t statClock(void);
+extern void noteIOLatency(BM_Data * const data, const bool write,
+		const uint64_t start);
+extern void notePinWait(BM_Data * const data, const uint64_t start);
+extern void evictRetiredFrames(BM_BufferPool * const bm);
+
+// Page table
+extern RC initPageTable(BM_Data * const data, const int numPages);
+extern void destroyPageTable(BM_Data * const data);
+extern int lookupPageTable(BM_Data * const data, const int file,
+		const PageNumber pageNum);
+extern int probePageTable(BM_Data * const data, const int file,
+		const PageNumber pageNum);
+extern void insertPageTable(BM_Data * const data, const int file,
+		const PageNumber pageNum, const int frame);
+extern void removePageTable(BM_Data * const data, const int file,
+		const PageNumber pageNum, const int frame);
+
+// Background writer
+extern RC startBackgroundWriter(BM_BufferPool * const bm,
+		const BM_PoolOptions * const options);
+extern void stopBackgroundWriter(BM_BufferPool * const bm);
+
+// Prefetcher
+extern RC startPrefetcher(BM_BufferPool * const bm,
+		const BM_PoolOptions * const options);
+extern void stopPrefetcher(BM_BufferPool * const bm);
+extern void notePrefetchAccess(BM_BufferPool * const bm,
+		const PageNumber pageNum);
+extern void notePrefetchUse(BM_BufferPool * const bm, const bool used);
+
+// Warm-up
+extern RC startWarmer(BM_BufferPool * const bm,
+		const BM_PoolOptions * const options);
+extern void stopWarmer(BM_BufferPool * const bm);
+extern void queueWarmup(BM_BufferPool * const bm);
+extern void cancelWarmup(BM_BufferPool * const bm);
+extern void saveWarmupList(BM_BufferPool * const bm);
+
+// Replacement policies
+extern const BM_Policy *getStrategyPolicy(const ReplacementStrategy strategy);
+extern RC initPolicy(BM_Data * const data, const BM_Policy * const policy);
+extern void destroyPolicy(BM_Data * const data);
+
+// Access trace
+extern RC startTrace(BM_BufferPool * const bm,
+		const BM_PoolOptions * const options);
+extern void stopTrace(BM_BufferPool * const bm);
+extern void traceAccess(BM_BufferPool * const bm, const BM_TraceOp op,
+		const PageNumber pageNum);
+
+// Compressed tier
+extern RC startTier(BM_BufferPool * const bm,
+		const BM_PoolOptions * const options);
+extern void stopTier(BM_BufferPool * const bm);
+extern void storeTierPage(BM_BufferPool * const bm, const int num);
+extern bool loadTierPage(BM_BufferPool * const bm, const int file,
+		const PageNumber pageNum, char * const data);
+extern void dropTierFile(BM_BufferPool * const bm, const int file);
+
+// Shared memory pools
+extern RC attachShmPool(BM_BufferPool * const bm,
+		const char * const pageFileName, const int numPages,
+		const BM_PoolOptions * const options);
+extern RC detachShmPool(BM_BufferPool * const bm);
+extern RC flushShmPool(BM_BufferPool * const bm);
+extern RC pinShmPage(BM_BufferPool * const bm, BM_PageHandle * const page,
+		const PageNumber pageNum);
+extern RC pinShmPages(BM_BufferPool * const bm,
+		const PageNumber * const pageNums, const int n,
+		BM_PageHandle * const pages);
+extern RC unpinShmPage(BM_BufferPool * const bm, BM_PageHandle * const page);
+extern RC forceShmPage(BM_BufferPool * const bm, BM_PageHandle * const page);
+extern int findShmFrame(BM_BufferPool * const bm, const PageNumber pageNum);
+extern void noteShmLatch(BM_Data * const data, const int frame,
+		const int mode);
+extern void recoverShmClients(BM_Data * const data);
 
 #endif
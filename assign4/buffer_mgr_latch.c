@@ -0,0 +1,341 @@
+/*
+ * buffer_mgr_latch.c
+ *
+ *  Shared/exclusive latches protecting the contents of page frames. A pin
+ *  only keeps a page resident, a latch on its frame orders the threads
+ *  reading and writing the page. Each latch is a single word in
+ *  BM_Data.pageLatch: a count of shared holders plus flags for an exclusive
+ *  holder, a pending upgrade and waiting exclusive latchers. Latches are
+ *  taken and released with atomic operations only, waiters spin a while and
+ *  then yield the CPU. Latches are held briefly, never across pool calls
+ *  that may wait for I/O.
+ */
+
+#include "buffer_mgr.h"
+
+#include <sched.h>
+
+#define PRIVATE static
+
+//Spins on a busy latch before the waiter starts to yield the CPU
+#define LATCH_SPINS 64
+
+//Waits on a busy latch of a shared memory pool between two looks for a
+//dead holder
+#define LATCH_SHM_CHECK 4096
+
+PRIVATE inline int getLatchedFrameIndex(BM_BufferPool * const,
+		const BM_PageHandle * const);
+PRIVATE inline bool tryLatchFrame(BM_Data * const, const int,
+		const BM_LatchMode);
+PRIVATE inline void backOff(BM_Data * const, int * const);
+
+/**
+ * Pins page pageNum like pinPage and latches it in mode. With BM_LATCH_NONE
+ * this is a plain pin.
+ *
+ * bm = buffer pool handle
+ * page = page handle to hold data and corresponding page number
+ * pageNum = page number to be pinned
+ * mode = latch mode the page is pinned in
+ */
+RC pinPageLatched(BM_BufferPool * const bm, BM_PageHandle * const page,
+		const PageNumber pageNum, const BM_LatchMode mode) {
+
+	RC ret = pinPage(bm, page, pageNum);
+	if (ret != RC_OK || mode == BM_LATCH_NONE) {
+		return ret;
+	}
+
+	ret = latchPage(bm, page, mode);
+	if (ret != RC_OK) {
+		unpinPage(bm, page);
+	}
+	return ret;
+}
+
+/**
+ * Latches the frame of pinned page in mode, waiting while a conflicting
+ * latch is held. Shared latchers wait behind a waiting exclusive latcher, so
+ * a stream of readers can't starve writers. Latches aren't reentrant.
+ *
+ * bm = buffer pool handle
+ * page = handle of the pinned page
+ * mode = BM_LATCH_SHARED or BM_LATCH_EXCLUSIVE
+ */
+RC latchPage(BM_BufferPool * const bm, BM_PageHandle * const page,
+		const BM_LatchMode mode) {
+
+	//Sanity checks
+	if (bm == NULL || bm->mgmtData == NULL) {
+		THROW(RC_INVALID_HANDLE, "Buffer pool handle is invalid");
+	}
+	if (page == NULL) {
+		THROW(RC_INVALID_HANDLE, "Page handle is invalid");
+	}
+	if (mode != BM_LATCH_SHARED && mode != BM_LATCH_EXCLUSIVE) {
+		THROW(RC_INVALID_OP, "Invalid latch mode");
+	}
+
+	int index = getLatchedFrameIndex(bm, page);
+	if (index == -1) {
+		THROW(RC_PAGE_NOT_PINNED, "Requested page has not been pinned");
+	}
+
+	if (tryLatchFrame((BM_Data *) bm->mgmtData, index, mode)) {
+		return RC_OK;
+	}
+
+	uint64_t start = statClock();
+	int spins = 0;
+	while (!tryLatchFrame((BM_Data *) bm->mgmtData, index, mode)) {
+		//Announce the writer, so no new readers get in ahead of it
+		if (mode == BM_LATCH_EXCLUSIVE) {
+			__atomic_or_fetch(&((BM_Data *) bm->mgmtData)->pageLatch[index],
+					BM_LATCH_WAITING, __ATOMIC_RELAXED);
+		}
+		backOff((BM_Data *) bm->mgmtData, &spins);
+	}
+	STAT_ADD(((BM_Data *) bm->mgmtData)->stats.latchWaits, 1);
+	STAT_ADD(((BM_Data *) bm->mgmtData)->stats.latchWaitNanos,
+			statClock() - start);
+
+	//All OK
+	return RC_OK;
+}
+
+/**
+ * Latches the frame of pinned page in mode if that's possible without
+ * waiting, fails with RC_PAGE_LATCH_BUSY otherwise.
+ *
+ * bm = buffer pool handle
+ * page = handle of the pinned page
+ * mode = BM_LATCH_SHARED or BM_LATCH_EXCLUSIVE
+ */
+RC tryLatchPage(BM_BufferPool * const bm, BM_PageHandle * const page,
+		const BM_LatchMode mode) {
+
+	//Sanity checks
+	if (bm == NULL || bm->mgmtData == NULL) {
+		THROW(RC_INVALID_HANDLE, "Buffer pool handle is invalid");
+	}
+	if (page == NULL) {
+		THROW(RC_INVALID_HANDLE, "Page handle is invalid");
+	}
+	if (mode != BM_LATCH_SHARED && mode != BM_LATCH_EXCLUSIVE) {
+		THROW(RC_INVALID_OP, "Invalid latch mode");
+	}
+
+	int index = getLatchedFrameIndex(bm, page);
+	if (index == -1) {
+		THROW(RC_PAGE_NOT_PINNED, "Requested page has not been pinned");
+	}
+
+	if (!tryLatchFrame((BM_Data *) bm->mgmtData, index, mode)) {
+		THROW(RC_PAGE_LATCH_BUSY, "Page is latched by another thread");
+	}
+
+	//All OK
+	return RC_OK;
+}
+
+/**
+ * Turns the shared latch the caller holds on page into an exclusive one,
+ * waiting for the other shared holders to leave. Only one upgrade may be
+ * pending per page: a second upgrader would wait for the first forever, so
+ * it fails with RC_PAGE_LATCH_BUSY instead and still holds its shared latch.
+ *
+ * bm = buffer pool handle
+ * page = handle of the page latched shared
+ */
+RC upgradePageLatch(BM_BufferPool * const bm, BM_PageHandle * const page) {
+
+	//Sanity checks
+	if (bm == NULL || bm->mgmtData == NULL) {
+		THROW(RC_INVALID_HANDLE, "Buffer pool handle is invalid");
+	}
+	if (page == NULL) {
+		THROW(RC_INVALID_HANDLE, "Page handle is invalid");
+	}
+
+	int index = getLatchedFrameIndex(bm, page);
+	if (index == -1) {
+		THROW(RC_PAGE_NOT_PINNED, "Requested page has not been pinned");
+	}
+
+	int *latch = &((BM_Data *) bm->mgmtData)->pageLatch[index];
+	int value = ATOMIC_LOAD(*latch);
+	do {
+		if ((value & BM_LATCH_SHARED_MASK) == 0
+				|| (value & BM_LATCH_EXCLUSIVE_BIT) != 0) {
+			THROW(RC_INVALID_OP, "Page is not latched shared");
+		}
+		if ((value & BM_LATCH_UPGRADING) != 0) {
+			THROW(RC_PAGE_LATCH_BUSY, "Page latch is being upgraded already");
+		}
+	} while (!ATOMIC_CAS(*latch, value, value | BM_LATCH_UPGRADING));
+	if (((BM_Data *) bm->mgmtData)->shm != NULL) {
+		noteShmLatch((BM_Data *) bm->mgmtData, index, BM_SHM_LATCH_UPGRADING);
+	}
+
+	//Pending upgrade keeps new latchers out, wait until we're the last reader
+	uint64_t start = statClock();
+	int spins = 0;
+	bool waited = FALSE;
+	value = ATOMIC_LOAD(*latch);
+	for (;;) {
+		if ((value & BM_LATCH_SHARED_MASK) == 1) {
+			if (ATOMIC_CAS(*latch, value, BM_LATCH_EXCLUSIVE_BIT)) {
+				if (((BM_Data *) bm->mgmtData)->shm != NULL) {
+					noteShmLatch((BM_Data *) bm->mgmtData, index,
+							BM_LATCH_EXCLUSIVE);
+				}
+				break;
+			}
+			continue;
+		}
+		waited = TRUE;
+		backOff((BM_Data *) bm->mgmtData, &spins);
+		value = ATOMIC_LOAD(*latch);
+	}
+	if (waited) {
+		STAT_ADD(((BM_Data *) bm->mgmtData)->stats.latchWaits, 1);
+		STAT_ADD(((BM_Data *) bm->mgmtData)->stats.latchWaitNanos,
+				statClock() - start);
+	}
+
+	//All OK
+	return RC_OK;
+}
+
+/**
+ * Releases the latch the caller holds on page, whichever mode it was taken
+ * in. Must be called before the page is unpinned.
+ *
+ * bm = buffer pool handle
+ * page = handle of the latched page
+ */
+RC unlatchPage(BM_BufferPool * const bm, BM_PageHandle * const page) {
+
+	//Sanity checks
+	if (bm == NULL || bm->mgmtData == NULL) {
+		THROW(RC_INVALID_HANDLE, "Buffer pool handle is invalid");
+	}
+	if (page == NULL) {
+		THROW(RC_INVALID_HANDLE, "Page handle is invalid");
+	}
+
+	int index = getLatchedFrameIndex(bm, page);
+	if (index == -1) {
+		THROW(RC_PAGE_NOT_PINNED, "Requested page has not been pinned");
+	}
+
+	//An exclusive latch excludes shared holders, so the exclusive flag tells
+	//which one the caller holds
+	int *latch = &((BM_Data *) bm->mgmtData)->pageLatch[index];
+	int value = ATOMIC_LOAD(*latch);
+	if ((value & BM_LATCH_EXCLUSIVE_BIT) != 0) {
+		__atomic_and_fetch(latch, ~BM_LATCH_EXCLUSIVE_BIT, __ATOMIC_RELEASE);
+	} else if ((value & BM_LATCH_SHARED_MASK) != 0) {
+		__atomic_sub_fetch(latch, 1, __ATOMIC_RELEASE);
+	} else {
+		THROW(RC_INVALID_OP, "Page is not latched");
+	}
+	if (((BM_Data *) bm->mgmtData)->shm != NULL) {
+		noteShmLatch((BM_Data *) bm->mgmtData, index, BM_LATCH_NONE);
+	}
+
+	//All OK
+	return RC_OK;
+}
+
+/**
+ * Unlatches page, then unpins it.
+ *
+ * bm = buffer pool handle
+ * page = handle of the latched page
+ */
+RC unpinPageLatched(BM_BufferPool * const bm, BM_PageHandle * const page) {
+
+	RC ret = unlatchPage(bm, page);
+	if (ret != RC_OK) {
+		return ret;
+	}
+	return unpinPage(bm, page);
+}
+
+/**
+ * Private utility function to find frame of a page the caller has pinned.
+ * Returns -1 if the page isn't pinned.
+ *
+ * bm = buffer pool handle
+ * page = handle of the pinned page
+ */
+PRIVATE inline int getLatchedFrameIndex(BM_BufferPool * const bm,
+		const BM_PageHandle * const page) {
+
+	int index = getHandleFrameIndex(bm, page);
+	if (index != -1
+			&& ATOMIC_LOAD(((BM_Data *) bm->mgmtData)->fixCount[index]) <= 0) {
+		return -1;
+	}
+	return index;
+}
+
+/**
+ * Private utility function to take latch of frame in mode if it's free for
+ * that mode. Returns TRUE if the latch was taken.
+ *
+ * data = buffer pool management data
+ * frame = index of the page frame
+ * mode = BM_LATCH_SHARED or BM_LATCH_EXCLUSIVE
+ */
+PRIVATE inline bool tryLatchFrame(BM_Data * const data, const int frame,
+		const BM_LatchMode mode) {
+
+	int value = ATOMIC_LOAD(data->pageLatch[frame]);
+
+	if (mode == BM_LATCH_EXCLUSIVE) {
+		//Free but for waiting writers, we may be one of them
+		while ((value & ~BM_LATCH_WAITING) == 0) {
+			if (ATOMIC_CAS(data->pageLatch[frame], value,
+					BM_LATCH_EXCLUSIVE_BIT)) {
+				if (data->shm != NULL) {
+					noteShmLatch(data, frame, mode);
+				}
+				return TRUE;
+			}
+		}
+		return FALSE;
+	}
+
+	while ((value
+			& (BM_LATCH_EXCLUSIVE_BIT | BM_LATCH_UPGRADING | BM_LATCH_WAITING))
+			== 0) {
+		if (ATOMIC_CAS(data->pageLatch[frame], value, value + 1)) {
+			if (data->shm != NULL) {
+				noteShmLatch(data, frame, mode);
+			}
+			return TRUE;
+		}
+	}
+	return FALSE;
+}
+
+/**
+ * Private utility function to wait a little for a busy latch: spin first,
+ * then yield the CPU to the holder. The holder of a latch of a shared memory
+ * pool may be a client that died, so now and then its latches are looked
+ * for.
+ *
+ * data = buffer pool management data
+ * spins = no of times the caller waited so far
+ */
+PRIVATE inline void backOff(BM_Data * const data, int * const spins) {
+	if ((*spins)++ >= LATCH_SPINS) {
+		sched_yield();
+		if (data->shm != NULL && *spins % LATCH_SHM_CHECK == 0) {
+			recoverShmClients(data);
+		}
+	}
+}
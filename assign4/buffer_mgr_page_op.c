@@ -9,15 +9,51 @@
 
 #include <stdio.h>
 #include <stdlib.h>
-#include <sys/time.h>
+#include <sys/mman.h>
 
 #define PRIVATE static
 
+//Dirty frame collected for write back, ordered by page number
+typedef struct FlushEntry {
+	PageNumber pageNum;
+	int frame;
+} FlushEntry;
+
 void *memset(void *, int, size_t);
+void *memcpy(void *, const void *, size_t);
 
 PRIVATE inline int getPageFrameIndex(BM_BufferPool * const, const PageNumber);
+PRIVATE inline int getPinnedFrameIndex(BM_BufferPool * const,
+		const PageNumber);
+PRIVATE inline int pinResidentFrame(BM_BufferPool * const, const PageNumber);
+PRIVATE inline void notePageAccess(BM_BufferPool * const, const int);
+PRIVATE inline void setFrameRetention(BM_Data * const, const int,
+		const BM_RetentionHint);
+PRIVATE inline void noteRetentionHint(BM_BufferPool * const, const int,
+		const BM_RetentionHint);
+PRIVATE RC pinPageGeneric(BM_BufferPool * const, BM_PageHandle * const,
+		const PageNumber, BM_AccessRing * const, const BM_RetentionHint);
 PRIVATE inline int getFreeFrameIndex(BM_BufferPool * const);
-PRIVATE inline void checkAndSwapPage(BM_BufferPool * const, PageNumber);
+PRIVATE int getRingFrameIndex(BM_BufferPool * const, BM_AccessRing * const,
+		const PageNumber);
+PRIVATE inline int chooseVictimFrame(BM_BufferPool * const);
+PRIVATE inline bool checkAndSwapPage(BM_BufferPool * const, PageNumber,
+		const BM_EvictReason);
+PRIVATE RC loadClaimedFrame(BM_BufferPool * const, const int,
+		const PageNumber);
+PRIVATE RC loadClaimedFrames(BM_BufferPool * const, int * const,
+		const PageNumber * const, const int);
+PRIVATE bool publishClaimedFrame(BM_BufferPool * const, const int,
+		const PageNumber);
+PRIVATE RC finishClaimedFrame(BM_BufferPool * const, const int, const RC);
+PRIVATE bool writeClaimedFrame(BM_BufferPool * const, const int);
+PRIVATE inline bool holdFrame(BM_Data * const, const int);
+PRIVATE inline void beginFrameIO(BM_BufferPool * const, const int, const int);
+PRIVATE inline void endFrameIO(BM_BufferPool * const, const int);
+PRIVATE inline void latchPoolForPin(BM_BufferPool * const);
+PRIVATE int compareFlushEntries(const void *, const void *);
+PRIVATE inline void waitForPin(BM_BufferPool * const, pthread_cond_t * const);
+PRIVATE inline void unlinkDirtyFrame(BM_Data * const, const int);
 
 /**
  * Marks a page in buffer pool as modified / dirtied
@@ -35,24 +71,22 @@ RC markDirty(BM_BufferPool * const bm, BM_PageHandle * const page) {
 		THROW(RC_INVALID_HANDLE, "Page handle is invalid");
 	}
 
-	//Look up if requested page already exists in pool
-	int index = getPageFrameIndex(bm, page->pageNum);
+	//Look up frame of the pinned page
+	int index = getHandleFrameIndex(bm, page);
 
 	if (index == -1) {
 		THROW(RC_PAGE_NOT_PINNED, "Requested page has not been pinned");
 	}
 
-	//Acquire GLOBAL lock
-	pthread_mutex_lock(&GLOBAL_LOCK);
-	//Check if page is already marked as dirty
-	if (((BM_Data *) bm->mgmtData)->dirtyFlags[index] == FALSE) {
-		//Mark page as dirty
-		((BM_Data *) bm->mgmtData)->dirtyFlags[index] = TRUE;
-		//Increment dirty page count
-		((BM_Data *) bm->mgmtData)->numDirtyPages++;
+	//Page is pinned, so the frame can't go away: no latch needed
+	if (((BM_Data *) bm->mgmtData)->shm != NULL) {
+		ATOMIC_STORE(((BM_Data *) bm->mgmtData)->dirtyFlags[index], TRUE);
+		return RC_OK;
+	}
+	setFrameDirty((BM_Data *) bm->mgmtData, index);
+	if (((BM_Data *) bm->mgmtData)->trace != NULL) {
+		traceAccess(bm, BM_TRACE_DIRTY, page->pageNum);
 	}
-	//Release lock
-	pthread_mutex_unlock(&GLOBAL_LOCK);
 
 	//All OK
 	return RC_OK;
@@ -78,27 +112,38 @@ RC unpinPage(BM_BufferPool * const bm, BM_PageHandle * const page) {
 		THROW(RC_INVALID_HANDLE, "Page handle is invalid");
 	}
 
-	//Look up if requested page already exists in pool
-	int index = getPageFrameIndex(bm, page->pageNum);
+	if (((BM_Data *) bm->mgmtData)->shm != NULL) {
+		return unpinShmPage(bm, page);
+	}
+
+	//Look up frame of the pinned page
+	int index = getHandleFrameIndex(bm, page);
 
 	//Index = -1 indicates page isn't available in pool
 	if (index == -1) {
 		THROW(RC_PAGE_NOT_EXIST, "Requested page doesn't exist in buffer pool");
 	}
 
-	//Acquire GLOBAL lock
-	pthread_mutex_lock(&GLOBAL_LOCK);
-	if (((BM_Data *) bm->mgmtData)->fixCount[index] == 0) {
-		//Release lock
-		pthread_mutex_unlock(&GLOBAL_LOCK);
-		THROW(RC_PAGE_NOT_PINNED, "Requested page has not been pinned");
-	}
-	//Update fix count of pinned page
-	((BM_Data *) bm->mgmtData)->fixCount[index]--;
+	//Update fix count of pinned page, never below 0
+	int fix = ATOMIC_LOAD(((BM_Data *) bm->mgmtData)->fixCount[index]);
+	do {
+		if (fix <= 0) {
+			THROW(RC_PAGE_NOT_PINNED, "Requested page has not been pinned");
+		}
+	} while (!ATOMIC_CAS(((BM_Data *) bm->mgmtData)->fixCount[index], fix,
+			fix - 1));
 	//Decrement pin count
-	((BM_Data *) bm->mgmtData)->numPinnedPages--;
-	//Release lock
-	pthread_mutex_unlock(&GLOBAL_LOCK);
+	ATOMIC_DEC(((BM_Data *) bm->mgmtData)->numPinnedPages);
+
+	//Let replacement policy note the unpin, only once it took effect
+	if (((BM_Data *) bm->mgmtData)->policy->onUnpin != NULL) {
+		((BM_Data *) bm->mgmtData)->policy->onUnpin(
+				(BM_Data *) bm->mgmtData,
+				((BM_Data *) bm->mgmtData)->policyState, index);
+	}
+	if (((BM_Data *) bm->mgmtData)->trace != NULL) {
+		traceAccess(bm, BM_TRACE_UNPIN, page->pageNum);
+	}
 
 	//All OK
 	return RC_OK;
@@ -120,34 +165,64 @@ RC forcePage(BM_BufferPool * const bm, BM_PageHandle * const page) {
 		THROW(RC_INVALID_HANDLE, "Page handle is invalid");
 	}
 
-	//Look up if requested page already exists in pool
-	int index = getPageFrameIndex(bm, page->pageNum);
+	if (((BM_Data *) bm->mgmtData)->shm != NULL) {
+		return forceShmPage(bm, page);
+	}
+
+	//Acquire pool latch
+	pthread_mutex_lock(&((BM_Data *) bm->mgmtData)->poolLock);
+
+	//Ensure enough blocks exist in underlying pagefile, the latch may be
+	//released meanwhile
+	writeNewBlocks(bm, -1);
+
+	//Look up if requested page already exists in pool, the handle's frame
+	//reference spares the lookup if the page is still in that frame. Once
+	//ready, the frame is held with a pin of our own, so it stays while the
+	//latch is released for the write.
+	int index;
+	while ((index = getHandleFrameIndex(bm, page)) != -1) {
+		if (((BM_Data *) bm->mgmtData)->frameState[index] == FRAME_READY
+				&& holdFrame((BM_Data *) bm->mgmtData, index)) {
+			break;
+		}
+		//Page is being read, written back or evicted
+		pthread_cond_wait(&((BM_Data *) bm->mgmtData)->frameCond[index],
+				&((BM_Data *) bm->mgmtData)->poolLock);
+	}
 
 	//Index = -1 indicates page isn't available in pool
 	if (index == -1) {
+		//Release pool latch
+		pthread_mutex_unlock(&((BM_Data *) bm->mgmtData)->poolLock);
 		THROW(RC_PAGE_NOT_EXIST, "Requested page doesn't exist in buffer pool");
 	}
 
-	//Acquire GLOBAL lock
-	pthread_mutex_lock(&GLOBAL_LOCK);
-	//Ensure enough blocks exist in underlying pagefile
-	writeNewBlocks(bm, -1);
-	writeBlock(page->pageNum, &(((BM_Data *) bm->mgmtData)->smFH), page->data);
-
-	if (((BM_Data *) bm->mgmtData)->dirtyFlags[index] == TRUE) {
-		//Decrement dirty page count
-		((BM_Data *) bm->mgmtData)->numDirtyPages--;
-		//Reset dirty flag
-		((BM_Data *) bm->mgmtData)->dirtyFlags[index] = FALSE;
+	//Reset dirty flag before writing, so a concurrent update re-dirties the page
+	clearFrameDirty((BM_Data *) bm->mgmtData, index);
+	beginFrameIO(bm, index, FRAME_WRITING);
+	uint64_t start = statClock();
+	RC ret = writeBlock(((BM_Data *) bm->mgmtData)->pageFrameIndexMap[index],
+			&((BM_Data *) bm->mgmtData)->files[bm->fileId]->smFH,
+			((BM_Data *) bm->mgmtData)->pages[index].data);
+	noteIOLatency((BM_Data *) bm->mgmtData, TRUE, start);
+	endFrameIO(bm, index);
+
+	if (ret != RC_OK) {
+		//Keep the page dirty, it's written again later
+		setFrameDirty((BM_Data *) bm->mgmtData, index);
+	} else {
+		//Update IO Count
+		STAT_ADD(((BM_Data *) bm->mgmtData)->stats.writes, 1);
 	}
 
-	//Update IO Count
-	((BM_Data *) bm->mgmtData)->numWriteIO++;
-	//Release lock
-	pthread_mutex_unlock(&GLOBAL_LOCK);
+	//Give our pin back
+	ATOMIC_DEC(((BM_Data *) bm->mgmtData)->fixCount[index]);
+	pthread_cond_broadcast(&((BM_Data *) bm->mgmtData)->frameIdle);
+	//Release pool latch
+	pthread_mutex_unlock(&((BM_Data *) bm->mgmtData)->poolLock);
 
-	//All OK
-	return RC_OK;
+	return ret;
 }
 
 /**
@@ -164,6 +239,67 @@ RC forcePage(BM_BufferPool * const bm, BM_PageHandle * const page) {
  */
 RC pinPage(BM_BufferPool * const bm, BM_PageHandle * const page,
 		const PageNumber pageNum) {
+	return pinPageGeneric(bm, page, pageNum, NULL, BM_RETAIN_NORMAL);
+}
+
+/**
+ * Pins page like pinPage and puts it in retention class hint. A sticky pin
+ * keeps the page sticky until it's evicted, e.g. for metadata pages. An
+ * evict-first pin only applies if it loads the page, e.g. for a page a scan
+ * touches once, a later normal pin takes the page back to normal.
+ *
+ * bm = buffer pool handle
+ * page = page handle to hold data and corresponding page number
+ * pageNum = index of the page to be pinned
+ * hint = retention class of the page
+ */
+RC pinPageHint(BM_BufferPool * const bm, BM_PageHandle * const page,
+		const PageNumber pageNum, const BM_RetentionHint hint) {
+
+	//Sanity checks
+	if (hint != BM_RETAIN_NORMAL && hint != BM_RETAIN_STICKY
+			&& hint != BM_RETAIN_EVICT_FIRST) {
+		THROW(RC_INVALID_OP, "Invalid retention hint");
+	}
+
+	return pinPageGeneric(bm, page, pageNum, NULL, hint);
+}
+
+/**
+ * Pins page like pinPage, but a miss recycles a frame of the caller's access
+ * ring instead of evicting a victim chosen by the pool's replacement strategy.
+ * Large sequential passes thus only ever occupy the frames of their ring and
+ * leave the working set of the pool alone. Pages a ring loads are evicted
+ * first, should their frame leave the ring.
+ *
+ * bm = buffer pool handle
+ * ring = access ring of the caller
+ * page = page handle to hold data and corresponding page number
+ * pageNum = index of the page to be pinned
+ */
+RC pinPageWithRing(BM_BufferPool * const bm, BM_AccessRing * const ring,
+		BM_PageHandle * const page, const PageNumber pageNum) {
+
+	//Sanity checks
+	if (ring == NULL || ring->frames == NULL) {
+		THROW(RC_INVALID_HANDLE, "Access ring is invalid");
+	}
+
+	return pinPageGeneric(bm, page, pageNum, ring, BM_RETAIN_EVICT_FIRST);
+}
+
+/**
+ * Private implementation of pinPage, pinPageHint and pinPageWithRing
+ *
+ * bm = buffer pool handle
+ * page = page handle to hold data and corresponding page number
+ * pageNum = index of the page to be pinned
+ * ring = access ring to take the frame from on a miss, NULL for none
+ * hint = retention class of the page
+ */
+PRIVATE RC pinPageGeneric(BM_BufferPool * const bm, BM_PageHandle * const page,
+		const PageNumber pageNum, BM_AccessRing * const ring,
+		const BM_RetentionHint hint) {
 
 	//Sanity checks
 	if (bm == NULL) {
@@ -176,166 +312,547 @@ RC pinPage(BM_BufferPool * const bm, BM_PageHandle * const page,
 		THROW(RC_INVALID_PAGE_REQUESTED, "Invalid page requested for pin");
 	}
 
-	//Acquire GLOBAL lock, as Pin functionality modifies almost all shared data
-	pthread_mutex_lock(&GLOBAL_LOCK);
+	//Retention hints and rings are left to CLOCK of the segment
+	if (((BM_Data *) bm->mgmtData)->shm != NULL) {
+		return pinShmPage(bm, page, pageNum);
+	}
+
+	//Fast path: page is resident, pin it without taking any latch
+	int index = pinResidentFrame(bm, pageNum);
+	if (index != -1) {
+		//Page Hit
+		STAT_ADD(((BM_Data *) bm->mgmtData)->stats.hits, 1);
+		noteRetentionHint(bm, index, hint);
+		notePageAccess(bm, index);
+		page->pageNum = pageNum;
+		page->data = ((BM_Data *) bm->mgmtData)->pages[index].data;
+		page->frame = index;
+		if (((BM_Data *) bm->mgmtData)->trace != NULL) {
+			traceAccess(bm, BM_TRACE_PIN, pageNum);
+		}
+		notePrefetchAccess(bm, pageNum);
+		return RC_OK;
+	}
+
+	//Acquire pool latch, as loading a page modifies almost all shared data
+	latchPoolForPin(bm);
 
-	//Look up if requested page already exists in pool
-	int index = getPageFrameIndex(bm, pageNum);
+	for (;;) {
+		//Look up if requested page already exists in pool
+		index = getPageFrameIndex(bm, pageNum);
 
-	//Index = -1 indicates page isn't available in pool
-	if (index == -1) {
+		if (index != -1) {
+			//Page is being read or written back, wait for that and look again
+			if (((BM_Data *) bm->mgmtData)->frameState[index] != FRAME_READY) {
+				waitForPin(bm, &((BM_Data *) bm->mgmtData)->frameCond[index]);
+				continue;
+			}
+			//Page Hit
+			STAT_ADD(((BM_Data *) bm->mgmtData)->stats.hits, 1);
+			//Update fix count of pinned page
+			ATOMIC_INC(((BM_Data *) bm->mgmtData)->fixCount[index]);
+			noteRetentionHint(bm, index, hint);
+			break;
+		}
+
+		//Index = -1 indicates page isn't available in pool
 		//Now we need to fetch the requested page from disk and pin it in pool
 
 		//Check if empty page frame is available to accommodate new page
-		if (((BM_Data *) bm->mgmtData)->numPinnedPages == bm->numPages) {
-			//Release lock
-			pthread_mutex_unlock(&GLOBAL_LOCK);
+		if (ATOMIC_LOAD(((BM_Data *) bm->mgmtData)->numPinnedPages)
+				>= ((BM_Data *) bm->mgmtData)->numFramesUsed) {
+			//Release pool latch
+			pthread_mutex_unlock(&((BM_Data *) bm->mgmtData)->poolLock);
 			THROW(RC_ALL_FRAMES_OCCUPIED,
 					"All frames are occupied by pinned pages");
 		}
 
-		index = getFreeFrameIndex(bm);
+		//Frame comes back claimed, with fix count FRAME_EVICTING
+		index = ring != NULL ?
+				getRingFrameIndex(bm, ring, pageNum) : getFreeFrameIndex(bm);
 
 		if (index == -1) {
-			//Release lock
-			pthread_mutex_unlock(&GLOBAL_LOCK);
+			//Release pool latch
+			pthread_mutex_unlock(&((BM_Data *) bm->mgmtData)->poolLock);
 			THROW(RC_ALL_FRAMES_OCCUPIED,
 					"Couldn't get empty page frame for page");
 		}
 
-		//Acquire page frames access lock
-		pthread_mutex_lock(&PAGE_FRAME_LOCK);
-		//Remove previous page from frame, if present
-		if (((BM_Data *) bm->mgmtData)->pages[index] != NULL) {
-			if (((BM_Data *) bm->mgmtData)->pages[index]->data != NULL) {
-				free(((BM_Data*) bm->mgmtData)->pages[index]->data);
-			}
-			free(((BM_Data*) bm->mgmtData)->pages[index]);
+		//Latch may have been released to write back the victim, someone else
+		//may have loaded the page meanwhile
+		if (getPageFrameIndex(bm, pageNum) != -1) {
+			//Give the empty frame back
+			ATOMIC_STORE(((BM_Data *) bm->mgmtData)->fixCount[index], 0);
+			pthread_cond_broadcast(&((BM_Data *) bm->mgmtData)->frameIdle);
+			continue;
 		}
 
-		//Allocate memory to page frame to hold incoming page data
-		((BM_Data *) bm->mgmtData)->pages[index] = (BM_PageHandle *) malloc(
-				sizeof(BM_PageHandle));
-		((BM_Data *) bm->mgmtData)->pages[index]->data = (SM_PageHandle) malloc(
-				PAGE_SIZE);
-
-		//Read requested page from page file on disk
-		RC ret = readBlock(pageNum, &(((BM_Data *) bm->mgmtData)->smFH),
-				((BM_Data *) bm->mgmtData)->pages[index]->data);
-
-		//Release page frames access lock
-		pthread_mutex_unlock(&PAGE_FRAME_LOCK);
-
-		if (ret == RC_OK) {
-			((BM_Data *) bm->mgmtData)->numReadIO++;
-		}
-		//Check if requested page was available in page file on disk
-		else if (ret == RC_READ_NON_EXISTING_PAGE) {
-			((BM_Data *) bm->mgmtData)->newBlockRequested = TRUE;
-			((BM_Data *) bm->mgmtData)->dirtyFlags[index] = TRUE;
-			((BM_Data *) bm->mgmtData)->numDirtyPages++;
-			//Acquire page frames access lock
-			pthread_mutex_lock(&PAGE_FRAME_LOCK);
-			//Now that the block is new, it must contain all NULLs, don't read from disk, it's slow
-			memset(((BM_Data *) bm->mgmtData)->pages[index]->data, '\0',
-					PAGE_SIZE);
-			//Release page frames access lock
-			pthread_mutex_unlock(&PAGE_FRAME_LOCK);
-			((BM_Data *) bm->mgmtData)->extraBlockReqCount++;
-		}
-		//Some other error occurred
-		else {
-			//Release lock
-			pthread_mutex_unlock(&GLOBAL_LOCK);
+		//Page Miss
+		STAT_ADD(((BM_Data *) bm->mgmtData)->stats.misses, 1);
+		setFrameRetention((BM_Data *) bm->mgmtData, index, hint);
+		RC ret = loadClaimedFrame(bm, index, pageNum);
+		if (ret != RC_OK) {
+			//Release pool latch
+			pthread_mutex_unlock(&((BM_Data *) bm->mgmtData)->poolLock);
 			THROW(ret, "Page read from page file failed");
 		}
-
-		//Acquire page frames access lock
-		pthread_mutex_lock(&PAGE_FRAME_LOCK);
-		//Set page number in frame
-		((BM_Data *) bm->mgmtData)->pages[index]->pageNum = pageNum;
-		//Release page frames access lock
-		pthread_mutex_unlock(&PAGE_FRAME_LOCK);
-
-		gettimeofday(&(((BM_Data *) bm->mgmtData)->pageInTime[index]), NULL);
-	} else {
-		//Page Hit
-		((BM_Data *) bm->mgmtData)->pageHit++;
+		break;
 	}
 
-	//Increment pin request counter
-	((BM_Data *) bm->mgmtData)->pinReqCount++;
-	//Page already exists in pool, simply point page handle to existing data
+	notePageAccess(bm, index);
+	//Point page handle to frame's data
 	page->pageNum = pageNum;
-	//Acquire page frames access lock
-	pthread_mutex_lock(&PAGE_FRAME_LOCK);
-	//Point page data to page in frame's data
-	page->data = ((BM_Data *) bm->mgmtData)->pages[index]->data;
-	//Release page frames access lock
-	pthread_mutex_unlock(&PAGE_FRAME_LOCK);
-	//Update page and frame index mapping
-	((BM_Data *) bm->mgmtData)->pageFrameIndexMap[index] = pageNum;
-	//Update fix count of pinned page
-	((BM_Data *) bm->mgmtData)->fixCount[index]++;
-	//Update use time stamp
-	gettimeofday(&(((BM_Data *) bm->mgmtData)->pageUsedTime[index]), NULL);
-	//Increment page usage count
-	((BM_Data *) bm->mgmtData)->pageUsedCount[index]++;
-	//Increment pin count
-	((BM_Data *) bm->mgmtData)->numPinnedPages++;
+	page->data = ((BM_Data *) bm->mgmtData)->pages[index].data;
+	page->frame = index;
 
 #ifdef _DEBUG
 	printf("\n Pinned Page: %d", pageNum);
 	printDebugInfo(bm);
 #endif
 
-	//Release lock
-	pthread_mutex_unlock(&GLOBAL_LOCK);
+	//Release pool latch
+	pthread_mutex_unlock(&((BM_Data *) bm->mgmtData)->poolLock);
+
+	if (((BM_Data *) bm->mgmtData)->trace != NULL) {
+		traceAccess(bm, BM_TRACE_PIN, pageNum);
+	}
+	//Stream detection runs outside the pool latch
+	notePrefetchAccess(bm, pageNum);
+
+	//All OK
+	return RC_OK;
+}
+
+/**
+ * Pins n pages at once. Hits are resolved and victims chosen for all misses
+ * under a single hold of the pool latch, then all missing pages are read
+ * with one vectored read per run of consecutive pages while the latch is
+ * released. Either all pages get pinned or none.
+ *
+ * bm = buffer pool handle
+ * pageNums = page numbers of the pages to be pinned
+ * n = no of pages to be pinned
+ * pages = page handles, one per page, to hold data and page number
+ */
+RC pinPages(BM_BufferPool * const bm, const PageNumber * const pageNums,
+		const int n, BM_PageHandle * const pages) {
+
+	int i, j, numMisses;
+
+	//Sanity checks
+	if (bm == NULL) {
+		THROW(RC_INVALID_HANDLE, "Buffer pool handle is invalid");
+	}
+	if (pageNums == NULL || pages == NULL || n < 0) {
+		THROW(RC_INVALID_HANDLE, "Page handle is invalid");
+	}
+	for (i = 0; i < n; i++) {
+		if (pageNums[i] < 0) {
+			THROW(RC_INVALID_PAGE_REQUESTED, "Invalid page requested for pin");
+		}
+	}
+	if (n == 0) {
+		return RC_OK;
+	}
+	if (((BM_Data *) bm->mgmtData)->shm != NULL) {
+		return pinShmPages(bm, pageNums, n, pages);
+	}
+
+	//frames[i] is frame of page i, -1 until resolved. misses are indexes into
+	//pageNums, claimFrames/claimPages list the frames claimed for them.
+	int *frames = (int *) malloc(n * sizeof(int));
+	int *misses = (int *) malloc(n * sizeof(int));
+	int *claimFrames = (int *) malloc(n * sizeof(int));
+	PageNumber *claimPages = (PageNumber *) malloc(n * sizeof(PageNumber));
+	if (frames == NULL || misses == NULL || claimFrames == NULL
+			|| claimPages == NULL) {
+		free(frames);
+		free(misses);
+		free(claimFrames);
+		free(claimPages);
+		THROW(RC_NOT_ENOUGH_MEMORY,
+				"Not enough memory available for resource allocation");
+	}
+	for (i = 0; i < n; i++) {
+		frames[i] = -1;
+	}
+
+	RC ret = RC_OK;
+
+	//Acquire pool latch
+	latchPoolForPin(bm);
+
+	for (;;) {
+		bool retry = FALSE;
+		numMisses = 0;
+
+		//Pin hits. Pages in I/O are waited for before any frame is claimed,
+		//so that two batches never wait on each other's frames.
+		for (i = 0; i < n && retry == FALSE; i++) {
+			if (frames[i] != -1) {
+				continue;
+			}
+			//Repeated page numbers share the frame of the first one
+			for (j = 0; j < i && pageNums[j] != pageNums[i]; j++)
+				;
+			if (j < i) {
+				continue;
+			}
+			int index = getPageFrameIndex(bm, pageNums[i]);
+			if (index == -1) {
+				misses[numMisses++] = i;
+			} else if (((BM_Data *) bm->mgmtData)->frameState[index]
+					!= FRAME_READY) {
+				waitForPin(bm, &((BM_Data *) bm->mgmtData)->frameCond[index]);
+				retry = TRUE;
+			} else {
+				//Page Hit
+				STAT_ADD(((BM_Data *) bm->mgmtData)->stats.hits, 1);
+				ATOMIC_INC(((BM_Data *) bm->mgmtData)->fixCount[index]);
+				frames[i] = index;
+			}
+		}
+		if (retry == TRUE) {
+			continue;
+		}
+
+		//Claim a frame for each miss, in page order so reads coalesce
+		for (i = 1; i < numMisses; i++) {
+			int miss = misses[i];
+			for (j = i; j > 0 && pageNums[misses[j - 1]] > pageNums[miss]; j--) {
+				misses[j] = misses[j - 1];
+			}
+			misses[j] = miss;
+		}
+		for (i = 0; i < numMisses; i++) {
+			//Frame comes back claimed, with fix count FRAME_EVICTING
+			frames[misses[i]] = getFreeFrameIndex(bm);
+			if (frames[misses[i]] == -1) {
+				ret = RC_ALL_FRAMES_OCCUPIED;
+				break;
+			}
+		}
+
+		//Latch may have been released to write back victims, someone else
+		//may have loaded some of the pages meanwhile
+		for (i = 0; i < numMisses && ret == RC_OK && retry == FALSE; i++) {
+			retry = getPageFrameIndex(bm, pageNums[misses[i]]) != -1;
+		}
+		if (ret != RC_OK || retry == TRUE) {
+			//Give the empty frames back, then start over
+			for (i = 0; i < numMisses; i++) {
+				if (frames[misses[i]] != -1) {
+					ATOMIC_STORE(
+							((BM_Data *) bm->mgmtData)->fixCount[frames[misses[i]]],
+							0);
+					frames[misses[i]] = -1;
+				}
+			}
+			pthread_cond_broadcast(&((BM_Data *) bm->mgmtData)->frameIdle);
+		}
+		if (ret != RC_OK || retry == FALSE) {
+			break;
+		}
+	}
+
+	if (ret == RC_OK) {
+		//Publish all misses, then read them with the latch released
+		for (i = 0; i < numMisses; i++) {
+			claimFrames[i] = frames[misses[i]];
+			claimPages[i] = pageNums[misses[i]];
+		}
+		STAT_ADD(((BM_Data *) bm->mgmtData)->stats.misses, numMisses);
+		ret = loadClaimedFrames(bm, claimFrames, claimPages, numMisses);
+		for (i = 0; i < numMisses; i++) {
+			frames[misses[i]] = claimFrames[i];
+		}
+	}
+
+	//Repeated page numbers take another pin on the frame of the first one
+	for (i = 0; i < n; i++) {
+		for (j = 0; j < i && pageNums[j] != pageNums[i]; j++)
+			;
+		if (j < i && frames[j] != -1) {
+			frames[i] = frames[j];
+			ATOMIC_INC(((BM_Data *) bm->mgmtData)->fixCount[frames[i]]);
+		}
+	}
+
+	for (i = 0; i < n; i++) {
+		if (frames[i] == -1) {
+			continue;
+		}
+		if (ret != RC_OK) {
+			//All or none, drop pins taken so far
+			ATOMIC_DEC(((BM_Data *) bm->mgmtData)->fixCount[frames[i]]);
+			continue;
+		}
+		noteRetentionHint(bm, frames[i], BM_RETAIN_NORMAL);
+		notePageAccess(bm, frames[i]);
+		//Point page handle to frame's data
+		pages[i].pageNum = pageNums[i];
+		pages[i].data = ((BM_Data *) bm->mgmtData)->pages[frames[i]].data;
+		pages[i].frame = frames[i];
+		if (((BM_Data *) bm->mgmtData)->trace != NULL) {
+			traceAccess(bm, BM_TRACE_PIN, pageNums[i]);
+		}
+	}
+
+	//Release pool latch
+	pthread_mutex_unlock(&((BM_Data *) bm->mgmtData)->poolLock);
+
+	free(frames);
+	free(misses);
+	free(claimFrames);
+	free(claimPages);
+
+	if (ret != RC_OK) {
+		THROW(ret, "Pinning pages failed");
+	}
 
 	//All OK
 	return RC_OK;
 }
 
+/**
+ * Unpins n pages at once. Unpinning never takes the pool latch, so this is
+ * a convenience counterpart of pinPages. All pages are unpinned even if
+ * some of them fail, the last failure is returned.
+ *
+ * bm = buffer pool handle
+ * pages = page handles of the pinned pages
+ * n = no of pages to be unpinned
+ */
+RC unpinPages(BM_BufferPool * const bm, BM_PageHandle * const pages,
+		const int n) {
+
+	RC ret = RC_OK;
+	int i;
+
+	//Sanity checks
+	if (pages == NULL && n > 0) {
+		THROW(RC_INVALID_HANDLE, "Page handle is invalid");
+	}
+
+	for (i = 0; i < n; i++) {
+		RC rc = unpinPage(bm, &pages[i]);
+		if (rc != RC_OK) {
+			ret = rc;
+		}
+	}
+
+	return ret;
+}
+
+/**
+ * Reads pages into pool ahead of demand, without pinning them. Pages already
+ * in pool or beyond end of page file are skipped, and so are the rest once no
+ * victim frame is left. Runs of consecutive pages are read with one vectored
+ * read, the pool latch is released meanwhile. Returns the no of pages loaded.
+ *
+ * bm = buffer pool handle
+ * pageNums = page numbers of the pages to be prefetched
+ * n = no of pages to be prefetched
+ */
+int prefetchPages(BM_BufferPool * const bm, const PageNumber * const pageNums,
+		const int n) {
+
+	int i, j, numClaims = 0, numLoaded = 0;
+
+	//Sanity checks
+	if (bm == NULL || bm->mgmtData == NULL || pageNums == NULL || n <= 0
+			|| ((BM_Data *) bm->mgmtData)->shm != NULL) {
+		return 0;
+	}
+
+	int *frames = (int *) malloc(n * sizeof(int));
+	PageNumber *claimPages = (PageNumber *) malloc(n * sizeof(PageNumber));
+	if (frames == NULL || claimPages == NULL) {
+		free(frames);
+		free(claimPages);
+		return 0;
+	}
+
+	//Acquire pool latch
+	pthread_mutex_lock(&((BM_Data *) bm->mgmtData)->poolLock);
+
+	//Queued prefetches may outlive the view of their page file
+	for (i = 0; i < n && bm->fileId < ((BM_Data *) bm->mgmtData)->numFiles
+			&& ((BM_Data *) bm->mgmtData)->files[bm->fileId]->refCount > 0;
+			i++) {
+		if (pageNums[i] < 0
+				|| pageNums[i]
+						>= ((BM_Data *) bm->mgmtData)->files[bm->fileId]->smFH.totalNumPages
+				|| getPageFrameIndex(bm, pageNums[i]) != -1) {
+			continue;
+		}
+		for (j = 0; j < numClaims && claimPages[j] != pageNums[i]; j++)
+			;
+		if (j < numClaims) {
+			continue;
+		}
+		//Frame comes back claimed, with fix count FRAME_EVICTING
+		int index = getFreeFrameIndex(bm);
+		if (index == -1) {
+			break;
+		}
+		frames[numClaims] = index;
+		claimPages[numClaims] = pageNums[i];
+		numClaims++;
+	}
+
+	//Latch may have been released to write back victims, give back frames of
+	//pages someone else loaded meanwhile, or all if the page file got closed
+	for (i = 0, j = 0; i < numClaims; i++) {
+		if (((BM_Data *) bm->mgmtData)->files[bm->fileId]->refCount == 0
+				|| getPageFrameIndex(bm, claimPages[i]) != -1) {
+			ATOMIC_STORE(((BM_Data *) bm->mgmtData)->fixCount[frames[i]], 0);
+			pthread_cond_broadcast(&((BM_Data *) bm->mgmtData)->frameIdle);
+			continue;
+		}
+		frames[j] = frames[i];
+		claimPages[j] = claimPages[i];
+		j++;
+	}
+	numClaims = j;
+
+	//Flag frames before they become visible, a pin racing the read is a hit
+	if (((BM_Data *) bm->mgmtData)->prefetched != NULL) {
+		for (i = 0; i < numClaims; i++) {
+			ATOMIC_STORE(((BM_Data *) bm->mgmtData)->prefetched[frames[i]],
+					TRUE);
+		}
+	}
+
+	loadClaimedFrames(bm, frames, claimPages, numClaims);
+
+	for (i = 0; i < numClaims; i++) {
+		if (frames[i] == -1) {
+			continue;
+		}
+		//Drop the pin loading took
+		ATOMIC_DEC(((BM_Data *) bm->mgmtData)->fixCount[frames[i]]);
+		numLoaded++;
+	}
+	STAT_ADD(((BM_Data *) bm->mgmtData)->stats.prefetches, numLoaded);
+	pthread_cond_broadcast(&((BM_Data *) bm->mgmtData)->frameIdle);
+
+	//Release pool latch
+	pthread_mutex_unlock(&((BM_Data *) bm->mgmtData)->poolLock);
+
+	free(frames);
+	free(claimPages);
+
+	return numLoaded;
+}
+
 /**
  * Private utility function to ensure that non-existing pages pinned get their
- * corresponding blocks written to pagefile before actual page
+ * corresponding blocks written to pagefile before actual page. Pages of the
+ * new blocks are copied and their frames pinned, so the blocks are appended
+ * with the pool latch released. Meanwhile other callers for the page file
+ * wait, and the page file handle keeps its old size. Caller must hold the
+ * pool latch.
  *
  * bm = buffer pool handle
  * num = page index to check if we find new page being written of that index
  */
 bool inline writeNewBlocks(BM_BufferPool * const bm, PageNumber num) {
 
+	//Blocks go to page file of frame num, or of the pool handle if none
+	int fileId = num >= 0 ? ((BM_Data *) bm->mgmtData)->frameFile[num] :
+			bm->fileId;
+	BM_File *file = ((BM_Data *) bm->mgmtData)->files[fileId];
+
+	//Blocks appended by someone else must exist before pages past them are
+	//written
+	while (file->appending == TRUE) {
+		pthread_cond_wait(&((BM_Data *) bm->mgmtData)->frameIdle,
+				&((BM_Data *) bm->mgmtData)->poolLock);
+	}
+
+	//Pages requested during an append may be covered by it
+	if (file->lastBlockRequested < file->actualPageFileCnt) {
+		file->newBlockRequested = FALSE;
+	}
+
 	bool ret = FALSE;
-	if (((BM_Data *) bm->mgmtData)->newBlockRequested == TRUE) {
-		int i;
-		for (i = 0; i < ((BM_Data *) bm->mgmtData)->extraBlockReqCount; i++) {
-			int cBlock = ((BM_Data *) bm->mgmtData)->actualPageFileCnt + i;
+	if (file->newBlockRequested == TRUE) {
+		//Pages past end of file may be pinned in any order, blocks up to the
+		//highest one are appended
+		int i, numBlocks = file->lastBlockRequested + 1
+				- file->actualPageFileCnt;
+		int *frames = (int *) malloc(numBlocks * sizeof(int));
+		char *blocks = (char *) calloc(numBlocks, PAGE_SIZE);
+		if (frames == NULL || blocks == NULL) {
+			free(frames);
+			free(blocks);
+			//Fall back to appending straight from the frames
+			frames = NULL;
+			blocks = NULL;
+		}
+
+		for (i = 0; i < numBlocks; i++) {
+			int cBlock = file->actualPageFileCnt + i;
 			//Look up if requested page already exists in pool
-			int index = getPageFrameIndex(bm, cBlock);
+			int index = lookupPageTable((BM_Data *) bm->mgmtData, fileId,
+					cBlock);
 
+			//Reset dirty flag
 			if ((index != -1)
-					&& ((BM_Data *) bm->mgmtData)->dirtyFlags[index] == TRUE) {
-				//Acquire page frames access lock
-				pthread_mutex_lock(&PAGE_FRAME_LOCK);
-				appendEmptyBlockData(&(((BM_Data *) bm->mgmtData)->smFH),
-						((BM_Data *) bm->mgmtData)->pages[index]->data);
-				//Release page frames access lock
-				pthread_mutex_unlock(&PAGE_FRAME_LOCK);
-				ret = index == num;
-				//Decrement dirty page count
-				((BM_Data *) bm->mgmtData)->numDirtyPages--;
-				//Reset dirty flag
-				((BM_Data *) bm->mgmtData)->dirtyFlags[index] = FALSE;
+					&& clearFrameDirty((BM_Data *) bm->mgmtData, index)) {
+				if (blocks == NULL) {
+					appendEmptyBlockData(&file->smFH,
+							((BM_Data *) bm->mgmtData)->pages[index].data);
+				} else {
+					memcpy(blocks + (size_t) i * PAGE_SIZE,
+							((BM_Data *) bm->mgmtData)->pages[index].data,
+							PAGE_SIZE);
+				}
+				ret = ret || index == num;
 				//Update IO Count
-				((BM_Data *) bm->mgmtData)->numWriteIO++;
-			} else {
-				appendEmptyBlockData(&(((BM_Data *) bm->mgmtData)->smFH), NULL);
+				STAT_ADD(((BM_Data *) bm->mgmtData)->stats.writes, 1);
+			} else if (blocks == NULL) {
+				appendEmptyBlockData(&file->smFH, NULL);
 			}
+			STAT_ADD(((BM_Data *) bm->mgmtData)->stats.newBlocks, 1);
+
+			//Keep the page in its frame until its block exists, a claimed
+			//frame is kept by its claimer, which waits for the append
+			if (frames != NULL) {
+				frames[i] = index != -1
+						&& holdFrame((BM_Data *) bm->mgmtData, index) ?
+						index : -1;
+			}
+		}
+		file->newBlockRequested = FALSE;
+
+		if (blocks != NULL) {
+			//Blocks requested meanwhile follow the ones appended now
+			SM_FileHandle fh = file->smFH;
+			file->appending = TRUE;
+			//Release pool latch
+			pthread_mutex_unlock(&((BM_Data *) bm->mgmtData)->poolLock);
+			for (i = 0; i < numBlocks; i++) {
+				appendEmptyBlockData(&fh, blocks + (size_t) i * PAGE_SIZE);
+			}
+			//Acquire pool latch
+			pthread_mutex_lock(&((BM_Data *) bm->mgmtData)->poolLock);
+			file->smFH.totalNumPages = fh.totalNumPages;
+			file->smFH.curPagePos = fh.curPagePos;
+			file->appending = FALSE;
+
+			for (i = 0; i < numBlocks; i++) {
+				if (frames[i] != -1) {
+					ATOMIC_DEC(((BM_Data *) bm->mgmtData)->fixCount[frames[i]]);
+				}
+			}
+			pthread_cond_broadcast(&((BM_Data *) bm->mgmtData)->frameIdle);
 		}
-		((BM_Data *) bm->mgmtData)->newBlockRequested = FALSE;
-		((BM_Data *) bm->mgmtData)->extraBlockReqCount = 0;
-		((BM_Data *) bm->mgmtData)->actualPageFileCnt =
-				((BM_Data *) bm->mgmtData)->smFH.totalNumPages;
+		file->actualPageFileCnt = file->smFH.totalNumPages;
+
+		free(frames);
+		free(blocks);
 	}
 
 	return ret;
@@ -343,116 +860,1143 @@ bool inline writeNewBlocks(BM_BufferPool * const bm, PageNumber num) {
 
 /**
  * Private utility function to find index of page frame of a specific
- * page with page number pageNum
+ * page with page number pageNum. Only the page table shard of pageNum is latched.
  *
  * bm = buffer pool handle
  * pageNum = page number to be looked up
  */
 PRIVATE inline int getPageFrameIndex(BM_BufferPool * const bm,
 		const PageNumber pageNum) {
+	return lookupPageTable((BM_Data *) bm->mgmtData, bm->fileId, pageNum);
+}
 
-	int i, index = -1;
-
-	//Acquire page frames access lock
-	pthread_mutex_lock(&PAGE_FRAME_LOCK);
-	BM_PageHandle **pages = ((BM_Data *) bm->mgmtData)->pages;
-	//Scan through each page to get index of requested page
-	for (i = 0; i < bm->numPages; i++) {
-		if ((pages[i] != NULL) && pages[i]->pageNum == pageNum) {
-			index = i;
-			//Release page frames access lock
-			pthread_mutex_unlock(&PAGE_FRAME_LOCK);
-			break;
-		}
+/**
+ * Private utility function to find frame of a page the caller has pinned.
+ * A pinned frame can't be evicted, so the latch-free probe is trusted when it
+ * hits and the latched lookup only covers probes racing a chain update.
+ *
+ * bm = buffer pool handle
+ * pageNum = page number to be looked up
+ */
+PRIVATE inline int getPinnedFrameIndex(BM_BufferPool * const bm,
+		const PageNumber pageNum) {
+
+	int index = probePageTable((BM_Data *) bm->mgmtData, bm->fileId, pageNum);
+	if (index == -1) {
+		index = getPageFrameIndex(bm, pageNum);
 	}
-	//Release page frames access lock
-	pthread_mutex_unlock(&PAGE_FRAME_LOCK);
 
 	return index;
 }
 
 /**
- *	Private utility function to find free frame index within
- *	internal page - frame mapping array
+ * Finds frame of the page of handle page. The frame reference set by the pin
+ * calls is used if the frame still holds that page, which is always the case
+ * while the handle's page is pinned. Otherwise, e.g. for handles filled in by
+ * the caller, the page is looked up in page table. Returns -1 if the page
+ * isn't in the pool.
  *
- *	bm = buffer pool handle
+ * bm = buffer pool handle
+ * page = page handle
  */
-PRIVATE inline int getFreeFrameIndex(BM_BufferPool * const bm) {
+int getHandleFrameIndex(BM_BufferPool * const bm,
+		const BM_PageHandle * const page) {
+
+	int frame = page->frame;
+	//Frame arrays never shrink, so any frame below maxFrames can be checked
+	if (page->pageNum >= 0 && frame >= 0
+			&& frame < ((BM_Data *) bm->mgmtData)->maxFrames
+			&& ATOMIC_LOAD(((BM_Data *) bm->mgmtData)->pageFrameIndexMap[frame])
+					== page->pageNum
+			&& ATOMIC_LOAD(((BM_Data *) bm->mgmtData)->frameFile[frame])
+					== bm->fileId) {
+		return frame;
+	}
 
-	int i, freeIndex = -1, lfuIndex = -1, lruIndex = -1, firstInIndex = -1;
+	if (((BM_Data *) bm->mgmtData)->shm != NULL) {
+		return findShmFrame(bm, page->pageNum);
+	}
+	return getPinnedFrameIndex(bm, page->pageNum);
+}
 
-	//Look for free page frame
-	for (i = 0; i < bm->numPages; i++) {
-		if (((BM_Data *) bm->mgmtData)->pageFrameIndexMap[i] == NO_PAGE) {
-			//Free page frame found with index i
-			freeIndex = i;
-			break;
-		}
-		if (((BM_Data *) bm->mgmtData)->fixCount[i] == 0) {
-			if (firstInIndex == -1) {
-				firstInIndex = i;
-				lruIndex = i;
-				lfuIndex = i;
-			} else {
-				if (((BM_Data *) bm->mgmtData)->pageInTime[i].tv_usec
-						< ((BM_Data *) bm->mgmtData)->pageInTime[firstInIndex].tv_usec)
-					firstInIndex = i;
-				if (((BM_Data *) bm->mgmtData)->pageUsedTime[i].tv_usec
-						< ((BM_Data *) bm->mgmtData)->pageUsedTime[lruIndex].tv_usec)
-					lruIndex = i;
-				if (((BM_Data *) bm->mgmtData)->pageUsedCount[i]
-															  < ((BM_Data *) bm->mgmtData)->pageUsedCount[lfuIndex])
-					lfuIndex = i;
-				if (((BM_Data *) bm->mgmtData)->pageUsedCount[i]
-															  == ((BM_Data *) bm->mgmtData)->pageUsedCount[lfuIndex])
-					if (((BM_Data *) bm->mgmtData)->pageInTime[i].tv_usec
-							< ((BM_Data *) bm->mgmtData)->pageInTime[lfuIndex].tv_usec)
-						lfuIndex = i;
-			}
-		}
+/**
+ * Private utility function to pin a resident page without taking any latch.
+ * Fix count is raised with compare-and-swap, unless frame is being evicted,
+ * then the frame is re-validated in case it was recycled for another page
+ * between probe and pin.
+ * Returns index of the pinned frame, -1 if caller must take the latched path.
+ *
+ * bm = buffer pool handle
+ * pageNum = page number to be pinned
+ */
+PRIVATE inline int pinResidentFrame(BM_BufferPool * const bm,
+		const PageNumber pageNum) {
+
+	int index = probePageTable((BM_Data *) bm->mgmtData, bm->fileId, pageNum);
+	if (index == -1) {
+		return -1;
 	}
 
-	//If free page frame is not found
-	if (freeIndex == -1) {
-		if (bm->strategy == RS_FIFO) {
-			freeIndex = firstInIndex;
-		} else if (bm->strategy == RS_LRU) {
-			freeIndex = lruIndex;
-		} else if (bm->strategy == RS_LFU) {
-			freeIndex = lfuIndex;
+	int fix = ATOMIC_LOAD(((BM_Data *) bm->mgmtData)->fixCount[index]);
+	do {
+		//Frame is claimed for eviction or still loading
+		if (fix < 0) {
+			return -1;
 		}
-		if (freeIndex != -1)
-			checkAndSwapPage(bm, freeIndex);
+	} while (!ATOMIC_CAS(((BM_Data *) bm->mgmtData)->fixCount[index], fix,
+			fix + 1));
+
+	//Our pin keeps the frame from being claimed from now on, re-validate it
+	if (ATOMIC_LOAD(((BM_Data *) bm->mgmtData)->pageFrameIndexMap[index])
+			!= pageNum
+			|| ATOMIC_LOAD(((BM_Data *) bm->mgmtData)->frameFile[index])
+					!= bm->fileId) {
+		ATOMIC_DEC(((BM_Data *) bm->mgmtData)->fixCount[index]);
+		return -1;
 	}
 
-	return freeIndex;
+	return index;
 }
 
-PRIVATE inline void checkAndSwapPage(BM_BufferPool * const bm, PageNumber num) {
-	if (((BM_Data *) bm->mgmtData)->dirtyFlags[num] == TRUE) {
-		//Ensure enough blocks exist in underlying pagefile
-		if (!writeNewBlocks(bm, num)) {
-			//Acquire page frames access lock
-			pthread_mutex_lock(&PAGE_FRAME_LOCK);
-			writeBlock(((BM_Data *) bm->mgmtData)->pageFrameIndexMap[num],
-					&(((BM_Data *) bm->mgmtData)->smFH),
-					((BM_Data *) bm->mgmtData)->pages[num]->data);
-			//Release page frames access lock
-			pthread_mutex_unlock(&PAGE_FRAME_LOCK);
-			//Decrement dirty page count
-			((BM_Data *) bm->mgmtData)->numDirtyPages--;
-			//Reset dirty flag
-			((BM_Data *) bm->mgmtData)->dirtyFlags[num] = FALSE;
-			//Update IO Count
-			((BM_Data *) bm->mgmtData)->numWriteIO++;
-		}
-
+/**
+ * Private utility function to update pin bookkeeping of a freshly pinned frame.
+ * Use stamps and counts are up to the replacement policy.
+ *
+ * bm = buffer pool handle
+ * index = index of the pinned frame
+ */
+PRIVATE inline void notePageAccess(BM_BufferPool * const bm, const int index) {
+	//Increment pin request counter
+	STAT_ADD(((BM_Data *) bm->mgmtData)->stats.pinRequests, 1);
+	//Let replacement policy note the use
+	if (((BM_Data *) bm->mgmtData)->policy->onAccess != NULL) {
+		((BM_Data *) bm->mgmtData)->policy->onAccess(
+				(BM_Data *) bm->mgmtData,
+				((BM_Data *) bm->mgmtData)->policyState, index);
 	}
-	((BM_Data *) bm->mgmtData)->pageInTime[num].tv_usec = -1;
-	((BM_Data *) bm->mgmtData)->pageUsedTime[num].tv_usec = -1;
-	((BM_Data *) bm->mgmtData)->pageUsedCount[num] = 0;
-	//Update page and frame index mapping
-	((BM_Data *) bm->mgmtData)->pageFrameIndexMap[num] = NO_PAGE;
+	//First pin of a prefetched page, read ahead paid off
+	if (((BM_Data *) bm->mgmtData)->prefetched != NULL
+			&& ATOMIC_XCHG(((BM_Data *) bm->mgmtData)->prefetched[index], FALSE)
+					== TRUE) {
+		notePrefetchUse(bm, TRUE);
+	}
+	//Increment pin count
+	ATOMIC_INC(((BM_Data *) bm->mgmtData)->numPinnedPages);
+}
+
+/**
+ * Private utility function to put page of frame in retention class hint,
+ * keeping count of evict-first frames.
+ *
+ * data = buffer pool management data
+ * frame = index of the page frame
+ * hint = retention class of the page
+ */
+PRIVATE inline void setFrameRetention(BM_Data * const data, const int frame,
+		const BM_RetentionHint hint) {
+	if (ATOMIC_XCHG(data->retention[frame], hint) == BM_RETAIN_EVICT_FIRST) {
+		ATOMIC_DEC(data->numEvictFirst);
+	}
+	if (hint == BM_RETAIN_EVICT_FIRST) {
+		ATOMIC_INC(data->numEvictFirst);
+	}
+}
+
+/**
+ * Private utility function to apply retention hint of a pin to the resident
+ * page it pinned. The pin keeps the frame from being evicted meanwhile, so
+ * no latch is needed.
+ *
+ * bm = buffer pool handle
+ * index = index of the pinned frame
+ * hint = retention class the pin asked for
+ */
+PRIVATE inline void noteRetentionHint(BM_BufferPool * const bm,
+		const int index, const BM_RetentionHint hint) {
+
+	int evictFirst = BM_RETAIN_EVICT_FIRST;
+
+	if (hint == BM_RETAIN_STICKY) {
+		if (ATOMIC_LOAD(((BM_Data *) bm->mgmtData)->retention[index])
+				!= BM_RETAIN_STICKY) {
+			setFrameRetention((BM_Data *) bm->mgmtData, index,
+					BM_RETAIN_STICKY);
+		}
+	} else if (hint == BM_RETAIN_NORMAL
+			&& ATOMIC_CAS(((BM_Data *) bm->mgmtData)->retention[index],
+					evictFirst, BM_RETAIN_NORMAL)) {
+		//Page is used again, it wasn't touched just once after all
+		ATOMIC_DEC(((BM_Data *) bm->mgmtData)->numEvictFirst);
+	}
+}
+
+/**
+ * Marks frame dirty. Returns TRUE if frame was clean before, the frame is
+ * then linked into the dirty list.
+ *
+ * data = buffer pool management data
+ * frame = index of the page frame
+ */
+bool setFrameDirty(BM_Data * const data, const int frame) {
+
+	//Frame already dirty, which is the common case: no latch needed
+	if (ATOMIC_LOAD(data->dirtyFlags[frame]) == TRUE) {
+		return FALSE;
+	}
+
+	bool ret = FALSE;
+	pthread_mutex_lock(&data->dirtyLock);
+	if (data->dirtyFlags[frame] == FALSE) {
+		//Link frame at head of the dirty list
+		data->dirtyPrev[frame] = -1;
+		data->dirtyNext[frame] = data->dirtyHead;
+		if (data->dirtyHead != -1) {
+			data->dirtyPrev[data->dirtyHead] = frame;
+		}
+		data->dirtyHead = frame;
+		ATOMIC_STORE(data->dirtyFlags[frame], TRUE);
+		//Increment dirty page count
+		ATOMIC_INC(data->numDirtyPages);
+		ret = TRUE;
+	}
+	pthread_mutex_unlock(&data->dirtyLock);
+
+	return ret;
+}
+
+/**
+ * Resets dirty flag of frame and unlinks it from the dirty list. Returns
+ * TRUE if frame was dirty, i.e. caller now owns writing it back.
+ *
+ * data = buffer pool management data
+ * frame = index of the page frame
+ */
+bool clearFrameDirty(BM_Data * const data, const int frame) {
+
+	//Frame already clean: no latch needed
+	if (ATOMIC_LOAD(data->dirtyFlags[frame]) == FALSE) {
+		return FALSE;
+	}
+
+	bool ret = FALSE;
+	pthread_mutex_lock(&data->dirtyLock);
+	if (data->dirtyFlags[frame] == TRUE) {
+		unlinkDirtyFrame(data, frame);
+		ATOMIC_STORE(data->dirtyFlags[frame], FALSE);
+		//Decrement dirty page count
+		ATOMIC_DEC(data->numDirtyPages);
+		ret = TRUE;
+	}
+	pthread_mutex_unlock(&data->dirtyLock);
+
+	return ret;
+}
+
+/**
+ * Private utility function to take a frame out of the dirty list. Caller
+ * must hold the dirty list latch.
+ *
+ * data = buffer pool management data
+ * frame = index of the dirty page frame
+ */
+PRIVATE inline void unlinkDirtyFrame(BM_Data * const data, const int frame) {
+	if (data->dirtyPrev[frame] != -1) {
+		data->dirtyNext[data->dirtyPrev[frame]] = data->dirtyNext[frame];
+	} else {
+		data->dirtyHead = data->dirtyNext[frame];
+	}
+	if (data->dirtyNext[frame] != -1) {
+		data->dirtyPrev[data->dirtyNext[frame]] = data->dirtyPrev[frame];
+	}
+	data->dirtyNext[frame] = -1;
+	data->dirtyPrev[frame] = -1;
+}
+
+/**
+ *	Private utility function to find free frame index within
+ *	internal page - frame mapping array. Returned frame is claimed for the
+ *	caller: its fix count is FRAME_EVICTING and its old page, if any, has been
+ *	swapped out. Caller must hold the pool latch, which is released while
+ *	waiting for frames in I/O or writing back the victim.
+ *
+ *	bm = buffer pool handle
+ */
+PRIVATE inline int getFreeFrameIndex(BM_BufferPool * const bm) {
+
+	int freeIndex;
+
+	//Pool has been shrunk while some retired frames were pinned
+	if (((BM_Data *) bm->mgmtData)->numFramesUsed
+			> ((BM_Data *) bm->mgmtData)->numFrames) {
+		evictRetiredFrames(bm);
+	}
+
+	for (;;) {
+		//A latch-free pin may take the chosen frame before we claim it,
+		//choose again in that case
+		while ((freeIndex = chooseVictimFrame(bm)) != -1) {
+			int unpinned = 0;
+			if (ATOMIC_CAS(((BM_Data *) bm->mgmtData)->fixCount[freeIndex],
+					unpinned, FRAME_EVICTING)) {
+				break;
+			}
+		}
+		//Frames in I/O are neither pinned nor victims, wait for one to finish
+		if (freeIndex != -1
+				|| ((BM_Data *) bm->mgmtData)->numFramesInIO == 0) {
+			break;
+		}
+		waitForPin(bm, &((BM_Data *) bm->mgmtData)->frameIdle);
+	}
+
+	if (freeIndex != -1
+			&& ((BM_Data *) bm->mgmtData)->pageFrameIndexMap[freeIndex]
+					!= NO_PAGE) {
+		STAT_ADD(((BM_Data *) bm->mgmtData)->stats.strategyVictims[
+				bm->strategy], 1);
+		if (!checkAndSwapPage(bm, freeIndex, BM_EVICT_REPLACE)) {
+			//Victim couldn't be written back, it keeps its page and stays
+			//dirty
+			ATOMIC_STORE(((BM_Data *) bm->mgmtData)->fixCount[freeIndex], 0);
+			pthread_cond_broadcast(&((BM_Data *) bm->mgmtData)->frameIdle);
+			freeIndex = -1;
+		}
+	}
+
+	return freeIndex;
+}
+
+/**
+ *	Private utility function to take the next frame of an access ring for
+ *	page pageNum. The frame is recycled if it still holds the page the ring
+ *	put there and nobody has it pinned, otherwise a frame is taken from the
+ *	pool as usual and replaces it in the ring. Returned frame is claimed like
+ *	one from getFreeFrameIndex. Caller must hold the pool latch.
+ *
+ *	bm = buffer pool handle
+ *	ring = access ring of the caller
+ *	pageNum = page to be loaded in the frame
+ */
+PRIVATE int getRingFrameIndex(BM_BufferPool * const bm,
+		BM_AccessRing * const ring, const PageNumber pageNum) {
+
+	int slot = ring->next;
+	int index = ring->frames[slot];
+	int unpinned = 0;
+
+	ring->next = (slot + 1) % ring->size;
+
+	if (index != -1 && index < ((BM_Data *) bm->mgmtData)->numFrames
+			&& ((BM_Data *) bm->mgmtData)->pageFrameIndexMap[index]
+					== ring->pages[slot]
+			&& ((BM_Data *) bm->mgmtData)->frameFile[index] == bm->fileId
+			&& ATOMIC_CAS(((BM_Data *) bm->mgmtData)->fixCount[index],
+					unpinned, FRAME_EVICTING)) {
+		if (!checkAndSwapPage(bm, index, BM_EVICT_RING)) {
+			//Frame couldn't be written back, it keeps its page
+			ATOMIC_STORE(((BM_Data *) bm->mgmtData)->fixCount[index], 0);
+			pthread_cond_broadcast(&((BM_Data *) bm->mgmtData)->frameIdle);
+			index = -1;
+		}
+	} else {
+		index = getFreeFrameIndex(bm);
+	}
+
+	if (index != -1) {
+		ring->frames[slot] = index;
+		ring->pages[slot] = pageNum;
+	}
+
+	return index;
+}
+
+/**
+ * Sets up an access ring of size frames for large sequential passes over
+ * pool bm, see pinPageWithRing. Ring is clamped to a quarter of the pool.
+ * A ring belongs to a single caller and must not be shared between threads.
+ *
+ * bm = buffer pool handle
+ * ring = access ring to be initialized
+ * size = no of frames in the ring
+ */
+RC initAccessRing(BM_BufferPool * const bm, BM_AccessRing * const ring,
+		const int size) {
+
+	int i;
+
+	//Sanity checks
+	if (bm == NULL) {
+		THROW(RC_INVALID_HANDLE, "Buffer pool handle is invalid");
+	}
+	if (ring == NULL) {
+		THROW(RC_INVALID_HANDLE, "Access ring is invalid");
+	}
+
+	int numFrames = ATOMIC_LOAD(((BM_Data *) bm->mgmtData)->numFrames);
+	ring->size = size < numFrames / 4 ? size : numFrames / 4;
+	if (ring->size < 1) {
+		ring->size = 1;
+	}
+	ring->next = 0;
+	ring->frames = (int *) malloc(ring->size * sizeof(int));
+	ring->pages = (PageNumber *) malloc(ring->size * sizeof(PageNumber));
+
+	if (ring->frames == NULL || ring->pages == NULL) {
+		free(ring->frames);
+		free(ring->pages);
+		ring->frames = NULL;
+		ring->pages = NULL;
+		THROW(RC_NOT_ENOUGH_MEMORY,
+				"Not enough memory available for resource allocation");
+	}
+
+	for (i = 0; i < ring->size; i++) {
+		ring->frames[i] = -1;
+		ring->pages[i] = NO_PAGE;
+	}
+
+	//All OK
+	return RC_OK;
+}
+
+/**
+ * Releases an access ring. Pages it loaded stay in the pool.
+ *
+ * ring = access ring to be released
+ */
+void freeAccessRing(BM_AccessRing * const ring) {
+	free(ring->frames);
+	ring->frames = NULL;
+	free(ring->pages);
+	ring->pages = NULL;
+}
+
+/**
+ *	Private utility function to pick an empty frame or, if there is none, a
+ *	victim frame with fix count 0: an evict-first one if there is one, else
+ *	as per replacement policy of the pool.
+ *	Frames are only searched for an empty one while the policy doesn't know
+ *	all of them to hold a page, a full pool goes straight to the policy.
+ *
+ *	bm = buffer pool handle
+ */
+PRIVATE inline int chooseVictimFrame(BM_BufferPool * const bm) {
+
+	int i, n;
+
+	//Look for free page frame, retired frames are never handed out
+	if (((BM_Data *) bm->mgmtData)->numFramesLoaded
+			< ((BM_Data *) bm->mgmtData)->numFrames) {
+		for (i = 0; i < ((BM_Data *) bm->mgmtData)->numFrames; i++) {
+			//Empty, and not claimed by a batch pin already
+			if (((BM_Data *) bm->mgmtData)->pageFrameIndexMap[i] == NO_PAGE
+					&& ATOMIC_LOAD(((BM_Data *) bm->mgmtData)->fixCount[i])
+							== 0) {
+				return i;
+			}
+		}
+	}
+
+	//Evict-first pages go before the policy is asked, hand sweeps over them
+	//so they leave in turn
+	if (ATOMIC_LOAD(((BM_Data *) bm->mgmtData)->numEvictFirst) > 0) {
+		for (n = 0; n < ((BM_Data *) bm->mgmtData)->numFrames; n++) {
+			i = ((BM_Data *) bm->mgmtData)->evictFirstHand++;
+			if (i >= ((BM_Data *) bm->mgmtData)->numFrames) {
+				i = 0;
+				((BM_Data *) bm->mgmtData)->evictFirstHand = 1;
+			}
+			if (ATOMIC_LOAD(((BM_Data *) bm->mgmtData)->retention[i])
+					== BM_RETAIN_EVICT_FIRST
+					&& ((BM_Data *) bm->mgmtData)->pageFrameIndexMap[i]
+							!= NO_PAGE
+					&& ATOMIC_LOAD(((BM_Data *) bm->mgmtData)->fixCount[i])
+							== 0) {
+				return i;
+			}
+		}
+	}
+
+	return ((BM_Data *) bm->mgmtData)->policy->chooseVictim(
+			(BM_Data *) bm->mgmtData, ((BM_Data *) bm->mgmtData)->policyState);
+}
+
+/**
+ *	Private utility function to write back page of a claimed victim frame if
+ *	it's dirty and detach the page from the frame. Pins of the old page wait
+ *	for the write back, then find it gone and read it again. Returns FALSE,
+ *	leaving the page in its frame, if the write back failed.
+ *
+ *	bm = buffer pool handle
+ *	num = index of the victim frame
+ */
+PRIVATE inline bool checkAndSwapPage(BM_BufferPool * const bm, PageNumber num,
+		const BM_EvictReason reason) {
+	if (((BM_Data *) bm->mgmtData)->dirtyFlags[num] == TRUE) {
+		if (writeClaimedFrame(bm, num)) {
+			STAT_ADD(((BM_Data *) bm->mgmtData)->stats.dirtyEvictions, 1);
+		} else if (((BM_Data *) bm->mgmtData)->dirtyFlags[num] == TRUE) {
+			//Write failed, the frame keeps its page
+			return FALSE;
+		}
+	}
+	STAT_ADD(((BM_Data *) bm->mgmtData)->stats.evictions[reason], 1);
+	//Frame leaves the replacement policy before the latch may be released
+	if (((BM_Data *) bm->mgmtData)->policy->onEvict != NULL) {
+		((BM_Data *) bm->mgmtData)->policy->onEvict((BM_Data *) bm->mgmtData,
+				((BM_Data *) bm->mgmtData)->policyState, num);
+	}
+	((BM_Data *) bm->mgmtData)->numFramesLoaded--;
+	//Prefetched page evicted before anyone pinned it
+	if (((BM_Data *) bm->mgmtData)->prefetched != NULL
+			&& ATOMIC_XCHG(((BM_Data *) bm->mgmtData)->prefetched[num], FALSE)
+					== TRUE) {
+		notePrefetchUse(bm, FALSE);
+	}
+	//Page is clean now, keep a compressed copy of replaced ones. Pages of
+	//access rings were touched once and pages of closed files are gone.
+	if (((BM_Data *) bm->mgmtData)->tier != NULL
+			&& (reason == BM_EVICT_REPLACE || reason == BM_EVICT_RESIZE)) {
+		storeTierPage(bm, num);
+	}
+	((BM_Data *) bm->mgmtData)->pageInTime[num] = 0;
+	((BM_Data *) bm->mgmtData)->pageUsedTime[num] = 0;
+	((BM_Data *) bm->mgmtData)->pageUsedCount[num] = 0;
+	setFrameRetention((BM_Data *) bm->mgmtData, num, BM_RETAIN_NORMAL);
+	//Drop the page from page table
+	removePageTable((BM_Data *) bm->mgmtData,
+			((BM_Data *) bm->mgmtData)->frameFile[num],
+			((BM_Data *) bm->mgmtData)->pageFrameIndexMap[num], num);
+	//Update page and frame index mapping
+	ATOMIC_STORE(((BM_Data *) bm->mgmtData)->pageFrameIndexMap[num], NO_PAGE);
+	((BM_Data *) bm->mgmtData)->pages[num].pageNum = NO_PAGE;
+	//Let waiters for the old page look again
+	pthread_cond_broadcast(&((BM_Data *) bm->mgmtData)->frameCond[num]);
+
+	return TRUE;
+}
+
+/**
+ *	Private utility function to read page pageNum into a claimed, empty frame
+ *	and pin it. The page is published as FRAME_READING first, so that pins of
+ *	the same page wait for this read instead of issuing their own, then the
+ *	pool latch is released during the read. Caller must hold the pool latch.
+ *
+ *	bm = buffer pool handle
+ *	num = index of the claimed frame
+ *	pageNum = page to be read
+ */
+PRIVATE RC loadClaimedFrame(BM_BufferPool * const bm, const int num,
+		const PageNumber pageNum) {
+
+	RC ret = RC_OK;
+
+	if (publishClaimedFrame(bm, num, pageNum)) {
+		//Read requested page from page file on disk
+		beginFrameIO(bm, num, FRAME_READING);
+		uint64_t start = statClock();
+		ret = readBlock(pageNum,
+				&((BM_Data *) bm->mgmtData)->files[bm->fileId]->smFH,
+				((BM_Data *) bm->mgmtData)->pages[num].data);
+		noteIOLatency((BM_Data *) bm->mgmtData, FALSE, start);
+		endFrameIO(bm, num);
+		if (ret == RC_OK) {
+			STAT_ADD(((BM_Data *) bm->mgmtData)->stats.reads, 1);
+		}
+	}
+
+	return finishClaimedFrame(bm, num, ret);
+}
+
+/**
+ *	Private utility function to load pages pageNums[0..n-1] into claimed,
+ *	empty frames frames[0..n-1] and pin them. All pages are published first,
+ *	then read with one vectored read per run of consecutive pages while the
+ *	pool latch is released. Frames whose read failed are given back and set
+ *	to -1 in frames, the last failure is returned. Caller must hold the pool
+ *	latch.
+ *
+ *	bm = buffer pool handle
+ *	frames = indexes of the claimed frames
+ *	pageNums = pages to be read, ideally sorted
+ *	n = no of pages
+ */
+PRIVATE RC loadClaimedFrames(BM_BufferPool * const bm, int * const frames,
+		const PageNumber * const pageNums, const int n) {
+
+	int i, numReads = 0;
+	RC ret = RC_OK;
+
+	if (n == 0) {
+		return RC_OK;
+	}
+
+	int *readNums = (int *) malloc(n * sizeof(int));
+	SM_PageHandle *readData = (SM_PageHandle *) malloc(
+			n * sizeof(SM_PageHandle));
+	RC *results = (RC *) malloc(n * sizeof(RC));
+	if (readNums == NULL || readData == NULL || results == NULL) {
+		free(readNums);
+		free(readData);
+		free(results);
+		//Fall back to loading one frame at a time
+		for (i = 0; i < n; i++) {
+			if (loadClaimedFrame(bm, frames[i], pageNums[i]) != RC_OK) {
+				frames[i] = -1;
+				ret = RC_READ_FAILED;
+			}
+		}
+		return ret;
+	}
+
+	for (i = 0; i < n; i++) {
+		if (publishClaimedFrame(bm, frames[i], pageNums[i])) {
+			((BM_Data *) bm->mgmtData)->frameState[frames[i]] = FRAME_READING;
+			((BM_Data *) bm->mgmtData)->numFramesInIO++;
+			readNums[numReads] = pageNums[i];
+			readData[numReads] =
+					((BM_Data *) bm->mgmtData)->pages[frames[i]].data;
+			numReads++;
+		}
+	}
+
+	if (numReads > 0) {
+		//Release pool latch
+		pthread_mutex_unlock(&((BM_Data *) bm->mgmtData)->poolLock);
+		uint64_t start = statClock();
+		readBlocks(readNums, numReads,
+				&((BM_Data *) bm->mgmtData)->files[bm->fileId]->smFH, readData,
+				results);
+		noteIOLatency((BM_Data *) bm->mgmtData, FALSE, start);
+		//Acquire pool latch
+		pthread_mutex_lock(&((BM_Data *) bm->mgmtData)->poolLock);
+	}
+
+	numReads = 0;
+	for (i = 0; i < n; i++) {
+		RC read = RC_OK;
+		if (((BM_Data *) bm->mgmtData)->frameState[frames[i]]
+				== FRAME_READING) {
+			((BM_Data *) bm->mgmtData)->frameState[frames[i]] = FRAME_READY;
+			((BM_Data *) bm->mgmtData)->numFramesInIO--;
+			pthread_cond_broadcast(
+					&((BM_Data *) bm->mgmtData)->frameCond[frames[i]]);
+			pthread_cond_broadcast(&((BM_Data *) bm->mgmtData)->frameIdle);
+			read = results[numReads++];
+			if (read == RC_OK) {
+				STAT_ADD(((BM_Data *) bm->mgmtData)->stats.reads, 1);
+			}
+		}
+		if (finishClaimedFrame(bm, frames[i], read) != RC_OK) {
+			frames[i] = -1;
+			ret = read;
+		}
+	}
+
+	free(readNums);
+	free(readData);
+	free(results);
+
+	return ret;
+}
+
+/**
+ *	Private utility function to publish page pageNum in a claimed, empty
+ *	frame. A page beyond end of page file is zeroed right away, one in the
+ *	compressed tier taken from there, otherwise TRUE is returned and caller
+ *	must read the page and finish the frame.
+ *	Caller must hold the pool latch.
+ *
+ *	bm = buffer pool handle
+ *	num = index of the claimed frame
+ *	pageNum = page to be loaded
+ */
+PRIVATE bool publishClaimedFrame(BM_BufferPool * const bm, const int num,
+		const PageNumber pageNum) {
+
+	BM_File *file = ((BM_Data *) bm->mgmtData)->files[bm->fileId];
+
+	//Set page number in frame descriptor
+	((BM_Data *) bm->mgmtData)->pages[num].pageNum = pageNum;
+	//Publish the frame in page table, page file first as probes match it last
+	ATOMIC_STORE(((BM_Data *) bm->mgmtData)->frameFile[num], bm->fileId);
+	ATOMIC_STORE(((BM_Data *) bm->mgmtData)->pageFrameIndexMap[num], pageNum);
+	insertPageTable((BM_Data *) bm->mgmtData, bm->fileId, pageNum, num);
+
+	//Check if requested page is available in page file on disk, its
+	//compressed copy saves the read
+	if (pageNum < file->smFH.totalNumPages) {
+		return ((BM_Data *) bm->mgmtData)->tier == NULL
+				|| !loadTierPage(bm, bm->fileId, pageNum,
+						((BM_Data *) bm->mgmtData)->pages[num].data);
+	}
+
+	file->newBlockRequested = TRUE;
+	setFrameDirty((BM_Data *) bm->mgmtData, num);
+	//Now that the block is new, it must contain all NULLs, don't read from disk, it's slow
+	memset(((BM_Data *) bm->mgmtData)->pages[num].data, '\0', PAGE_SIZE);
+	if (pageNum > file->lastBlockRequested) {
+		file->lastBlockRequested = pageNum;
+	}
+
+	return FALSE;
+}
+
+/**
+ *	Private utility function to pin a published frame once its page is read,
+ *	or to unpublish it and give it back empty if the read failed.
+ *	Caller must hold the pool latch.
+ *
+ *	bm = buffer pool handle
+ *	num = index of the claimed frame
+ *	ret = outcome of the read
+ */
+PRIVATE RC finishClaimedFrame(BM_BufferPool * const bm, const int num,
+		const RC ret) {
+
+	if (ret != RC_OK) {
+		//Unpublish the frame and give it back empty
+		removePageTable((BM_Data *) bm->mgmtData,
+				((BM_Data *) bm->mgmtData)->frameFile[num],
+				((BM_Data *) bm->mgmtData)->pageFrameIndexMap[num], num);
+		ATOMIC_STORE(((BM_Data *) bm->mgmtData)->pageFrameIndexMap[num],
+				NO_PAGE);
+		((BM_Data *) bm->mgmtData)->pages[num].pageNum = NO_PAGE;
+		if (((BM_Data *) bm->mgmtData)->prefetched != NULL) {
+			ATOMIC_STORE(((BM_Data *) bm->mgmtData)->prefetched[num], FALSE);
+		}
+		setFrameRetention((BM_Data *) bm->mgmtData, num, BM_RETAIN_NORMAL);
+		ATOMIC_STORE(((BM_Data *) bm->mgmtData)->fixCount[num], 0);
+		pthread_cond_broadcast(&((BM_Data *) bm->mgmtData)->frameCond[num]);
+		pthread_cond_broadcast(&((BM_Data *) bm->mgmtData)->frameIdle);
+		return ret;
+	}
+
+	((BM_Data *) bm->mgmtData)->pageInTime[num] = ATOMIC_INC(
+			((BM_Data *) bm->mgmtData)->clock);
+	//Hand the frame to replacement policy before pins can see it
+	if (((BM_Data *) bm->mgmtData)->policy->onLoad != NULL) {
+		((BM_Data *) bm->mgmtData)->policy->onLoad((BM_Data *) bm->mgmtData,
+				((BM_Data *) bm->mgmtData)->policyState, num);
+	}
+	((BM_Data *) bm->mgmtData)->numFramesLoaded++;
+	//Page is ready, pin it. This also makes it visible to latch-free pins.
+	ATOMIC_STORE(((BM_Data *) bm->mgmtData)->fixCount[num], 1);
+
+	//All OK
+	return RC_OK;
+}
+
+/**
+ *	Private utility function to write back page of a claimed, dirty frame.
+ *	The frame is flagged FRAME_WRITING and the pool latch is released during
+ *	the write. Returns TRUE if the page was written. A failed write leaves
+ *	the page dirty again and returns FALSE. Caller must hold the pool latch,
+ *	which is held again on return.
+ *
+ *	bm = buffer pool handle
+ *	num = index of the claimed frame
+ */
+PRIVATE bool writeClaimedFrame(BM_BufferPool * const bm, const int num) {
+
+	//Ensure enough blocks exist in underlying pagefile, then reset dirty
+	//flag unless that already wrote this page. Appending may release the
+	//latch, so the frame is flagged meanwhile to keep latched pins off it.
+	((BM_Data *) bm->mgmtData)->frameState[num] = FRAME_WRITING;
+	bool written = writeNewBlocks(bm, num);
+	((BM_Data *) bm->mgmtData)->frameState[num] = FRAME_READY;
+	if (written) {
+		return TRUE;
+	}
+	if (!clearFrameDirty((BM_Data *) bm->mgmtData, num)) {
+		return FALSE;
+	}
+
+	beginFrameIO(bm, num, FRAME_WRITING);
+	uint64_t start = statClock();
+	RC ret = writeBlock(((BM_Data *) bm->mgmtData)->pageFrameIndexMap[num],
+			&((BM_Data *) bm->mgmtData)->files[
+					((BM_Data *) bm->mgmtData)->frameFile[num]]->smFH,
+			((BM_Data *) bm->mgmtData)->pages[num].data);
+	noteIOLatency((BM_Data *) bm->mgmtData, TRUE, start);
+	endFrameIO(bm, num);
+
+	if (ret != RC_OK) {
+		//Keep the page dirty, it's written again later
+		setFrameDirty((BM_Data *) bm->mgmtData, num);
+		return FALSE;
+	}
+
+	//Update IO Count
+	STAT_ADD(((BM_Data *) bm->mgmtData)->stats.writes, 1);
+
+	return TRUE;
+}
+
+/**
+ * Writes back page of frame num if it's dirty and nobody has it pinned.
+ * Returns TRUE if the page was written. Caller must hold the pool latch,
+ * which is released during the write.
+ *
+ * bm = buffer pool handle
+ * num = index of the page frame
+ */
+bool writeBackFrame(BM_BufferPool * const bm, const int num) {
+
+	if (((BM_Data *) bm->mgmtData)->pageFrameIndexMap[num] == NO_PAGE
+			|| ATOMIC_LOAD(((BM_Data *) bm->mgmtData)->dirtyFlags[num])
+					== FALSE) {
+		return FALSE;
+	}
+
+	//Claim the frame so no latch-free pin can modify it while it's written
+	int unpinned = 0;
+	if (!ATOMIC_CAS(((BM_Data *) bm->mgmtData)->fixCount[num], unpinned,
+			FRAME_EVICTING)) {
+		return FALSE;
+	}
+
+	bool written = writeClaimedFrame(bm, num);
+
+	//Give the frame back
+	ATOMIC_STORE(((BM_Data *) bm->mgmtData)->fixCount[num], 0);
+	pthread_cond_broadcast(&((BM_Data *) bm->mgmtData)->frameCond[num]);
+	pthread_cond_broadcast(&((BM_Data *) bm->mgmtData)->frameIdle);
+
+	return written;
+}
+
+/**
+ *	Private utility function to pin frame num on behalf of the pool, so its
+ *	page stays while the pool latch is released. Fails if the frame is
+ *	claimed. Returns TRUE if the frame was pinned.
+ *
+ *	data = buffer pool management data
+ *	num = index of the page frame
+ */
+PRIVATE inline bool holdFrame(BM_Data * const data, const int num) {
+	int fix = ATOMIC_LOAD(data->fixCount[num]);
+	do {
+		if (fix < 0) {
+			return FALSE;
+		}
+	} while (!ATOMIC_CAS(data->fixCount[num], fix, fix + 1));
+
+	return TRUE;
+}
+
+/**
+ * Writes back dirty, unpinned pages of page file of pool handle bm in page
+ * number order. Dirty pages are found through the dirty list, so the cost
+ * is in the no of dirty pages, not pool size. Frames are claimed
+ * BM_FLUSH_BATCH at a time and each run of consecutive pages goes to disk
+ * with one vectored write while the latch is released. Returns no of pages
+ * written. Caller must hold the pool latch.
+ *
+ * bm = buffer pool handle
+ */
+int flushFilePages(BM_BufferPool * const bm) {
+
+	int i, n = 0, written = 0;
+
+	//Ensure enough blocks exist in underlying pagefile
+	writeNewBlocks(bm, -1);
+
+	//Pages dirtied once the list is walked are left for the next flush
+	int numDirty = ATOMIC_LOAD(((BM_Data *) bm->mgmtData)->numDirtyPages);
+	FlushEntry *entries = (FlushEntry *) malloc(
+			(numDirty + 1) * sizeof(FlushEntry));
+	int *frames = (int *) malloc(BM_FLUSH_BATCH * sizeof(int));
+	int *pageNums = (int *) malloc(BM_FLUSH_BATCH * sizeof(int));
+	SM_PageHandle *data = (SM_PageHandle *) malloc(
+			BM_FLUSH_BATCH * sizeof(SM_PageHandle));
+	RC *results = (RC *) malloc(BM_FLUSH_BATCH * sizeof(RC));
+	if (entries == NULL || frames == NULL || pageNums == NULL || data == NULL
+			|| results == NULL) {
+		free(entries);
+		free(frames);
+		free(pageNums);
+		free(data);
+		free(results);
+		//Fall back to writing one frame at a time
+		for (i = 0; i < ((BM_Data *) bm->mgmtData)->numFramesUsed; i++) {
+			if (((BM_Data *) bm->mgmtData)->frameFile[i] == bm->fileId
+					&& writeBackFrame(bm, i)) {
+				written++;
+			}
+		}
+		return written;
+	}
+
+	//Walk the dirty list rather than the whole pool
+	pthread_mutex_lock(&((BM_Data *) bm->mgmtData)->dirtyLock);
+	for (i = ((BM_Data *) bm->mgmtData)->dirtyHead; i != -1 && n < numDirty;
+			i = ((BM_Data *) bm->mgmtData)->dirtyNext[i]) {
+		if (((BM_Data *) bm->mgmtData)->frameFile[i] == bm->fileId
+				&& ((BM_Data *) bm->mgmtData)->pageFrameIndexMap[i] != NO_PAGE) {
+			entries[n].pageNum =
+					((BM_Data *) bm->mgmtData)->pageFrameIndexMap[i];
+			entries[n].frame = i;
+			n++;
+		}
+	}
+	pthread_mutex_unlock(&((BM_Data *) bm->mgmtData)->dirtyLock);
+	qsort(entries, n, sizeof(FlushEntry), compareFlushEntries);
+
+	int next = 0;
+	while (next < n) {
+		int numClaimed = 0;
+
+		//Claim the next batch. Latch was released since frames were
+		//collected, so each one is checked again.
+		for (; next < n && numClaimed < BM_FLUSH_BATCH; next++) {
+			int frame = entries[next].frame;
+			int unpinned = 0;
+			if (((BM_Data *) bm->mgmtData)->pageFrameIndexMap[frame]
+					!= entries[next].pageNum
+					|| ((BM_Data *) bm->mgmtData)->frameFile[frame]
+							!= bm->fileId
+					|| ((BM_Data *) bm->mgmtData)->frameState[frame]
+							!= FRAME_READY
+					|| !ATOMIC_CAS(((BM_Data *) bm->mgmtData)->fixCount[frame],
+							unpinned, FRAME_EVICTING)) {
+				continue;
+			}
+			//Reset dirty flag before writing, frame is claimed meanwhile
+			if (!clearFrameDirty((BM_Data *) bm->mgmtData, frame)) {
+				ATOMIC_STORE(((BM_Data *) bm->mgmtData)->fixCount[frame], 0);
+				continue;
+			}
+			((BM_Data *) bm->mgmtData)->frameState[frame] = FRAME_WRITING;
+			((BM_Data *) bm->mgmtData)->numFramesInIO++;
+			pageNums[numClaimed] = entries[next].pageNum;
+			data[numClaimed] = ((BM_Data *) bm->mgmtData)->pages[frame].data;
+			frames[numClaimed++] = frame;
+		}
+		if (numClaimed == 0) {
+			continue;
+		}
+
+		//Release pool latch
+		pthread_mutex_unlock(&((BM_Data *) bm->mgmtData)->poolLock);
+		uint64_t start = statClock();
+		writeBlocks(pageNums, numClaimed,
+				&((BM_Data *) bm->mgmtData)->files[bm->fileId]->smFH, data,
+				results);
+		noteIOLatency((BM_Data *) bm->mgmtData, TRUE, start);
+		//Acquire pool latch
+		pthread_mutex_lock(&((BM_Data *) bm->mgmtData)->poolLock);
+
+		for (i = 0; i < numClaimed; i++) {
+			if (results[i] == RC_OK) {
+				written++;
+			} else {
+				//Keep the page dirty, it's written again later
+				setFrameDirty((BM_Data *) bm->mgmtData, frames[i]);
+			}
+			((BM_Data *) bm->mgmtData)->frameState[frames[i]] = FRAME_READY;
+			((BM_Data *) bm->mgmtData)->numFramesInIO--;
+			ATOMIC_STORE(((BM_Data *) bm->mgmtData)->fixCount[frames[i]], 0);
+			pthread_cond_broadcast(
+					&((BM_Data *) bm->mgmtData)->frameCond[frames[i]]);
+		}
+		pthread_cond_broadcast(&((BM_Data *) bm->mgmtData)->frameIdle);
+	}
+	STAT_ADD(((BM_Data *) bm->mgmtData)->stats.writes, written);
+
+	free(entries);
+	free(frames);
+	free(pageNums);
+	free(data);
+	free(results);
+
+	return written;
+}
+
+/**
+ * Writes back all dirty pages of page file of pool handle bm and drops all
+ * its pages from pool, so the page file can be closed. Fails without
+ * dropping anything if one of them is pinned, and stops at the first page
+ * that can't be written back. Caller must hold the pool latch, which is
+ * released during writes.
+ *
+ * bm = buffer pool handle
+ */
+RC evictFilePages(BM_BufferPool * const bm) {
+
+	int i;
+
+	for (i = 0; i < ((BM_Data *) bm->mgmtData)->numFramesUsed; i++) {
+		if (((BM_Data *) bm->mgmtData)->frameFile[i] == bm->fileId
+				&& ((BM_Data *) bm->mgmtData)->pageFrameIndexMap[i] != NO_PAGE
+				&& ATOMIC_LOAD(((BM_Data *) bm->mgmtData)->fixCount[i]) > 0) {
+			THROW(RC_SHUTDOWN_FAIL,
+					"There are some pages pinned in memory, cannot shutdown now");
+		}
+	}
+
+	//Write dirty pages back in page order first, eviction below then finds
+	//them clean
+	flushFilePages(bm);
+
+	for (i = 0; i < ((BM_Data *) bm->mgmtData)->numFramesUsed; i++) {
+		//Page is being read or written back, wait for that and look again
+		while (((BM_Data *) bm->mgmtData)->frameFile[i] == bm->fileId
+				&& ((BM_Data *) bm->mgmtData)->pageFrameIndexMap[i] != NO_PAGE
+				&& ((BM_Data *) bm->mgmtData)->frameState[i] != FRAME_READY) {
+			pthread_cond_wait(&((BM_Data *) bm->mgmtData)->frameCond[i],
+					&((BM_Data *) bm->mgmtData)->poolLock);
+		}
+		if (((BM_Data *) bm->mgmtData)->frameFile[i] != bm->fileId
+				|| ((BM_Data *) bm->mgmtData)->pageFrameIndexMap[i] == NO_PAGE) {
+			continue;
+		}
+
+		//Claim the frame, write it back if dirty and detach its page
+		int unpinned = 0;
+		if (!ATOMIC_CAS(((BM_Data *) bm->mgmtData)->fixCount[i], unpinned,
+				FRAME_EVICTING)) {
+			THROW(RC_SHUTDOWN_FAIL,
+					"There are some pages pinned in memory, cannot shutdown now");
+		}
+		bool swapped = checkAndSwapPage(bm, i, BM_EVICT_CLOSE);
+
+		//Give the frame back, empty unless its page couldn't be written
+		ATOMIC_STORE(((BM_Data *) bm->mgmtData)->fixCount[i], 0);
+		pthread_cond_broadcast(&((BM_Data *) bm->mgmtData)->frameIdle);
+		if (!swapped) {
+			THROW(RC_WRITE_FAILED, "Writing back a page failed");
+		}
+	}
+
+	//All OK
+	return RC_OK;
+}
+
+/**
+ * Evicts pages of frames retired by shrinking the pool, dirty ones are
+ * written back first, and gives memory of the emptied frames at the end of
+ * the arena back to the system. Frames pinned or in I/O are left for a later
+ * call. Caller must hold the pool latch, which is released during writes.
+ *
+ * bm = buffer pool handle
+ */
+void evictRetiredFrames(BM_BufferPool * const bm) {
+
+	int i, used = ((BM_Data *) bm->mgmtData)->numFramesUsed;
+
+	//Bounds are read again each time, a resize may run during a write
+	for (i = ((BM_Data *) bm->mgmtData)->numFrames;
+			i < ((BM_Data *) bm->mgmtData)->numFramesUsed; i++) {
+		if (((BM_Data *) bm->mgmtData)->pageFrameIndexMap[i] == NO_PAGE
+				|| ((BM_Data *) bm->mgmtData)->frameState[i] != FRAME_READY) {
+			continue;
+		}
+
+		//Claim the frame, write it back if dirty and detach its page
+		int unpinned = 0;
+		if (!ATOMIC_CAS(((BM_Data *) bm->mgmtData)->fixCount[i], unpinned,
+				FRAME_EVICTING)) {
+			continue;
+		}
+		checkAndSwapPage(bm, i, BM_EVICT_RESIZE);
+
+		//Give the frame back empty
+		ATOMIC_STORE(((BM_Data *) bm->mgmtData)->fixCount[i], 0);
+		pthread_cond_broadcast(&((BM_Data *) bm->mgmtData)->frameIdle);
+	}
+
+	//Retired frames past the last one still in use are dropped
+	while (((BM_Data *) bm->mgmtData)->numFramesUsed
+			> ((BM_Data *) bm->mgmtData)->numFrames) {
+		i = ((BM_Data *) bm->mgmtData)->numFramesUsed - 1;
+		if (((BM_Data *) bm->mgmtData)->pageFrameIndexMap[i] != NO_PAGE
+				|| ATOMIC_LOAD(((BM_Data *) bm->mgmtData)->fixCount[i]) != 0) {
+			break;
+		}
+		((BM_Data *) bm->mgmtData)->numFramesUsed--;
+	}
+
+	//Explicit huge pages can only be released in whole
+	if (((BM_Data *) bm->mgmtData)->numFramesUsed < used
+			&& ((BM_Data *) bm->mgmtData)->hugePageState
+					!= BM_HUGEPAGE_MAPPED) {
+		madvise(((BM_Data *) bm->mgmtData)->frameArena
+				+ (size_t) ((BM_Data *) bm->mgmtData)->numFramesUsed * PAGE_SIZE,
+				(size_t) (used - ((BM_Data *) bm->mgmtData)->numFramesUsed)
+						* PAGE_SIZE, MADV_DONTNEED);
+	}
+}
+
+/**
+ *	Private utility function to flag a claimed frame as in I/O and release
+ *	the pool latch for the duration of the I/O
+ *
+ *	bm = buffer pool handle
+ *	num = index of the claimed frame
+ *	state = FRAME_READING or FRAME_WRITING
+ */
+PRIVATE inline void beginFrameIO(BM_BufferPool * const bm, const int num,
+		const int state) {
+	((BM_Data *) bm->mgmtData)->frameState[num] = state;
+	((BM_Data *) bm->mgmtData)->numFramesInIO++;
+	//Release pool latch
+	pthread_mutex_unlock(&((BM_Data *) bm->mgmtData)->poolLock);
+}
+
+/**
+ *	Private utility function to re-acquire the pool latch after I/O on a
+ *	frame and wake up everyone waiting for it
+ *
+ *	bm = buffer pool handle
+ *	num = index of the claimed frame
+ */
+PRIVATE inline void endFrameIO(BM_BufferPool * const bm, const int num) {
+	//Acquire pool latch
+	pthread_mutex_lock(&((BM_Data *) bm->mgmtData)->poolLock);
+	((BM_Data *) bm->mgmtData)->frameState[num] = FRAME_READY;
+	((BM_Data *) bm->mgmtData)->numFramesInIO--;
+	pthread_cond_broadcast(&((BM_Data *) bm->mgmtData)->frameCond[num]);
+	pthread_cond_broadcast(&((BM_Data *) bm->mgmtData)->frameIdle);
+}
+
+/**
+ *	Private utility function to take the pool latch on behalf of a pin. Only
+ *	a contended latch is timed, so the clock stays off the common path.
+ *
+ *	bm = buffer pool handle
+ */
+PRIVATE inline void latchPoolForPin(BM_BufferPool * const bm) {
+	if (pthread_mutex_trylock(&((BM_Data *) bm->mgmtData)->poolLock) != 0) {
+		uint64_t start = statClock();
+		pthread_mutex_lock(&((BM_Data *) bm->mgmtData)->poolLock);
+		notePinWait((BM_Data *) bm->mgmtData, start);
+	}
+}
+
+/**
+ *	Private utility function to wait on cond with the pool latch on behalf of
+ *	a pin, counting the wait in pool statistics
+ *
+ *	bm = buffer pool handle
+ *	cond = condition to wait on
+ */
+PRIVATE inline void waitForPin(BM_BufferPool * const bm,
+		pthread_cond_t * const cond) {
+	uint64_t start = statClock();
+	pthread_cond_wait(cond, &((BM_Data *) bm->mgmtData)->poolLock);
+	notePinWait((BM_Data *) bm->mgmtData, start);
+}
+
+/**
+ *	Private utility function ordering flush entries by page number
+ */
+PRIVATE int compareFlushEntries(const void *a, const void *b) {
+
+	PageNumber x = ((const FlushEntry *) a)->pageNum;
+	PageNumber y = ((const FlushEntry *) b)->pageNum;
+
+	return (x > y) - (x < y);
 }
 
 /**
@@ -461,31 +2005,31 @@ PRIVATE inline void checkAndSwapPage(BM_BufferPool * const bm, PageNumber num) {
 void inline printDebugInfo(BM_BufferPool * const bm) {
 	int i;
 	printf("\n\n Frame Index Map: ");
-	for (i = 0; i < bm->numPages; i++) {
+	for (i = 0; i < ((BM_Data *) bm->mgmtData)->numFramesUsed; i++) {
 		printf("  {%d,%d}, ", i,
 				((BM_Data *) bm->mgmtData)->pageFrameIndexMap[i]);
 	}
 
 	printf("\n Pages: ");
-	BM_PageHandle **pages = ((BM_Data *) bm->mgmtData)->pages;
-	for (i = 0; i < bm->numPages; i++) {
-		if ((pages[i] != NULL)) {
-			printf("  {%d,%d}, ", i, pages[i]->pageNum);
+	BM_PageHandle *pages = ((BM_Data *) bm->mgmtData)->pages;
+	for (i = 0; i < ((BM_Data *) bm->mgmtData)->numFramesUsed; i++) {
+		if (pages[i].pageNum != NO_PAGE) {
+			printf("  {%d,%d}, ", i, pages[i].pageNum);
 		}
 	}
 
 	printf("\n Fix Count Array: ");
-	for (i = 0; i < bm->numPages; i++) {
+	for (i = 0; i < ((BM_Data *) bm->mgmtData)->numFramesUsed; i++) {
 		printf("  {%d,%d}, ", i, ((BM_Data *) bm->mgmtData)->fixCount[i]);
 	}
 
 	printf("\n Dirty Flags Array: ");
-	for (i = 0; i < bm->numPages; i++) {
+	for (i = 0; i < ((BM_Data *) bm->mgmtData)->numFramesUsed; i++) {
 		printf("  {%d,%d}, ", i, ((BM_Data *) bm->mgmtData)->dirtyFlags[i]);
 	}
 
 	printf("\n Usage Count Array: ");
-	for (i = 0; i < bm->numPages; i++) {
+	for (i = 0; i < ((BM_Data *) bm->mgmtData)->numFramesUsed; i++) {
 		printf("  {%d,%d}, ", i, ((BM_Data *) bm->mgmtData)->pageUsedCount[i]);
 	}
 	printf("\n");
@@ -0,0 +1,224 @@
+/*
+ * buffer_mgr_page_table.c
+ *
+ *  Maps (page file, page number) keys to the page frames holding them. The
+ *  table is split into shards keyed by page number, each protected by its
+ *  own latch, so lookups for different pages don't contend with each other
+ *  or with the pool latch.
+ *  Links are published atomically, so hot lookups can also probe the table
+ *  without any latch and validate the frame they land on afterwards.
+ */
+
+#include "buffer_mgr.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define PRIVATE static
+
+//Longest chain a latch-free probe follows before giving up
+#define PROBE_LIMIT 32
+
+//Offsets keys of different page files, so their first pages spread across
+//shards. Odd, hence consecutive pages of a file keep landing in consecutive
+//shards.
+#define FILE_KEY_STRIDE 0x9E3779B1u
+
+PRIVATE inline unsigned int getPageKey(const int, const PageNumber);
+PRIVATE inline BM_PageTableShard *getShard(BM_Data * const,
+		const unsigned int);
+PRIVATE inline int getBucket(BM_Data * const, BM_PageTableShard * const,
+		const unsigned int);
+
+/**
+ * Allocates page table shards and buckets for a pool of numPages frames
+ *
+ * data = buffer pool management data
+ * numPages = no of frames in the pool
+ */
+RC initPageTable(BM_Data * const data, const int numPages) {
+
+	int i, j, perShard;
+
+	//Never create more shards than frames, a shard needs at least one entry
+	data->numShards = BM_PAGE_TABLE_SHARDS;
+	if (numPages < data->numShards) {
+		data->numShards = numPages > 0 ? numPages : 1;
+	}
+
+	data->shards = (BM_PageTableShard *) malloc(
+			data->numShards * sizeof(BM_PageTableShard));
+	//hashNext chains frames whose pages fall in the same bucket
+	data->hashNext = (int *) malloc((numPages > 0 ? numPages : 1) * sizeof(int));
+
+	if (data->shards == NULL || data->hashNext == NULL) {
+		free(data->shards);
+		free(data->hashNext);
+		THROW(RC_NOT_ENOUGH_MEMORY,
+				"Not enough memory available for resource allocation");
+	}
+
+	for (i = 0; i < numPages; i++) {
+		data->hashNext[i] = -1;
+	}
+
+	//Keep load factor at or below 0.5, bucket count is a power of 2
+	perShard = (numPages + data->numShards - 1) / data->numShards;
+	for (i = 0; i < data->numShards; i++) {
+		BM_PageTableShard *shard = &data->shards[i];
+		shard->numBuckets = 1;
+		while (shard->numBuckets < 2 * perShard) {
+			shard->numBuckets <<= 1;
+		}
+		shard->buckets = (int *) malloc(shard->numBuckets * sizeof(int));
+		for (j = 0; j < shard->numBuckets; j++) {
+			shard->buckets[j] = -1;
+		}
+		pthread_mutex_init(&shard->lock, NULL);
+	}
+
+	//All OK
+	return RC_OK;
+}
+
+/**
+ * Releases page table shards
+ *
+ * data = buffer pool management data
+ */
+void destroyPageTable(BM_Data * const data) {
+	int i;
+	for (i = 0; i < data->numShards; i++) {
+		pthread_mutex_destroy(&data->shards[i].lock);
+		free(data->shards[i].buckets);
+	}
+	free(data->shards);
+	data->shards = NULL;
+	free(data->hashNext);
+	data->hashNext = NULL;
+}
+
+/**
+ * Returns index of the frame holding page pageNum of page file file, -1 if
+ * page isn't in pool
+ *
+ * data = buffer pool management data
+ * file = slot of the page file in file table of the pool
+ * pageNum = page number to be looked up
+ */
+int lookupPageTable(BM_Data * const data, const int file,
+		const PageNumber pageNum) {
+
+	unsigned int key = getPageKey(file, pageNum);
+	BM_PageTableShard *shard = getShard(data, key);
+
+	//Acquire shard latch
+	pthread_mutex_lock(&shard->lock);
+	int frame = shard->buckets[getBucket(data, shard, key)];
+	while (frame != -1
+			&& (data->pageFrameIndexMap[frame] != pageNum
+					|| data->frameFile[frame] != file)) {
+		frame = data->hashNext[frame];
+	}
+	//Release shard latch
+	pthread_mutex_unlock(&shard->lock);
+
+	return frame;
+}
+
+/**
+ * Latch-free variant of lookupPageTable. Chains may change under the probe, so
+ * it can miss a resident page or land on a frame that no longer holds pageNum;
+ * callers must pin the frame and re-validate pageFrameIndexMap, falling back
+ * to lookupPageTable on a miss.
+ *
+ * data = buffer pool management data
+ * file = slot of the page file in file table of the pool
+ * pageNum = page number to be looked up
+ */
+int probePageTable(BM_Data * const data, const int file,
+		const PageNumber pageNum) {
+
+	unsigned int key = getPageKey(file, pageNum);
+	BM_PageTableShard *shard = getShard(data, key);
+	int steps = 0;
+
+	int frame = ATOMIC_LOAD(shard->buckets[getBucket(data, shard, key)]);
+	while (frame != -1 && steps++ < PROBE_LIMIT) {
+		if (ATOMIC_LOAD(data->pageFrameIndexMap[frame]) == pageNum
+				&& ATOMIC_LOAD(data->frameFile[frame]) == file) {
+			return frame;
+		}
+		frame = ATOMIC_LOAD(data->hashNext[frame]);
+	}
+
+	return -1;
+}
+
+/**
+ * Records that page pageNum of page file file is now held by frame.
+ * Caller must have set frameFile[frame] to file and pageFrameIndexMap[frame]
+ * to pageNum.
+ *
+ * data = buffer pool management data
+ * file = slot of the page file in file table of the pool
+ * pageNum = page number loaded in frame
+ * frame = index of the page frame
+ */
+void insertPageTable(BM_Data * const data, const int file,
+		const PageNumber pageNum, const int frame) {
+
+	unsigned int key = getPageKey(file, pageNum);
+	BM_PageTableShard *shard = getShard(data, key);
+	int bucket = getBucket(data, shard, key);
+
+	//Acquire shard latch
+	pthread_mutex_lock(&shard->lock);
+	ATOMIC_STORE(data->hashNext[frame], shard->buckets[bucket]);
+	ATOMIC_STORE(shard->buckets[bucket], frame);
+	//Release shard latch
+	pthread_mutex_unlock(&shard->lock);
+}
+
+/**
+ * Removes mapping of page pageNum of page file file to frame
+ *
+ * data = buffer pool management data
+ * file = slot of the page file in file table of the pool
+ * pageNum = page number held by frame
+ * frame = index of the page frame
+ */
+void removePageTable(BM_Data * const data, const int file,
+		const PageNumber pageNum, const int frame) {
+
+	unsigned int key = getPageKey(file, pageNum);
+	BM_PageTableShard *shard = getShard(data, key);
+	int *link = &shard->buckets[getBucket(data, shard, key)];
+
+	//Acquire shard latch
+	pthread_mutex_lock(&shard->lock);
+	while (*link != -1 && *link != frame) {
+		link = &data->hashNext[*link];
+	}
+	if (*link == frame) {
+		ATOMIC_STORE(*link, data->hashNext[frame]);
+		ATOMIC_STORE(data->hashNext[frame], -1);
+	}
+	//Release shard latch
+	pthread_mutex_unlock(&shard->lock);
+}
+
+PRIVATE inline unsigned int getPageKey(const int file,
+		const PageNumber pageNum) {
+	return (unsigned int) pageNum + (unsigned int) file * FILE_KEY_STRIDE;
+}
+
+PRIVATE inline BM_PageTableShard *getShard(BM_Data * const data,
+		const unsigned int key) {
+	return &data->shards[key % data->numShards];
+}
+
+PRIVATE inline int getBucket(BM_Data * const data,
+		BM_PageTableShard * const shard, const unsigned int key) {
+	return (key / data->numShards) & (shard->numBuckets - 1);
+}
@@ -0,0 +1,1318 @@
+/*
+ * buffer_mgr_policy.c
+ *
+ *  Built-in page replacement policies, one per ReplacementStrategy. Each
+ *  policy keeps its own state and does only its own bookkeeping: FIFO chains
+ *  frames in load order, CLOCK sweeps a hand over reference bits, LRU, LRU-K
+ *  and LFU keep resident frames in a min heap on their key. Pins only update
+ *  the key stamps of their frame with atomic operations, a heap takes changed
+ *  keys into account lazily when it's asked for a victim. Keys only grow
+ *  while a page is resident, so a heap top whose key is still current is the
+ *  least of all.
+ *
+ *  Sticky frames are passed over by all of them, they are chosen only if no
+ *  other frame is fit, in the order of the policy.
+ *
+ *  AUTO runs the FIFO, LRU, CLOCK and LFU policies side by side and lets one
+ *  of them pick victims. Ghost caches, which hold page numbers only, replay
+ *  a sample of the pins against each candidate; when another candidate
+ *  keeps scoring more ghost hits than the live one, it takes over.
+ */
+
+#include "buffer_mgr.h"
+
+#include <stdlib.h>
+#include <limits.h>
+
+#define PRIVATE static
+
+// Ghost cache of AUTO holds up to this many pages, larger pools are sampled
+#define AUTO_GHOST_SIZE 512
+
+// Sampled pins per AUTO window, past windows count half as much each
+#define AUTO_WINDOW 1024
+
+// Score a candidate must beat live one by, in %, and for how many windows
+// in a row, before AUTO switches to it
+#define AUTO_MARGIN 5
+#define AUTO_CONFIRM 2
+
+// Candidates of AUTO. LRU-K isn't one, it shares use stamps with LRU.
+#define AUTO_CANDIDATES 4
+
+// FIFO: resident frames chained in load order
+typedef struct FifoState {
+	int head;	// frame loaded first, -1 if none
+	int tail;
+	int *next;
+	int *prev;
+} FifoState;
+
+// CLOCK: reference bit of each frame and position of the hand
+typedef struct ClockState {
+	int hand;
+	int *referenced;
+} ClockState;
+
+// Key of a frame in a heap policy, compared by key first, then by tie
+typedef void (*HeapKeyFunc)(BM_Data * const, void * const, const int,
+		unsigned long * const, unsigned long * const);
+
+// LRU, LRU-K and LFU: resident frames in a min heap on the policy's key
+typedef struct HeapState {
+	HeapKeyFunc getKey;
+	int size;
+	int *heap;	// frames, the one with the least key on top
+	int *pos;	// place of each frame in heap, -1 if not in it
+	unsigned long *key;	// key each frame got its place with
+	unsigned long *tie;
+	int *aside;	// unfit heap tops taken off while choosing a victim
+	unsigned long *history;	// LRU-K only: second to last use of frames
+} HeapState;
+
+// Ghost cache of an AUTO candidate: page keys in slots, replaced as per
+// the candidate's strategy. LFU slots are kept in a heap on their use count.
+typedef struct GhostCache {
+	ReplacementStrategy strategy;
+	int capacity;
+	int size;	// slots holding a page
+	uint64_t *pages;	// page of each slot, file slot << 32 | page no
+	int numBuckets;
+	int *buckets;	// slots chained per hash bucket
+	int *hashNext;
+	int hand;	// FIFO and CLOCK: next slot to replace or look at
+	int *referenced;	// CLOCK only
+	int head;	// LRU only: list of slots, most recently used first
+	int tail;
+	int *next;
+	int *prev;
+	HeapState *heap;	// LFU only
+	unsigned long tick;
+} GhostCache;
+
+// AUTO: state of the candidates, the live one and their ghost caches
+typedef struct AutoState {
+	void *states[AUTO_CANDIDATES];
+	int live;	// candidate picking victims
+	pthread_mutex_t lock;	// guards ghosts and scores
+	int sampleRate;	// one in this many pages is replayed to ghosts
+	GhostCache ghosts[AUTO_CANDIDATES];
+	int window;	// sampled pins in current window
+	uint64_t hits[AUTO_CANDIDATES];	// ghost hits in current window
+	uint64_t score[AUTO_CANDIDATES];	// decayed ghost hits of past windows
+	int leader;	// candidate beating live one, -1 if none
+	int leaderWindows;	// windows in a row it did
+} AutoState;
+
+PRIVATE RC initFifo(BM_Data * const, void ** const);
+PRIVATE void destroyFifo(BM_Data * const, void * const);
+PRIVATE void loadFifo(BM_Data * const, void * const, const int);
+PRIVATE void evictFifo(BM_Data * const, void * const, const int);
+PRIVATE int chooseFifoVictim(BM_Data * const, void * const);
+PRIVATE RC initClock(BM_Data * const, void ** const);
+PRIVATE void destroyClock(BM_Data * const, void * const);
+PRIVATE void unpinClock(BM_Data * const, void * const, const int);
+PRIVATE void resetClock(BM_Data * const, void * const, const int);
+PRIVATE int chooseClockVictim(BM_Data * const, void * const);
+PRIVATE RC initLru(BM_Data * const, void ** const);
+PRIVATE void accessLru(BM_Data * const, void * const, const int);
+PRIVATE void loadLru(BM_Data * const, void * const, const int);
+PRIVATE void getLruKey(BM_Data * const, void * const, const int,
+		unsigned long * const, unsigned long * const);
+PRIVATE RC initLruK(BM_Data * const, void ** const);
+PRIVATE void accessLruK(BM_Data * const, void * const, const int);
+PRIVATE void loadLruK(BM_Data * const, void * const, const int);
+PRIVATE void getLruKKey(BM_Data * const, void * const, const int,
+		unsigned long * const, unsigned long * const);
+PRIVATE RC initLfu(BM_Data * const, void ** const);
+PRIVATE void accessLfu(BM_Data * const, void * const, const int);
+PRIVATE void getLfuKey(BM_Data * const, void * const, const int,
+		unsigned long * const, unsigned long * const);
+PRIVATE RC initHeap(const int, const HeapKeyFunc, const bool, void ** const);
+PRIVATE void destroyHeap(BM_Data * const, void * const);
+PRIVATE void loadHeap(BM_Data * const, void * const, const int);
+PRIVATE void evictHeap(BM_Data * const, void * const, const int);
+PRIVATE int chooseHeapVictim(BM_Data * const, void * const);
+PRIVATE inline void getHeapKey(BM_Data * const, HeapState * const, const int,
+		unsigned long * const, unsigned long * const);
+PRIVATE inline bool heapLess(HeapState * const, const int, const int);
+PRIVATE inline void swapHeap(HeapState * const, const int, const int);
+PRIVATE void siftUp(HeapState * const, int);
+PRIVATE void siftDown(HeapState * const, int);
+PRIVATE void pushHeap(HeapState * const, const int);
+PRIVATE void removeHeapAt(HeapState * const, const int);
+PRIVATE RC initAuto(BM_Data * const, void ** const);
+PRIVATE void destroyAuto(BM_Data * const, void * const);
+PRIVATE void accessAuto(BM_Data * const, void * const, const int);
+PRIVATE void loadAuto(BM_Data * const, void * const, const int);
+PRIVATE void unpinAuto(BM_Data * const, void * const, const int);
+PRIVATE void evictAuto(BM_Data * const, void * const, const int);
+PRIVATE int chooseAutoVictim(BM_Data * const, void * const);
+PRIVATE void noteAutoSample(BM_Data * const, AutoState * const,
+		const uint64_t);
+PRIVATE RC initGhost(GhostCache * const, const ReplacementStrategy,
+		const int);
+PRIVATE void destroyGhost(GhostCache * const);
+PRIVATE bool accessGhost(GhostCache * const, const uint64_t);
+PRIVATE int chooseGhostVictim(GhostCache * const);
+PRIVATE inline int getGhostBucket(GhostCache * const, const uint64_t);
+PRIVATE void unhashGhostSlot(GhostCache * const, const int);
+
+PRIVATE const BM_Policy fifoPolicy = { "FIFO", initFifo, destroyFifo, NULL,
+		loadFifo, NULL, evictFifo, chooseFifoVictim };
+PRIVATE const BM_Policy lruPolicy = { "LRU", initLru, destroyHeap, accessLru,
+		loadLru, NULL, evictHeap, chooseHeapVictim };
+PRIVATE const BM_Policy clockPolicy = { "CLOCK", initClock, destroyClock, NULL,
+		resetClock, unpinClock, resetClock, chooseClockVictim };
+PRIVATE const BM_Policy lfuPolicy = { "LFU", initLfu, destroyHeap, accessLfu,
+		loadHeap, NULL, evictHeap, chooseHeapVictim };
+PRIVATE const BM_Policy lruKPolicy = { "LRU-K", initLruK, destroyHeap,
+		accessLruK, loadLruK, NULL, evictHeap, chooseHeapVictim };
+PRIVATE const BM_Policy autoPolicy = { "AUTO", initAuto, destroyAuto,
+		accessAuto, loadAuto, unpinAuto, evictAuto, chooseAutoVictim };
+
+PRIVATE const ReplacementStrategy autoCandidates[AUTO_CANDIDATES] = { RS_FIFO,
+		RS_LRU, RS_CLOCK, RS_LFU };
+
+/**
+ * Returns the built-in policy of strategy, NULL for an unknown strategy.
+ *
+ * strategy = page replacement strategy
+ */
+const BM_Policy *getStrategyPolicy(const ReplacementStrategy strategy) {
+	switch (strategy) {
+	case RS_FIFO:
+		return &fifoPolicy;
+	case RS_LRU:
+		return &lruPolicy;
+	case RS_CLOCK:
+		return &clockPolicy;
+	case RS_LFU:
+		return &lfuPolicy;
+	case RS_LRU_K:
+		return &lruKPolicy;
+	case RS_AUTO:
+		return &autoPolicy;
+	default:
+		return NULL;
+	}
+}
+
+/**
+ * Sets up replacement policy of a pool. Nobody else may see the pool yet.
+ *
+ * data = buffer pool management data
+ * policy = replacement policy of the pool
+ */
+RC initPolicy(BM_Data * const data, const BM_Policy * const policy) {
+
+	data->policy = NULL;
+	data->policyState = NULL;
+	data->numFramesLoaded = 0;
+
+	if (policy == NULL || policy->chooseVictim == NULL) {
+		THROW(RC_INVALID_OP, "Invalid page replacement strategy");
+	}
+	if (policy->init != NULL) {
+		RC ret = policy->init(data, &data->policyState);
+		if (ret != RC_OK) {
+			return ret;
+		}
+	}
+	data->policy = policy;
+
+	//All OK
+	return RC_OK;
+}
+
+/**
+ * Releases state of the replacement policy of a pool, if it has been set up.
+ *
+ * data = buffer pool management data
+ */
+void destroyPolicy(BM_Data * const data) {
+	if (data->policy != NULL && data->policy->destroy != NULL) {
+		data->policy->destroy(data, data->policyState);
+	}
+	data->policy = NULL;
+	data->policyState = NULL;
+}
+
+/**
+ * Private utility function to set up FIFO state.
+ *
+ * data = buffer pool management data
+ * statePtr = set to the new state
+ */
+PRIVATE RC initFifo(BM_Data * const data, void ** const statePtr) {
+
+	int i;
+
+	FifoState *state = (FifoState *) malloc(sizeof(FifoState));
+	if (state == NULL) {
+		THROW(RC_NOT_ENOUGH_MEMORY,
+				"Not enough memory available for resource allocation");
+	}
+	state->next = (int *) malloc(data->maxFrames * sizeof(int));
+	state->prev = (int *) malloc(data->maxFrames * sizeof(int));
+	if (state->next == NULL || state->prev == NULL) {
+		free(state->next);
+		free(state->prev);
+		free(state);
+		THROW(RC_NOT_ENOUGH_MEMORY,
+				"Not enough memory available for resource allocation");
+	}
+	for (i = 0; i < data->maxFrames; i++) {
+		state->next[i] = -1;
+		state->prev[i] = -1;
+	}
+	state->head = -1;
+	state->tail = -1;
+	*statePtr = state;
+
+	//All OK
+	return RC_OK;
+}
+
+/**
+ * Private utility function to release FIFO state.
+ *
+ * data = buffer pool management data
+ * policyState = FIFO state
+ */
+PRIVATE void destroyFifo(BM_Data * const data, void * const policyState) {
+	FifoState *state = (FifoState *) policyState;
+	free(state->next);
+	free(state->prev);
+	free(state);
+}
+
+/**
+ * Private utility function to chain a freshly loaded frame at the tail.
+ *
+ * data = buffer pool management data
+ * policyState = FIFO state
+ * frame = index of the page frame
+ */
+PRIVATE void loadFifo(BM_Data * const data, void * const policyState,
+		const int frame) {
+	FifoState *state = (FifoState *) policyState;
+	state->next[frame] = -1;
+	state->prev[frame] = state->tail;
+	if (state->tail != -1) {
+		state->next[state->tail] = frame;
+	} else {
+		state->head = frame;
+	}
+	state->tail = frame;
+}
+
+/**
+ * Private utility function to unchain a frame losing its page.
+ *
+ * data = buffer pool management data
+ * policyState = FIFO state
+ * frame = index of the page frame
+ */
+PRIVATE void evictFifo(BM_Data * const data, void * const policyState,
+		const int frame) {
+	FifoState *state = (FifoState *) policyState;
+	if (state->prev[frame] != -1) {
+		state->next[state->prev[frame]] = state->next[frame];
+	} else {
+		state->head = state->next[frame];
+	}
+	if (state->next[frame] != -1) {
+		state->prev[state->next[frame]] = state->prev[frame];
+	} else {
+		state->tail = state->prev[frame];
+	}
+	state->next[frame] = -1;
+	state->prev[frame] = -1;
+}
+
+/**
+ * Private utility function to choose the earliest loaded frame nobody has
+ * pinned. Only pinned and sticky frames are passed over, the earliest
+ * sticky one is chosen if nothing else is left.
+ *
+ * data = buffer pool management data
+ * policyState = FIFO state
+ */
+PRIVATE int chooseFifoVictim(BM_Data * const data, void * const policyState) {
+
+	FifoState *state = (FifoState *) policyState;
+	int frame, sticky = -1;
+
+	for (frame = state->head; frame != -1; frame = state->next[frame]) {
+		if (frame < data->numFrames
+				&& ATOMIC_LOAD(data->fixCount[frame]) == 0) {
+			if (ATOMIC_LOAD(data->retention[frame]) != BM_RETAIN_STICKY) {
+				return frame;
+			}
+			if (sticky == -1) {
+				sticky = frame;
+			}
+		}
+	}
+	return sticky;
+}
+
+/**
+ * Private utility function to set up CLOCK state.
+ *
+ * data = buffer pool management data
+ * statePtr = set to the new state
+ */
+PRIVATE RC initClock(BM_Data * const data, void ** const statePtr) {
+
+	int i;
+
+	ClockState *state = (ClockState *) malloc(sizeof(ClockState));
+	if (state == NULL) {
+		THROW(RC_NOT_ENOUGH_MEMORY,
+				"Not enough memory available for resource allocation");
+	}
+	state->referenced = (int *) malloc(data->maxFrames * sizeof(int));
+	if (state->referenced == NULL) {
+		free(state);
+		THROW(RC_NOT_ENOUGH_MEMORY,
+				"Not enough memory available for resource allocation");
+	}
+	for (i = 0; i < data->maxFrames; i++) {
+		state->referenced[i] = FALSE;
+	}
+	state->hand = 0;
+	*statePtr = state;
+
+	//All OK
+	return RC_OK;
+}
+
+/**
+ * Private utility function to release CLOCK state.
+ *
+ * data = buffer pool management data
+ * policyState = CLOCK state
+ */
+PRIVATE void destroyClock(BM_Data * const data, void * const policyState) {
+	ClockState *state = (ClockState *) policyState;
+	free(state->referenced);
+	free(state);
+}
+
+/**
+ * Private utility function to give an unpinned frame its second chance.
+ * A frame loaded but never pinned, e.g. by the prefetcher, has none.
+ *
+ * data = buffer pool management data
+ * policyState = CLOCK state
+ * frame = index of the page frame
+ */
+PRIVATE void unpinClock(BM_Data * const data, void * const policyState,
+		const int frame) {
+	ATOMIC_STORE(((ClockState *) policyState)->referenced[frame], TRUE);
+}
+
+/**
+ * Private utility function to clear reference bit of a frame getting or
+ * losing its page.
+ *
+ * data = buffer pool management data
+ * policyState = CLOCK state
+ * frame = index of the page frame
+ */
+PRIVATE void resetClock(BM_Data * const data, void * const policyState,
+		const int frame) {
+	ATOMIC_STORE(((ClockState *) policyState)->referenced[frame], FALSE);
+}
+
+/**
+ * Private utility function to sweep the hand to the next resident, unpinned
+ * frame whose reference bit is clear, clearing the bits it passes. Two
+ * rounds clear every bit, so a third would find nothing new. Sticky frames
+ * are passed over, the first one passed is chosen if nothing else is left.
+ *
+ * data = buffer pool management data
+ * policyState = CLOCK state
+ */
+PRIVATE int chooseClockVictim(BM_Data * const data, void * const policyState) {
+
+	ClockState *state = (ClockState *) policyState;
+	int i, sticky = -1;
+
+	//Pool may have been shrunk below the hand
+	if (state->hand >= data->numFrames) {
+		state->hand = 0;
+	}
+
+	for (i = 0; i < 2 * data->numFrames; i++) {
+		int frame = state->hand;
+		state->hand = (frame + 1) % data->numFrames;
+		if (data->pageFrameIndexMap[frame] == NO_PAGE
+				|| ATOMIC_LOAD(data->fixCount[frame]) != 0) {
+			continue;
+		}
+		if (ATOMIC_LOAD(data->retention[frame]) == BM_RETAIN_STICKY) {
+			if (sticky == -1) {
+				sticky = frame;
+			}
+			continue;
+		}
+		if (ATOMIC_XCHG(state->referenced[frame], FALSE) == TRUE) {
+			continue;
+		}
+		return frame;
+	}
+	return sticky;
+}
+
+/**
+ * Private utility function to set up LRU state. The key of a frame is the
+ * pool clock tick of its last pin.
+ *
+ * data = buffer pool management data
+ * statePtr = set to the new state
+ */
+PRIVATE RC initLru(BM_Data * const data, void ** const statePtr) {
+	return initHeap(data->maxFrames, getLruKey, FALSE, statePtr);
+}
+
+/**
+ * Private utility function to stamp a pinned frame with its use time. Pins
+ * of a frame race to stamp it, the latest stamp wins, as keys of the heap
+ * must never go down.
+ *
+ * data = buffer pool management data
+ * policyState = LRU state
+ * frame = index of the page frame
+ */
+PRIVATE void accessLru(BM_Data * const data, void * const policyState,
+		const int frame) {
+	const unsigned long now = ATOMIC_INC(data->clock);
+	unsigned long used;
+
+	do {
+		used = ATOMIC_LOAD(data->pageUsedTime[frame]);
+	} while (used < now && !ATOMIC_CAS(data->pageUsedTime[frame], used, now));
+}
+
+/**
+ * Private utility function to add a freshly loaded frame to the heap. A page
+ * counts as used when it's loaded, so a prefetched page isn't the next
+ * victim right away.
+ *
+ * data = buffer pool management data
+ * policyState = LRU state
+ * frame = index of the page frame
+ */
+PRIVATE void loadLru(BM_Data * const data, void * const policyState,
+		const int frame) {
+	ATOMIC_STORE(data->pageUsedTime[frame], data->pageInTime[frame]);
+	loadHeap(data, policyState, frame);
+}
+
+/**
+ * Private utility function to get the LRU key of frame.
+ *
+ * data = buffer pool management data
+ * policyState = LRU state
+ * frame = index of the page frame
+ * key = set to the last use of the frame
+ * tie = set to 0, use time stamps are unique
+ */
+PRIVATE void getLruKey(BM_Data * const data, void * const policyState,
+		const int frame, unsigned long * const key, unsigned long * const tie) {
+	*key = ATOMIC_LOAD(data->pageUsedTime[frame]);
+	*tie = 0;
+}
+
+/**
+ * Private utility function to set up LRU-K state, with K = 2. The key of a
+ * frame is its second to last pin, pages pinned once go first in LRU order.
+ * History is only kept while a page is resident.
+ *
+ * data = buffer pool management data
+ * statePtr = set to the new state
+ */
+PRIVATE RC initLruK(BM_Data * const data, void ** const statePtr) {
+	return initHeap(data->maxFrames, getLruKKey, TRUE, statePtr);
+}
+
+/**
+ * Private utility function to shift use history of a pinned frame.
+ *
+ * data = buffer pool management data
+ * policyState = LRU-K state
+ * frame = index of the page frame
+ */
+PRIVATE void accessLruK(BM_Data * const data, void * const policyState,
+		const int frame) {
+	ATOMIC_STORE(((HeapState *) policyState)->history[frame],
+			ATOMIC_XCHG(data->pageUsedTime[frame], ATOMIC_INC(data->clock)));
+}
+
+/**
+ * Private utility function to add a freshly loaded frame to the heap with
+ * no use history. Loading isn't a use, the pin loading it, if any, is.
+ *
+ * data = buffer pool management data
+ * policyState = LRU-K state
+ * frame = index of the page frame
+ */
+PRIVATE void loadLruK(BM_Data * const data, void * const policyState,
+		const int frame) {
+	ATOMIC_STORE(((HeapState *) policyState)->history[frame], 0);
+	ATOMIC_STORE(data->pageUsedTime[frame], 0);
+	loadHeap(data, policyState, frame);
+}
+
+/**
+ * Private utility function to get the LRU-K key of frame.
+ *
+ * data = buffer pool management data
+ * policyState = LRU-K state
+ * frame = index of the page frame
+ * key = set to the second to last use of the frame, 0 if none
+ * tie = set to the last use of the frame
+ */
+PRIVATE void getLruKKey(BM_Data * const data, void * const policyState,
+		const int frame, unsigned long * const key, unsigned long * const tie) {
+	*key = ATOMIC_LOAD(((HeapState *) policyState)->history[frame]);
+	*tie = ATOMIC_LOAD(data->pageUsedTime[frame]);
+}
+
+/**
+ * Private utility function to set up LFU state. The key of a frame is its
+ * no of pins, ties go to the page loaded first.
+ *
+ * data = buffer pool management data
+ * statePtr = set to the new state
+ */
+PRIVATE RC initLfu(BM_Data * const data, void ** const statePtr) {
+	return initHeap(data->maxFrames, getLfuKey, FALSE, statePtr);
+}
+
+/**
+ * Private utility function to count a pin of frame.
+ *
+ * data = buffer pool management data
+ * policyState = LFU state
+ * frame = index of the page frame
+ */
+PRIVATE void accessLfu(BM_Data * const data, void * const policyState,
+		const int frame) {
+	ATOMIC_INC(data->pageUsedCount[frame]);
+}
+
+/**
+ * Private utility function to get the LFU key of frame.
+ *
+ * data = buffer pool management data
+ * policyState = LFU state
+ * frame = index of the page frame
+ * key = set to the no of pins of the frame
+ * tie = set to the load time of the frame
+ */
+PRIVATE void getLfuKey(BM_Data * const data, void * const policyState,
+		const int frame, unsigned long * const key, unsigned long * const tie) {
+	*key = ATOMIC_LOAD(data->pageUsedCount[frame]);
+	*tie = data->pageInTime[frame];
+}
+
+/**
+ * Private utility function to set up state of a heap of up to n entries.
+ *
+ * n = no of entries the heap can hold
+ * getKey = key of a frame in the policy, NULL if keys are set directly
+ * history = TRUE if the policy keeps use history of frames
+ * statePtr = set to the new state
+ */
+PRIVATE RC initHeap(const int n, const HeapKeyFunc getKey, const bool history,
+		void ** const statePtr) {
+
+	int i;
+
+	HeapState *state = (HeapState *) malloc(sizeof(HeapState));
+	if (state == NULL) {
+		THROW(RC_NOT_ENOUGH_MEMORY,
+				"Not enough memory available for resource allocation");
+	}
+	state->getKey = getKey;
+	state->size = 0;
+	state->heap = (int *) malloc(n * sizeof(int));
+	state->pos = (int *) malloc(n * sizeof(int));
+	state->key = (unsigned long *) malloc(n * sizeof(unsigned long));
+	state->tie = (unsigned long *) malloc(n * sizeof(unsigned long));
+	state->aside = (int *) malloc(n * sizeof(int));
+	state->history = NULL;
+	if (history) {
+		state->history = (unsigned long *) calloc(n, sizeof(unsigned long));
+	}
+	if (state->heap == NULL || state->pos == NULL || state->key == NULL
+			|| state->tie == NULL || state->aside == NULL
+			|| (history && state->history == NULL)) {
+		destroyHeap(NULL, state);
+		THROW(RC_NOT_ENOUGH_MEMORY,
+				"Not enough memory available for resource allocation");
+	}
+	for (i = 0; i < n; i++) {
+		state->pos[i] = -1;
+	}
+	*statePtr = state;
+
+	//All OK
+	return RC_OK;
+}
+
+/**
+ * Private utility function to release state of a heap.
+ *
+ * data = buffer pool management data
+ * policyState = heap state
+ */
+PRIVATE void destroyHeap(BM_Data * const data, void * const policyState) {
+	HeapState *state = (HeapState *) policyState;
+	free(state->heap);
+	free(state->pos);
+	free(state->key);
+	free(state->tie);
+	free(state->aside);
+	free(state->history);
+	free(state);
+}
+
+/**
+ * Private utility function to add a frame to the heap with its current key.
+ *
+ * data = buffer pool management data
+ * policyState = heap state
+ * frame = index of the page frame
+ */
+PRIVATE void loadHeap(BM_Data * const data, void * const policyState,
+		const int frame) {
+	HeapState *state = (HeapState *) policyState;
+	getHeapKey(data, state, frame, &state->key[frame], &state->tie[frame]);
+	pushHeap(state, frame);
+}
+
+/**
+ * Private utility function to take a frame losing its page off the heap.
+ *
+ * data = buffer pool management data
+ * policyState = heap state
+ * frame = index of the page frame
+ */
+PRIVATE void evictHeap(BM_Data * const data, void * const policyState,
+		const int frame) {
+	HeapState *state = (HeapState *) policyState;
+	if (state->pos[frame] != -1) {
+		removeHeapAt(state, state->pos[frame]);
+	}
+}
+
+/**
+ * Private utility function to choose the frame with the least current key
+ * nobody has pinned. A heap top whose key grew since it got its place is
+ * moved down first. Pinned and retired tops are taken off while looking
+ * further and put back afterwards.
+ *
+ * data = buffer pool management data
+ * policyState = heap state
+ */
+PRIVATE int chooseHeapVictim(BM_Data * const data, void * const policyState) {
+
+	HeapState *state = (HeapState *) policyState;
+	int i, victim = -1, numAside = 0;
+	unsigned long key, tie;
+
+	while (state->size > 0) {
+		int frame = state->heap[0];
+		getHeapKey(data, state, frame, &key, &tie);
+		if (key != state->key[frame] || tie != state->tie[frame]) {
+			state->key[frame] = key;
+			state->tie[frame] = tie;
+			siftDown(state, 0);
+			continue;
+		}
+		if (frame < data->numFrames
+				&& ATOMIC_LOAD(data->fixCount[frame]) == 0) {
+			victim = frame;
+			break;
+		}
+		removeHeapAt(state, 0);
+		state->aside[numAside++] = frame;
+	}
+
+	for (i = 0; i < numAside; i++) {
+		loadHeap(data, state, state->aside[i]);
+	}
+
+	return victim;
+}
+
+/**
+ * Private utility function to get the key of frame in a heap policy. Sticky
+ * frames get the largest key, so they come last in the policy's order. A
+ * frame never stops being sticky while resident, so keys still only grow.
+ *
+ * data = buffer pool management data
+ * state = heap state
+ * frame = index of the page frame
+ * key = set to the key of the frame
+ * tie = set to the tie breaker of the frame
+ */
+PRIVATE inline void getHeapKey(BM_Data * const data, HeapState * const state,
+		const int frame, unsigned long * const key, unsigned long * const tie) {
+	state->getKey(data, state, frame, key, tie);
+	if (ATOMIC_LOAD(data->retention[frame]) == BM_RETAIN_STICKY) {
+		*key = ULONG_MAX;
+	}
+}
+
+/**
+ * Private utility function to compare keys of heap places a and b. Returns
+ * TRUE if a's key is less.
+ *
+ * state = heap state
+ * a = place in heap
+ * b = place in heap
+ */
+PRIVATE inline bool heapLess(HeapState * const state, const int a,
+		const int b) {
+	int x = state->heap[a], y = state->heap[b];
+	if (state->key[x] != state->key[y]) {
+		return state->key[x] < state->key[y];
+	}
+	return state->tie[x] < state->tie[y];
+}
+
+/**
+ * Private utility function to swap entries at heap places a and b.
+ *
+ * state = heap state
+ * a = place in heap
+ * b = place in heap
+ */
+PRIVATE inline void swapHeap(HeapState * const state, const int a,
+		const int b) {
+	int entry = state->heap[a];
+	state->heap[a] = state->heap[b];
+	state->heap[b] = entry;
+	state->pos[state->heap[a]] = a;
+	state->pos[state->heap[b]] = b;
+}
+
+/**
+ * Private utility function to move the entry at heap place i up to its place.
+ *
+ * state = heap state
+ * i = place in heap
+ */
+PRIVATE void siftUp(HeapState * const state, int i) {
+	while (i > 0 && heapLess(state, i, (i - 1) / 2)) {
+		swapHeap(state, i, (i - 1) / 2);
+		i = (i - 1) / 2;
+	}
+}
+
+/**
+ * Private utility function to move the entry at heap place i down to its
+ * place.
+ *
+ * state = heap state
+ * i = place in heap
+ */
+PRIVATE void siftDown(HeapState * const state, int i) {
+	for (;;) {
+		int least = i, child = 2 * i + 1;
+		if (child < state->size && heapLess(state, child, least)) {
+			least = child;
+		}
+		if (child + 1 < state->size && heapLess(state, child + 1, least)) {
+			least = child + 1;
+		}
+		if (least == i) {
+			break;
+		}
+		swapHeap(state, i, least);
+		i = least;
+	}
+}
+
+/**
+ * Private utility function to add an entry whose key is set to the heap.
+ *
+ * state = heap state
+ * entry = frame or slot to be added
+ */
+PRIVATE void pushHeap(HeapState * const state, const int entry) {
+	state->heap[state->size] = entry;
+	state->pos[entry] = state->size;
+	siftUp(state, state->size++);
+}
+
+/**
+ * Private utility function to take the entry at heap place i off the heap.
+ *
+ * state = heap state
+ * i = place in heap
+ */
+PRIVATE void removeHeapAt(HeapState * const state, const int i) {
+	state->pos[state->heap[i]] = -1;
+	if (i == --state->size) {
+		return;
+	}
+	state->heap[i] = state->heap[state->size];
+	state->pos[state->heap[i]] = i;
+	siftUp(state, i);
+	siftDown(state, i);
+}
+
+/**
+ * Private utility function to set up AUTO state: every candidate policy and
+ * a ghost cache per candidate. Ghosts are sized like the pool, pools larger
+ * than AUTO_GHOST_SIZE frames replay only one in sampleRate pages to ghosts
+ * that much smaller. LRU picks victims until a candidate proves better.
+ *
+ * data = buffer pool management data
+ * statePtr = set to the new state
+ */
+PRIVATE RC initAuto(BM_Data * const data, void ** const statePtr) {
+
+	int i;
+	RC ret = RC_OK;
+
+	AutoState *state = (AutoState *) calloc(1, sizeof(AutoState));
+	if (state == NULL) {
+		THROW(RC_NOT_ENOUGH_MEMORY,
+				"Not enough memory available for resource allocation");
+	}
+	pthread_mutex_init(&state->lock, NULL);
+	state->leader = -1;
+	state->sampleRate = (data->numFrames + AUTO_GHOST_SIZE - 1)
+			/ AUTO_GHOST_SIZE;
+	if (state->sampleRate < 1) {
+		state->sampleRate = 1;
+	}
+
+	for (i = 0; i < AUTO_CANDIDATES && ret == RC_OK; i++) {
+		ret = getStrategyPolicy(autoCandidates[i])->init(data,
+				&state->states[i]);
+		if (ret == RC_OK) {
+			ret = initGhost(&state->ghosts[i], autoCandidates[i],
+					data->numFrames / state->sampleRate);
+		}
+		if (autoCandidates[i] == RS_LRU) {
+			state->live = i;
+		}
+	}
+	if (ret != RC_OK) {
+		destroyAuto(data, state);
+		return ret;
+	}
+
+	*statePtr = state;
+
+	//All OK
+	return RC_OK;
+}
+
+/**
+ * Private utility function to release AUTO state.
+ *
+ * data = buffer pool management data
+ * policyState = AUTO state
+ */
+PRIVATE void destroyAuto(BM_Data * const data, void * const policyState) {
+
+	AutoState *state = (AutoState *) policyState;
+	int i;
+
+	for (i = 0; i < AUTO_CANDIDATES; i++) {
+		if (state->states[i] != NULL) {
+			getStrategyPolicy(autoCandidates[i])->destroy(data,
+					state->states[i]);
+		}
+		destroyGhost(&state->ghosts[i]);
+	}
+	pthread_mutex_destroy(&state->lock);
+	free(state);
+}
+
+/**
+ * Private utility function to pass a pin to every candidate, and to the
+ * ghosts if the page is sampled. Ghosts are skipped while another pin holds
+ * their latch, a sample may miss a pin but pins never wait for it.
+ *
+ * data = buffer pool management data
+ * policyState = AUTO state
+ * frame = index of the page frame
+ */
+PRIVATE void accessAuto(BM_Data * const data, void * const policyState,
+		const int frame) {
+
+	AutoState *state = (AutoState *) policyState;
+	int i;
+
+	for (i = 0; i < AUTO_CANDIDATES; i++) {
+		if (getStrategyPolicy(autoCandidates[i])->onAccess != NULL) {
+			getStrategyPolicy(autoCandidates[i])->onAccess(data,
+					state->states[i], frame);
+		}
+	}
+
+	//Frame is pinned, its page can't change under us
+	uint64_t page = ((uint64_t) ATOMIC_LOAD(data->frameFile[frame]) << 32)
+			| (uint32_t) ATOMIC_LOAD(data->pageFrameIndexMap[frame]);
+	if (((page * 0x9e3779b97f4a7c15ULL) >> 40) % state->sampleRate != 0
+			|| pthread_mutex_trylock(&state->lock) != 0) {
+		return;
+	}
+	noteAutoSample(data, state, page);
+	pthread_mutex_unlock(&state->lock);
+}
+
+/**
+ * Private utility function to pass a loaded frame to every candidate.
+ *
+ * data = buffer pool management data
+ * policyState = AUTO state
+ * frame = index of the page frame
+ */
+PRIVATE void loadAuto(BM_Data * const data, void * const policyState,
+		const int frame) {
+
+	AutoState *state = (AutoState *) policyState;
+	int i;
+
+	for (i = 0; i < AUTO_CANDIDATES; i++) {
+		if (getStrategyPolicy(autoCandidates[i])->onLoad != NULL) {
+			getStrategyPolicy(autoCandidates[i])->onLoad(data,
+					state->states[i], frame);
+		}
+	}
+}
+
+/**
+ * Private utility function to pass an unpin to every candidate.
+ *
+ * data = buffer pool management data
+ * policyState = AUTO state
+ * frame = index of the page frame
+ */
+PRIVATE void unpinAuto(BM_Data * const data, void * const policyState,
+		const int frame) {
+
+	AutoState *state = (AutoState *) policyState;
+	int i;
+
+	for (i = 0; i < AUTO_CANDIDATES; i++) {
+		if (getStrategyPolicy(autoCandidates[i])->onUnpin != NULL) {
+			getStrategyPolicy(autoCandidates[i])->onUnpin(data,
+					state->states[i], frame);
+		}
+	}
+}
+
+/**
+ * Private utility function to pass an evicted frame to every candidate.
+ *
+ * data = buffer pool management data
+ * policyState = AUTO state
+ * frame = index of the page frame
+ */
+PRIVATE void evictAuto(BM_Data * const data, void * const policyState,
+		const int frame) {
+
+	AutoState *state = (AutoState *) policyState;
+	int i;
+
+	for (i = 0; i < AUTO_CANDIDATES; i++) {
+		if (getStrategyPolicy(autoCandidates[i])->onEvict != NULL) {
+			getStrategyPolicy(autoCandidates[i])->onEvict(data,
+					state->states[i], frame);
+		}
+	}
+}
+
+/**
+ * Private utility function to let the live candidate choose a victim.
+ *
+ * data = buffer pool management data
+ * policyState = AUTO state
+ */
+PRIVATE int chooseAutoVictim(BM_Data * const data, void * const policyState) {
+	AutoState *state = (AutoState *) policyState;
+	int live = ATOMIC_LOAD(state->live);
+	return getStrategyPolicy(autoCandidates[live])->chooseVictim(data,
+			state->states[live]);
+}
+
+/**
+ * Private utility function to replay a sampled pin to the ghosts. At the end
+ * of a window, scores are decayed and the window's ghost hits added. A
+ * candidate scoring AUTO_MARGIN % more than the live one for AUTO_CONFIRM
+ * windows in a row becomes live. All candidates are up to date, so a switch
+ * takes effect with the next victim. Caller must hold the AUTO latch.
+ *
+ * data = buffer pool management data
+ * state = AUTO state
+ * page = page pinned, file slot << 32 | page no
+ */
+PRIVATE void noteAutoSample(BM_Data * const data, AutoState * const state,
+		const uint64_t page) {
+
+	int i, best;
+
+	for (i = 0; i < AUTO_CANDIDATES; i++) {
+		if (accessGhost(&state->ghosts[i], page)) {
+			state->hits[i]++;
+		}
+	}
+	if (++state->window < AUTO_WINDOW) {
+		return;
+	}
+
+	best = state->live;
+	for (i = 0; i < AUTO_CANDIDATES; i++) {
+		state->score[i] = state->score[i] / 2 + state->hits[i];
+		state->hits[i] = 0;
+		if (state->score[i] > state->score[best]) {
+			best = i;
+		}
+	}
+	state->window = 0;
+
+	if (best == state->live
+			|| state->score[best] * 100
+					<= state->score[state->live] * (100 + AUTO_MARGIN)) {
+		state->leader = -1;
+		state->leaderWindows = 0;
+		return;
+	}
+	if (best != state->leader) {
+		state->leader = best;
+		state->leaderWindows = 0;
+	}
+	if (++state->leaderWindows >= AUTO_CONFIRM) {
+		ATOMIC_STORE(state->live, best);
+		STAT_ADD(data->stats.autoSwitches[autoCandidates[best]], 1);
+		state->leader = -1;
+		state->leaderWindows = 0;
+	}
+}
+
+/**
+ * Private utility function to set up an empty ghost cache.
+ *
+ * ghost = ghost cache to be set up
+ * strategy = replacement strategy of the ghost
+ * capacity = no of pages the ghost holds
+ */
+PRIVATE RC initGhost(GhostCache * const ghost,
+		const ReplacementStrategy strategy, const int capacity) {
+
+	int i;
+	void *heap = NULL;
+
+	ghost->strategy = strategy;
+	ghost->capacity = capacity > 0 ? capacity : 1;
+	ghost->size = 0;
+	ghost->hand = 0;
+	ghost->head = -1;
+	ghost->tail = -1;
+	ghost->tick = 0;
+	for (ghost->numBuckets = 1; ghost->numBuckets < ghost->capacity;
+			ghost->numBuckets <<= 1)
+		;
+	ghost->pages = (uint64_t *) malloc(ghost->capacity * sizeof(uint64_t));
+	ghost->buckets = (int *) malloc(ghost->numBuckets * sizeof(int));
+	ghost->hashNext = (int *) malloc(ghost->capacity * sizeof(int));
+	ghost->referenced = (int *) calloc(ghost->capacity, sizeof(int));
+	ghost->next = (int *) malloc(ghost->capacity * sizeof(int));
+	ghost->prev = (int *) malloc(ghost->capacity * sizeof(int));
+	ghost->heap = NULL;
+	if (strategy == RS_LFU
+			&& initHeap(ghost->capacity, NULL, FALSE, &heap) == RC_OK) {
+		ghost->heap = (HeapState *) heap;
+	}
+
+	if (ghost->pages == NULL || ghost->buckets == NULL
+			|| ghost->hashNext == NULL || ghost->referenced == NULL
+			|| ghost->next == NULL || ghost->prev == NULL
+			|| (strategy == RS_LFU && ghost->heap == NULL)) {
+		destroyGhost(ghost);
+		THROW(RC_NOT_ENOUGH_MEMORY,
+				"Not enough memory available for resource allocation");
+	}
+	for (i = 0; i < ghost->numBuckets; i++) {
+		ghost->buckets[i] = -1;
+	}
+
+	//All OK
+	return RC_OK;
+}
+
+/**
+ * Private utility function to release a ghost cache.
+ *
+ * ghost = ghost cache to be released
+ */
+PRIVATE void destroyGhost(GhostCache * const ghost) {
+	free(ghost->pages);
+	ghost->pages = NULL;
+	free(ghost->buckets);
+	ghost->buckets = NULL;
+	free(ghost->hashNext);
+	ghost->hashNext = NULL;
+	free(ghost->referenced);
+	ghost->referenced = NULL;
+	free(ghost->next);
+	ghost->next = NULL;
+	free(ghost->prev);
+	ghost->prev = NULL;
+	if (ghost->heap != NULL) {
+		destroyHeap(NULL, ghost->heap);
+		ghost->heap = NULL;
+	}
+}
+
+/**
+ * Private utility function to replay a pin of page to a ghost cache. Returns
+ * TRUE if the ghost holds the page, otherwise the page replaces a victim of
+ * the ghost's strategy.
+ *
+ * ghost = ghost cache
+ * page = page pinned, file slot << 32 | page no
+ */
+PRIVATE bool accessGhost(GhostCache * const ghost, const uint64_t page) {
+
+	int bucket = getGhostBucket(ghost, page);
+	int slot;
+
+	for (slot = ghost->buckets[bucket]; slot != -1;
+			slot = ghost->hashNext[slot]) {
+		if (ghost->pages[slot] == page) {
+			break;
+		}
+	}
+
+	if (slot != -1) {
+		if (ghost->strategy == RS_LRU && slot != ghost->head) {
+			//Move to front of the list
+			ghost->next[ghost->prev[slot]] = ghost->next[slot];
+			if (ghost->next[slot] != -1) {
+				ghost->prev[ghost->next[slot]] = ghost->prev[slot];
+			} else {
+				ghost->tail = ghost->prev[slot];
+			}
+			ghost->prev[slot] = -1;
+			ghost->next[slot] = ghost->head;
+			ghost->prev[ghost->head] = slot;
+			ghost->head = slot;
+		} else if (ghost->strategy == RS_CLOCK) {
+			ghost->referenced[slot] = TRUE;
+		} else if (ghost->strategy == RS_LFU) {
+			ghost->heap->key[slot]++;
+			siftDown(ghost->heap, ghost->heap->pos[slot]);
+		}
+		return TRUE;
+	}
+
+	//Miss, fill the next empty slot or replace a victim
+	if (ghost->size < ghost->capacity) {
+		slot = ghost->size++;
+	} else {
+		slot = chooseGhostVictim(ghost);
+		unhashGhostSlot(ghost, slot);
+	}
+	ghost->pages[slot] = page;
+	ghost->hashNext[slot] = ghost->buckets[bucket];
+	ghost->buckets[bucket] = slot;
+
+	if (ghost->strategy == RS_LRU) {
+		ghost->prev[slot] = -1;
+		ghost->next[slot] = ghost->head;
+		if (ghost->head != -1) {
+			ghost->prev[ghost->head] = slot;
+		} else {
+			ghost->tail = slot;
+		}
+		ghost->head = slot;
+	} else if (ghost->strategy == RS_CLOCK) {
+		ghost->referenced[slot] = FALSE;
+	} else if (ghost->strategy == RS_LFU) {
+		ghost->heap->key[slot] = 1;
+		ghost->heap->tie[slot] = ++ghost->tick;
+		pushHeap(ghost->heap, slot);
+	}
+	return FALSE;
+}
+
+/**
+ * Private utility function to take the slot of a full ghost cache to be
+ * replaced next off its strategy's bookkeeping. Slots were filled in order,
+ * so FIFO replaces them round robin.
+ *
+ * ghost = ghost cache
+ */
+PRIVATE int chooseGhostVictim(GhostCache * const ghost) {
+
+	int slot;
+
+	switch (ghost->strategy) {
+	case RS_LRU:
+		slot = ghost->tail;
+		ghost->tail = ghost->prev[slot];
+		if (ghost->tail != -1) {
+			ghost->next[ghost->tail] = -1;
+		} else {
+			ghost->head = -1;
+		}
+		return slot;
+	case RS_CLOCK:
+		while (ghost->referenced[ghost->hand]) {
+			ghost->referenced[ghost->hand] = FALSE;
+			ghost->hand = (ghost->hand + 1) % ghost->capacity;
+		}
+		slot = ghost->hand;
+		ghost->hand = (ghost->hand + 1) % ghost->capacity;
+		return slot;
+	case RS_LFU:
+		slot = ghost->heap->heap[0];
+		removeHeapAt(ghost->heap, 0);
+		return slot;
+	default:
+		slot = ghost->hand;
+		ghost->hand = (ghost->hand + 1) % ghost->capacity;
+		return slot;
+	}
+}
+
+/**
+ * Private utility function to get hash bucket of page in a ghost cache.
+ *
+ * ghost = ghost cache
+ * page = file slot << 32 | page no
+ */
+PRIVATE inline int getGhostBucket(GhostCache * const ghost,
+		const uint64_t page) {
+	return (int) ((page * 0x9e3779b97f4a7c15ULL) >> 32)
+			& (ghost->numBuckets - 1);
+}
+
+/**
+ * Private utility function to drop page of a ghost slot from the hash
+ * chains.
+ *
+ * ghost = ghost cache
+ * slot = slot being replaced
+ */
+PRIVATE void unhashGhostSlot(GhostCache * const ghost, const int slot) {
+	int *link = &ghost->buckets[getGhostBucket(ghost, ghost->pages[slot])];
+	while (*link != slot) {
+		link = &ghost->hashNext[*link];
+	}
+	*link = ghost->hashNext[slot];
+}
@@ -9,12 +9,56 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <limits.h>
+#include <sys/mman.h>
+
+#define PRIVATE static
 
 size_t strlen(const char *);
 char *strcpy(char *, const char *);
+int strcmp(const char *, const char *);
+void *memset(void *, int, size_t);
+
+//Process-wide pool shared by all page files, NULL unless initSharedBufferPool
+//was called. sharedPoolLock serializes its setup and teardown with views
+//being initialized on it.
+PRIVATE BM_BufferPool *sharedPool = NULL;
+PRIVATE pthread_mutex_t sharedPoolLock = PTHREAD_MUTEX_INITIALIZER;
+
+PRIVATE RC createPool(BM_BufferPool * const, const int, ReplacementStrategy,
+		const BM_PoolOptions * const);
+PRIVATE void releasePool(BM_BufferPool * const);
+PRIVATE RC openPoolFile(BM_BufferPool * const, const char * const);
+PRIVATE RC closePoolFile(BM_BufferPool * const);
+PRIVATE RC allocFrameArena(BM_Data * const, const int, const bool);
+PRIVATE void releaseFrameArena(BM_Data * const);
+PRIVATE void initFrames(BM_Data * const, const int);
+
+/**
+ * Fills pool options with their defaults
+ *
+ * options = options to be initialized
+ */
+void initPoolOptions(BM_PoolOptions * const options) {
+	options->useHugePages = FALSE;
+	options->backgroundWriter = FALSE;
+	options->writerDirtyTarget = 10;
+	options->writerPagesPerSec = 1000;
+	options->prefetch = FALSE;
+	options->prefetchMaxWindow = 32;
+	options->maxPages = 0;
+	options->warmup = FALSE;
+	options->traceFile = NULL;
+	options->traceMaxEvents = 1 << 20;
+	options->policy = NULL;
+	options->tierBytes = 0;
+	options->shmName = NULL;
+}
 
 /**
- * Initializes buffer pool.
+ * Initializes buffer pool. While the shared pool is up, a view on it is
+ * returned instead, see initSharedBufferPool.
  *
  * bm = buffer pool handle
  * pageFileName = name of the underlying page file for which this pool is being created
@@ -24,6 +68,29 @@ char *strcpy(char *, const char *);
  */
 RC initBufferPool(BM_BufferPool * const bm, const char * const pageFileName,
 		const int numPages, ReplacementStrategy strategy, void *stratData) {
+	return initBufferPoolWithOptions(bm, pageFileName, numPages, strategy,
+			stratData, NULL);
+}
+
+/**
+ * Initializes buffer pool with additional configuration. While the shared
+ * pool is up, a view on it is returned instead and numPages, strategy and
+ * options are ignored. With a shared memory segment in options, the pool is
+ * attached to it instead, see attachShmPool.
+ *
+ * bm = buffer pool handle
+ * pageFileName = name of the underlying page file for which this pool is being created
+ * numPages = no of pages this pool can hold in memory at a time
+ * strategy = page replacement strategy used to swap out pages when needed
+ * stratData = additional replacement strategy configuration parameters
+ * options = pool configuration, NULL for defaults
+ */
+RC initBufferPoolWithOptions(BM_BufferPool * const bm,
+		const char * const pageFileName, const int numPages,
+		ReplacementStrategy strategy, void *stratData,
+		const BM_PoolOptions * const options) {
+
+	RC ret;
 
 	//Sanity checks
 	if (bm == NULL) {
@@ -36,242 +103,871 @@ RC initBufferPool(BM_BufferPool * const bm, const char * const pageFileName,
 		THROW(RC_INVALID_PAGE_NUM, "Invalid numPages");
 	}
 
-	//Ideally we shouldn't need mutex on init, shutdown functions,
-	//because clients are expected to use these functions properly
-	//i.e. there shouldn't be multiple threads calling these functions simultaneously
-	//One client should use these functions only once at a time.
+	if (options != NULL && options->shmName != NULL) {
+		return attachShmPool(bm, pageFileName, numPages, options);
+	}
 
-	//But we'll assume clients are bad and use locks on these functions also.
+	pthread_mutex_lock(&sharedPoolLock);
+	if (sharedPool != NULL) {
+		//View on the shared pool, only page file is its own
+		bm->numPages = sharedPool->numPages;
+		bm->strategy = sharedPool->strategy;
+		bm->mgmtData = sharedPool->mgmtData;
+
+		//Acquire pool latch
+		pthread_mutex_lock(&((BM_Data *) bm->mgmtData)->poolLock);
+		ret = openPoolFile(bm, pageFileName);
+		//Release pool latch
+		pthread_mutex_unlock(&((BM_Data *) bm->mgmtData)->poolLock);
+
+		pthread_mutex_unlock(&sharedPoolLock);
+		if (ret != RC_OK) {
+			bm->mgmtData = NULL;
+		}
+		return ret;
+	}
+	pthread_mutex_unlock(&sharedPoolLock);
 
-	//Init Global lock
-	pthread_mutex_init(&GLOBAL_LOCK, NULL);
-	//Init locks specific to page frame access
-	pthread_mutex_init(&PAGE_FRAME_LOCK, NULL);
-	//Acquire lock
-	pthread_mutex_lock(&GLOBAL_LOCK);
-	//Acquire page frames access lock also
-	pthread_mutex_lock(&PAGE_FRAME_LOCK);
+	ret = createPool(bm, numPages, strategy, options);
+	if (ret != RC_OK) {
+		return ret;
+	}
 
-	//Set capacity of pool
-	bm->numPages = numPages;
+	//Acquire pool latch
+	pthread_mutex_lock(&((BM_Data *) bm->mgmtData)->poolLock);
+	ret = openPoolFile(bm, pageFileName);
+	//Release pool latch
+	pthread_mutex_unlock(&((BM_Data *) bm->mgmtData)->poolLock);
 
-	//Set page file name in pool
-	bm->pageFile = (char*) malloc(strlen(pageFileName) + sizeof(char));
-	strcpy(bm->pageFile, pageFileName);
+	if (ret != RC_OK) {
+		releasePool(bm);
+		return ret;
+	}
 
-	bm->strategy = strategy;
+	//All OK
+	return RC_OK;
+}
 
-	//Set additional metadata for the pool
-	bm->mgmtData = (BM_Data *) malloc(sizeof(BM_Data));
+/**
+ * Force writes any dirty pages to disk and if all pages have fix count of 0,
+ * buffer manager resources are released. For a view on the shared pool,
+ * only its page file is flushed and dropped from the shared pool, once no
+ * other view is open on it.
+ *
+ * bm = buffer pool handle
+ */
+RC shutdownBufferPool(BM_BufferPool * const bm) {
 
-	//pages is the actual array holding page frames
-	((BM_Data *) bm->mgmtData)->pages = (BM_PageHandle **) malloc(
-			sizeof(BM_PageHandle *) * numPages);
+	RC ret;
 
-	//dirtyFlags array hold dirty-ness status of pages
-	((BM_Data *) bm->mgmtData)->dirtyFlags = (bool *) malloc(
-			numPages * sizeof(bool));
+	//Sanity checks
+	if (bm == NULL || bm->mgmtData == NULL) {
+		THROW(RC_INVALID_HANDLE, "Buffer pool handle is invalid");
+	}
 
-	//fixCount array holds fix count of pages
-	((BM_Data *) bm->mgmtData)->fixCount = (PageNumber *) malloc(
-			numPages * sizeof(PageNumber));
+	if (((BM_Data *) bm->mgmtData)->shm != NULL) {
+		return detachShmPool(bm);
+	}
 
-	//pageInTime array holds epoch time when page was brought in pool
-	((BM_Data *) bm->mgmtData)->pageInTime = (struct timeval *) malloc(
-			numPages * sizeof(struct timeval));
+	if (((BM_Data *) bm->mgmtData)->shared == TRUE) {
+		//Acquire pool latch
+		pthread_mutex_lock(&((BM_Data *) bm->mgmtData)->poolLock);
+		ret = closePoolFile(bm);
+		//Release pool latch
+		pthread_mutex_unlock(&((BM_Data *) bm->mgmtData)->poolLock);
+
+		if (ret == RC_OK) {
+			bm->mgmtData = NULL;
+			free(bm->pageFile);
+			bm->pageFile = NULL;
+		}
+		return ret;
+	}
 
-	//pageUsedTime array holds epoch time when page was last used
-	((BM_Data *) bm->mgmtData)->pageUsedTime = (struct timeval *) malloc(
-			numPages * sizeof(struct timeval));
+	//Don't allow shutdown if there are pinned pages
+	if (ATOMIC_LOAD(((BM_Data *) bm->mgmtData)->numPinnedPages) != 0) {
+		THROW(RC_SHUTDOWN_FAIL,
+				"There are some pages pinned in memory, cannot shutdown now");
+	}
 
-	//pageUsedTime array holds epoch time when page was last used
-	((BM_Data *) bm->mgmtData)->pageUsedCount = (int *) malloc(
-			numPages * sizeof(int));
+	//Background threads must be gone before the page file is closed
+	stopWarmer(bm);
+	stopPrefetcher(bm);
+	stopBackgroundWriter(bm);
+	stopTrace(bm);
 
-	//frameIndexMap holds page no and it's index in pool
-	((BM_Data *) bm->mgmtData)->pageFrameIndexMap = (PageNumber *) malloc(
-			numPages * sizeof(PageNumber));
+	//Acquire pool latch
+	pthread_mutex_lock(&((BM_Data *) bm->mgmtData)->poolLock);
 
-	int i = 0;
-	for (; i < numPages; i++) {
-		((BM_Data *) bm->mgmtData)->pageFrameIndexMap[i] = NO_PAGE;
-		((BM_Data *) bm->mgmtData)->fixCount[i] = 0;
-		((BM_Data *) bm->mgmtData)->pages[i] = NULL;
-		((BM_Data *) bm->mgmtData)->dirtyFlags[i] = FALSE;
-		((BM_Data *) bm->mgmtData)->pageInTime[i].tv_usec = -1;
-		((BM_Data *) bm->mgmtData)->pageUsedTime[i].tv_usec = -1;
-		((BM_Data *) bm->mgmtData)->pageUsedCount[i] = 0;
+#ifdef _DEBUG
+	printf("\n Arrays Before Shutdown:");
+	printDebugInfo(bm);
+#endif
+
+	//Write all dirty pages to disk and close underlying page file
+	ret = closePoolFile(bm);
+
+	//Release pool latch
+	pthread_mutex_unlock(&((BM_Data *) bm->mgmtData)->poolLock);
+
+	if (ret != RC_OK) {
+		return ret;
 	}
 
-	((BM_Data *) bm->mgmtData)->numDirtyPages = 0;
-	((BM_Data *) bm->mgmtData)->numPinnedPages = 0;
-	((BM_Data *) bm->mgmtData)->numReadIO = 0;
-	((BM_Data *) bm->mgmtData)->numWriteIO = 0;
-	((BM_Data *) bm->mgmtData)->newBlockRequested = FALSE;
-	((BM_Data *) bm->mgmtData)->extraBlockReqCount = 0;
-	((BM_Data *) bm->mgmtData)->pageHit = 0;
-	((BM_Data *) bm->mgmtData)->pinReqCount = 0;
+#ifdef _DEBUG
+	printf("\n Stats before shutdown: ");
+	printIOStat(bm);
+#endif
 
-	//Open underlying page file
-	openPageFile(bm->pageFile, &(((BM_Data *) bm->mgmtData)->smFH));
+	releasePool(bm);
+
+	return RC_OK;
+}
+
+/**
+ * Writes all dirty pages from buffer pool with fix count of 0 to disk.
+ * For a view on the shared pool, only pages of its page file are written.
+ *
+ * bm = buffer pool handle
+ */
+RC forceFlushPool(BM_BufferPool * const bm) {
+
+	//Sanity checks
+	if (bm == NULL) {
+		THROW(RC_INVALID_HANDLE, "Buffer pool handle is invalid");
+	}
+
+	if (((BM_Data *) bm->mgmtData)->shm != NULL) {
+		return flushShmPool(bm);
+	}
 
-	((BM_Data *) bm->mgmtData)->actualPageFileCnt =
-			((BM_Data *) bm->mgmtData)->smFH.totalNumPages;
+	//Acquire pool latch
+	pthread_mutex_lock(&((BM_Data *) bm->mgmtData)->poolLock);
+
+	if (((BM_Data *) bm->mgmtData)->numDirtyPages > 0) {
+		//Write all dirty pages with fix count 0 to disk, sorted and coalesced.
+		//Latch is released during writes, frames are claimed meanwhile.
+		flushFilePages(bm);
+	}
 
-	//Release page frames access lock
-	pthread_mutex_unlock(&PAGE_FRAME_LOCK);
-	//Release lock
-	pthread_mutex_unlock(&GLOBAL_LOCK);
+	//Release pool latch
+	pthread_mutex_unlock(&((BM_Data *) bm->mgmtData)->poolLock);
 
 	//All OK
 	return RC_OK;
 }
 
 /**
- * Force writes any dirty pages to disk and if all pages have fix count of 0,
- * buffer manager resources are released
+ * Backs up page file of pool handle bm to backupFileName while the pool
+ * stays in use. Dirty pages are written back, then the page file is
+ * snapshotted and streamed to the backup file in order. A page written back
+ * meanwhile has its pre-image copied to the backup first, so writes go on
+ * and the backup holds the page file as of the snapshot. Pages pinned and
+ * dirty at the snapshot are backed up as they are on disk.
  *
  * bm = buffer pool handle
+ * backupFileName = name of the backup file
  */
-RC shutdownBufferPool(BM_BufferPool * const bm) {
+RC backupPool(BM_BufferPool * const bm, const char * const backupFileName) {
+
+	SM_BackupHandle backup;
 
 	//Sanity checks
-	if (bm == NULL) {
+	if (bm == NULL || bm->mgmtData == NULL) {
 		THROW(RC_INVALID_HANDLE, "Buffer pool handle is invalid");
 	}
 
-	//Don't allow shutdown if there are pinned pages
-	if (((BM_Data *) bm->mgmtData)->numPinnedPages != 0) {
-		THROW(RC_SHUTDOWN_FAIL,
-				"There are some pages pinned in memory, cannot shutdown now");
+	if (backupFileName == NULL) {
+		THROW(RC_INVALID_PAGE_FILE_NAME, "Backup file name is invalid");
 	}
 
-	//Acquire lock
-	pthread_mutex_lock(&GLOBAL_LOCK);
-	//Acquire page frames access lock
-	pthread_mutex_lock(&PAGE_FRAME_LOCK);
+	//Other clients of the segment write the page file behind our back
+	if (((BM_Data *) bm->mgmtData)->shm != NULL) {
+		THROW(RC_INVALID_OP, "Shared memory pools can't be backed up");
+	}
 
-	int i;
-	writeNewBlocks(bm, -1);
+	//Snapshot takes the pages written back up to now
+	RC ret = forceFlushPool(bm);
+	if (ret != RC_OK) {
+		return ret;
+	}
 
-	//Write all dirty pages to disk.
-	if (((BM_Data *) bm->mgmtData)->numDirtyPages > 0) {
-		for (i = 0; i < bm->numPages; i++) {
-			if (((BM_Data *) bm->mgmtData)->pageFrameIndexMap[i] != NO_PAGE
-					&& ((BM_Data *) bm->mgmtData)->dirtyFlags[i] == TRUE) {
-				//Ensure enough blocks exist in underlying pagefile
-				writeBlock(((BM_Data *) bm->mgmtData)->pageFrameIndexMap[i],
-						&(((BM_Data *) bm->mgmtData)->smFH),
-						((BM_Data *) bm->mgmtData)->pages[i]->data);
-				//Reset dirty flag
-				((BM_Data *) bm->mgmtData)->dirtyFlags[i] = FALSE;
-				//Update IO Count
-				((BM_Data *) bm->mgmtData)->numWriteIO++;
-				//Decrement dirty page count
-				((BM_Data *) bm->mgmtData)->numDirtyPages--;
-			}
+	ret = startBackup(bm->pageFile, (char *) backupFileName, &backup);
+	if (ret != RC_OK) {
+		return ret;
+	}
+
+	return finishBackup(&backup);
+}
+
+/**
+ * Changes the number of pages a running pool holds in memory at a time, up
+ * to maxPages of its options, or BM_DEFAULT_GROWTH times the initial
+ * numPages for pools opened without it and without huge pages. Growing
+ * takes effect right away. Shrinking retires the frames past newNumPages:
+ * replacement stops using them and their pages are evicted, dirty ones
+ * written back first. Retired frames still pinned are evicted by a later
+ * resize or page miss once unpinned.
+ * Resizing a view resizes the shared pool.
+ *
+ * bm = buffer pool handle
+ * newNumPages = no of pages this pool can hold in memory at a time
+ */
+RC resizeBufferPool(BM_BufferPool * const bm, const int newNumPages) {
+
+	//Sanity checks
+	if (bm == NULL || bm->mgmtData == NULL) {
+		THROW(RC_INVALID_HANDLE, "Buffer pool handle is invalid");
+	}
+	if (((BM_Data *) bm->mgmtData)->shm != NULL) {
+		THROW(RC_INVALID_OP, "Shared memory pools can't be resized");
+	}
+	if (newNumPages <= 0
+			|| newNumPages > ((BM_Data *) bm->mgmtData)->maxFrames) {
+		THROW(RC_INVALID_PAGE_NUM, "Invalid numPages");
+	}
+
+	//Acquire pool latch
+	pthread_mutex_lock(&((BM_Data *) bm->mgmtData)->poolLock);
+
+	if (newNumPages > ((BM_Data *) bm->mgmtData)->numFrames) {
+		//Retired frames still in use are taken back as they are, frames
+		//past them start empty
+		if (newNumPages > ((BM_Data *) bm->mgmtData)->numFramesUsed) {
+			initFrames((BM_Data *) bm->mgmtData, newNumPages);
+			((BM_Data *) bm->mgmtData)->numFramesUsed = newNumPages;
+		}
+		ATOMIC_STORE(((BM_Data *) bm->mgmtData)->numFrames, newNumPages);
+	} else if (newNumPages < ((BM_Data *) bm->mgmtData)->numFrames) {
+		ATOMIC_STORE(((BM_Data *) bm->mgmtData)->numFrames, newNumPages);
+		evictRetiredFrames(bm);
+	}
+	((BM_Data *) bm->mgmtData)->writerDirtyTarget = newNumPages
+			* ((BM_Data *) bm->mgmtData)->writerDirtyPercent / 100;
+
+	//Release pool latch
+	pthread_mutex_unlock(&((BM_Data *) bm->mgmtData)->poolLock);
+
+	bm->numPages = newNumPages;
+	if (((BM_Data *) bm->mgmtData)->shared == TRUE) {
+		//Views initialized from now on get the new size
+		pthread_mutex_lock(&sharedPoolLock);
+		if (sharedPool != NULL) {
+			sharedPool->numPages = newNumPages;
 		}
+		pthread_mutex_unlock(&sharedPoolLock);
 	}
 
-#ifdef _DEBUG
-	printf("\n Arrays Before Shutdown:");
-	printDebugInfo(bm);
-#endif
+	//All OK
+	return RC_OK;
+}
 
-	//Close underlying page file
-	closePageFile(&(((BM_Data *) bm->mgmtData)->smFH));
+/**
+ * Sets up the process-wide shared pool. From now on every buffer pool
+ * initialized gets a view on it, so all page files compete for the same
+ * numPages frames under a single replacement strategy and the memory goes
+ * wherever the hot pages are. Pools initialized before stay private.
+ *
+ * numPages = no of pages the shared pool can hold in memory at a time
+ * strategy = page replacement strategy used to swap out pages when needed
+ * stratData = additional replacement strategy configuration parameters
+ * options = pool configuration, NULL for defaults
+ */
+RC initSharedBufferPool(const int numPages, ReplacementStrategy strategy,
+		void *stratData, const BM_PoolOptions * const options) {
 
-#ifdef _DEBUG
-	printf("\n Stats before shutdown: ");
-	printIOStat(bm);
-#endif
+	//Sanity checks
+	if (numPages <= 0) {
+		THROW(RC_INVALID_PAGE_NUM, "Invalid numPages");
+	}
+	if (options != NULL && options->shmName != NULL) {
+		THROW(RC_INVALID_OP, "Shared pool can't live in shared memory");
+	}
 
-	BM_PageHandle **pages = ((BM_Data *) bm->mgmtData)->pages;
-	//Release memory allocated for internal page frames
-	for (i = 0; i < bm->numPages; i++) {
-		if (pages[i] != NULL) {
-			if (pages[i]->data != NULL) {
-				free(((BM_Data*) bm->mgmtData)->pages[i]->data);
-			}
-			free(((BM_Data*) bm->mgmtData)->pages[i]);
+	pthread_mutex_lock(&sharedPoolLock);
+	if (sharedPool != NULL) {
+		pthread_mutex_unlock(&sharedPoolLock);
+		THROW(RC_SHARED_POOL_EXISTS, "Shared buffer pool is already up");
+	}
+
+	BM_BufferPool *bm = MAKE_POOL();
+	if (bm == NULL) {
+		pthread_mutex_unlock(&sharedPoolLock);
+		THROW(RC_NOT_ENOUGH_MEMORY,
+				"Not enough memory available for resource allocation");
+	}
+
+	RC ret = createPool(bm, numPages, strategy, options);
+	if (ret != RC_OK) {
+		free(bm);
+		pthread_mutex_unlock(&sharedPoolLock);
+		return ret;
+	}
+	((BM_Data *) bm->mgmtData)->shared = TRUE;
+	sharedPool = bm;
+
+	pthread_mutex_unlock(&sharedPoolLock);
+
+	//All OK
+	return RC_OK;
+}
+
+/**
+ * Releases the shared pool. Fails while views on it are still open.
+ * Buffer pools initialized afterwards are private again.
+ */
+RC shutdownSharedBufferPool(void) {
+
+	int i;
+
+	pthread_mutex_lock(&sharedPoolLock);
+	if (sharedPool == NULL) {
+		pthread_mutex_unlock(&sharedPoolLock);
+		THROW(RC_INVALID_HANDLE, "Shared buffer pool is not up");
+	}
+
+	//Acquire pool latch
+	pthread_mutex_lock(&((BM_Data *) sharedPool->mgmtData)->poolLock);
+	for (i = 0; i < ((BM_Data *) sharedPool->mgmtData)->numFiles; i++) {
+		if (((BM_Data *) sharedPool->mgmtData)->files[i]->refCount > 0) {
+			break;
 		}
 	}
+	//Release pool latch
+	pthread_mutex_unlock(&((BM_Data *) sharedPool->mgmtData)->poolLock);
+
+	if (i < ((BM_Data *) sharedPool->mgmtData)->numFiles) {
+		pthread_mutex_unlock(&sharedPoolLock);
+		THROW(RC_SHUTDOWN_FAIL,
+				"There are views open on shared buffer pool, cannot shutdown now");
+	}
+
+	releasePool(sharedPool);
+	free(sharedPool);
+	sharedPool = NULL;
+
+	pthread_mutex_unlock(&sharedPoolLock);
+
+	//All OK
+	return RC_OK;
+}
+
+/**
+ * Allocates frames and bookkeeping of a pool without any page file and
+ * starts its background threads
+ *
+ * bm = buffer pool handle
+ * numPages = no of pages this pool can hold in memory at a time
+ * strategy = page replacement strategy used to swap out pages when needed
+ * options = pool configuration, NULL for defaults
+ */
+PRIVATE RC createPool(BM_BufferPool * const bm, const int numPages,
+		ReplacementStrategy strategy, const BM_PoolOptions * const options) {
+
+	BM_PoolOptions defaults;
+	if (options == NULL) {
+		initPoolOptions(&defaults);
+	}
+	const BM_PoolOptions * const opts = options != NULL ? options : &defaults;
+
+	//Frame arrays are sized for the largest the pool may be resized to, so
+	//they never move under latch-free readers. Without maxPages the pool may
+	//grow BM_DEFAULT_GROWTH times; the kernel backs the arena tail only once
+	//its frames are used. Explicit huge pages are reserved whole on mapping,
+	//so huge page pools only get the headroom maxPages asks for.
+	int maxFrames = numPages;
+	if (opts->maxPages > 0) {
+		maxFrames = opts->maxPages > numPages ? opts->maxPages : numPages;
+	} else if (opts->useHugePages == FALSE
+			&& numPages <= INT_MAX / BM_DEFAULT_GROWTH) {
+		maxFrames = numPages * BM_DEFAULT_GROWTH;
+	}
+
+	//Set capacity of pool
+	bm->numPages = numPages;
+	bm->pageFile = NULL;
+	bm->fileId = -1;
+
+	bm->strategy = strategy;
+
+	//Set additional metadata for the pool
+	bm->mgmtData = (BM_Data *) malloc(sizeof(BM_Data));
+	if (bm->mgmtData == NULL) {
+		THROW(RC_NOT_ENOUGH_MEMORY,
+				"Not enough memory available for resource allocation");
+	}
+
+	//Latches are private to this pool, so pools of different page files never
+	//wait on each other. Nobody else can see the pool until we return,
+	//hence no latch is held during init.
+	pthread_mutex_init(&((BM_Data *) bm->mgmtData)->poolLock, NULL);
+	if (initPageTable((BM_Data *) bm->mgmtData, maxFrames) != RC_OK) {
+		pthread_mutex_destroy(&((BM_Data *) bm->mgmtData)->poolLock);
+		free(bm->mgmtData);
+		bm->mgmtData = NULL;
+		THROW(RC_NOT_ENOUGH_MEMORY,
+				"Not enough memory available for resource allocation");
+	}
+
+	//pages is the fixed array of frame descriptors, frameArena is a single
+	//page aligned slab holding data of all frames. Frames are reused in place.
+	((BM_Data *) bm->mgmtData)->pages = (BM_PageHandle *) malloc(
+			sizeof(BM_PageHandle) * (maxFrames > 0 ? maxFrames : 1));
+	if (((BM_Data *) bm->mgmtData)->pages == NULL
+			|| allocFrameArena((BM_Data *) bm->mgmtData, maxFrames,
+					opts->useHugePages) != RC_OK) {
+		free(((BM_Data *) bm->mgmtData)->pages);
+		destroyPageTable((BM_Data *) bm->mgmtData);
+		pthread_mutex_destroy(&((BM_Data *) bm->mgmtData)->poolLock);
+		free(bm->mgmtData);
+		bm->mgmtData = NULL;
+		THROW(RC_NOT_ENOUGH_MEMORY,
+				"Not enough memory available for resource allocation");
+	}
+
+	//dirtyFlags array hold dirty-ness status of pages, dirty frames are
+	//also chained in the dirty list so flushes needn't scan the pool
+	((BM_Data *) bm->mgmtData)->dirtyFlags = (bool *) malloc(
+			maxFrames * sizeof(bool));
+	((BM_Data *) bm->mgmtData)->dirtyNext = (int *) malloc(
+			maxFrames * sizeof(int));
+	((BM_Data *) bm->mgmtData)->dirtyPrev = (int *) malloc(
+			maxFrames * sizeof(int));
+	((BM_Data *) bm->mgmtData)->dirtyHead = -1;
+	pthread_mutex_init(&((BM_Data *) bm->mgmtData)->dirtyLock, NULL);
+
+	//fixCount array holds fix count of pages
+	((BM_Data *) bm->mgmtData)->fixCount = (PageNumber *) malloc(
+			maxFrames * sizeof(PageNumber));
+
+	//frameState array holds I/O state of frames, frameCond array is waited
+	//on by pins of a page while its frame is in I/O
+	((BM_Data *) bm->mgmtData)->frameState = (int *) malloc(
+			maxFrames * sizeof(int));
+	((BM_Data *) bm->mgmtData)->frameCond = (pthread_cond_t *) malloc(
+			maxFrames * sizeof(pthread_cond_t));
+
+	//pageLatch array holds latch word of frames, see buffer_mgr_latch.c
+	((BM_Data *) bm->mgmtData)->pageLatch = (int *) malloc(
+			maxFrames * sizeof(int));
+	pthread_cond_init(&((BM_Data *) bm->mgmtData)->frameIdle, NULL);
+	((BM_Data *) bm->mgmtData)->numFramesInIO = 0;
+
+	//pageInTime array holds pool clock tick when page was brought in pool
+	((BM_Data *) bm->mgmtData)->pageInTime = (unsigned long *) malloc(
+			maxFrames * sizeof(unsigned long));
+
+	//pageUsedTime array holds pool clock tick when page was last used
+	((BM_Data *) bm->mgmtData)->pageUsedTime = (unsigned long *) malloc(
+			maxFrames * sizeof(unsigned long));
+
+	//pageUsedTime array holds epoch time when page was last used
+	((BM_Data *) bm->mgmtData)->pageUsedCount = (int *) malloc(
+			maxFrames * sizeof(int));
+
+	//frameIndexMap holds page no and it's index in pool, frameFile the slot
+	//of its page file in file table
+	((BM_Data *) bm->mgmtData)->pageFrameIndexMap = (PageNumber *) malloc(
+			maxFrames * sizeof(PageNumber));
+	((BM_Data *) bm->mgmtData)->frameFile = (int *) malloc(
+			maxFrames * sizeof(int));
+
+	//retention array holds retention class of pages
+	((BM_Data *) bm->mgmtData)->retention = (int *) malloc(
+			maxFrames * sizeof(int));
+	((BM_Data *) bm->mgmtData)->numEvictFirst = 0;
+	((BM_Data *) bm->mgmtData)->evictFirstHand = 0;
+
+	((BM_Data *) bm->mgmtData)->maxFrames = maxFrames;
+	((BM_Data *) bm->mgmtData)->numFramesInit = 0;
+	((BM_Data *) bm->mgmtData)->numFramesUsed = 0;
+	((BM_Data *) bm->mgmtData)->prefetched = NULL;
+	initFrames((BM_Data *) bm->mgmtData, numPages);
+	((BM_Data *) bm->mgmtData)->numFrames = numPages;
+	((BM_Data *) bm->mgmtData)->numFramesUsed = numPages;
+
+	((BM_Data *) bm->mgmtData)->shared = FALSE;
+	((BM_Data *) bm->mgmtData)->shm = NULL;
+	((BM_Data *) bm->mgmtData)->files = NULL;
+	((BM_Data *) bm->mgmtData)->numFiles = 0;
+	((BM_Data *) bm->mgmtData)->numDirtyPages = 0;
+	((BM_Data *) bm->mgmtData)->numPinnedPages = 0;
+	memset(&((BM_Data *) bm->mgmtData)->stats, 0, sizeof(BM_PoolStats));
+	((BM_Data *) bm->mgmtData)->clock = 0;
+
+	//Start background threads last, they may touch the pool right away
+	((BM_Data *) bm->mgmtData)->prefetchRunning = FALSE;
+	((BM_Data *) bm->mgmtData)->warmupRunning = FALSE;
+	((BM_Data *) bm->mgmtData)->warmupEnabled = FALSE;
+	((BM_Data *) bm->mgmtData)->trace = NULL;
+	((BM_Data *) bm->mgmtData)->tier = NULL;
+	//Policy of options replaces the built-in one of strategy
+	RC ret = initPolicy((BM_Data *) bm->mgmtData,
+			opts->policy != NULL ? opts->policy : getStrategyPolicy(strategy));
+	if (ret == RC_OK) {
+		ret = startTrace(bm, opts);
+	}
+	if (ret == RC_OK) {
+		ret = startTier(bm, opts);
+	}
+	if (ret == RC_OK) {
+		ret = startBackgroundWriter(bm, opts);
+	}
+	if (ret == RC_OK) {
+		ret = startPrefetcher(bm, opts);
+	}
+	if (ret == RC_OK) {
+		ret = startWarmer(bm, opts);
+	}
+	if (ret != RC_OK) {
+		releasePool(bm);
+		return ret;
+	}
+
+	//All OK
+	return RC_OK;
+}
+
+/**
+ * Stops background threads of a pool and releases its frames and
+ * bookkeeping. Page files must have been closed already.
+ *
+ * bm = buffer pool handle
+ */
+PRIVATE void releasePool(BM_BufferPool * const bm) {
+
+	int i;
+
+	//Background threads must be gone before pool resources are released
+	stopWarmer(bm);
+	stopPrefetcher(bm);
+	stopBackgroundWriter(bm);
+	stopTrace(bm);
+	stopTier(bm);
+
+	//Acquire pool latch
+	pthread_mutex_lock(&((BM_Data *) bm->mgmtData)->poolLock);
 
 	free(((BM_Data *) bm->mgmtData)->fixCount);
 	((BM_Data *) bm->mgmtData)->fixCount = NULL;
+	for (i = 0; i < ((BM_Data *) bm->mgmtData)->numFramesInit; i++) {
+		pthread_cond_destroy(&((BM_Data *) bm->mgmtData)->frameCond[i]);
+	}
+	pthread_cond_destroy(&((BM_Data *) bm->mgmtData)->frameIdle);
+	free(((BM_Data *) bm->mgmtData)->frameState);
+	((BM_Data *) bm->mgmtData)->frameState = NULL;
+	free(((BM_Data *) bm->mgmtData)->frameCond);
+	((BM_Data *) bm->mgmtData)->frameCond = NULL;
+	free(((BM_Data *) bm->mgmtData)->pageLatch);
+	((BM_Data *) bm->mgmtData)->pageLatch = NULL;
 	free(((BM_Data *) bm->mgmtData)->dirtyFlags);
 	((BM_Data *) bm->mgmtData)->dirtyFlags = NULL;
+	free(((BM_Data *) bm->mgmtData)->dirtyNext);
+	((BM_Data *) bm->mgmtData)->dirtyNext = NULL;
+	free(((BM_Data *) bm->mgmtData)->dirtyPrev);
+	((BM_Data *) bm->mgmtData)->dirtyPrev = NULL;
+	pthread_mutex_destroy(&((BM_Data *) bm->mgmtData)->dirtyLock);
 	free(((BM_Data *) bm->mgmtData)->pageFrameIndexMap);
 	((BM_Data *) bm->mgmtData)->pageFrameIndexMap = NULL;
+	free(((BM_Data *) bm->mgmtData)->frameFile);
+	((BM_Data *) bm->mgmtData)->frameFile = NULL;
 	free(((BM_Data *) bm->mgmtData)->pageInTime);
 	((BM_Data *) bm->mgmtData)->pageInTime = NULL;
 	free(((BM_Data *) bm->mgmtData)->pageUsedTime);
 	((BM_Data *) bm->mgmtData)->pageUsedTime = NULL;
 	free(((BM_Data *) bm->mgmtData)->pageUsedCount);
 	((BM_Data *) bm->mgmtData)->pageUsedCount = NULL;
+	free(((BM_Data *) bm->mgmtData)->retention);
+	((BM_Data *) bm->mgmtData)->retention = NULL;
+	destroyPolicy((BM_Data *) bm->mgmtData);
+	//Release memory allocated for internal page frames
+	releaseFrameArena((BM_Data *) bm->mgmtData);
 	free(((BM_Data *) bm->mgmtData)->pages);
 	((BM_Data *) bm->mgmtData)->pages = NULL;
+	destroyPageTable((BM_Data *) bm->mgmtData);
+	//Release file table, all slots are free by now
+	for (i = 0; i < ((BM_Data *) bm->mgmtData)->numFiles; i++) {
+		free(((BM_Data *) bm->mgmtData)->files[i]);
+	}
+	free(((BM_Data *) bm->mgmtData)->files);
+	((BM_Data *) bm->mgmtData)->files = NULL;
+
+	//Release pool latch
+	pthread_mutex_unlock(&((BM_Data *) bm->mgmtData)->poolLock);
+	//Destroy the pool latch
+	pthread_mutex_destroy(&((BM_Data *) bm->mgmtData)->poolLock);
+
 	free(bm->mgmtData);
 	bm->mgmtData = NULL;
 	free(bm->pageFile);
 	bm->pageFile = NULL;
+}
+
+/**
+ * Opens page file pageFileName in pool of handle bm and points the handle to
+ * its slot in file table. A page file already open in the pool shares its
+ * slot. Slots are never released before the pool, so a slot may be used
+ * without the latch once looked up. Caller must hold the pool latch.
+ *
+ * bm = buffer pool handle
+ * pageFileName = name of the page file
+ */
+PRIVATE RC openPoolFile(BM_BufferPool * const bm,
+		const char * const pageFileName) {
+
+	int i, slot = -1;
+
+	for (i = 0; i < ((BM_Data *) bm->mgmtData)->numFiles; i++) {
+		BM_File *file = ((BM_Data *) bm->mgmtData)->files[i];
+		if (file->refCount > 0 && strcmp(file->name, pageFileName) == 0) {
+			slot = i;
+			break;
+		}
+		if (file->refCount == 0 && slot == -1) {
+			slot = i;
+		}
+	}
+
+	//Set page file name in pool
+	bm->pageFile = (char*) malloc(strlen(pageFileName) + sizeof(char));
+	if (bm->pageFile == NULL) {
+		THROW(RC_NOT_ENOUGH_MEMORY,
+				"Not enough memory available for resource allocation");
+	}
+	strcpy(bm->pageFile, pageFileName);
 
-	//Release page frames access lock
-	pthread_mutex_unlock(&PAGE_FRAME_LOCK);
-	//Release lock
-	pthread_mutex_unlock(&GLOBAL_LOCK);
-	//Destroy the page frames lock
-	pthread_mutex_destroy(&PAGE_FRAME_LOCK);
-	//Destroy the global lock
-	pthread_mutex_destroy(&GLOBAL_LOCK);
+	//Page file already open in pool
+	if (slot != -1 && ((BM_Data *) bm->mgmtData)->files[slot]->refCount > 0) {
+		((BM_Data *) bm->mgmtData)->files[slot]->refCount++;
+		bm->fileId = slot;
+		return RC_OK;
+	}
 
+	//No free slot, grow file table
+	if (slot == -1) {
+		BM_File **files = (BM_File **) realloc(
+				((BM_Data *) bm->mgmtData)->files,
+				(((BM_Data *) bm->mgmtData)->numFiles + 1) * sizeof(BM_File *));
+		BM_File *file = (BM_File *) malloc(sizeof(BM_File));
+		if (files != NULL) {
+			((BM_Data *) bm->mgmtData)->files = files;
+		}
+		if (files == NULL || file == NULL) {
+			free(file);
+			free(bm->pageFile);
+			bm->pageFile = NULL;
+			THROW(RC_NOT_ENOUGH_MEMORY,
+					"Not enough memory available for resource allocation");
+		}
+		file->refCount = 0;
+		file->name = NULL;
+		slot = ((BM_Data *) bm->mgmtData)->numFiles++;
+		((BM_Data *) bm->mgmtData)->files[slot] = file;
+	}
+
+	BM_File *file = ((BM_Data *) bm->mgmtData)->files[slot];
+
+	//Open underlying page file
+	file->name = (char*) malloc(strlen(pageFileName) + sizeof(char));
+	if (file->name == NULL) {
+		free(bm->pageFile);
+		bm->pageFile = NULL;
+		THROW(RC_NOT_ENOUGH_MEMORY,
+				"Not enough memory available for resource allocation");
+	}
+	strcpy(file->name, pageFileName);
+	//File handle keeps pointing to the name, slot owns it
+	RC ret = openPageFile(file->name, &file->smFH);
+	if (ret != RC_OK) {
+		free(file->name);
+		file->name = NULL;
+		free(bm->pageFile);
+		bm->pageFile = NULL;
+		return ret;
+	}
+
+	file->refCount = 1;
+	file->newBlockRequested = FALSE;
+	file->lastBlockRequested = NO_PAGE;
+	file->appending = FALSE;
+	file->actualPageFileCnt = file->smFH.totalNumPages;
+	bm->fileId = slot;
+
+	//Load pages hot when page file was closed last time
+	queueWarmup(bm);
+
+	//All OK
 	return RC_OK;
 }
 
 /**
- * Writes all dirty pages from buffer pool with fix count of 0 to disk
+ * Closes page file of pool handle bm. Once no other view is open on it, all
+ * its dirty pages are written back, its pages dropped from pool and the page
+ * file closed. Caller must hold the pool latch.
  *
  * bm = buffer pool handle
  */
-RC forceFlushPool(BM_BufferPool * const bm) {
+PRIVATE RC closePoolFile(BM_BufferPool * const bm) {
 
-	//Sanity checks
-	if (bm == NULL) {
-		THROW(RC_INVALID_HANDLE, "Buffer pool handle is invalid");
+	BM_File *file = ((BM_Data *) bm->mgmtData)->files[bm->fileId];
+
+	if (file->refCount > 1) {
+		file->refCount--;
+		return RC_OK;
 	}
 
-	//Acquire lock
-	pthread_mutex_lock(&GLOBAL_LOCK);
-	//Acquire page frames access lock
-	pthread_mutex_lock(&PAGE_FRAME_LOCK);
+	//Remember hot pages for next open, while they are still resident
+	cancelWarmup(bm);
+	saveWarmupList(bm);
 
-	if (((BM_Data *) bm->mgmtData)->numDirtyPages > 0) {
-		writeNewBlocks(bm, -1);
-		//Write all dirty pages with fix count 0 to disk.
-		int i;
-		for (i = 0; i < bm->numPages; i++) {
-			if (((BM_Data *) bm->mgmtData)->pageFrameIndexMap[i] != NO_PAGE
-					&& ((BM_Data *) bm->mgmtData)->dirtyFlags[i] == TRUE
-					&& ((BM_Data *) bm->mgmtData)->fixCount[i] == 0) {
-				//Ensure enough blocks exist in underlying pagefile
-				writeBlock(((BM_Data *) bm->mgmtData)->pageFrameIndexMap[i],
-						&(((BM_Data *) bm->mgmtData)->smFH),
-						((BM_Data *) bm->mgmtData)->pages[i]->data);
-				//Reset dirty flag
-				((BM_Data *) bm->mgmtData)->dirtyFlags[i] = FALSE;
-				//Update IO Count
-				((BM_Data *) bm->mgmtData)->numWriteIO++;
-				//Decrement dirty page count
-				((BM_Data *) bm->mgmtData)->numDirtyPages--;
-			}
-		}
+	//Write all dirty pages to disk.
+	RC ret = evictFilePages(bm);
+	if (ret != RC_OK) {
+		return ret;
 	}
 
-	//Release page frames access lock
-	pthread_mutex_unlock(&PAGE_FRAME_LOCK);
-	//Release lock
-	pthread_mutex_unlock(&GLOBAL_LOCK);
+	//Slot may be reused by another page file
+	dropTierFile(bm, bm->fileId);
+
+	//Close underlying page file
+	closePageFile(&file->smFH);
+	free(file->name);
+	file->name = NULL;
+	file->refCount = 0;
 
 	//All OK
 	return RC_OK;
 }
+
+/**
+ * Allocates the slab holding data of all page frames. With huge pages
+ * requested, explicit huge pages are tried first, then a regular mapping
+ * aligned to huge page size and advised for transparent huge pages. The
+ * outcome is kept in hugePageState.
+ *
+ * data = buffer pool management data
+ * numPages = no of frames in the pool
+ * useHugePages = TRUE to back the slab by huge pages, if possible
+ */
+PRIVATE RC allocFrameArena(BM_Data * const data, const int numPages,
+		const bool useHugePages) {
+
+	data->arenaSize = (size_t) PAGE_SIZE * (numPages > 0 ? numPages : 1);
+	data->hugePageState = BM_HUGEPAGE_OFF;
+	data->frameArena = NULL;
+
+	if (useHugePages == FALSE) {
+		if (posix_memalign((void **) &data->frameArena, BM_FRAME_ALIGNMENT,
+				data->arenaSize) != 0) {
+			data->frameArena = NULL;
+			THROW(RC_NOT_ENOUGH_MEMORY,
+					"Not enough memory available for resource allocation");
+		}
+		return RC_OK;
+	}
+
+	//Huge pages are only handed out in whole
+	data->arenaSize = (data->arenaSize + BM_HUGE_PAGE_SIZE - 1)
+			& ~((size_t) BM_HUGE_PAGE_SIZE - 1);
+
+#ifdef MAP_HUGETLB
+	void *arena = mmap(NULL, data->arenaSize, PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+	if (arena != MAP_FAILED) {
+		data->frameArena = (char *) arena;
+		data->hugePageState = BM_HUGEPAGE_MAPPED;
+		return RC_OK;
+	}
+#endif
+
+	//No huge pages reserved, map one huge page extra so the slab can be
+	//aligned to a huge page boundary, then trim the slack at both ends
+	size_t mapSize = data->arenaSize + BM_HUGE_PAGE_SIZE;
+	char *map = (char *) mmap(NULL, mapSize, PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (map == (char *) MAP_FAILED) {
+		THROW(RC_NOT_ENOUGH_MEMORY,
+				"Not enough memory available for resource allocation");
+	}
+	char *aligned = (char *) (((uintptr_t) map + BM_HUGE_PAGE_SIZE - 1)
+			& ~((uintptr_t) BM_HUGE_PAGE_SIZE - 1));
+	if (aligned > map) {
+		munmap(map, aligned - map);
+	}
+	if (aligned + data->arenaSize < map + mapSize) {
+		munmap(aligned + data->arenaSize,
+				(map + mapSize) - (aligned + data->arenaSize));
+	}
+	data->frameArena = aligned;
+
+#ifdef MADV_HUGEPAGE
+	if (madvise(data->frameArena, data->arenaSize, MADV_HUGEPAGE) == 0) {
+		data->hugePageState = BM_HUGEPAGE_ADVISED;
+		return RC_OK;
+	}
+#endif
+	data->hugePageState = BM_HUGEPAGE_FAILED;
+
+	//All OK, frames still work from regular pages
+	return RC_OK;
+}
+
+/**
+ * Releases the slab holding data of all page frames
+ *
+ * data = buffer pool management data
+ */
+PRIVATE void releaseFrameArena(BM_Data * const data) {
+	if (data->hugePageState == BM_HUGEPAGE_OFF) {
+		free(data->frameArena);
+	} else {
+		munmap(data->frameArena, data->arenaSize);
+	}
+	data->frameArena = NULL;
+}
+
+/**
+ * Sets up frames from numFramesUsed up to numFrames as empty frames
+ * backed by their place in the frame arena. Caller must hold the pool latch,
+ * unless nobody else can see the pool yet.
+ *
+ * data = buffer pool management data
+ * numFrames = no of frames in use once set up
+ */
+PRIVATE void initFrames(BM_Data * const data, const int numFrames) {
+
+	int i, numInit = data->numFramesInit;
+
+	for (i = data->numFramesInit; i < numFrames; i++) {
+		pthread_cond_init(&data->frameCond[i], NULL);
+	}
+	if (numFrames > data->numFramesInit) {
+		data->numFramesInit = numFrames;
+	}
+
+	for (i = data->numFramesUsed; i < numFrames; i++) {
+		ATOMIC_STORE(data->pageFrameIndexMap[i], NO_PAGE);
+		data->frameFile[i] = -1;
+		ATOMIC_STORE(data->fixCount[i], 0);
+		data->frameState[i] = FRAME_READY;
+		data->pageLatch[i] = 0;
+		data->pages[i].pageNum = NO_PAGE;
+		data->pages[i].data = data->frameArena + (size_t) i * PAGE_SIZE;
+		data->pages[i].frame = i;
+		if (i < numInit) {
+			//Frame was in use before, take it out of dirty list too
+			clearFrameDirty(data, i);
+		} else {
+			data->dirtyFlags[i] = FALSE;
+			data->dirtyNext[i] = -1;
+			data->dirtyPrev[i] = -1;
+		}
+		data->pageInTime[i] = 0;
+		data->pageUsedTime[i] = 0;
+		data->pageUsedCount[i] = 0;
+		data->retention[i] = BM_RETAIN_NORMAL;
+		if (data->prefetched != NULL) {
+			data->prefetched[i] = FALSE;
+		}
+	}
+}
@@ -0,0 +1,347 @@
+/*
+ * buffer_mgr_prefetch.c
+ *
+ *  Optional prefetcher of a buffer pool. pinPage reports each page it pins to
+ *  a small table of access streams; once the pins of a stream follow a
+ *  constant stride the next pages of that stream are queued and a worker
+ *  thread reads them into the pool ahead of demand.
+ *  The read-ahead window doubles whenever a prefetched page gets pinned and
+ *  halves whenever one is evicted unused.
+ */
+
+#include "buffer_mgr.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define PRIVATE static
+
+//Most pages the worker loads in one go
+#define PREFETCH_BATCH 32
+
+PRIVATE BM_PrefetchStream *findPrefetchStream(BM_Data * const, const int,
+		const PageNumber);
+PRIVATE void *prefetcherMain(void *);
+
+/**
+ * Starts prefetcher of the pool, if enabled in options
+ *
+ * bm = buffer pool handle
+ * options = pool configuration
+ */
+RC startPrefetcher(BM_BufferPool * const bm,
+		const BM_PoolOptions * const options) {
+
+	int i;
+
+	((BM_Data *) bm->mgmtData)->prefetchRunning = FALSE;
+	((BM_Data *) bm->mgmtData)->prefetchStop = FALSE;
+	((BM_Data *) bm->mgmtData)->prefetched = NULL;
+	((BM_Data *) bm->mgmtData)->prefetchQueue = NULL;
+	((BM_Data *) bm->mgmtData)->prefetchQueueFile = NULL;
+
+	if (options->prefetch == FALSE || bm->numPages == 0) {
+		return RC_OK;
+	}
+
+	((BM_Data *) bm->mgmtData)->prefetchHead = 0;
+	((BM_Data *) bm->mgmtData)->prefetchTail = 0;
+	((BM_Data *) bm->mgmtData)->prefetchClock = 0;
+	for (i = 0; i < BM_PREFETCH_STREAMS; i++) {
+		((BM_Data *) bm->mgmtData)->prefetchStreams[i].fileId = -1;
+		((BM_Data *) bm->mgmtData)->prefetchStreams[i].last = NO_PAGE;
+		((BM_Data *) bm->mgmtData)->prefetchStreams[i].next = NO_PAGE;
+		((BM_Data *) bm->mgmtData)->prefetchStreams[i].stride = 0;
+		((BM_Data *) bm->mgmtData)->prefetchStreams[i].run = 0;
+		((BM_Data *) bm->mgmtData)->prefetchStreams[i].stamp = 0;
+	}
+	((BM_Data *) bm->mgmtData)->prefetchWindow = BM_PREFETCH_MIN_WINDOW;
+	//Never read ahead more than half the pool
+	((BM_Data *) bm->mgmtData)->prefetchMaxWindow =
+			options->prefetchMaxWindow < bm->numPages / 2 ?
+					options->prefetchMaxWindow : bm->numPages / 2;
+	if (((BM_Data *) bm->mgmtData)->prefetchMaxWindow
+			< BM_PREFETCH_MIN_WINDOW) {
+		((BM_Data *) bm->mgmtData)->prefetchMaxWindow = BM_PREFETCH_MIN_WINDOW;
+	}
+
+	((BM_Data *) bm->mgmtData)->prefetched = (bool *) malloc(
+			((BM_Data *) bm->mgmtData)->maxFrames * sizeof(bool));
+	//Queue holds page numbers and slots of their page files
+	((BM_Data *) bm->mgmtData)->prefetchQueue = (PageNumber *) malloc(
+			BM_PREFETCH_QUEUE_SIZE * sizeof(PageNumber));
+	((BM_Data *) bm->mgmtData)->prefetchQueueFile = (int *) malloc(
+			BM_PREFETCH_QUEUE_SIZE * sizeof(int));
+	if (((BM_Data *) bm->mgmtData)->prefetched == NULL
+			|| ((BM_Data *) bm->mgmtData)->prefetchQueue == NULL
+			|| ((BM_Data *) bm->mgmtData)->prefetchQueueFile == NULL) {
+		free(((BM_Data *) bm->mgmtData)->prefetched);
+		free(((BM_Data *) bm->mgmtData)->prefetchQueue);
+		free(((BM_Data *) bm->mgmtData)->prefetchQueueFile);
+		((BM_Data *) bm->mgmtData)->prefetched = NULL;
+		((BM_Data *) bm->mgmtData)->prefetchQueue = NULL;
+		((BM_Data *) bm->mgmtData)->prefetchQueueFile = NULL;
+		THROW(RC_NOT_ENOUGH_MEMORY,
+				"Not enough memory available for resource allocation");
+	}
+	for (i = 0; i < ((BM_Data *) bm->mgmtData)->maxFrames; i++) {
+		((BM_Data *) bm->mgmtData)->prefetched[i] = FALSE;
+	}
+
+	pthread_mutex_init(&((BM_Data *) bm->mgmtData)->prefetchLock, NULL);
+	pthread_cond_init(&((BM_Data *) bm->mgmtData)->prefetchCond, NULL);
+	if (pthread_create(&((BM_Data *) bm->mgmtData)->prefetcher, NULL,
+			prefetcherMain, bm) != 0) {
+		pthread_cond_destroy(&((BM_Data *) bm->mgmtData)->prefetchCond);
+		pthread_mutex_destroy(&((BM_Data *) bm->mgmtData)->prefetchLock);
+		free(((BM_Data *) bm->mgmtData)->prefetched);
+		free(((BM_Data *) bm->mgmtData)->prefetchQueue);
+		free(((BM_Data *) bm->mgmtData)->prefetchQueueFile);
+		((BM_Data *) bm->mgmtData)->prefetched = NULL;
+		((BM_Data *) bm->mgmtData)->prefetchQueue = NULL;
+		((BM_Data *) bm->mgmtData)->prefetchQueueFile = NULL;
+		THROW(RC_WRITER_START_FAILED, "Couldn't start prefetcher");
+	}
+	((BM_Data *) bm->mgmtData)->prefetchRunning = TRUE;
+
+	//All OK
+	return RC_OK;
+}
+
+/**
+ * Stops prefetcher of the pool and waits for its current batch.
+ * Caller must not hold the pool latch.
+ *
+ * bm = buffer pool handle
+ */
+void stopPrefetcher(BM_BufferPool * const bm) {
+
+	if (((BM_Data *) bm->mgmtData)->prefetchRunning == FALSE) {
+		return;
+	}
+
+	pthread_mutex_lock(&((BM_Data *) bm->mgmtData)->prefetchLock);
+	((BM_Data *) bm->mgmtData)->prefetchStop = TRUE;
+	pthread_cond_signal(&((BM_Data *) bm->mgmtData)->prefetchCond);
+	pthread_mutex_unlock(&((BM_Data *) bm->mgmtData)->prefetchLock);
+
+	pthread_join(((BM_Data *) bm->mgmtData)->prefetcher, NULL);
+	pthread_cond_destroy(&((BM_Data *) bm->mgmtData)->prefetchCond);
+	pthread_mutex_destroy(&((BM_Data *) bm->mgmtData)->prefetchLock);
+	free(((BM_Data *) bm->mgmtData)->prefetched);
+	((BM_Data *) bm->mgmtData)->prefetched = NULL;
+	free(((BM_Data *) bm->mgmtData)->prefetchQueue);
+	((BM_Data *) bm->mgmtData)->prefetchQueue = NULL;
+	free(((BM_Data *) bm->mgmtData)->prefetchQueueFile);
+	((BM_Data *) bm->mgmtData)->prefetchQueueFile = NULL;
+	((BM_Data *) bm->mgmtData)->prefetchRunning = FALSE;
+}
+
+/**
+ * Feeds a pin of page pageNum to the stream it belongs to. Streams are kept
+ * per page file. Once three pins of a stream in a row are the same stride
+ * apart, pages up to a window ahead of pageNum along that stride are queued
+ * for the worker, each page only once per stream. Must be called without the
+ * pool latch.
+ *
+ * bm = buffer pool handle
+ * pageNum = page number just pinned
+ */
+void notePrefetchAccess(BM_BufferPool * const bm, const PageNumber pageNum) {
+
+	BM_PrefetchStream *stream;
+
+	if (((BM_Data *) bm->mgmtData)->prefetchRunning == FALSE) {
+		return;
+	}
+
+	pthread_mutex_lock(&((BM_Data *) bm->mgmtData)->prefetchLock);
+
+	stream = findPrefetchStream((BM_Data *) bm->mgmtData, bm->fileId, pageNum);
+	stream->stamp = ++((BM_Data *) bm->mgmtData)->prefetchClock;
+
+	int stride = pageNum - stream->last;
+
+	//Repeated pins of one page, e.g. record by record, tell nothing
+	if (stream->last == NO_PAGE || stride == 0) {
+		stream->last = pageNum;
+		pthread_mutex_unlock(&((BM_Data *) bm->mgmtData)->prefetchLock);
+		return;
+	}
+
+	if (stride == stream->stride) {
+		stream->run++;
+	} else {
+		//Stream changed its stride, forget what was read ahead for the old one
+		stream->stride = stride;
+		stream->run = 1;
+		stream->next = pageNum + stride;
+	}
+	stream->last = pageNum;
+
+	if (stream->run >= 2 && abs(stride) <= BM_PREFETCH_MAX_STRIDE) {
+		int window = ATOMIC_LOAD(((BM_Data *) bm->mgmtData)->prefetchWindow);
+		PageNumber last = pageNum + stride * window;
+		PageNumber next = stream->next;
+		bool queued = FALSE;
+
+		//Don't queue pages the stream has already passed
+		if ((stride > 0 && next <= pageNum) || (stride < 0 && next >= pageNum)) {
+			next = pageNum + stride;
+		}
+		while (next >= 0
+				&& ((stride > 0 && next <= last) || (stride < 0 && next >= last))) {
+			int tail = (((BM_Data *) bm->mgmtData)->prefetchTail + 1)
+					% BM_PREFETCH_QUEUE_SIZE;
+			//Queue is full, worker is behind anyway
+			if (tail == ((BM_Data *) bm->mgmtData)->prefetchHead) {
+				break;
+			}
+			((BM_Data *) bm->mgmtData)->prefetchQueue[((BM_Data *) bm->mgmtData)->prefetchTail] =
+					next;
+			((BM_Data *) bm->mgmtData)->prefetchQueueFile[((BM_Data *) bm->mgmtData)->prefetchTail] =
+					bm->fileId;
+			((BM_Data *) bm->mgmtData)->prefetchTail = tail;
+			next += stride;
+			queued = TRUE;
+		}
+		stream->next = next;
+
+		if (queued) {
+			pthread_cond_signal(&((BM_Data *) bm->mgmtData)->prefetchCond);
+		}
+	}
+
+	pthread_mutex_unlock(&((BM_Data *) bm->mgmtData)->prefetchLock);
+}
+
+/**
+ * Adapts read-ahead window to whether a prefetched page got used before it
+ * was evicted
+ *
+ * bm = buffer pool handle
+ * used = TRUE if the prefetched page was pinned, FALSE if it was wasted
+ */
+void notePrefetchUse(BM_BufferPool * const bm, const bool used) {
+
+	int window = ATOMIC_LOAD(((BM_Data *) bm->mgmtData)->prefetchWindow);
+	int resized;
+
+	if (used) {
+		STAT_ADD(((BM_Data *) bm->mgmtData)->stats.prefetchHits, 1);
+		resized = window * 2;
+		if (resized > ((BM_Data *) bm->mgmtData)->prefetchMaxWindow) {
+			resized = ((BM_Data *) bm->mgmtData)->prefetchMaxWindow;
+		}
+	} else {
+		STAT_ADD(((BM_Data *) bm->mgmtData)->stats.prefetchWastes, 1);
+		resized = window / 2;
+		if (resized < BM_PREFETCH_MIN_WINDOW) {
+			resized = BM_PREFETCH_MIN_WINDOW;
+		}
+	}
+
+	//Concurrent updates may lose one step, the window is only a hint
+	ATOMIC_CAS(((BM_Data *) bm->mgmtData)->prefetchWindow, window, resized);
+}
+
+/**
+ * Private utility function to find the stream a pin of page pageNum of file
+ * slot fileId belongs to: the stream of that file pageNum continues at its
+ * stride, else its closest stream not yet following a stride within
+ * BM_PREFETCH_MAX_STRIDE pages of it. If there is none, the least recently
+ * pinned stream is reset for the file. Caller must hold the prefetch lock.
+ *
+ * data = pool bookkeeping
+ * fileId = file slot of the page file
+ * pageNum = page number just pinned
+ */
+PRIVATE BM_PrefetchStream *findPrefetchStream(BM_Data * const data,
+		const int fileId, const PageNumber pageNum) {
+
+	BM_PrefetchStream *closest = NULL, *oldest = NULL;
+	int i, distance = BM_PREFETCH_MAX_STRIDE + 1;
+
+	for (i = 0; i < BM_PREFETCH_STREAMS; i++) {
+		BM_PrefetchStream *stream = &data->prefetchStreams[i];
+		//Unused streams have stamp 0 and are taken first
+		if (oldest == NULL || stream->stamp < oldest->stamp) {
+			oldest = stream;
+		}
+		if (stream->stamp == 0 || stream->fileId != fileId) {
+			continue;
+		}
+		//Same page again, or next page at the stride of the stream
+		if (pageNum == stream->last
+				|| (stream->stride != 0
+						&& pageNum - stream->last == stream->stride)) {
+			return stream;
+		}
+		if (stream->run < 2 && abs(pageNum - stream->last) < distance) {
+			closest = stream;
+			distance = abs(pageNum - stream->last);
+		}
+	}
+
+	if (closest != NULL) {
+		return closest;
+	}
+
+	oldest->fileId = fileId;
+	oldest->last = NO_PAGE;
+	oldest->next = NO_PAGE;
+	oldest->stride = 0;
+	oldest->run = 0;
+
+	return oldest;
+}
+
+/**
+ * Prefetch worker. Drains the queue in batches of pages of one page file
+ * until stopped.
+ *
+ * arg = buffer pool handle
+ */
+PRIVATE void *prefetcherMain(void *arg) {
+
+	BM_BufferPool * const bm = (BM_BufferPool *) arg;
+	PageNumber batch[PREFETCH_BATCH];
+	//Pages are loaded through a view on the page file they were queued for
+	BM_BufferPool view = *bm;
+
+	pthread_mutex_lock(&((BM_Data *) bm->mgmtData)->prefetchLock);
+	for (;;) {
+		while (((BM_Data *) bm->mgmtData)->prefetchStop == FALSE
+				&& ((BM_Data *) bm->mgmtData)->prefetchHead
+						== ((BM_Data *) bm->mgmtData)->prefetchTail) {
+			pthread_cond_wait(&((BM_Data *) bm->mgmtData)->prefetchCond,
+					&((BM_Data *) bm->mgmtData)->prefetchLock);
+		}
+		if (((BM_Data *) bm->mgmtData)->prefetchStop == TRUE) {
+			break;
+		}
+
+		int n = 0;
+		view.fileId =
+				((BM_Data *) bm->mgmtData)->prefetchQueueFile[((BM_Data *) bm->mgmtData)->prefetchHead];
+		while (n < PREFETCH_BATCH
+				&& ((BM_Data *) bm->mgmtData)->prefetchHead
+						!= ((BM_Data *) bm->mgmtData)->prefetchTail
+				&& ((BM_Data *) bm->mgmtData)->prefetchQueueFile[((BM_Data *) bm->mgmtData)->prefetchHead]
+						== view.fileId) {
+			batch[n++] =
+					((BM_Data *) bm->mgmtData)->prefetchQueue[((BM_Data *) bm->mgmtData)->prefetchHead];
+			((BM_Data *) bm->mgmtData)->prefetchHead =
+					(((BM_Data *) bm->mgmtData)->prefetchHead + 1)
+							% BM_PREFETCH_QUEUE_SIZE;
+		}
+
+		//Load without holding the queue lock, pins keep feeding the queue
+		pthread_mutex_unlock(&((BM_Data *) bm->mgmtData)->prefetchLock);
+		prefetchPages(&view, batch, n);
+		pthread_mutex_lock(&((BM_Data *) bm->mgmtData)->prefetchLock);
+	}
+	pthread_mutex_unlock(&((BM_Data *) bm->mgmtData)->prefetchLock);
+
+	return NULL;
+}
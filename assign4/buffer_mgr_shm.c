@@ -0,0 +1,1359 @@
+/*
+ * buffer_mgr_shm.c
+ *
+ *  Buffer pools living in a named POSIX shared memory segment, so pools of
+ *  several processes cache their page files in a single set of frames and a
+ *  hot page is held once per host instead of once per process. Each pool
+ *  attached to the segment is a client of it. The segment holds a
+ *  BM_ShmHeader, the page table, the frame arrays, the pins of each client
+ *  on each frame and the frame arena. BM_Data of a client stays private,
+ *  with pageFrameIndexMap, fixCount, dirtyFlags and the frame arena pointing
+ *  into the segment, and every client opens the page files on its own.
+ *
+ *  Frame state is guarded by a robust, process-shared mutex in the header.
+ *  Disk I/O runs without it on frames in FRAME_READING or FRAME_WRITING,
+ *  pins of their pages poll meanwhile. A process-shared condition isn't
+ *  used, as a waiter dying inside it leaves it broken for everybody else.
+ *  Replacement is CLOCK. Page latches work as in a private pool, their
+ *  words are in the segment, and each client keeps track of the latches it
+ *  holds.
+ *
+ *  A client that dies is cleaned up by the next client that notices: when
+ *  it gets the mutex with EOWNERDEAD, finds no victim frame or waits for an
+ *  I/O too long, or waits for a page latch too long. Pins and latches of the
+ *  dead client are dropped, the page of a frame it was reading is dropped
+ *  and a frame it was writing stays dirty. If it died
+ *  holding the mutex, page table and fix counts are rebuilt from the frame
+ *  arrays and pins first.
+ */
+
+#include "buffer_mgr.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define PRIVATE static
+
+// Poll interval while waiting for an I/O of another client, and the number
+// of polls between looks for dead clients
+#define SHM_WAIT_US 100
+#define SHM_WAIT_CHECK 1000
+
+// Attach retries while the segment is being set up or torn down
+#define SHM_ATTACH_TRIES 5000
+#define SHM_ATTACH_DELAY_US 1000
+
+// Alignment of the arrays in the segment
+#define SHM_ALIGNMENT 64
+
+PRIVATE RC mapShmSegment(BM_Data * const, const int);
+PRIVATE size_t layoutShmSegment(BM_Data * const, char * const, const int,
+		const int);
+PRIVATE void *carveShmSegment(char * const, size_t * const, const size_t,
+		const size_t);
+PRIVATE void initShmSegment(BM_Data * const, const int, const int,
+		const size_t);
+PRIVATE void lockShm(BM_Data * const);
+PRIVATE void unlockShm(BM_Data * const);
+PRIVATE void waitShm(BM_Data * const);
+PRIVATE bool recoverShm(BM_Data * const, const bool);
+PRIVATE RC openShmFile(BM_Data * const, const char * const, int * const);
+PRIVATE bool releaseShmFile(BM_Data * const, const int);
+PRIVATE SM_FileHandle *getShmHandle(BM_Data * const, const int);
+PRIVATE void closeShmHandles(BM_Data * const);
+PRIVATE inline int hashShmPage(BM_Data * const, const int, const PageNumber);
+PRIVATE int findShmPage(BM_Data * const, const int, const PageNumber);
+PRIVATE int findShmHandleFrame(BM_BufferPool * const,
+		const BM_PageHandle * const);
+PRIVATE void insertShmPage(BM_Data * const, const int);
+PRIVATE void removeShmPage(BM_Data * const, const int);
+PRIVATE int chooseShmVictim(BM_Data * const);
+PRIVATE bool isShmIOPending(BM_Data * const);
+PRIVATE RC loadShmFrame(BM_BufferPool * const, const int, const PageNumber);
+PRIVATE RC writeShmFrame(BM_Data * const, const int);
+
+/**
+ * Attaches pool to the shared memory segment named by options, creating it
+ * with numPages frames if it doesn't exist yet. Otherwise numPages is
+ * ignored and the pool gets the frames of the segment. Replacement is CLOCK
+ * whatever the strategy of the pool. Pools of the same page file share its
+ * pages, page files are told apart by the name they are opened with.
+ * Background writer, prefetch, warm-up, tracing, custom policies, the
+ * compressed tier, huge pages and resizing aren't supported.
+ *
+ * bm = buffer pool handle
+ * pageFileName = name of the underlying page file for which this pool is being created
+ * numPages = no of pages the segment holds if this pool creates it
+ * options = pool configuration
+ */
+RC attachShmPool(BM_BufferPool * const bm, const char * const pageFileName,
+		const int numPages, const BM_PoolOptions * const options) {
+
+	RC ret;
+	int i, file;
+
+	//Sanity checks
+	if (strlen(pageFileName) >= BM_SHM_NAME_SIZE) {
+		THROW(RC_INVALID_PAGE_FILE_NAME, "Page file name is too long");
+	}
+	if (options->useHugePages || options->backgroundWriter
+			|| options->prefetch || options->warmup
+			|| options->traceFile != NULL || options->policy != NULL
+			|| options->tierBytes != 0 || options->maxPages > numPages) {
+		THROW(RC_INVALID_OP, "Option not supported by shared memory pools");
+	}
+
+	BM_Data *data = (BM_Data *) calloc(1, sizeof(BM_Data));
+	BM_Shm *shm = (BM_Shm *) calloc(1, sizeof(BM_Shm));
+	char *name = strdup(options->shmName);
+	char *pageFile = strdup(pageFileName);
+	if (data == NULL || shm == NULL || name == NULL || pageFile == NULL) {
+		free(data);
+		free(shm);
+		free(name);
+		free(pageFile);
+		THROW(RC_NOT_ENOUGH_MEMORY,
+				"Not enough memory available for resource allocation");
+	}
+	shm->name = name;
+	data->shm = shm;
+
+	//Segment comes back latched
+	ret = mapShmSegment(data, numPages);
+	if (ret != RC_OK) {
+		free(data);
+		free(shm);
+		free(name);
+		free(pageFile);
+		return ret;
+	}
+	const size_t size = shm->header->size;
+
+	//Slots of dead clients are taken back first. Our slot is taken before
+	//the page file is opened, which may release the latch.
+	recoverShm(data, FALSE);
+	shm->client = -1;
+	for (i = 0; i < BM_SHM_MAX_CLIENTS && shm->client == -1; i++) {
+		if (shm->header->clients[i].pid == 0) {
+			shm->client = i;
+		}
+	}
+	if (shm->client == -1) {
+		ret = RC_SHM_FAILED;
+		RC_message = "Too many clients attached to shared memory pool";
+	} else {
+		shm->header->clients[shm->client].pid = getpid();
+		shm->header->clients[shm->client].file = -1;
+		shm->header->numClients++;
+		ret = openShmFile(data, pageFileName, &file);
+		if (ret != RC_OK) {
+			shm->header->clients[shm->client].pid = 0;
+			shm->header->numClients--;
+		}
+	}
+	if (ret != RC_OK) {
+		if (shm->header->numClients == 0) {
+			//Nobody else is attached, tear the segment down
+			for (i = 0; i < BM_SHM_MAX_FILES; i++) {
+				releaseShmFile(data, i);
+			}
+			ATOMIC_STORE(shm->header->magic, BM_SHM_DEAD);
+			shm_unlink(shm->name);
+		}
+		closeShmHandles(data);
+		unlockShm(data);
+		munmap(shm->header, size);
+		free(data);
+		free(shm);
+		free(name);
+		free(pageFile);
+		return ret;
+	}
+	shm->header->clients[shm->client].file = file;
+
+	//Private part of the pool, frame arrays are those of the segment
+	data->maxFrames = shm->header->numFrames;
+	data->numFrames = shm->header->numFrames;
+	data->numFramesUsed = shm->header->numFrames;
+	bm->numPages = shm->header->numFrames;
+	bm->strategy = RS_CLOCK;
+	bm->pageFile = pageFile;
+	bm->fileId = file;
+	bm->mgmtData = data;
+
+	unlockShm(data);
+
+	//All OK
+	return RC_OK;
+}
+
+/**
+ * Detaches pool from its shared memory segment, once pages of its page file
+ * are written back. Its pages leave the segment once no other client is
+ * open on the page file, and the segment is removed along with its last
+ * client.
+ *
+ * bm = buffer pool handle
+ */
+RC detachShmPool(BM_BufferPool * const bm) {
+
+	BM_Data *data = (BM_Data *) bm->mgmtData;
+	BM_Shm *shm = data->shm;
+	const size_t size = shm->header->size;
+	int i;
+
+	//Don't allow shutdown if there are pinned pages
+	if (ATOMIC_LOAD(data->numPinnedPages) != 0) {
+		THROW(RC_SHUTDOWN_FAIL,
+				"There are some pages pinned in memory, cannot shutdown now");
+	}
+
+	//Write back pages of the page file, so it's complete on disk once its
+	//last client is gone
+	flushShmPool(bm);
+
+	lockShm(data);
+
+	//Dead clients mustn't keep the segment alive
+	recoverShm(data, FALSE);
+	shm->header->clients[shm->client].pid = 0;
+	shm->header->numClients--;
+	shm->header->files[bm->fileId].refCount--;
+	releaseShmFile(data, bm->fileId);
+
+	if (shm->header->numClients == 0) {
+		//Write back pages dead clients left behind, nobody will after us
+		for (i = 0; i < BM_SHM_MAX_FILES; i++) {
+			releaseShmFile(data, i);
+		}
+		ATOMIC_STORE(shm->header->magic, BM_SHM_DEAD);
+		shm_unlink(shm->name);
+	}
+	closeShmHandles(data);
+
+	unlockShm(data);
+	munmap(shm->header, size);
+
+	free(shm->name);
+	free(shm);
+	free(data);
+	bm->mgmtData = NULL;
+	free(bm->pageFile);
+	bm->pageFile = NULL;
+
+	return RC_OK;
+}
+
+/**
+ * Writes all dirty pages of the pool's page file with fix count of 0 to
+ * disk, whichever client dirtied them.
+ *
+ * bm = buffer pool handle
+ */
+RC flushShmPool(BM_BufferPool * const bm) {
+
+	BM_Data *data = (BM_Data *) bm->mgmtData;
+	RC ret = RC_OK;
+	int i;
+
+	lockShm(data);
+
+	for (i = 0; i < data->shm->header->numFrames; i++) {
+		if (data->frameFile[i] == bm->fileId
+				&& data->pageFrameIndexMap[i] != NO_PAGE
+				&& data->dirtyFlags[i] == TRUE && data->fixCount[i] == 0
+				&& data->frameState[i] == FRAME_READY) {
+			//Latch is released during the write
+			if (writeShmFrame(data, i) != RC_OK) {
+				ret = RC_WRITE_FAILED;
+			}
+		}
+	}
+
+	unlockShm(data);
+
+	return ret;
+}
+
+/**
+ * Pins page pageNum of the pool's page file, reading it into a victim frame
+ * chosen by CLOCK if no client has it in the segment yet. Pages beyond end
+ * of page file are appended to it right away.
+ *
+ * bm = buffer pool handle
+ * page = page handle to hold data and corresponding page number
+ * pageNum = index of the page to be pinned
+ */
+RC pinShmPage(BM_BufferPool * const bm, BM_PageHandle * const page,
+		const PageNumber pageNum) {
+
+	BM_Data *data = (BM_Data *) bm->mgmtData;
+	BM_Shm *shm = data->shm;
+	uint64_t start = 0;
+	int index;
+	RC ret;
+
+	lockShm(data);
+
+	while (TRUE) {
+		index = findShmPage(data, bm->fileId, pageNum);
+		if (index != -1 && data->frameState[index] == FRAME_READY) {
+			//Page Hit
+			STAT_ADD(data->stats.hits, 1);
+			break;
+		}
+		if (index != -1) {
+			//Page is being read or written back
+			if (start == 0) {
+				start = statClock();
+			}
+			waitShm(data);
+			continue;
+		}
+
+		index = chooseShmVictim(data);
+		if (index == -1) {
+			//Frames may be held by dead clients or come free after an I/O
+			if (recoverShm(data, FALSE)) {
+				continue;
+			}
+			if (!isShmIOPending(data)) {
+				unlockShm(data);
+				THROW(RC_ALL_FRAMES_OCCUPIED,
+						"All frames are occupied by pinned pages");
+			}
+			if (start == 0) {
+				start = statClock();
+			}
+			waitShm(data);
+			continue;
+		}
+
+		if (data->dirtyFlags[index] == TRUE) {
+			//Victim is written back first, meanwhile its page may be pinned
+			//again or another page loaded, so look again afterwards
+			ret = writeShmFrame(data, index);
+			if (ret != RC_OK) {
+				unlockShm(data);
+				return ret;
+			}
+			STAT_ADD(data->stats.dirtyEvictions, 1);
+			continue;
+		}
+
+		ret = loadShmFrame(bm, index, pageNum);
+		if (ret != RC_OK) {
+			unlockShm(data);
+			return ret;
+		}
+		break;
+	}
+
+	//Pins are counted per client, so those of a dead one can be dropped
+	shm->pins[shm->client * shm->header->numFrames + index]++;
+	ATOMIC_INC(data->fixCount[index]);
+	shm->referenced[index] = 1;
+
+	unlockShm(data);
+
+	if (start != 0) {
+		notePinWait(data, start);
+	}
+	STAT_ADD(data->stats.pinRequests, 1);
+	ATOMIC_INC(data->numPinnedPages);
+	page->pageNum = pageNum;
+	page->data = data->frameArena + (size_t) index * PAGE_SIZE;
+	page->frame = index;
+
+	//All OK
+	return RC_OK;
+}
+
+/**
+ * Pins n pages one after the other. Either all pages get pinned or none.
+ *
+ * bm = buffer pool handle
+ * pageNums = page numbers of the pages to be pinned
+ * n = no of pages to be pinned
+ * pages = page handles, one per page, to hold data and page number
+ */
+RC pinShmPages(BM_BufferPool * const bm, const PageNumber * const pageNums,
+		const int n, BM_PageHandle * const pages) {
+
+	int i;
+
+	for (i = 0; i < n; i++) {
+		RC ret = pinShmPage(bm, &pages[i], pageNums[i]);
+		if (ret != RC_OK) {
+			while (--i >= 0) {
+				unpinShmPage(bm, &pages[i]);
+			}
+			return ret;
+		}
+	}
+
+	//All OK
+	return RC_OK;
+}
+
+/**
+ * Drops a pin the pool holds on page. Pins of other clients can't be
+ * dropped.
+ *
+ * bm = buffer pool handle
+ * page = page handle of the pinned page
+ */
+RC unpinShmPage(BM_BufferPool * const bm, BM_PageHandle * const page) {
+
+	BM_Data *data = (BM_Data *) bm->mgmtData;
+	BM_Shm *shm = data->shm;
+
+	lockShm(data);
+
+	int index = findShmHandleFrame(bm, page);
+	if (index == -1) {
+		unlockShm(data);
+		THROW(RC_PAGE_NOT_EXIST, "Requested page doesn't exist in buffer pool");
+	}
+
+	int *pins = &shm->pins[shm->client * shm->header->numFrames + index];
+	if (*pins == 0) {
+		unlockShm(data);
+		THROW(RC_PAGE_NOT_PINNED, "Requested page has not been pinned");
+	}
+	(*pins)--;
+	ATOMIC_DEC(data->fixCount[index]);
+
+	unlockShm(data);
+
+	//Decrement pin count
+	ATOMIC_DEC(data->numPinnedPages);
+
+	//All OK
+	return RC_OK;
+}
+
+/**
+ * Writes page to disk irrespective of whether it's dirty or not.
+ *
+ * bm = buffer pool handle
+ * page = page handle to hold data and corresponding page number
+ */
+RC forceShmPage(BM_BufferPool * const bm, BM_PageHandle * const page) {
+
+	BM_Data *data = (BM_Data *) bm->mgmtData;
+	int index;
+	RC ret;
+
+	lockShm(data);
+
+	while ((index = findShmHandleFrame(bm, page)) != -1
+			&& data->frameState[index] != FRAME_READY) {
+		//Page is being read or written back
+		waitShm(data);
+	}
+	if (index == -1) {
+		unlockShm(data);
+		THROW(RC_PAGE_NOT_EXIST, "Requested page doesn't exist in buffer pool");
+	}
+
+	ret = writeShmFrame(data, index);
+
+	unlockShm(data);
+
+	return ret;
+}
+
+/**
+ * Finds frame of page pageNum of the pool's page file in the segment.
+ * Returns -1 if the page isn't there.
+ *
+ * bm = buffer pool handle
+ * pageNum = page number to be looked up
+ */
+int findShmFrame(BM_BufferPool * const bm, const PageNumber pageNum) {
+
+	BM_Data *data = (BM_Data *) bm->mgmtData;
+
+	lockShm(data);
+	int index = findShmPage(data, bm->fileId, pageNum);
+	unlockShm(data);
+
+	return index;
+}
+
+/**
+ * Keeps track of the latches the pool holds on frame, so those of a dead
+ * client can be released. The latch words of each client and frame mirror
+ * its share of the latch word of the frame. Called by page latch functions
+ * right after they changed the latch word.
+ *
+ * data = buffer pool management data
+ * frame = index of the page frame
+ * mode = latch taken, BM_LATCH_NONE for a latch released and
+ *		BM_SHM_LATCH_UPGRADING for an upgrade begun
+ */
+void noteShmLatch(BM_Data * const data, const int frame, const int mode) {
+
+	int *held = &data->shm->latches[data->shm->client
+			* data->shm->header->numFrames + frame];
+	int value = ATOMIC_LOAD(*held), next;
+
+	do {
+		if (mode == BM_LATCH_SHARED) {
+			next = value + 1;
+		} else if (mode == BM_SHM_LATCH_UPGRADING) {
+			next = value | BM_LATCH_UPGRADING;
+		} else if (mode == BM_LATCH_EXCLUSIVE) {
+			//Upgrade turns our shared latch exclusive
+			next = (value & BM_LATCH_UPGRADING) != 0 ?
+					((value & ~BM_LATCH_UPGRADING) - 1)
+							| BM_LATCH_EXCLUSIVE_BIT :
+					value | BM_LATCH_EXCLUSIVE_BIT;
+		} else {
+			//An exclusive latch excludes shared holders
+			next = (value & BM_LATCH_EXCLUSIVE_BIT) != 0 ?
+					value & ~BM_LATCH_EXCLUSIVE_BIT : value - 1;
+		}
+	} while (!ATOMIC_CAS(*held, value, next));
+}
+
+/**
+ * Cleans up after dead clients of the pool's segment, for waiters on page
+ * latches their holder may never release.
+ *
+ * data = buffer pool management data
+ */
+void recoverShmClients(BM_Data * const data) {
+	lockShm(data);
+	recoverShm(data, FALSE);
+	unlockShm(data);
+}
+
+/**
+ * Private utility function to open the segment, or create and set it up
+ * with numPages frames if it doesn't exist. Returns with the segment
+ * latched. A segment being torn down by its last client is waited out.
+ *
+ * data = buffer pool management data
+ * numPages = no of frames of a segment created
+ */
+PRIVATE RC mapShmSegment(BM_Data * const data, const int numPages) {
+
+	BM_Shm *shm = data->shm;
+	struct stat st;
+	int tries, fd, numBuckets;
+	size_t size;
+	char *base;
+
+	for (tries = 0; tries < SHM_ATTACH_TRIES; tries++) {
+		if (tries > 0) {
+			usleep(SHM_ATTACH_DELAY_US);
+		}
+
+		fd = shm_open(shm->name, O_RDWR | O_CREAT | O_EXCL, 0600);
+		if (fd != -1) {
+			//First client sets the segment up
+			if (numPages <= 0) {
+				close(fd);
+				shm_unlink(shm->name);
+				THROW(RC_INVALID_PAGE_NUM, "Invalid numPages");
+			}
+			for (numBuckets = 16; numBuckets < numPages; numBuckets <<= 1)
+				;
+			size = layoutShmSegment(data, NULL, numPages, numBuckets);
+			base = ftruncate(fd, size) == -1 ? MAP_FAILED :
+					mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd,
+							0);
+			close(fd);
+			if (base == MAP_FAILED) {
+				shm_unlink(shm->name);
+				THROW(RC_SHM_FAILED, "Unable to create shared memory segment");
+			}
+			layoutShmSegment(data, base, numPages, numBuckets);
+			initShmSegment(data, numPages, numBuckets, size);
+		} else if (errno == EEXIST) {
+			fd = shm_open(shm->name, O_RDWR, 0);
+			if (fd == -1) {
+				//Removed by its last client meanwhile
+				continue;
+			}
+
+			//Header tells the size, once the first client has set it up
+			BM_ShmHeader *header = NULL;
+			if (fstat(fd, &st) == 0
+					&& st.st_size >= (off_t) sizeof(BM_ShmHeader)) {
+				header = (BM_ShmHeader *) mmap(NULL, sizeof(BM_ShmHeader),
+						PROT_READ, MAP_SHARED, fd, 0);
+			}
+			if (header == NULL || header == MAP_FAILED) {
+				close(fd);
+				continue;
+			}
+			uint32_t magic = ATOMIC_LOAD(header->magic);
+			size = header->size;
+			const int numFrames = header->numFrames;
+			numBuckets = header->numBuckets;
+			munmap(header, sizeof(BM_ShmHeader));
+			if (magic != BM_SHM_MAGIC) {
+				close(fd);
+				continue;
+			}
+
+			base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+			close(fd);
+			if (base == MAP_FAILED) {
+				THROW(RC_SHM_FAILED, "Unable to map shared memory segment");
+			}
+			layoutShmSegment(data, base, numFrames, numBuckets);
+		} else {
+			THROW(RC_SHM_FAILED, "Unable to open shared memory segment");
+		}
+
+		//Last client may have torn the segment down before we latched it
+		lockShm(data);
+		if (shm->header->magic == BM_SHM_MAGIC) {
+			return RC_OK;
+		}
+		unlockShm(data);
+		munmap(base, size);
+	}
+
+	THROW(RC_SHM_FAILED, "Timed out attaching to shared memory segment");
+}
+
+/**
+ * Private utility function to point the segment arrays of the pool into the
+ * segment mapped at base. Returns size of the segment, with base NULL only
+ * the size is computed.
+ *
+ * data = buffer pool management data
+ * base = start of the mapped segment, NULL for none
+ * numFrames = no of frames of the segment
+ * numBuckets = no of page table buckets of the segment
+ */
+PRIVATE size_t layoutShmSegment(BM_Data * const data, char * const base,
+		const int numFrames, const int numBuckets) {
+
+	BM_Shm *shm = data->shm;
+	size_t offset = 0;
+
+	shm->header = (BM_ShmHeader *) carveShmSegment(base, &offset,
+			sizeof(BM_ShmHeader), SHM_ALIGNMENT);
+	shm->buckets = (int *) carveShmSegment(base, &offset,
+			numBuckets * sizeof(int), SHM_ALIGNMENT);
+	shm->hashNext = (int *) carveShmSegment(base, &offset,
+			numFrames * sizeof(int), SHM_ALIGNMENT);
+	shm->ioOwner = (int *) carveShmSegment(base, &offset,
+			numFrames * sizeof(int), SHM_ALIGNMENT);
+	shm->referenced = (int *) carveShmSegment(base, &offset,
+			numFrames * sizeof(int), SHM_ALIGNMENT);
+	shm->pins = (int *) carveShmSegment(base, &offset,
+			(size_t) BM_SHM_MAX_CLIENTS * numFrames * sizeof(int),
+			SHM_ALIGNMENT);
+	shm->latches = (int *) carveShmSegment(base, &offset,
+			(size_t) BM_SHM_MAX_CLIENTS * numFrames * sizeof(int),
+			SHM_ALIGNMENT);
+	data->pageFrameIndexMap = (PageNumber *) carveShmSegment(base, &offset,
+			numFrames * sizeof(PageNumber), SHM_ALIGNMENT);
+	data->frameFile = (int *) carveShmSegment(base, &offset,
+			numFrames * sizeof(int), SHM_ALIGNMENT);
+	data->fixCount = (int *) carveShmSegment(base, &offset,
+			numFrames * sizeof(int), SHM_ALIGNMENT);
+	data->dirtyFlags = (bool *) carveShmSegment(base, &offset,
+			numFrames * sizeof(bool), SHM_ALIGNMENT);
+	data->frameState = (int *) carveShmSegment(base, &offset,
+			numFrames * sizeof(int), SHM_ALIGNMENT);
+	data->pageLatch = (int *) carveShmSegment(base, &offset,
+			numFrames * sizeof(int), SHM_ALIGNMENT);
+	data->frameArena = (char *) carveShmSegment(base, &offset,
+			(size_t) numFrames * PAGE_SIZE, BM_FRAME_ALIGNMENT);
+	data->arenaSize = (size_t) numFrames * PAGE_SIZE;
+
+	return offset;
+}
+
+/**
+ * Private utility function to take size bytes at offset, aligned to
+ * alignment, and advance offset past them. Returns NULL if base is NULL.
+ *
+ * base = start of the mapped segment, NULL for none
+ * offset = offset of the first free byte of the segment
+ * size = no of bytes taken
+ * alignment = alignment of the bytes taken, a power of 2
+ */
+PRIVATE void *carveShmSegment(char * const base, size_t * const offset,
+		const size_t size, const size_t alignment) {
+
+	const size_t start = (*offset + alignment - 1) & ~(alignment - 1);
+
+	*offset = start + size;
+	return base != NULL ? base + start : NULL;
+}
+
+/**
+ * Private utility function to set up a segment just created and mapped:
+ * all frames empty, latch shared between processes. Clients attaching
+ * meanwhile wait for the magic, which is set last.
+ *
+ * data = buffer pool management data
+ * numFrames = no of frames of the segment
+ * numBuckets = no of page table buckets of the segment
+ * size = size of the segment
+ */
+PRIVATE void initShmSegment(BM_Data * const data, const int numFrames,
+		const int numBuckets, const size_t size) {
+
+	BM_ShmHeader *header = data->shm->header;
+	pthread_mutexattr_t lockAttr;
+	int i;
+
+	header->numFrames = numFrames;
+	header->numBuckets = numBuckets;
+	header->size = size;
+	header->numClients = 0;
+	header->clockHand = 0;
+	for (i = 0; i < BM_SHM_MAX_CLIENTS; i++) {
+		header->clients[i].pid = 0;
+		header->clients[i].file = -1;
+	}
+	for (i = 0; i < BM_SHM_MAX_FILES; i++) {
+		header->files[i].name[0] = '\0';
+		header->files[i].refCount = 0;
+		header->files[i].totalNumPages = 0;
+		header->files[i].generation = 0;
+	}
+
+	for (i = 0; i < numBuckets; i++) {
+		data->shm->buckets[i] = -1;
+	}
+	for (i = 0; i < numFrames; i++) {
+		data->shm->hashNext[i] = -1;
+		data->shm->ioOwner[i] = -1;
+		data->shm->referenced[i] = 0;
+		data->pageFrameIndexMap[i] = NO_PAGE;
+		data->frameFile[i] = -1;
+		data->fixCount[i] = 0;
+		data->dirtyFlags[i] = FALSE;
+		data->frameState[i] = FRAME_READY;
+		data->pageLatch[i] = 0;
+	}
+	memset(data->shm->pins, 0,
+			(size_t) BM_SHM_MAX_CLIENTS * numFrames * sizeof(int));
+	memset(data->shm->latches, 0,
+			(size_t) BM_SHM_MAX_CLIENTS * numFrames * sizeof(int));
+
+	//Latch survives its holder dying, the next one to take it is told
+	pthread_mutexattr_init(&lockAttr);
+	pthread_mutexattr_setpshared(&lockAttr, PTHREAD_PROCESS_SHARED);
+	pthread_mutexattr_setrobust(&lockAttr, PTHREAD_MUTEX_ROBUST);
+	pthread_mutex_init(&header->lock, &lockAttr);
+	pthread_mutexattr_destroy(&lockAttr);
+
+	ATOMIC_STORE(header->magic, BM_SHM_MAGIC);
+}
+
+/**
+ * Private utility function to latch the segment. If the previous holder
+ * died with the latch, the state it left is repaired first.
+ *
+ * data = buffer pool management data
+ */
+PRIVATE void lockShm(BM_Data * const data) {
+	if (pthread_mutex_lock(&data->shm->header->lock) == EOWNERDEAD) {
+		recoverShm(data, TRUE);
+		pthread_mutex_consistent(&data->shm->header->lock);
+	}
+}
+
+/**
+ * Private utility function to release latch of the segment.
+ *
+ * data = buffer pool management data
+ */
+PRIVATE void unlockShm(BM_Data * const data) {
+	pthread_mutex_unlock(&data->shm->header->lock);
+}
+
+/**
+ * Private utility function to wait for a frame to leave I/O, with the
+ * segment latched. A client dying in I/O never finishes it, so every so
+ * often the waiter looks for dead clients itself.
+ *
+ * data = buffer pool management data
+ */
+PRIVATE void waitShm(BM_Data * const data) {
+	unlockShm(data);
+	usleep(SHM_WAIT_US);
+	lockShm(data);
+
+	if (++data->shm->waits % SHM_WAIT_CHECK == 0) {
+		recoverShm(data, FALSE);
+	}
+}
+
+/**
+ * Private utility function to clean up after clients that died. Their pins
+ * are dropped, frames they were reading are emptied and frames they were
+ * writing stay dirty. With rebuild, page table and fix counts are rebuilt
+ * from the frame arrays and pins first, as a client dying with the latch
+ * may have left them half updated. Returns TRUE if a dead client was found.
+ * Caller must hold the segment latch.
+ *
+ * data = buffer pool management data
+ * rebuild = rebuild page table and fix counts
+ */
+PRIVATE bool recoverShm(BM_Data * const data, const bool rebuild) {
+
+	BM_Shm *shm = data->shm;
+	BM_ShmHeader *header = shm->header;
+	const int numFrames = header->numFrames;
+	bool found = FALSE;
+	int c, i;
+
+	if (rebuild) {
+		for (i = 0; i < header->numBuckets; i++) {
+			shm->buckets[i] = -1;
+		}
+		for (i = 0; i < numFrames; i++) {
+			int fix = 0;
+			for (c = 0; c < BM_SHM_MAX_CLIENTS; c++) {
+				fix += shm->pins[c * numFrames + i];
+			}
+			ATOMIC_STORE(data->fixCount[i], fix);
+			if (data->pageFrameIndexMap[i] != NO_PAGE) {
+				insertShmPage(data, i);
+			}
+		}
+	}
+
+	for (c = 0; c < BM_SHM_MAX_CLIENTS; c++) {
+		if (header->clients[c].pid == 0 || kill(header->clients[c].pid, 0) == 0
+				|| errno != ESRCH) {
+			continue;
+		}
+
+		for (i = 0; i < numFrames; i++) {
+			int *pins = &shm->pins[c * numFrames + i];
+			int *latches = &shm->latches[c * numFrames + i];
+			if (*pins > 0) {
+				__atomic_sub_fetch(&data->fixCount[i], *pins,
+						__ATOMIC_ACQ_REL);
+				//Its latches go, and so does its announcement of a waiting
+				//writer: writers still waiting announce themselves again
+				const int held = *latches & ~BM_LATCH_SHARED_MASK;
+				__atomic_and_fetch(&data->pageLatch[i],
+						~(held | BM_LATCH_WAITING), __ATOMIC_ACQ_REL);
+				__atomic_sub_fetch(&data->pageLatch[i],
+						*latches & BM_LATCH_SHARED_MASK, __ATOMIC_ACQ_REL);
+			}
+			*pins = 0;
+			*latches = 0;
+
+			if (data->frameState[i] != FRAME_READY
+					&& shm->ioOwner[i] == c) {
+				if (data->frameState[i] == FRAME_READING) {
+					//Page was only partly read
+					removeShmPage(data, i);
+				} else {
+					//Page may be partly written
+					ATOMIC_STORE(data->dirtyFlags[i], TRUE);
+				}
+				data->frameState[i] = FRAME_READY;
+				shm->ioOwner[i] = -1;
+			}
+		}
+
+		//Page file slot is taken back once nobody is open on it
+		if (header->clients[c].file != -1) {
+			header->files[header->clients[c].file].refCount--;
+		}
+		header->clients[c].pid = 0;
+		header->numClients--;
+		found = TRUE;
+	}
+
+	return found;
+}
+
+/**
+ * Private utility function to open page file name for the pool. The slot
+ * of the page file is shared if another client is open on it, otherwise
+ * a free slot is taken and the page file opened to learn its page count.
+ * Slots nobody is open on anymore, left behind by dead clients, are taken
+ * back. Caller must hold the segment latch.
+ *
+ * data = buffer pool management data
+ * name = name of the page file
+ * file = set to the slot of the page file
+ */
+PRIVATE RC openShmFile(BM_Data * const data, const char * const name,
+		int * const file) {
+
+	BM_Shm *shm = data->shm;
+	BM_ShmFile *files = shm->header->files;
+	int i, same, empty, orphan;
+	RC ret;
+
+	//Releasing a slot may wait, so look again after each release
+	while (TRUE) {
+		same = -1;
+		empty = -1;
+		orphan = -1;
+		for (i = 0; i < BM_SHM_MAX_FILES; i++) {
+			if (files[i].name[0] == '\0') {
+				if (empty == -1) {
+					empty = i;
+				}
+			} else if (strcmp(files[i].name, name) == 0) {
+				same = i;
+			} else if (files[i].refCount == 0 && orphan == -1) {
+				orphan = i;
+			}
+		}
+
+		if (same != -1 && files[same].refCount > 0) {
+			//Page file already open in segment
+			if (getShmHandle(data, same) == NULL) {
+				THROW(RC_FILE_NOT_FOUND, "Error opening file");
+			}
+			files[same].refCount++;
+			*file = same;
+			return RC_OK;
+		}
+		if (same != -1) {
+			//Page file may have changed since its last client has gone
+			releaseShmFile(data, same);
+			continue;
+		}
+		if (empty == -1 && orphan != -1) {
+			releaseShmFile(data, orphan);
+			continue;
+		}
+		break;
+	}
+
+	if (empty == -1) {
+		THROW(RC_SHM_FAILED, "Too many page files open in shared memory pool");
+	}
+
+	//Handle left open on a former page file of the slot
+	if (shm->handles[empty].mgmtInfo != NULL) {
+		fclose((FILE *) shm->handles[empty].mgmtInfo);
+	}
+	strcpy(files[empty].name, name);
+	ret = openPageFile(files[empty].name, &shm->handles[empty]);
+	if (ret != RC_OK) {
+		shm->handles[empty].mgmtInfo = NULL;
+		files[empty].name[0] = '\0';
+		return ret;
+	}
+	shm->generations[empty] = files[empty].generation;
+	files[empty].totalNumPages = shm->handles[empty].totalNumPages;
+	files[empty].refCount = 1;
+	*file = empty;
+
+	//All OK
+	return RC_OK;
+}
+
+/**
+ * Private utility function to free slot file if nobody is open on its page
+ * file anymore. Waits for write backs of its pages by other clients, then
+ * writes back the dirty ones left, drops all of them and saves the page
+ * count. Returns TRUE if the slot was freed. Caller must hold the segment
+ * latch, which may be released meanwhile.
+ *
+ * data = buffer pool management data
+ * file = slot of the page file
+ */
+PRIVATE bool releaseShmFile(BM_Data * const data, const int file) {
+
+	BM_Shm *shm = data->shm;
+	BM_ShmFile *slot = &shm->header->files[file];
+	SM_FileHandle *fh;
+	int i;
+
+	while (TRUE) {
+		if (slot->name[0] == '\0' || slot->refCount > 0) {
+			return FALSE;
+		}
+		for (i = 0; i < shm->header->numFrames; i++) {
+			if (data->frameFile[i] == file
+					&& data->frameState[i] != FRAME_READY) {
+				break;
+			}
+		}
+		if (i == shm->header->numFrames) {
+			break;
+		}
+		waitShm(data);
+	}
+
+	//Nobody else uses pages of the file, so they're written under the latch
+	fh = getShmHandle(data, file);
+	for (i = 0; i < shm->header->numFrames; i++) {
+		if (data->frameFile[i] != file) {
+			continue;
+		}
+		if (data->dirtyFlags[i] == TRUE && fh != NULL) {
+			uint64_t start = statClock();
+			if (writeBlock(data->pageFrameIndexMap[i], fh,
+					data->frameArena + (size_t) i * PAGE_SIZE) == RC_OK) {
+				STAT_ADD(data->stats.writes, 1);
+			}
+			noteIOLatency(data, TRUE, start);
+		}
+		removeShmPage(data, i);
+		STAT_ADD(data->stats.evictions[BM_EVICT_CLOSE], 1);
+	}
+
+	//Page count is saved with the page file before the slot forgets it
+	if (fh != NULL) {
+		closePageFile(fh);
+		fh->mgmtInfo = NULL;
+	}
+	slot->name[0] = '\0';
+	slot->generation++;
+
+	return TRUE;
+}
+
+/**
+ * Private utility function to get the pool's handle of the page file in
+ * slot file, opening it if needed. Page count of the handle is brought up
+ * to that of the slot. Returns NULL if the page file can't be opened.
+ * Caller must hold the segment latch.
+ *
+ * data = buffer pool management data
+ * file = slot of the page file
+ */
+PRIVATE SM_FileHandle *getShmHandle(BM_Data * const data, const int file) {
+
+	BM_Shm *shm = data->shm;
+	BM_ShmFile *slot = &shm->header->files[file];
+	SM_FileHandle *fh = &shm->handles[file];
+
+	//Slot was freed since, page count got saved by the client freeing it
+	if (fh->mgmtInfo != NULL && shm->generations[file] != slot->generation) {
+		fclose((FILE *) fh->mgmtInfo);
+		fh->mgmtInfo = NULL;
+	}
+
+	if (fh->mgmtInfo == NULL) {
+		if (openPageFile(slot->name, fh) != RC_OK) {
+			fh->mgmtInfo = NULL;
+			return NULL;
+		}
+		shm->generations[file] = slot->generation;
+	}
+
+	//Page count only grows
+	fh->totalNumPages = slot->totalNumPages;
+
+	return fh;
+}
+
+/**
+ * Private utility function to close all page file handles of the pool,
+ * saving the current page count with each page file still in its slot.
+ * Caller must hold the segment latch.
+ *
+ * data = buffer pool management data
+ */
+PRIVATE void closeShmHandles(BM_Data * const data) {
+
+	BM_Shm *shm = data->shm;
+	int i;
+
+	for (i = 0; i < BM_SHM_MAX_FILES; i++) {
+		SM_FileHandle *fh = &shm->handles[i];
+		if (fh->mgmtInfo == NULL) {
+			continue;
+		}
+		if (shm->generations[i] == shm->header->files[i].generation
+				&& shm->header->files[i].name[0] != '\0') {
+			fh->totalNumPages = shm->header->files[i].totalNumPages;
+			closePageFile(fh);
+		} else {
+			fclose((FILE *) fh->mgmtInfo);
+		}
+		fh->mgmtInfo = NULL;
+	}
+}
+
+/**
+ * Private utility function to hash a page to its page table bucket.
+ *
+ * data = buffer pool management data
+ * file = slot of the page file
+ * pageNum = page number
+ */
+PRIVATE inline int hashShmPage(BM_Data * const data, const int file,
+		const PageNumber pageNum) {
+
+	uint64_t key = ((uint64_t) file << 32) | (uint32_t) pageNum;
+	return ((key * 0x9e3779b97f4a7c15ULL) >> 32)
+			& (data->shm->header->numBuckets - 1);
+}
+
+/**
+ * Private utility function to find frame of page pageNum of slot file.
+ * Returns -1 if the page isn't in the segment. Caller must hold the segment
+ * latch.
+ *
+ * data = buffer pool management data
+ * file = slot of the page file
+ * pageNum = page number to be looked up
+ */
+PRIVATE int findShmPage(BM_Data * const data, const int file,
+		const PageNumber pageNum) {
+
+	int index = data->shm->buckets[hashShmPage(data, file, pageNum)];
+
+	while (index != -1
+			&& (data->pageFrameIndexMap[index] != pageNum
+					|| data->frameFile[index] != file)) {
+		index = data->shm->hashNext[index];
+	}
+
+	return index;
+}
+
+/**
+ * Private utility function to find frame of the page of handle page, using
+ * the frame reference of the handle if it still holds the page. Caller must
+ * hold the segment latch.
+ *
+ * bm = buffer pool handle
+ * page = page handle
+ */
+PRIVATE int findShmHandleFrame(BM_BufferPool * const bm,
+		const BM_PageHandle * const page) {
+
+	BM_Data *data = (BM_Data *) bm->mgmtData;
+	const int frame = page->frame;
+
+	if (page->pageNum >= 0 && frame >= 0 && frame < data->maxFrames
+			&& data->pageFrameIndexMap[frame] == page->pageNum
+			&& data->frameFile[frame] == bm->fileId) {
+		return frame;
+	}
+
+	return findShmPage(data, bm->fileId, page->pageNum);
+}
+
+/**
+ * Private utility function to add the page of frame to page table.
+ * Caller must hold the segment latch.
+ *
+ * data = buffer pool management data
+ * frame = index of the page frame
+ */
+PRIVATE void insertShmPage(BM_Data * const data, const int frame) {
+
+	const int bucket = hashShmPage(data, data->frameFile[frame],
+			data->pageFrameIndexMap[frame]);
+
+	data->shm->hashNext[frame] = data->shm->buckets[bucket];
+	data->shm->buckets[bucket] = frame;
+}
+
+/**
+ * Private utility function to drop the page of frame from page table and
+ * leave the frame empty. Caller must hold the segment latch.
+ *
+ * data = buffer pool management data
+ * frame = index of the page frame
+ */
+PRIVATE void removeShmPage(BM_Data * const data, const int frame) {
+
+	int *link = &data->shm->buckets[hashShmPage(data, data->frameFile[frame],
+			data->pageFrameIndexMap[frame])];
+
+	while (*link != -1 && *link != frame) {
+		link = &data->shm->hashNext[*link];
+	}
+	if (*link == frame) {
+		*link = data->shm->hashNext[frame];
+	}
+	data->shm->hashNext[frame] = -1;
+	data->shm->referenced[frame] = 0;
+	ATOMIC_STORE(data->pageFrameIndexMap[frame], NO_PAGE);
+	ATOMIC_STORE(data->frameFile[frame], -1);
+	ATOMIC_STORE(data->dirtyFlags[frame], FALSE);
+}
+
+/**
+ * Private utility function to choose a victim frame with CLOCK: the hand
+ * passes over frames in use, taking away their reference bit, and stops at
+ * the first unpinned frame without one. Returns -1 if all frames are pinned
+ * or in I/O. Caller must hold the segment latch.
+ *
+ * data = buffer pool management data
+ */
+PRIVATE int chooseShmVictim(BM_Data * const data) {
+
+	BM_ShmHeader *header = data->shm->header;
+	int n;
+
+	for (n = 0; n < 2 * header->numFrames; n++) {
+		const int i = header->clockHand;
+		header->clockHand = (i + 1) % header->numFrames;
+
+		if (data->fixCount[i] != 0 || data->frameState[i] != FRAME_READY) {
+			continue;
+		}
+		if (data->pageFrameIndexMap[i] != NO_PAGE
+				&& data->shm->referenced[i] != 0) {
+			data->shm->referenced[i] = 0;
+			continue;
+		}
+		return i;
+	}
+
+	return -1;
+}
+
+/**
+ * Private utility function to tell whether any frame is in I/O. Caller must
+ * hold the segment latch.
+ *
+ * data = buffer pool management data
+ */
+PRIVATE bool isShmIOPending(BM_Data * const data) {
+
+	int i;
+
+	for (i = 0; i < data->shm->header->numFrames; i++) {
+		if (data->frameState[i] != FRAME_READY) {
+			return TRUE;
+		}
+	}
+
+	return FALSE;
+}
+
+/**
+ * Private utility function to load page pageNum of the pool's page file to
+ * clean victim frame index. The latch is released while the page is read,
+ * pins of the page wait meanwhile. Caller must hold the segment latch.
+ *
+ * bm = buffer pool handle
+ * index = index of the victim frame
+ * pageNum = page to be loaded
+ */
+PRIVATE RC loadShmFrame(BM_BufferPool * const bm, const int index,
+		const PageNumber pageNum) {
+
+	BM_Data *data = (BM_Data *) bm->mgmtData;
+	BM_Shm *shm = data->shm;
+	BM_ShmFile *file = &shm->header->files[bm->fileId];
+	char *frame = data->frameArena + (size_t) index * PAGE_SIZE;
+	RC ret;
+
+	SM_FileHandle *fh = getShmHandle(data, bm->fileId);
+	if (fh == NULL) {
+		THROW(RC_FILE_NOT_FOUND, "Error opening file");
+	}
+
+	//Victim leaves the pool
+	if (data->pageFrameIndexMap[index] != NO_PAGE) {
+		removeShmPage(data, index);
+		STAT_ADD(data->stats.evictions[BM_EVICT_REPLACE], 1);
+		STAT_ADD(data->stats.strategyVictims[RS_CLOCK], 1);
+	}
+	STAT_ADD(data->stats.misses, 1);
+
+	if (pageNum >= file->totalNumPages) {
+		//Page file grows right away, under the latch, so all clients agree
+		//on its page count
+		ret = ensureCapacity(pageNum + 1, fh);
+		if (ret != RC_OK) {
+			return ret;
+		}
+		STAT_ADD(data->stats.newBlocks, pageNum + 1 - file->totalNumPages);
+		file->totalNumPages = pageNum + 1;
+		memset(frame, 0, PAGE_SIZE);
+		ATOMIC_STORE(data->pageFrameIndexMap[index], pageNum);
+		ATOMIC_STORE(data->frameFile[index], bm->fileId);
+		insertShmPage(data, index);
+		return RC_OK;
+	}
+
+	//Frame is in I/O before it's published, so a client dying half way
+	//leaves nothing behind that looks loaded
+	data->frameState[index] = FRAME_READING;
+	shm->ioOwner[index] = shm->client;
+	ATOMIC_STORE(data->pageFrameIndexMap[index], pageNum);
+	ATOMIC_STORE(data->frameFile[index], bm->fileId);
+	insertShmPage(data, index);
+
+	unlockShm(data);
+	uint64_t start = statClock();
+	ret = readBlock(pageNum, fh, frame);
+	noteIOLatency(data, FALSE, start);
+	lockShm(data);
+
+	data->frameState[index] = FRAME_READY;
+	shm->ioOwner[index] = -1;
+
+	if (ret != RC_OK) {
+		removeShmPage(data, index);
+		return ret;
+	}
+	//Update IO Count
+	STAT_ADD(data->stats.reads, 1);
+
+	return RC_OK;
+}
+
+/**
+ * Private utility function to write back the page of frame, which must be
+ * in no I/O. The latch is released during the write, pins of the page wait
+ * meanwhile. Caller must hold the segment latch.
+ *
+ * data = buffer pool management data
+ * frame = index of the page frame
+ */
+PRIVATE RC writeShmFrame(BM_Data * const data, const int frame) {
+
+	BM_Shm *shm = data->shm;
+	const PageNumber pageNum = data->pageFrameIndexMap[frame];
+	RC ret;
+
+	SM_FileHandle *fh = getShmHandle(data, data->frameFile[frame]);
+	if (fh == NULL) {
+		THROW(RC_FILE_NOT_FOUND, "Error opening file");
+	}
+
+	//Reset dirty flag before writing, so a concurrent update re-dirties it
+	ATOMIC_STORE(data->dirtyFlags[frame], FALSE);
+	data->frameState[frame] = FRAME_WRITING;
+	shm->ioOwner[frame] = shm->client;
+
+	unlockShm(data);
+	uint64_t start = statClock();
+	ret = writeBlock(pageNum, fh,
+			data->frameArena + (size_t) frame * PAGE_SIZE);
+	noteIOLatency(data, TRUE, start);
+	lockShm(data);
+
+	data->frameState[frame] = FRAME_READY;
+	shm->ioOwner[frame] = -1;
+
+	if (ret != RC_OK) {
+		ATOMIC_STORE(data->dirtyFlags[frame], TRUE);
+		return ret;
+	}
+	//Update IO Count
+	STAT_ADD(data->stats.writes, 1);
+
+	return RC_OK;
+}
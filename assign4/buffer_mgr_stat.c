@@ -3,6 +3,17 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <time.h>
+
+// Room for a dump of pool statistics in either format
+#define STATS_DUMP_SIZE 8192
+
+// Bound of latency histogram bucket i in us, as comparison and value
+#define LATENCY_BOUND(i)						\
+		((i) == BM_LATENCY_BUCKETS - 1) ? ">=" : "<",			\
+		((i) == BM_LATENCY_BUCKETS - 1) ? 1UL << ((i) - 1) : 1UL << (i)
 
 // local functions
 static void printStrat(BM_BufferPool * const bm);
@@ -39,6 +50,32 @@ int *getFixCounts(BM_BufferPool * const bm) {
 	return ((BM_Data *) bm->mgmtData)->fixCount;
 }
 
+/*
+ * Returns how frame memory of the pool is backed, tells whether a
+ * request for huge pages was honored
+ *
+ * bm = buffer pool handle
+ */
+BM_HugePageState getHugePageState(BM_BufferPool * const bm) {
+	return ((BM_Data *) bm->mgmtData)->hugePageState;
+}
+
+/*
+ * Returns the number of pages written to disk by background writer
+ * since a buffer pool has been initialized
+ *
+ * bm = buffer pool handle
+ */
+int getNumWriterWriteIO(BM_BufferPool * const bm) {
+
+	//Sanity checks
+	if (bm == NULL) {
+		THROW(RC_INVALID_HANDLE, "Buffer pool handle is invalid");
+	}
+
+	return (int) ATOMIC_LOAD(((BM_Data *) bm->mgmtData)->stats.writerWrites);
+}
+
 /*
  * Returns the number of pages that have been read from disk
  * since a buffer pool has been initialized
@@ -52,7 +89,7 @@ int getNumReadIO(BM_BufferPool * const bm) {
 		THROW(RC_INVALID_HANDLE, "Buffer pool handle is invalid");
 	}
 
-	return ((BM_Data *) bm->mgmtData)->numReadIO;
+	return (int) ATOMIC_LOAD(((BM_Data *) bm->mgmtData)->stats.reads);
 }
 
 /*
@@ -68,17 +105,132 @@ int getNumWriteIO(BM_BufferPool * const bm) {
 		THROW(RC_INVALID_HANDLE, "Buffer pool handle is invalid");
 	}
 
-	return ((BM_Data *) bm->mgmtData)->numWriteIO;
+	return (int) ATOMIC_LOAD(((BM_Data *) bm->mgmtData)->stats.writes);
 }
 
 float getPageHitCount(BM_BufferPool * const bm) {
-	return ((BM_Data *) bm->mgmtData)->pageHit;
+	return (float) ATOMIC_LOAD(((BM_Data *) bm->mgmtData)->stats.hits);
 }
 
 float getPageHitRatio(BM_BufferPool * const bm) {
-	((BM_Data *) bm->mgmtData)->hitRatio = ((BM_Data *) bm->mgmtData)->pageHit
-			/ ((BM_Data *) bm->mgmtData)->pinReqCount;
-	return ((BM_Data *) bm->mgmtData)->hitRatio;
+	//Ratio is taken in double, exact counts don't survive a float
+	uint64_t requests = ATOMIC_LOAD(
+			((BM_Data *) bm->mgmtData)->stats.pinRequests);
+	return requests == 0 ?
+			0 : (float) ((double) ATOMIC_LOAD(
+					((BM_Data *) bm->mgmtData)->stats.hits) / requests);
+}
+
+/*
+ * Returns the number of pages read into pool ahead of demand
+ *
+ * bm = buffer pool handle
+ */
+long getPrefetchCount(BM_BufferPool * const bm) {
+	return (long) ATOMIC_LOAD(((BM_Data *) bm->mgmtData)->stats.prefetches);
+}
+
+/*
+ * Returns the number of prefetched pages pinned before being evicted
+ *
+ * bm = buffer pool handle
+ */
+long getPrefetchHitCount(BM_BufferPool * const bm) {
+	return (long) ATOMIC_LOAD(((BM_Data *) bm->mgmtData)->stats.prefetchHits);
+}
+
+/*
+ * Returns the number of prefetched pages evicted without ever being pinned
+ *
+ * bm = buffer pool handle
+ */
+long getPrefetchWasteCount(BM_BufferPool * const bm) {
+	return (long) ATOMIC_LOAD(
+			((BM_Data *) bm->mgmtData)->stats.prefetchWastes);
+}
+
+float getPrefetchHitRatio(BM_BufferPool * const bm) {
+	uint64_t count = ATOMIC_LOAD(((BM_Data *) bm->mgmtData)->stats.prefetches);
+	return count == 0 ?
+			0 : (float) ((double) ATOMIC_LOAD(
+					((BM_Data *) bm->mgmtData)->stats.prefetchHits) / count);
+}
+
+/*
+ * Copies all counters of a pool into stats. Counters are read one by one
+ * without any latch, so a snapshot taken under load may be off by the
+ * operations in flight, but no counter ever goes backwards.
+ *
+ * bm = buffer pool handle
+ * stats = snapshot to be filled
+ */
+RC getPoolStats(BM_BufferPool * const bm, BM_PoolStats * const stats) {
+
+	//Sanity checks
+	if (bm == NULL || bm->mgmtData == NULL) {
+		THROW(RC_INVALID_HANDLE, "Buffer pool handle is invalid");
+	}
+	if (stats == NULL) {
+		THROW(RC_INVALID_HANDLE, "Statistics handle is invalid");
+	}
+
+	//BM_PoolStats holds nothing but 64 bit counters
+	uint64_t *from = (uint64_t *) &((BM_Data *) bm->mgmtData)->stats;
+	uint64_t *to = (uint64_t *) stats;
+	size_t i;
+	for (i = 0; i < sizeof(BM_PoolStats) / sizeof(uint64_t); i++) {
+		to[i] = __atomic_load_n(&from[i], __ATOMIC_RELAXED);
+	}
+
+	//All OK
+	return RC_OK;
+}
+
+/*
+ * Returns current time of the monotonic clock in nanoseconds, start stamp
+ * of a latency to be counted
+ */
+uint64_t statClock(void) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t) now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+/*
+ * Counts an I/O started at start in the read or write latency histogram
+ *
+ * data = buffer pool management data
+ * write = TRUE for a write, FALSE for a read
+ * start = statClock() before the I/O
+ */
+void noteIOLatency(BM_Data * const data, const bool write,
+		const uint64_t start) {
+
+	uint64_t nanos = statClock() - start;
+	uint64_t micros = nanos / 1000;
+	int bucket = micros == 0 ? 0 : 64 - __builtin_clzll(micros);
+	if (bucket >= BM_LATENCY_BUCKETS) {
+		bucket = BM_LATENCY_BUCKETS - 1;
+	}
+
+	if (write) {
+		STAT_ADD(data->stats.writeNanos, nanos);
+		STAT_ADD(data->stats.writeLatency[bucket], 1);
+	} else {
+		STAT_ADD(data->stats.readNanos, nanos);
+		STAT_ADD(data->stats.readLatency[bucket], 1);
+	}
+}
+
+/*
+ * Counts a pin that waited since start for the pool latch or a frame in I/O
+ *
+ * data = buffer pool management data
+ * start = statClock() before the wait
+ */
+void notePinWait(BM_Data * const data, const uint64_t start) {
+	STAT_ADD(data->stats.pinWaits, 1);
+	STAT_ADD(data->stats.pinWaitNanos, statClock() - start);
 }
 
 // external functions
@@ -151,10 +303,148 @@ sprintPageContent(BM_PageHandle * const page) {
 }
 
 void printIOStat(BM_BufferPool * const bm) {
+	//BM_STATS_FORMAT=json in environment dumps statistics as JSON instead
+	const char *format = getenv("BM_STATS_FORMAT");
+	if (format != NULL && strcmp(format, "json") == 0) {
+		printPoolStats(bm, BM_STATS_JSON);
+		return;
+	}
+
 	printf("\n## Read IO: %d", getNumReadIO(bm));
 	printf("\n## Write IO: %d\n", getNumWriteIO(bm));
 	printf("\n## Page Hits: %f\n", getPageHitCount(bm));
 	printf("\n## Page Hit Ratio: %f\n", getPageHitRatio(bm));
+	printPoolStats(bm, BM_STATS_TEXT);
+}
+
+void printPoolStats(BM_BufferPool * const bm, const BM_StatsFormat format) {
+	char *message = sprintPoolStats(bm, format);
+	if (message != NULL) {
+		printf("%s", message);
+		free(message);
+	}
+}
+
+/*
+ * Returns a dump of all pool counters as text or JSON, to be freed by the
+ * caller. NULL if the snapshot couldn't be taken.
+ *
+ * bm = buffer pool handle
+ * format = BM_STATS_TEXT or BM_STATS_JSON
+ */
+char *
+sprintPoolStats(BM_BufferPool * const bm, const BM_StatsFormat format) {
+	static const char *evictReasons[BM_EVICT_REASONS] = { "replace", "ring",
+			"resize", "close" };
+	static const char *strategies[BM_NUM_STRATEGIES] = { "FIFO", "LRU",
+			"CLOCK", "LFU", "LRU-K", "AUTO" };
+	BM_PoolStats stats;
+	char *message;
+	int i, pos = 0;
+
+	if (getPoolStats(bm, &stats) != RC_OK) {
+		return NULL;
+	}
+	message = (char *) malloc(STATS_DUMP_SIZE);
+	if (message == NULL) {
+		return NULL;
+	}
+
+	double hitRatio = stats.pinRequests == 0 ?
+			0 : (double) stats.hits / stats.pinRequests;
+
+	if (format == BM_STATS_JSON) {
+		pos += snprintf(message + pos, STATS_DUMP_SIZE - pos,
+				"{\"pinRequests\":%" PRIu64 ",\"hits\":%" PRIu64
+				",\"misses\":%" PRIu64 ",\"hitRatio\":%f,\"reads\":%" PRIu64
+				",\"writes\":%" PRIu64 ",\"writerWrites\":%" PRIu64
+				",\"newBlocks\":%" PRIu64 ",\"dirtyEvictions\":%" PRIu64
+				",\"pinWaits\":%" PRIu64 ",\"pinWaitNanos\":%" PRIu64
+				",\"latchWaits\":%" PRIu64 ",\"latchWaitNanos\":%" PRIu64
+				",\"readNanos\":%" PRIu64 ",\"writeNanos\":%" PRIu64
+				",\"prefetches\":%" PRIu64 ",\"prefetchHits\":%" PRIu64
+				",\"prefetchWastes\":%" PRIu64 ",\"tierStores\":%" PRIu64
+				",\"tierHits\":%" PRIu64 ",\"evictions\":{",
+				stats.pinRequests, stats.hits, stats.misses, hitRatio,
+				stats.reads, stats.writes, stats.writerWrites, stats.newBlocks,
+				stats.dirtyEvictions, stats.pinWaits, stats.pinWaitNanos,
+				stats.latchWaits, stats.latchWaitNanos, stats.readNanos,
+				stats.writeNanos, stats.prefetches, stats.prefetchHits,
+				stats.prefetchWastes, stats.tierStores, stats.tierHits);
+		for (i = 0; i < BM_EVICT_REASONS; i++)
+			pos += snprintf(message + pos, STATS_DUMP_SIZE - pos,
+					"%s\"%s\":%" PRIu64, (i == 0) ? "" : ",", evictReasons[i],
+					stats.evictions[i]);
+		pos += snprintf(message + pos, STATS_DUMP_SIZE - pos,
+				"},\"strategyVictims\":{");
+		for (i = 0; i < BM_NUM_STRATEGIES; i++)
+			pos += snprintf(message + pos, STATS_DUMP_SIZE - pos,
+					"%s\"%s\":%" PRIu64, (i == 0) ? "" : ",", strategies[i],
+					stats.strategyVictims[i]);
+		pos += snprintf(message + pos, STATS_DUMP_SIZE - pos,
+				"},\"autoSwitches\":{");
+		for (i = 0; i < BM_NUM_STRATEGIES; i++)
+			pos += snprintf(message + pos, STATS_DUMP_SIZE - pos,
+					"%s\"%s\":%" PRIu64, (i == 0) ? "" : ",", strategies[i],
+					stats.autoSwitches[i]);
+		pos += snprintf(message + pos, STATS_DUMP_SIZE - pos,
+				"},\"readLatencyUs\":[");
+		for (i = 0; i < BM_LATENCY_BUCKETS; i++)
+			pos += snprintf(message + pos, STATS_DUMP_SIZE - pos,
+					"%s%" PRIu64, (i == 0) ? "" : ",", stats.readLatency[i]);
+		pos += snprintf(message + pos, STATS_DUMP_SIZE - pos,
+				"],\"writeLatencyUs\":[");
+		for (i = 0; i < BM_LATENCY_BUCKETS; i++)
+			pos += snprintf(message + pos, STATS_DUMP_SIZE - pos,
+					"%s%" PRIu64, (i == 0) ? "" : ",", stats.writeLatency[i]);
+		snprintf(message + pos, STATS_DUMP_SIZE - pos, "]}\n");
+		return message;
+	}
+
+	pos += snprintf(message + pos, STATS_DUMP_SIZE - pos,
+			"\n## Pin Requests: %" PRIu64 " (hits %" PRIu64 ", misses %" PRIu64
+			", ratio %f)\n## Reads: %" PRIu64 " (%" PRIu64 " ns)\n## Writes: %"
+			PRIu64 " (%" PRIu64 " ns, writer %" PRIu64 ", new blocks %" PRIu64
+			")\n## Pin Waits: %" PRIu64 " (%" PRIu64 " ns)\n## Latch Waits: %"
+			PRIu64 " (%" PRIu64 " ns)\n## Prefetches: %"
+			PRIu64 " (hits %" PRIu64 ", wasted %" PRIu64 ")\n## Tier Stores: %"
+			PRIu64 " (hits %" PRIu64 ")\n## Evictions:",
+			stats.pinRequests, stats.hits, stats.misses, hitRatio, stats.reads,
+			stats.readNanos, stats.writes, stats.writeNanos,
+			stats.writerWrites, stats.newBlocks, stats.pinWaits,
+			stats.pinWaitNanos, stats.latchWaits, stats.latchWaitNanos,
+			stats.prefetches, stats.prefetchHits, stats.prefetchWastes,
+			stats.tierStores, stats.tierHits);
+	for (i = 0; i < BM_EVICT_REASONS; i++)
+		pos += snprintf(message + pos, STATS_DUMP_SIZE - pos, " %s %" PRIu64,
+				evictReasons[i], stats.evictions[i]);
+	pos += snprintf(message + pos, STATS_DUMP_SIZE - pos,
+			" (dirty %" PRIu64 ")\n## Victims:", stats.dirtyEvictions);
+	for (i = 0; i < BM_NUM_STRATEGIES; i++)
+		pos += snprintf(message + pos, STATS_DUMP_SIZE - pos, " %s %" PRIu64,
+				strategies[i], stats.strategyVictims[i]);
+	pos += snprintf(message + pos, STATS_DUMP_SIZE - pos,
+			"\n## Auto Switches:");
+	for (i = 0; i < BM_NUM_STRATEGIES; i++)
+		pos += snprintf(message + pos, STATS_DUMP_SIZE - pos, " %s %" PRIu64,
+				strategies[i], stats.autoSwitches[i]);
+	//Histograms list non-empty buckets by their upper bound, the last one
+	//by its lower bound
+	pos += snprintf(message + pos, STATS_DUMP_SIZE - pos,
+			"\n## Read Latency:");
+	for (i = 0; i < BM_LATENCY_BUCKETS; i++)
+		if (stats.readLatency[i] > 0)
+			pos += snprintf(message + pos, STATS_DUMP_SIZE - pos,
+					" %s%luus %" PRIu64, LATENCY_BOUND(i), stats.readLatency[i]);
+	pos += snprintf(message + pos, STATS_DUMP_SIZE - pos,
+			"\n## Write Latency:");
+	for (i = 0; i < BM_LATENCY_BUCKETS; i++)
+		if (stats.writeLatency[i] > 0)
+			pos += snprintf(message + pos, STATS_DUMP_SIZE - pos,
+					" %s%luus %" PRIu64, LATENCY_BOUND(i), stats.writeLatency[i]);
+	snprintf(message + pos, STATS_DUMP_SIZE - pos, "\n");
+
+	return message;
 }
 
 void printStrat(BM_BufferPool * const bm) {
@@ -174,6 +464,9 @@ void printStrat(BM_BufferPool * const bm) {
 	case RS_LRU_K:
 		printf("LRU-K");
 		break;
+	case RS_AUTO:
+		printf("AUTO");
+		break;
 	default:
 		printf("%i", bm->strategy);
 		break;
@@ -3,10 +3,17 @@
 
 #include "buffer_mgr.h"
 
+// Output formats of pool statistics
+typedef enum BM_StatsFormat {
+	BM_STATS_TEXT = 0, BM_STATS_JSON = 1
+} BM_StatsFormat;
+
 // debug functions
 void printPoolContent(BM_BufferPool * const bm);
 void printPageContent(BM_PageHandle * const page);
 char *sprintPoolContent(BM_BufferPool * const bm);
 char *sprintPageContent(BM_PageHandle * const page);
+void printPoolStats(BM_BufferPool * const bm, const BM_StatsFormat format);
+char *sprintPoolStats(BM_BufferPool * const bm, const BM_StatsFormat format);
 
 #endif
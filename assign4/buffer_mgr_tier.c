@@ -0,0 +1,343 @@
+/*
+ * buffer_mgr_tier.c
+ *
+ *  Optional compressed second cache tier behind a buffer pool. Pages evicted
+ *  by replacement are compressed and kept in RAM up to a byte budget, a miss
+ *  looks there before it reads the page file. The tier is exclusive: a page
+ *  taken back into the pool leaves the tier, so a copy in the tier is never
+ *  older than the page file. Entries are dropped oldest first once the
+ *  budget is exceeded.
+ *
+ *  Pages are run length encoded, which suits pages padded with zeros or
+ *  blanks: a control byte c < 128 is followed by c + 1 literal bytes, a
+ *  control byte c >= 128 by one byte repeated (c & 0x7f) + TIER_MIN_RUN
+ *  times. Pages that don't compress to BM_TIER_MAX_SIZE aren't kept.
+ *
+ *  All functions run under the pool latch, no latch of its own is needed.
+ */
+
+#include "buffer_mgr.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define PRIVATE static
+
+// Shortest and longest run of a repeated byte encoded as a run
+#define TIER_MIN_RUN 3
+#define TIER_MAX_RUN (0x7f + TIER_MIN_RUN)
+
+// Longest literal run
+#define TIER_MAX_LITERAL 0x80
+
+// Budget bytes per hash bucket of the tier
+#define TIER_BYTES_PER_BUCKET 1024
+
+PRIVATE inline BM_TierEntry **findTierEntry(BM_Tier * const, const int,
+		const PageNumber);
+PRIVATE void removeTierEntry(BM_Tier * const, BM_TierEntry ** const);
+PRIVATE int compressPage(const char * const, char * const, const int);
+PRIVATE void decompressPage(const char * const, const int, char * const);
+
+/**
+ * Sets up the compressed tier of the pool if options give it a budget.
+ *
+ * bm = buffer pool handle
+ * options = pool configuration
+ */
+RC startTier(BM_BufferPool * const bm, const BM_PoolOptions * const options) {
+
+	int i;
+
+	((BM_Data *) bm->mgmtData)->tier = NULL;
+
+	if (options->tierBytes == 0) {
+		return RC_OK;
+	}
+
+	BM_Tier *tier = (BM_Tier *) malloc(sizeof(BM_Tier));
+	if (tier == NULL) {
+		THROW(RC_NOT_ENOUGH_MEMORY,
+				"Not enough memory available for resource allocation");
+	}
+	for (tier->numBuckets = 16;
+			(size_t) tier->numBuckets * TIER_BYTES_PER_BUCKET
+					< options->tierBytes && tier->numBuckets < (1 << 24);
+			tier->numBuckets <<= 1)
+		;
+	tier->buckets = (BM_TierEntry **) malloc(
+			tier->numBuckets * sizeof(BM_TierEntry *));
+	if (tier->buckets == NULL) {
+		free(tier);
+		THROW(RC_NOT_ENOUGH_MEMORY,
+				"Not enough memory available for resource allocation");
+	}
+	for (i = 0; i < tier->numBuckets; i++) {
+		tier->buckets[i] = NULL;
+	}
+	tier->maxBytes = options->tierBytes;
+	tier->usedBytes = 0;
+	tier->oldest = NULL;
+	tier->newest = NULL;
+	((BM_Data *) bm->mgmtData)->tier = tier;
+
+	//All OK
+	return RC_OK;
+}
+
+/**
+ * Drops all pages of the compressed tier and releases it. Caller must make
+ * sure nobody accesses the pool anymore.
+ *
+ * bm = buffer pool handle
+ */
+void stopTier(BM_BufferPool * const bm) {
+
+	BM_Tier *tier = ((BM_Data *) bm->mgmtData)->tier;
+	if (tier == NULL) {
+		return;
+	}
+	((BM_Data *) bm->mgmtData)->tier = NULL;
+
+	while (tier->oldest != NULL) {
+		BM_TierEntry *entry = tier->oldest;
+		tier->oldest = entry->newer;
+		free(entry);
+	}
+	free(tier->buckets);
+	free(tier);
+}
+
+/**
+ * Keeps a compressed copy of the page of claimed frame num, which must match
+ * the page file. Oldest pages are dropped to make room for it. Only called
+ * while the pool has a tier, caller must hold the pool latch.
+ *
+ * bm = buffer pool handle
+ * num = index of the page frame
+ */
+void storeTierPage(BM_BufferPool * const bm, const int num) {
+
+	BM_Tier *tier = ((BM_Data *) bm->mgmtData)->tier;
+	const int file = ((BM_Data *) bm->mgmtData)->frameFile[num];
+	const PageNumber pageNum =
+			((BM_Data *) bm->mgmtData)->pageFrameIndexMap[num];
+	BM_TierEntry **link = findTierEntry(tier, file, pageNum);
+
+	//Tier is exclusive, but don't trust an older copy anyway
+	if (*link != NULL) {
+		removeTierEntry(tier, link);
+	}
+
+	int size = compressPage(((BM_Data *) bm->mgmtData)->pages[num].data,
+			tier->buffer, BM_TIER_MAX_SIZE);
+	size_t bytes = sizeof(BM_TierEntry) + size;
+	if (size == -1 || bytes > tier->maxBytes) {
+		return;
+	}
+
+	while (tier->usedBytes + bytes > tier->maxBytes) {
+		BM_TierEntry *oldest = tier->oldest;
+		removeTierEntry(tier,
+				findTierEntry(tier, oldest->file, oldest->pageNum));
+	}
+
+	BM_TierEntry *entry = (BM_TierEntry *) malloc(bytes);
+	if (entry == NULL) {
+		//Tier is best effort
+		return;
+	}
+	entry->file = file;
+	entry->pageNum = pageNum;
+	entry->size = size;
+	memcpy(entry->data, tier->buffer, size);
+	link = findTierEntry(tier, file, pageNum);
+	entry->hashNext = NULL;
+	*link = entry;
+	entry->older = tier->newest;
+	entry->newer = NULL;
+	if (tier->newest != NULL) {
+		tier->newest->newer = entry;
+	} else {
+		tier->oldest = entry;
+	}
+	tier->newest = entry;
+	tier->usedBytes += bytes;
+
+	STAT_ADD(((BM_Data *) bm->mgmtData)->stats.tierStores, 1);
+}
+
+/**
+ * Takes page pageNum of file slot file out of the compressed tier into data.
+ * Returns FALSE if the tier doesn't hold the page. Only called while the
+ * pool has a tier, caller must hold the pool latch.
+ *
+ * bm = buffer pool handle
+ * file = slot of the page file in file table
+ * pageNum = page to be loaded
+ * data = frame data the page is decompressed to
+ */
+bool loadTierPage(BM_BufferPool * const bm, const int file,
+		const PageNumber pageNum, char * const data) {
+
+	BM_Tier *tier = ((BM_Data *) bm->mgmtData)->tier;
+	BM_TierEntry **link = findTierEntry(tier, file, pageNum);
+
+	if (*link == NULL) {
+		return FALSE;
+	}
+
+	decompressPage((*link)->data, (*link)->size, data);
+	removeTierEntry(tier, link);
+	STAT_ADD(((BM_Data *) bm->mgmtData)->stats.tierHits, 1);
+
+	return TRUE;
+}
+
+/**
+ * Drops all pages of file slot file from the compressed tier, so the slot
+ * can be reused by another page file. Caller must hold the pool latch.
+ *
+ * bm = buffer pool handle
+ * file = slot of the page file in file table
+ */
+void dropTierFile(BM_BufferPool * const bm, const int file) {
+
+	BM_Tier *tier = ((BM_Data *) bm->mgmtData)->tier;
+	BM_TierEntry *entry, *newer;
+
+	if (tier == NULL) {
+		return;
+	}
+
+	for (entry = tier->oldest; entry != NULL; entry = newer) {
+		newer = entry->newer;
+		if (entry->file == file) {
+			removeTierEntry(tier,
+					findTierEntry(tier, entry->file, entry->pageNum));
+		}
+	}
+}
+
+/**
+ * Private utility function to find the link to the entry of a page in its
+ * hash chain. The link holds NULL if the tier doesn't hold the page.
+ *
+ * tier = compressed tier
+ * file = slot of the page file in file table
+ * pageNum = page to be found
+ */
+PRIVATE inline BM_TierEntry **findTierEntry(BM_Tier * const tier,
+		const int file, const PageNumber pageNum) {
+
+	uint64_t key = ((uint64_t) file << 32) | (uint32_t) pageNum;
+	BM_TierEntry **link = &tier->buckets[((key * 0x9e3779b97f4a7c15ULL) >> 32)
+			& (tier->numBuckets - 1)];
+
+	while (*link != NULL
+			&& ((*link)->file != file || (*link)->pageNum != pageNum)) {
+		link = &(*link)->hashNext;
+	}
+	return link;
+}
+
+/**
+ * Private utility function to unlink an entry from its hash chain and the
+ * store order, and free it.
+ *
+ * tier = compressed tier
+ * link = link to the entry in its hash chain
+ */
+PRIVATE void removeTierEntry(BM_Tier * const tier, BM_TierEntry ** const link) {
+
+	BM_TierEntry *entry = *link;
+
+	*link = entry->hashNext;
+	if (entry->older != NULL) {
+		entry->older->newer = entry->newer;
+	} else {
+		tier->oldest = entry->newer;
+	}
+	if (entry->newer != NULL) {
+		entry->newer->older = entry->older;
+	} else {
+		tier->newest = entry->older;
+	}
+	tier->usedBytes -= sizeof(BM_TierEntry) + entry->size;
+	free(entry);
+}
+
+/**
+ * Private utility function to compress a page to out. Returns size of the
+ * compressed page, or -1 if it doesn't fit in limit bytes.
+ *
+ * page = page to be compressed
+ * out = buffer of at least limit bytes
+ * limit = max size of the compressed page
+ */
+PRIVATE int compressPage(const char * const page, char * const out,
+		const int limit) {
+
+	int in = 0, size = 0, literal = -1;
+
+	while (in < PAGE_SIZE) {
+		int run = 1;
+		while (in + run < PAGE_SIZE && run < TIER_MAX_RUN
+				&& page[in + run] == page[in]) {
+			run++;
+		}
+
+		if (run >= TIER_MIN_RUN) {
+			if (size + 2 > limit) {
+				return -1;
+			}
+			out[size++] = (char) (0x80 | (run - TIER_MIN_RUN));
+			out[size++] = page[in];
+			in += run;
+			literal = -1;
+			continue;
+		}
+
+		//Byte goes to the open literal run, or opens a new one
+		if (literal == -1 || out[literal] == TIER_MAX_LITERAL - 1) {
+			if (size + 1 > limit) {
+				return -1;
+			}
+			literal = size;
+			out[size++] = (char) -1;
+		}
+		if (size + 1 > limit) {
+			return -1;
+		}
+		out[literal]++;
+		out[size++] = page[in++];
+	}
+
+	return size;
+}
+
+/**
+ * Private utility function to decompress a page compressed by compressPage.
+ *
+ * in = compressed page
+ * size = size of the compressed page
+ * page = buffer of PAGE_SIZE bytes the page is decompressed to
+ */
+PRIVATE void decompressPage(const char * const in, const int size,
+		char * const page) {
+
+	int pos = 0, out = 0;
+
+	while (pos < size) {
+		int control = (unsigned char) in[pos++];
+		if (control & 0x80) {
+			int run = (control & 0x7f) + TIER_MIN_RUN;
+			memset(page + out, in[pos++], run);
+			out += run;
+		} else {
+			memcpy(page + out, in + pos, control + 1);
+			pos += control + 1;
+			out += control + 1;
+		}
+	}
+}
@@ -0,0 +1,141 @@
+/*
+ * buffer_mgr_trace.c
+ *
+ *  Optional access trace of a buffer pool. Pins, unpins and markDirty calls
+ *  are recorded as fixed size events to a trace file, which bm_replay replays
+ *  against other replacement strategies and pool sizes. The file is a ring
+ *  of a fixed no of events, so a pool can be traced indefinitely and the
+ *  file keeps its most recent accesses. Events are buffered in memory and
+ *  written BM_TRACE_BUFFER at a time.
+ */
+
+#include "buffer_mgr.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#define PRIVATE static
+
+PRIVATE void writeTraceBuffer(BM_Trace * const);
+
+/**
+ * Starts tracing accesses of the pool to the trace file of options, if any.
+ * An existing trace file is overwritten.
+ *
+ * bm = buffer pool handle
+ * options = pool configuration
+ */
+RC startTrace(BM_BufferPool * const bm, const BM_PoolOptions * const options) {
+
+	((BM_Data *) bm->mgmtData)->trace = NULL;
+
+	if (options->traceFile == NULL || options->traceMaxEvents <= 0) {
+		return RC_OK;
+	}
+
+	BM_Trace *trace = (BM_Trace *) malloc(sizeof(BM_Trace));
+	if (trace == NULL) {
+		THROW(RC_NOT_ENOUGH_MEMORY,
+				"Not enough memory available for resource allocation");
+	}
+	trace->fd = open(options->traceFile, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (trace->fd == -1) {
+		free(trace);
+		THROW(RC_WRITE_FAILED, "Couldn't create trace file");
+	}
+	pthread_mutex_init(&trace->lock, NULL);
+	trace->start = statClock();
+	trace->capacity = options->traceMaxEvents;
+	trace->numEvents = 0;
+	trace->numBuffered = 0;
+
+	//Header is written again after each batch of events
+	writeTraceBuffer(trace);
+	((BM_Data *) bm->mgmtData)->trace = trace;
+
+	//All OK
+	return RC_OK;
+}
+
+/**
+ * Writes events still buffered to the trace file and closes it. Caller must
+ * make sure nobody accesses the pool anymore.
+ *
+ * bm = buffer pool handle
+ */
+void stopTrace(BM_BufferPool * const bm) {
+
+	BM_Trace *trace = ((BM_Data *) bm->mgmtData)->trace;
+	if (trace == NULL) {
+		return;
+	}
+	((BM_Data *) bm->mgmtData)->trace = NULL;
+
+	writeTraceBuffer(trace);
+	close(trace->fd);
+	pthread_mutex_destroy(&trace->lock);
+	free(trace);
+}
+
+/**
+ * Records an access to page pageNum of page file of pool handle bm. Only
+ * called while the pool is traced.
+ *
+ * bm = buffer pool handle
+ * op = kind of access
+ * pageNum = page accessed
+ */
+void traceAccess(BM_BufferPool * const bm, const BM_TraceOp op,
+		const PageNumber pageNum) {
+
+	BM_Trace *trace = ((BM_Data *) bm->mgmtData)->trace;
+
+	pthread_mutex_lock(&trace->lock);
+	//Time is taken under the latch, so events are in time order in the file
+	BM_TraceEvent *event = &trace->buffer[trace->numBuffered++];
+	event->time = statClock() - trace->start;
+	event->pageNum = pageNum;
+	event->file = bm->fileId;
+	event->op = op;
+	event->pad = 0;
+	if (trace->numBuffered == BM_TRACE_BUFFER) {
+		writeTraceBuffer(trace);
+	}
+	pthread_mutex_unlock(&trace->lock);
+}
+
+/**
+ * Private utility function to append buffered events to the ring in trace
+ * file, wrapping around at its end, and update the file header. Caller must
+ * hold the trace latch, unless nobody else can see the trace.
+ *
+ * trace = trace being recorded
+ */
+PRIVATE void writeTraceBuffer(BM_Trace * const trace) {
+
+	int done = 0;
+	while (done < trace->numBuffered) {
+		uint64_t slot = trace->numEvents % trace->capacity;
+		int n = trace->numBuffered - done;
+		if (slot + n > trace->capacity) {
+			n = trace->capacity - slot;
+		}
+		if (pwrite(trace->fd, &trace->buffer[done], n * sizeof(BM_TraceEvent),
+				sizeof(BM_TraceHeader) + slot * sizeof(BM_TraceEvent)) == -1) {
+			//Trace is best effort, drop what's left
+			break;
+		}
+		trace->numEvents += n;
+		done += n;
+	}
+	trace->numBuffered = 0;
+
+	BM_TraceHeader header;
+	header.magic = BM_TRACE_MAGIC;
+	header.eventSize = sizeof(BM_TraceEvent);
+	header.capacity = trace->capacity;
+	header.numEvents = trace->numEvents;
+	pwrite(trace->fd, &header, sizeof(BM_TraceHeader), 0);
+}
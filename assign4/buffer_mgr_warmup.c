@@ -0,0 +1,385 @@
+/*
+ * buffer_mgr_warmup.c
+ *
+ *  Optional warm-up of a buffer pool across restarts. When a page file is
+ *  closed, page numbers of its resident pages are saved hottest first to a
+ *  sidecar file next to it. When the page file is opened again, a worker
+ *  thread reads those pages back into the pool, sorted by page number so
+ *  they load with long sequential reads.
+ */
+
+#include "buffer_mgr.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PRIVATE static
+
+//Sidecar starts with this tag followed by the page count, then page numbers
+#define WARMUP_MAGIC 0x424d5731
+
+//Most pages the worker loads in one go
+#define WARMUP_BATCH 64
+
+//Hotness of a resident page
+typedef struct WarmupEntry {
+	PageNumber pageNum;
+	int useCount;
+	unsigned long lastUse;
+} WarmupEntry;
+
+PRIVATE void *warmerMain(void *);
+PRIVATE char *getSidecarName(const char * const, const char * const);
+PRIVATE PageNumber *loadWarmupList(BM_BufferPool * const, const char * const,
+		int * const);
+PRIVATE int compareHotness(const void *, const void *);
+PRIVATE int comparePageNum(const void *, const void *);
+
+/**
+ * Starts warm-up worker of the pool, if enabled in options
+ *
+ * bm = buffer pool handle
+ * options = pool configuration
+ */
+RC startWarmer(BM_BufferPool * const bm, const BM_PoolOptions * const options) {
+
+	((BM_Data *) bm->mgmtData)->warmupEnabled = options->warmup;
+	((BM_Data *) bm->mgmtData)->warmupRunning = FALSE;
+	((BM_Data *) bm->mgmtData)->warmupStop = FALSE;
+	((BM_Data *) bm->mgmtData)->warmupCancel = FALSE;
+	((BM_Data *) bm->mgmtData)->warmupJobs = NULL;
+	((BM_Data *) bm->mgmtData)->warmupFile = -1;
+
+	if (options->warmup == FALSE || bm->numPages == 0) {
+		return RC_OK;
+	}
+
+	pthread_mutex_init(&((BM_Data *) bm->mgmtData)->warmupLock, NULL);
+	pthread_cond_init(&((BM_Data *) bm->mgmtData)->warmupCond, NULL);
+	if (pthread_create(&((BM_Data *) bm->mgmtData)->warmer, NULL, warmerMain,
+			bm) != 0) {
+		pthread_cond_destroy(&((BM_Data *) bm->mgmtData)->warmupCond);
+		pthread_mutex_destroy(&((BM_Data *) bm->mgmtData)->warmupLock);
+		THROW(RC_WRITER_START_FAILED, "Couldn't start warm-up worker");
+	}
+	((BM_Data *) bm->mgmtData)->warmupRunning = TRUE;
+
+	//All OK
+	return RC_OK;
+}
+
+/**
+ * Stops warm-up worker of the pool and waits for its current batch. Pages
+ * still waiting to be warmed up are dropped. Caller must not hold the pool
+ * latch.
+ *
+ * bm = buffer pool handle
+ */
+void stopWarmer(BM_BufferPool * const bm) {
+
+	if (((BM_Data *) bm->mgmtData)->warmupRunning == FALSE) {
+		return;
+	}
+
+	pthread_mutex_lock(&((BM_Data *) bm->mgmtData)->warmupLock);
+	((BM_Data *) bm->mgmtData)->warmupStop = TRUE;
+	pthread_cond_signal(&((BM_Data *) bm->mgmtData)->warmupCond);
+	pthread_mutex_unlock(&((BM_Data *) bm->mgmtData)->warmupLock);
+
+	pthread_join(((BM_Data *) bm->mgmtData)->warmer, NULL);
+	while (((BM_Data *) bm->mgmtData)->warmupJobs != NULL) {
+		BM_WarmupJob *job = ((BM_Data *) bm->mgmtData)->warmupJobs;
+		((BM_Data *) bm->mgmtData)->warmupJobs = job->next;
+		free(job->sidecar);
+		free(job);
+	}
+	pthread_cond_destroy(&((BM_Data *) bm->mgmtData)->warmupCond);
+	pthread_mutex_destroy(&((BM_Data *) bm->mgmtData)->warmupLock);
+	((BM_Data *) bm->mgmtData)->warmupRunning = FALSE;
+}
+
+/**
+ * Queues warm-up of page file of pool handle bm from its sidecar, if any.
+ * May be called with the pool latch held.
+ *
+ * bm = buffer pool handle
+ */
+void queueWarmup(BM_BufferPool * const bm) {
+
+	if (((BM_Data *) bm->mgmtData)->warmupRunning == FALSE) {
+		return;
+	}
+
+	BM_WarmupJob *job = (BM_WarmupJob *) malloc(sizeof(BM_WarmupJob));
+	if (job == NULL) {
+		return;
+	}
+	job->fileId = bm->fileId;
+	job->sidecar = getSidecarName(
+			((BM_Data *) bm->mgmtData)->files[bm->fileId]->name,
+			BM_WARMUP_SUFFIX);
+	job->next = NULL;
+	if (job->sidecar == NULL) {
+		free(job);
+		return;
+	}
+
+	pthread_mutex_lock(&((BM_Data *) bm->mgmtData)->warmupLock);
+	BM_WarmupJob **tail = &((BM_Data *) bm->mgmtData)->warmupJobs;
+	while (*tail != NULL) {
+		tail = &(*tail)->next;
+	}
+	*tail = job;
+	pthread_cond_signal(&((BM_Data *) bm->mgmtData)->warmupCond);
+	pthread_mutex_unlock(&((BM_Data *) bm->mgmtData)->warmupLock);
+}
+
+/**
+ * Drops pending warm-up of page file of pool handle bm, as the page file is
+ * about to be closed. A batch already being loaded finishes, the rest is
+ * skipped. May be called with the pool latch held.
+ *
+ * bm = buffer pool handle
+ */
+void cancelWarmup(BM_BufferPool * const bm) {
+
+	if (((BM_Data *) bm->mgmtData)->warmupRunning == FALSE) {
+		return;
+	}
+
+	pthread_mutex_lock(&((BM_Data *) bm->mgmtData)->warmupLock);
+	BM_WarmupJob **link = &((BM_Data *) bm->mgmtData)->warmupJobs;
+	while (*link != NULL) {
+		BM_WarmupJob *job = *link;
+		if (job->fileId == bm->fileId) {
+			*link = job->next;
+			free(job->sidecar);
+			free(job);
+		} else {
+			link = &job->next;
+		}
+	}
+	if (((BM_Data *) bm->mgmtData)->warmupFile == bm->fileId) {
+		((BM_Data *) bm->mgmtData)->warmupCancel = TRUE;
+	}
+	pthread_mutex_unlock(&((BM_Data *) bm->mgmtData)->warmupLock);
+}
+
+/**
+ * Saves page numbers of resident pages of page file of pool handle bm to its
+ * sidecar, most used and most recently used first. Warm-up is best effort,
+ * a sidecar that can't be written is skipped. Caller must hold the pool latch.
+ *
+ * bm = buffer pool handle
+ */
+void saveWarmupList(BM_BufferPool * const bm) {
+
+	int i, n = 0;
+
+	if (((BM_Data *) bm->mgmtData)->warmupEnabled == FALSE) {
+		return;
+	}
+
+	char *sidecar = getSidecarName(
+			((BM_Data *) bm->mgmtData)->files[bm->fileId]->name,
+			BM_WARMUP_SUFFIX);
+	char *temp = getSidecarName(
+			((BM_Data *) bm->mgmtData)->files[bm->fileId]->name,
+			BM_WARMUP_SUFFIX ".tmp");
+	WarmupEntry *entries = (WarmupEntry *) malloc(
+			(((BM_Data *) bm->mgmtData)->numFramesUsed + 1)
+					* sizeof(WarmupEntry));
+	PageNumber *pages = (PageNumber *) malloc(
+			(((BM_Data *) bm->mgmtData)->numFramesUsed + 2)
+					* sizeof(PageNumber));
+	if (sidecar == NULL || temp == NULL || entries == NULL || pages == NULL) {
+		free(sidecar);
+		free(temp);
+		free(entries);
+		free(pages);
+		return;
+	}
+
+	for (i = 0; i < ((BM_Data *) bm->mgmtData)->numFramesUsed; i++) {
+		if (((BM_Data *) bm->mgmtData)->frameFile[i] != bm->fileId
+				|| ((BM_Data *) bm->mgmtData)->pageFrameIndexMap[i]
+						== NO_PAGE) {
+			continue;
+		}
+		entries[n].pageNum = ((BM_Data *) bm->mgmtData)->pageFrameIndexMap[i];
+		entries[n].useCount = ((BM_Data *) bm->mgmtData)->pageUsedCount[i];
+		//Only LRU and LRU-K keep use time stamps, others have load time at best
+		entries[n].lastUse =
+				((BM_Data *) bm->mgmtData)->pageUsedTime[i]
+						> ((BM_Data *) bm->mgmtData)->pageInTime[i] ?
+						((BM_Data *) bm->mgmtData)->pageUsedTime[i] :
+						((BM_Data *) bm->mgmtData)->pageInTime[i];
+		n++;
+	}
+	qsort(entries, n, sizeof(WarmupEntry), compareHotness);
+
+	pages[0] = WARMUP_MAGIC;
+	pages[1] = n;
+	for (i = 0; i < n; i++) {
+		pages[i + 2] = entries[i].pageNum;
+	}
+
+	//Written aside and renamed, a crash never leaves a torn sidecar
+	FILE *out = fopen(temp, "wb");
+	if (out != NULL) {
+		size_t written = fwrite(pages, sizeof(PageNumber), n + 2, out);
+		if (fclose(out) == 0 && written == (size_t) n + 2) {
+			rename(temp, sidecar);
+		} else {
+			remove(temp);
+		}
+	}
+
+	free(sidecar);
+	free(temp);
+	free(entries);
+	free(pages);
+}
+
+/**
+ * Warm-up worker. Loads queued page files' sidecars one after the other,
+ * in batches of pages sorted by page number, until stopped.
+ *
+ * arg = buffer pool handle
+ */
+PRIVATE void *warmerMain(void *arg) {
+
+	BM_BufferPool * const bm = (BM_BufferPool *) arg;
+	//Pages are loaded through a view on the page file they were saved for
+	BM_BufferPool view = *bm;
+
+	pthread_mutex_lock(&((BM_Data *) bm->mgmtData)->warmupLock);
+	for (;;) {
+		while (((BM_Data *) bm->mgmtData)->warmupStop == FALSE
+				&& ((BM_Data *) bm->mgmtData)->warmupJobs == NULL) {
+			pthread_cond_wait(&((BM_Data *) bm->mgmtData)->warmupCond,
+					&((BM_Data *) bm->mgmtData)->warmupLock);
+		}
+		if (((BM_Data *) bm->mgmtData)->warmupStop == TRUE) {
+			break;
+		}
+
+		BM_WarmupJob *job = ((BM_Data *) bm->mgmtData)->warmupJobs;
+		((BM_Data *) bm->mgmtData)->warmupJobs = job->next;
+		((BM_Data *) bm->mgmtData)->warmupFile = job->fileId;
+		((BM_Data *) bm->mgmtData)->warmupCancel = FALSE;
+		pthread_mutex_unlock(&((BM_Data *) bm->mgmtData)->warmupLock);
+
+		int i, n = 0;
+		PageNumber *pages = loadWarmupList(bm, job->sidecar, &n);
+		view.fileId = job->fileId;
+		for (i = 0; pages != NULL && i < n; i += WARMUP_BATCH) {
+			pthread_mutex_lock(&((BM_Data *) bm->mgmtData)->warmupLock);
+			bool quit = ((BM_Data *) bm->mgmtData)->warmupStop
+					|| ((BM_Data *) bm->mgmtData)->warmupCancel;
+			pthread_mutex_unlock(&((BM_Data *) bm->mgmtData)->warmupLock);
+			if (quit) {
+				break;
+			}
+			//Closed page files and pages already resident are skipped
+			prefetchPages(&view, pages + i,
+					n - i < WARMUP_BATCH ? n - i : WARMUP_BATCH);
+		}
+		free(pages);
+		free(job->sidecar);
+		free(job);
+
+		pthread_mutex_lock(&((BM_Data *) bm->mgmtData)->warmupLock);
+		((BM_Data *) bm->mgmtData)->warmupFile = -1;
+	}
+	pthread_mutex_unlock(&((BM_Data *) bm->mgmtData)->warmupLock);
+
+	return NULL;
+}
+
+/**
+ * Private utility function to read a sidecar. The hottest pages that fit in
+ * the pool are returned sorted by page number, NULL if there is no usable
+ * sidecar. Caller frees the list.
+ *
+ * bm = buffer pool handle
+ * sidecar = name of the sidecar
+ * n = set to no of pages returned
+ */
+PRIVATE PageNumber *loadWarmupList(BM_BufferPool * const bm,
+		const char * const sidecar, int * const n) {
+
+	PageNumber header[2];
+	PageNumber *pages = NULL;
+
+	FILE *in = fopen(sidecar, "rb");
+	if (in == NULL) {
+		return NULL;
+	}
+
+	if (fread(header, sizeof(PageNumber), 2, in) == 2
+			&& header[0] == WARMUP_MAGIC && header[1] > 0) {
+		//Pages past the pool size would only evict hotter ones
+		int numFrames = ATOMIC_LOAD(((BM_Data *) bm->mgmtData)->numFrames);
+		*n = header[1] < numFrames ? header[1] : numFrames;
+		pages = (PageNumber *) malloc(*n * sizeof(PageNumber));
+		if (pages != NULL
+				&& fread(pages, sizeof(PageNumber), *n, in) == (size_t) *n) {
+			qsort(pages, *n, sizeof(PageNumber), comparePageNum);
+		} else {
+			free(pages);
+			pages = NULL;
+		}
+	}
+	fclose(in);
+
+	return pages;
+}
+
+/**
+ * Private utility function to build the name of a sidecar of a file
+ *
+ * fileName = name of the file
+ * suffix = suffix appended to fileName
+ */
+PRIVATE char *getSidecarName(const char * const fileName,
+		const char * const suffix) {
+
+	char *sidecar = (char *) malloc(strlen(fileName) + strlen(suffix) + 1);
+	if (sidecar != NULL) {
+		strcpy(sidecar, fileName);
+		strcat(sidecar, suffix);
+	}
+
+	return sidecar;
+}
+
+/**
+ * Private utility function ordering pages most used first, ties most
+ * recently used first
+ */
+PRIVATE int compareHotness(const void *a, const void *b) {
+
+	const WarmupEntry *x = (const WarmupEntry *) a;
+	const WarmupEntry *y = (const WarmupEntry *) b;
+
+	if (x->useCount != y->useCount) {
+		return x->useCount > y->useCount ? -1 : 1;
+	}
+	if (x->lastUse != y->lastUse) {
+		return x->lastUse > y->lastUse ? -1 : 1;
+	}
+	return 0;
+}
+
+/**
+ * Private utility function ordering page numbers ascending
+ */
+PRIVATE int comparePageNum(const void *a, const void *b) {
+
+	PageNumber x = *(const PageNumber *) a;
+	PageNumber y = *(const PageNumber *) b;
+
+	return (x > y) - (x < y);
+}
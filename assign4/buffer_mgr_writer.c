@@ -0,0 +1,156 @@
+/*
+ * buffer_mgr_writer.c
+ *
+ *  Optional background writer of a buffer pool. It trickles dirty, unpinned
+ *  frames to disk whenever the share of dirty frames rises above a target,
+ *  so that pinPage mostly finds a clean victim and doesn't have to write
+ *  one back before reading the requested page.
+ */
+
+#include "buffer_mgr.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define PRIVATE static
+
+PRIVATE void *writerMain(void *);
+PRIVATE void writerRound(BM_BufferPool * const);
+
+/**
+ * Starts background writer of the pool, if enabled in options
+ *
+ * bm = buffer pool handle
+ * options = pool configuration
+ */
+RC startBackgroundWriter(BM_BufferPool * const bm,
+		const BM_PoolOptions * const options) {
+
+	((BM_Data *) bm->mgmtData)->writerRunning = FALSE;
+	((BM_Data *) bm->mgmtData)->writerStop = FALSE;
+	((BM_Data *) bm->mgmtData)->writerCursor = 0;
+	((BM_Data *) bm->mgmtData)->writerDirtyPercent = 0;
+
+	if (options->backgroundWriter == FALSE || bm->numPages == 0) {
+		return RC_OK;
+	}
+
+	//Number of frames allowed to stay dirty, kept up to date on resize
+	((BM_Data *) bm->mgmtData)->writerDirtyPercent = options->writerDirtyTarget;
+	((BM_Data *) bm->mgmtData)->writerDirtyTarget = bm->numPages
+			* options->writerDirtyTarget / 100;
+	//Rate limit, spread evenly across rounds
+	((BM_Data *) bm->mgmtData)->writerPagesPerRound =
+			options->writerPagesPerSec * BM_WRITER_INTERVAL_MS / 1000;
+	if (((BM_Data *) bm->mgmtData)->writerPagesPerRound < 1) {
+		((BM_Data *) bm->mgmtData)->writerPagesPerRound = 1;
+	}
+
+	pthread_cond_init(&((BM_Data *) bm->mgmtData)->writerCond, NULL);
+	if (pthread_create(&((BM_Data *) bm->mgmtData)->writer, NULL, writerMain,
+			bm) != 0) {
+		pthread_cond_destroy(&((BM_Data *) bm->mgmtData)->writerCond);
+		THROW(RC_WRITER_START_FAILED, "Couldn't start background writer");
+	}
+	((BM_Data *) bm->mgmtData)->writerRunning = TRUE;
+
+	//All OK
+	return RC_OK;
+}
+
+/**
+ * Stops background writer of the pool and waits for it to finish its round.
+ * Caller must not hold the pool latch.
+ *
+ * bm = buffer pool handle
+ */
+void stopBackgroundWriter(BM_BufferPool * const bm) {
+
+	if (((BM_Data *) bm->mgmtData)->writerRunning == FALSE) {
+		return;
+	}
+
+	//Acquire pool latch
+	pthread_mutex_lock(&((BM_Data *) bm->mgmtData)->poolLock);
+	((BM_Data *) bm->mgmtData)->writerStop = TRUE;
+	pthread_cond_signal(&((BM_Data *) bm->mgmtData)->writerCond);
+	//Release pool latch
+	pthread_mutex_unlock(&((BM_Data *) bm->mgmtData)->poolLock);
+
+	pthread_join(((BM_Data *) bm->mgmtData)->writer, NULL);
+	pthread_cond_destroy(&((BM_Data *) bm->mgmtData)->writerCond);
+	((BM_Data *) bm->mgmtData)->writerRunning = FALSE;
+}
+
+/**
+ * Writer thread. Runs a round every BM_WRITER_INTERVAL_MS until stopped.
+ *
+ * arg = buffer pool handle
+ */
+PRIVATE void *writerMain(void *arg) {
+
+	BM_BufferPool * const bm = (BM_BufferPool *) arg;
+	struct timespec wakeUp;
+
+	//Acquire pool latch, it's released while waiting for next round
+	pthread_mutex_lock(&((BM_Data *) bm->mgmtData)->poolLock);
+	while (((BM_Data *) bm->mgmtData)->writerStop == FALSE) {
+		writerRound(bm);
+
+		clock_gettime(CLOCK_REALTIME, &wakeUp);
+		wakeUp.tv_nsec += BM_WRITER_INTERVAL_MS * 1000000L;
+		wakeUp.tv_sec += wakeUp.tv_nsec / 1000000000L;
+		wakeUp.tv_nsec %= 1000000000L;
+		while (((BM_Data *) bm->mgmtData)->writerStop == FALSE
+				&& pthread_cond_timedwait(
+						&((BM_Data *) bm->mgmtData)->writerCond,
+						&((BM_Data *) bm->mgmtData)->poolLock, &wakeUp)
+						!= ETIMEDOUT)
+			;
+	}
+	//Release pool latch
+	pthread_mutex_unlock(&((BM_Data *) bm->mgmtData)->poolLock);
+
+	return NULL;
+}
+
+/**
+ * Writes back dirty, unpinned frames until the pool is down to its dirty
+ * target or the rate limit for this round is used up. Frames are visited
+ * round robin. Caller must hold the pool latch, it's released during each
+ * write.
+ *
+ * bm = buffer pool handle
+ */
+PRIVATE void writerRound(BM_BufferPool * const bm) {
+
+	int written = 0, visited;
+
+	if (ATOMIC_LOAD(((BM_Data *) bm->mgmtData)->numDirtyPages)
+			<= ((BM_Data *) bm->mgmtData)->writerDirtyTarget) {
+		return;
+	}
+
+	for (visited = 0;
+			visited < ((BM_Data *) bm->mgmtData)->numFramesUsed
+					&& written < ((BM_Data *) bm->mgmtData)->writerPagesPerRound
+					&& ATOMIC_LOAD(((BM_Data *) bm->mgmtData)->numDirtyPages)
+							> ((BM_Data *) bm->mgmtData)->writerDirtyTarget
+					&& ((BM_Data *) bm->mgmtData)->writerStop == FALSE;
+			visited++) {
+
+		//Frames past the cursor may be gone after a resize
+		int i = ((BM_Data *) bm->mgmtData)->writerCursor
+				% ((BM_Data *) bm->mgmtData)->numFramesUsed;
+		((BM_Data *) bm->mgmtData)->writerCursor = (i + 1)
+				% ((BM_Data *) bm->mgmtData)->numFramesUsed;
+
+		//Latch is released during the write, frame is claimed meanwhile
+		if (writeBackFrame(bm, i)) {
+			STAT_ADD(((BM_Data *) bm->mgmtData)->stats.writerWrites, 1);
+			written++;
+		}
+	}
+}
@@ -28,6 +28,10 @@ typedef int RC;
 #define	RC_PAGE_NOT_EXIST	56
 #define	RC_ALL_FRAMES_OCCUPIED	57
 #define	RC_NOT_ENOUGH_MEMORY	58
+#define	RC_WRITER_START_FAILED	59
+#define	RC_SHARED_POOL_EXISTS	60
+#define	RC_PAGE_LATCH_BUSY	61
+#define	RC_SHM_FAILED	62
 
 #define	RC_REC_MGR_INVALID_SCHEMA	100
 #define	RC_REC_MGR_INVALID_TBL_NAME	101
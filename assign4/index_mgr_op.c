@@ -46,7 +46,7 @@ Btree* createNode(BTreeHandle* tree) {
 	Btree_stat *stat = tree->mgmtData;
 	BM_PageHandle *page = MAKE_PAGE_HANDLE();
 
-	pinPage(stat->fileInfo, page, 0);
+	pinPageHint(stat->fileInfo, page, 0, BM_RETAIN_STICKY);
 
 	blockNo = -1;
 	memcpy(&blockNo, page->data, sizeof(int));
@@ -538,7 +538,7 @@ RC updateStat(BTreeHandle *handle, Btree_stat* info) {
 	BM_PageHandle *page = MAKE_PAGE_HANDLE();
 
 	// pin the metadata page
-	pinPage(info->fileInfo, page, 0);
+	pinPageHint(info->fileInfo, page, 0, BM_RETAIN_STICKY);
 
 	// use the update metadat function
 	update(page->data, handle->keyType, info->order, info->num_nodes, 2);
@@ -15,7 +15,8 @@
 #define PRIVATE static
 
 PRIVATE RC writeRecord(RM_TableData *rel, Record *record);
-PRIVATE RC readRecord(RM_TableData *rel, RID id, Record **record);
+PRIVATE RC readRecord(RM_TableData *rel, RID id, Record **record,
+		BM_AccessRing *ring);
 
 bool checkIfPKExists(char* name, int size, int pk);
 RC addPrimaryKey(char* name, int size, int pk, RID id);
@@ -137,7 +138,7 @@ RC deleteRecord(RM_TableData *rel, RID id) {
 	Record *record;
 	//Read the record to be deleted
 	createRecord(&record, rel->schema);
-	RC rc = readRecord(rel, id, &record);
+	RC rc = readRecord(rel, id, &record, NULL);
 	if (rc != RC_OK) {
 		THROW(RC_REC_MGR_DELETE_REC_FAILED, "Delete record failed");
 	}
@@ -226,7 +227,7 @@ RC getRecord(RM_TableData *rel, RID id, Record *record) {
 		THROW(RC_INVALID_HANDLE, "Record handle is invalid");
 	}
 
-	return readRecord(rel, id, &record);
+	return readRecord(rel, id, &record, NULL);
 }
 
 /**
@@ -253,12 +254,23 @@ RC startScan(RM_TableData *rel, RM_ScanHandle *scan, Expr *cond) {
 	Record** r;
 	BM_PageHandle *pageData = (BM_PageHandle *) malloc(sizeof(BM_PageHandle));
 	RM_ScanIterator *iter = (RM_ScanIterator*) malloc(sizeof(RM_ScanIterator));
+	BM_AccessRing ring;
 
 	if (pageData == NULL) {
 		THROW(RC_NOT_ENOUGH_MEMORY,
 				"Not enough memory available for resource allocation");
 	}
 
+	//Scan pages through a private ring of frames, so a full pass over a
+	//large table doesn't evict the working set of the pool
+	if (initAccessRing(((RM_TableMgmtData *) rel->mgmtData)->bPool, &ring,
+			BM_SCAN_RING_SIZE) != RC_OK) {
+		free(pageData);
+		free(iter);
+		THROW(RC_NOT_ENOUGH_MEMORY,
+				"Not enough memory available for resource allocation");
+	}
+
 	scan->rel = rel;
 
 	iter->totalRecords = 0;
@@ -285,8 +297,14 @@ RC startScan(RM_TableData *rel, RM_ScanHandle *scan, Expr *cond) {
 			createRecord(&r[j], rel->schema);
 			id.slot = slot;
 
-			RC rc = readRecord(rel, id, &r[j]);
+			RC rc = readRecord(rel, id, &r[j], &ring);
 			if (rc != RC_OK) {
+				//Records matched so far are released by closeScan
+				freeRecord(r[j]);
+				r[j] = NULL;
+				iter->totalRecords = j;
+				freeAccessRing(&ring);
+				free(pageData);
 				THROW(RC_REC_MGR_DELETE_REC_FAILED, "Delete record failed");
 			}
 
@@ -308,6 +326,7 @@ RC startScan(RM_TableData *rel, RM_ScanHandle *scan, Expr *cond) {
 
 	iter->totalRecords = j;
 
+	freeAccessRing(&ring);
 	free(pageData);
 
 	//All OK
@@ -383,12 +402,21 @@ RC updateScan(RM_TableData *rel, Expr *cond, void (*op)(Schema*, Record *)) {
 	Value *result;
 	Record* r;
 	BM_PageHandle *pageData = (BM_PageHandle *) malloc(sizeof(BM_PageHandle));
+	BM_AccessRing ring;
 
 	if (pageData == NULL) {
 		THROW(RC_NOT_ENOUGH_MEMORY,
 				"Not enough memory available for resource allocation");
 	}
 
+	//Scan pages through a private ring of frames, see startScan
+	if (initAccessRing(((RM_TableMgmtData *) rel->mgmtData)->bPool, &ring,
+			BM_SCAN_RING_SIZE) != RC_OK) {
+		free(pageData);
+		THROW(RC_NOT_ENOUGH_MEMORY,
+				"Not enough memory available for resource allocation");
+	}
+
 	j = 0;
 	tuplesRead = 0;
 
@@ -399,8 +427,11 @@ RC updateScan(RM_TableData *rel, Expr *cond, void (*op)(Schema*, Record *)) {
 		while (slot < ((RM_TableMgmtData *) rel->mgmtData)->slotCapacityPage) {
 			createRecord(&r, rel->schema);
 			id.slot = slot;
-			RC rc = readRecord(rel, id, &r);
+			RC rc = readRecord(rel, id, &r, &ring);
 			if (rc != RC_OK) {
+				freeRecord(r);
+				freeAccessRing(&ring);
+				free(pageData);
 				THROW(RC_REC_MGR_DELETE_REC_FAILED, "Delete record failed");
 			}
 
@@ -424,6 +455,7 @@ RC updateScan(RM_TableData *rel, Expr *cond, void (*op)(Schema*, Record *)) {
 		}
 	}
 
+	freeAccessRing(&ring);
 	free(pageData);
 
 	//All OK
@@ -433,9 +465,11 @@ RC updateScan(RM_TableData *rel, Expr *cond, void (*op)(Schema*, Record *)) {
 /**
  * Private utility function to read records from physical storage.
  * It deserializes records stored in page file and returns as Record object.
+ * Scans pass their access ring, other callers NULL.
  *
  */
-PRIVATE RC readRecord(RM_TableData *rel, RID id, Record **record) {
+PRIVATE RC readRecord(RM_TableData *rel, RID id, Record **record,
+		BM_AccessRing *ring) {
 	SerBuffer *ss = malloc(sizeof(SerBuffer));
 	ss->next = 0;
 	ss->size = 0;
@@ -445,26 +479,52 @@ PRIVATE RC readRecord(RM_TableData *rel, RID id, Record **record) {
 	unsigned int slotOffset =
 			((RM_TableMgmtData *) rel->mgmtData)->physicalRecordSize * id.slot;
 
-	BM_PageHandle *page = (BM_PageHandle *) malloc(sizeof(BM_PageHandle));
-
-	if (page == NULL) {
-		THROW(RC_NOT_ENOUGH_MEMORY,
-				"Not enough memory available for resource allocation");
+	//Handle lives on the stack, pin fills in its frame reference, so the
+	//calls below don't look the page up again
+	BM_PageHandle page;
+
+	//Pin the page where record slot is present and latch it shared, so a
+	//concurrent writeRecord can't change the slot while it's copied
+	if (ring != NULL) {
+		RC rc = pinPageWithRing(((RM_TableMgmtData *) rel->mgmtData)->bPool,
+				ring, &page, id.page);
+		if (rc == RC_OK) {
+			rc = latchPage(((RM_TableMgmtData *) rel->mgmtData)->bPool, &page,
+					BM_LATCH_SHARED);
+			if (rc != RC_OK) {
+				unpinPage(((RM_TableMgmtData *) rel->mgmtData)->bPool, &page);
+			}
+		}
+		if (rc != RC_OK) {
+			free(ss->data);
+			free(ss);
+			return rc;
+		}
+	} else {
+		RC rc = pinPageLatched(((RM_TableMgmtData *) rel->mgmtData)->bPool,
+				&page, id.page, BM_LATCH_SHARED);
+		if (rc != RC_OK) {
+			free(ss->data);
+			free(ss);
+			return rc;
+		}
 	}
 
-	//Pin the page where record slot is present
-	pinPage(((RM_TableMgmtData *) rel->mgmtData)->bPool, page, id.page);
-	unpinPage(((RM_TableMgmtData *) rel->mgmtData)->bPool, page);
-
 	//Copy slot data from page to de-serialzation bufffer
-	memcpy(ss->data, page->data + slotOffset,
+	memcpy(ss->data, page.data + slotOffset,
 			((RM_TableMgmtData *) rel->mgmtData)->physicalRecordSize);
+	RC rc = unpinPageLatched(((RM_TableMgmtData *) rel->mgmtData)->bPool,
+			&page);
+	if (rc != RC_OK) {
+		free(ss->data);
+		free(ss);
+		return rc;
+	}
 
 	//Deserialize the record just read
 	deserializeRecordBin(ss, ((RM_TableMgmtData *) rel->mgmtData)->recordSize,
 			record);
 
-	free(page);
 	free(ss->data);
 	free(ss);
 
@@ -493,31 +553,32 @@ PRIVATE RC writeRecord(RM_TableData *rel, Record *record) {
 			((RM_TableMgmtData *) rel->mgmtData)->physicalRecordSize
 			* record->id.slot;
 
-	BM_PageHandle *page = (BM_PageHandle *) malloc(sizeof(BM_PageHandle));
-
-	if (page == NULL) {
-		THROW(RC_NOT_ENOUGH_MEMORY,
-				"Not enough memory available for resource allocation");
+	//Handle lives on the stack, pin fills in its frame reference, so the
+	//calls below don't look the page up again
+	BM_PageHandle page;
+
+	//Pin the page where record is to be written, latched exclusive as other
+	//slots of the page may be read or written concurrently
+	RC rc = pinPageLatched(((RM_TableMgmtData *) rel->mgmtData)->bPool, &page,
+			record->id.page, BM_LATCH_EXCLUSIVE);
+	if (rc == RC_OK) {
+		//Copy serialized record to page slot
+		memcpy(page.data + slotOffset, ss->data,
+				((RM_TableMgmtData *) rel->mgmtData)->physicalRecordSize);
+
+		//Mark page as dirty as record has been written to it
+		rc = markDirty(((RM_TableMgmtData *) rel->mgmtData)->bPool, &page);
+		RC unpinRc = unpinPageLatched(
+				((RM_TableMgmtData *) rel->mgmtData)->bPool, &page);
+		if (rc == RC_OK) {
+			rc = unpinRc;
+		}
 	}
 
-	//Pin the page where record is to be written
-	pinPage(((RM_TableMgmtData *) rel->mgmtData)->bPool, page, record->id.page);
-
-	//Copy serialized record to page slot
-	memcpy(page->data + slotOffset, ss->data,
-			((RM_TableMgmtData *) rel->mgmtData)->physicalRecordSize);
-
-	//Mark page as dirty as record has been written to it
-	markDirty(((RM_TableMgmtData *) rel->mgmtData)->bPool, page);
-	unpinPage(((RM_TableMgmtData *) rel->mgmtData)->bPool, page);
-
-	//	free(page->data);
-	free(page);
 	free(ss->data);
 	free(ss);
 
-	//All OK
-	return RC_OK;
+	return rc;
 }
 
 /**
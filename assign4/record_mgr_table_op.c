@@ -199,7 +199,9 @@ RC openTable(RM_TableData *rel, char *name) {
 				"Not enough memory available for resource allocation");
 	}
 
-	pinPage(((RM_TableMgmtData *) rel->mgmtData)->bPool, tableInfoPage, 0);
+	//Table info page is needed on every insert, keep it in pool
+	pinPageHint(((RM_TableMgmtData *) rel->mgmtData)->bPool, tableInfoPage, 0,
+			BM_RETAIN_STICKY);
 
 	unsigned int *data =
 			(unsigned int*) (&tableInfoPage->data[OFFSET_TOTAL_PAGE]);
@@ -471,7 +473,8 @@ RC freeSchema(Schema *schema) {
 PRIVATE inline void updateTableMetadata(RM_TableData *rel) {
 	BM_PageHandle *tableInfoPage = (BM_PageHandle *) malloc(
 			sizeof(BM_PageHandle));
-	pinPage(((RM_TableMgmtData *) rel->mgmtData)->bPool, tableInfoPage, 0);
+	pinPageHint(((RM_TableMgmtData *) rel->mgmtData)->bPool, tableInfoPage, 0,
+			BM_RETAIN_STICKY);
 
 	unsigned int pageCnt = ((RM_TableMgmtData *) rel->mgmtData)->pageCount;
 	memcpy(tableInfoPage->data + OFFSET_TOTAL_PAGE, (void *) &pageCnt,
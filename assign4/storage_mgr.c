@@ -4,17 +4,59 @@
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
 
 #define PRIVATE static
 #define META_FIELD_SIZE 10
 
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+#endif
+
+// Blocks streamed to a backup file per read
+#define BACKUP_BATCH 16
+
+// Backup state of each block of the page file
+#define BACKUP_PENDING 0
+#define BACKUP_COPYING 1
+#define BACKUP_DONE 2
+
+// Running backup of a page file. Its blocks are streamed in order, but a
+// block about to be overwritten first has its pre-image copied by the
+// writer, so the backup file holds the page file as of startBackup.
+typedef struct SM_Backup {
+	dev_t device;
+	ino_t inode;
+	int numPages;
+	char *blockState;	// BACKUP_* of each block
+	FILE *source;
+	SM_FileHandle target;
+	RC error;	// first failed copy, the backup is unusable then
+	int users;	// writers copying pre-images right now
+	pthread_mutex_t lock;
+	pthread_cond_t changed;	// a block was copied or a writer left
+	struct SM_Backup *next;
+} SM_Backup;
+
+// Running backups, writes only look them up while there are any
+PRIVATE SM_Backup *backups = NULL;
+PRIVATE int numBackups = 0;
+PRIVATE pthread_mutex_t backupsLock = PTHREAD_MUTEX_INITIALIZER;
+// Held shared by writes from looking for a backup until their blocks are
+// written, and exclusive by startBackup while it registers one
+PRIVATE pthread_rwlock_t backupWritesLock = PTHREAD_RWLOCK_INITIALIZER;
+
 int access(const char *, int);
 void updateMetaData(SM_FileHandle *);
 
 PRIVATE RC readBlockGeneric(int, SM_FileHandle *, SM_PageHandle);
 PRIVATE RC writeBlockGeneric(int, SM_FileHandle *, SM_PageHandle);
-
-static short metaChanged = 0;
+PRIVATE RC writeBlockData(int, FILE *, SM_PageHandle);
+PRIVATE void preserveBlocks(FILE *, const int *, int);
+PRIVATE RC copyBlocks(SM_Backup *, int, int);
 
 /**
  *	Initialize Storage Manager.
@@ -105,10 +147,15 @@ RC closePageFile(SM_FileHandle *fHandle) {
 		THROW(RC_FILE_HANDLE_NOT_INIT, "Page file handle not initialized");
 
 	FILE *fp = (FILE*) fHandle->mgmtInfo;
-	//Write updated metadata field to disk only at end
-	if (metaChanged) {
+	//Write updated metadata field to disk only at end. Whether the page
+	//count changed is read back from the file, several page files may be
+	//open at the same time.
+	char numPages[META_FIELD_SIZE + 1];
+	memset(numPages, '\0', META_FIELD_SIZE + 1);
+	fflush(fp);
+	if (pread(fileno(fp), numPages, META_FIELD_SIZE, 0) != META_FIELD_SIZE
+			|| atoi(numPages) != fHandle->totalNumPages) {
 		updateMetaData(fHandle);
-		metaChanged = 0;
 	}
 	fsync(fileno(fp));
 	if (fclose(fp) != 0) {
@@ -162,16 +209,12 @@ PRIVATE RC readBlockGeneric(int pageNum, SM_FileHandle *fHandle,
 
 	FILE *fp = (FILE*) fHandle->mgmtInfo;
 
-	fflush(fp);
-
-	long int currentPos = ftell(fp);
-	long int newPos = ((pageNum) * PAGE_SIZE) + META_FIELD_SIZE;
-
-	if (newPos != currentPos)
-		fseek(fp, (newPos - currentPos), SEEK_CUR);
+	//Positional read leaves the stream position alone, so concurrent reads
+	//and writes of different blocks don't need to be serialized
+	off_t newPos = ((off_t) pageNum * PAGE_SIZE) + META_FIELD_SIZE;
 
 	char buf[PAGE_SIZE];
-	if ((fread(buf, 1, PAGE_SIZE, fp)) != PAGE_SIZE) {
+	if (pread(fileno(fp), buf, PAGE_SIZE, newPos) != PAGE_SIZE) {
 		THROW(RC_READ_FAILED, "Unable to read from specified block");
 	}
 
@@ -195,6 +238,74 @@ RC readBlock(int pageNum, SM_FileHandle *fHandle, SM_PageHandle memPage) {
 	return readBlockGeneric(pageNum, fHandle, memPage);
 }
 
+/**
+ *	Reads n blocks pageNums[0..n-1] into memPages[0..n-1]. Each run of
+ *	consecutive block numbers is read with a single vectored read. Outcome
+ *	for block i is returned in results[i], RC_OK is returned only if all
+ *	blocks were read.
+ *
+ *	pageNums = page file block nos. to be read, ideally sorted
+ *	n = no of blocks to be read
+ *	fHandle = page file handle
+ *	memPages = buffers in which block data read is to be returned
+ *	results = outcome of each block read
+ */
+RC readBlocks(const int *pageNums, int n, SM_FileHandle *fHandle,
+		SM_PageHandle *memPages, RC *results) {
+	//Check if page file handle is init
+	if (fHandle == NULL)
+		THROW(RC_FILE_HANDLE_NOT_INIT, "Page file handle not initialized");
+
+	FILE *fp = (FILE*) fHandle->mgmtInfo;
+	RC ret = RC_OK;
+	int i = 0, j;
+
+	struct iovec *iov = (struct iovec *) malloc(
+			(n > 0 ? n : 1) * sizeof(struct iovec));
+	if (iov == NULL)
+		THROW(RC_READ_FAILED, "Not enough memory for vectored read");
+
+	while (i < n) {
+		//Find run of consecutive, existing blocks starting at i
+		int run = 1;
+		while (i + run < n && run < IOV_MAX
+				&& pageNums[i + run] == pageNums[i] + run
+				&& pageNums[i + run] < fHandle->totalNumPages)
+			run++;
+
+		if (pageNums[i] < 0 || pageNums[i] >= fHandle->totalNumPages) {
+			results[i] = RC_READ_NON_EXISTING_PAGE;
+			ret = results[i];
+			i++;
+			continue;
+		}
+
+		for (j = 0; j < run; j++) {
+			iov[j].iov_base = memPages[i + j];
+			iov[j].iov_len = PAGE_SIZE;
+		}
+		off_t pos = ((off_t) pageNums[i] * PAGE_SIZE) + META_FIELD_SIZE;
+		int whole = preadv(fileno(fp), iov, run, pos)
+				== (ssize_t) run * PAGE_SIZE;
+
+		for (j = 0; j < run; j++) {
+			//Short read, fall back to reading blocks one by one
+			results[i + j] =
+					whole ? RC_OK :
+							readBlockGeneric(pageNums[i + j], fHandle,
+									memPages[i + j]);
+			if (results[i + j] != RC_OK)
+				ret = results[i + j];
+		}
+		fHandle->curPagePos = pageNums[i + run - 1];
+		i += run;
+	}
+
+	free(iov);
+
+	return ret;
+}
+
 /**
  * 	Reads first block of page file
  *
@@ -296,28 +407,43 @@ PRIVATE RC writeBlockGeneric(int pageNum, SM_FileHandle *fHandle,
 	FILE *fp = (FILE*) fHandle->mgmtInfo;
 
 	if (fp) {
+		//Pre-image of the block goes to a running backup first. No backup
+		//can start until the block is written, see startBackup.
+		pthread_rwlock_rdlock(&backupWritesLock);
+		if (__atomic_load_n(&numBackups, __ATOMIC_ACQUIRE) > 0) {
+			preserveBlocks(fp, &pageNum, 1);
+		}
+
 		//Update the current page
 		fHandle->curPagePos = pageNum;
-		int bytes_written = 0;
-
-		long int currentPos = ftell(fp);
-		long int newPos = ((pageNum) * PAGE_SIZE) + META_FIELD_SIZE;
-
-		if (newPos != currentPos)
-			fseek(fp, (newPos - currentPos), SEEK_CUR);
+		RC ret = writeBlockData(pageNum, fp, memPage);
+		pthread_rwlock_unlock(&backupWritesLock);
 
-		bytes_written = fwrite(memPage, 1, PAGE_SIZE, fp);
-		if (bytes_written != PAGE_SIZE) {
-			fclose(fp);
-			THROW(RC_WRITE_FAILED, "Unable to write data to block");
-		}
-		fflush(fp);
-		return RC_OK;
+		return ret;
 	} else {
 		THROW(RC_WRITE_FAILED, "Invalid File Pointer");
 	}
 }
 
+/**
+ *	Private function to write data pointed by memory page memPage to block
+ *	pageNum of page file fp, which must exist.
+ *
+ *	pageNum = index of the block to which data is to be written
+ *	fp = page file
+ *	memPage = buffer containing data to be written to block
+ */
+PRIVATE RC writeBlockData(int pageNum, FILE *fp, SM_PageHandle memPage) {
+	//Positional write, see readBlockGeneric
+	off_t newPos = ((off_t) pageNum * PAGE_SIZE) + META_FIELD_SIZE;
+
+	int bytes_written = pwrite(fileno(fp), memPage, PAGE_SIZE, newPos);
+	if (bytes_written != PAGE_SIZE) {
+		THROW(RC_WRITE_FAILED, "Unable to write data to block");
+	}
+	return RC_OK;
+}
+
 /**
  * 	Writes data pointed by memory page memPage to page of index pageNum, then sets curPagePos to that block,
  * 	then updates curPagePos
@@ -330,6 +456,82 @@ RC writeBlock(int pageNum, SM_FileHandle *fHandle, SM_PageHandle memPage) {
 	return writeBlockGeneric(pageNum, fHandle, memPage);
 }
 
+/**
+ *	Writes n blocks memPages[0..n-1] to blocks pageNums[0..n-1]. Each run of
+ *	consecutive block numbers is written with a single vectored write.
+ *	Outcome for block i is returned in results[i], RC_OK is returned only if
+ *	all blocks were written.
+ *
+ *	pageNums = page file block nos. to be written, ideally sorted
+ *	n = no of blocks to be written
+ *	fHandle = page file handle
+ *	memPages = buffers containing data to be written to blocks
+ *	results = outcome of each block write
+ */
+RC writeBlocks(const int *pageNums, int n, SM_FileHandle *fHandle,
+		SM_PageHandle *memPages, RC *results) {
+	//Check if page file handle is init
+	if (fHandle == NULL)
+		THROW(RC_FILE_HANDLE_NOT_INIT, "Page file handle not initialized");
+
+	FILE *fp = (FILE*) fHandle->mgmtInfo;
+	RC ret = RC_OK;
+	int i = 0, j;
+
+	struct iovec *iov = (struct iovec *) malloc(
+			(n > 0 ? n : 1) * sizeof(struct iovec));
+	if (iov == NULL)
+		THROW(RC_WRITE_FAILED, "Not enough memory for vectored write");
+
+	//Pre-images of the blocks go to a running backup first. No backup can
+	//start until the blocks are written, see startBackup.
+	pthread_rwlock_rdlock(&backupWritesLock);
+	if (__atomic_load_n(&numBackups, __ATOMIC_ACQUIRE) > 0) {
+		preserveBlocks(fp, pageNums, n);
+	}
+
+	while (i < n) {
+		//Find run of consecutive, existing blocks starting at i
+		int run = 1;
+		while (i + run < n && run < IOV_MAX
+				&& pageNums[i + run] == pageNums[i] + run
+				&& pageNums[i + run] < fHandle->totalNumPages)
+			run++;
+
+		if (pageNums[i] < 0 || pageNums[i] >= fHandle->totalNumPages) {
+			results[i] = RC_WRITE_NON_EXISTING_PAGE;
+			ret = results[i];
+			i++;
+			continue;
+		}
+
+		for (j = 0; j < run; j++) {
+			iov[j].iov_base = memPages[i + j];
+			iov[j].iov_len = PAGE_SIZE;
+		}
+		off_t pos = ((off_t) pageNums[i] * PAGE_SIZE) + META_FIELD_SIZE;
+		int whole = pwritev(fileno(fp), iov, run, pos)
+				== (ssize_t) run * PAGE_SIZE;
+
+		for (j = 0; j < run; j++) {
+			//Short write, fall back to writing blocks one by one
+			results[i + j] =
+					whole ? RC_OK :
+							writeBlockData(pageNums[i + j], fp,
+									memPages[i + j]);
+			if (results[i + j] != RC_OK)
+				ret = results[i + j];
+		}
+		fHandle->curPagePos = pageNums[i + run - 1];
+		i += run;
+	}
+	pthread_rwlock_unlock(&backupWritesLock);
+
+	free(iov);
+
+	return ret;
+}
+
 /**
  * 	Writes data pointed by memory page memPage to the page file block pointed by curPagePos
  *
@@ -369,9 +571,6 @@ PRIVATE RC appendEmptyBlockGeneric(SM_FileHandle *fHandle,
 			THROW(RC_WRITE_FAILED, "Unable to write to new block");
 		}
 
-		//Just mark that metadata needs to be written back to file later
-		metaChanged = 1;
-
 		if (memPage == NULL) {
 			free(ph);
 		}
@@ -448,9 +647,6 @@ RC ensureCapacity(int numberOfPages, SM_FileHandle *fHandle) {
 				THROW(RC_WRITE_FAILED, "Unable to write to new block");
 			}
 
-			//Just mark that metadata needs to be written back to file later
-			metaChanged = 1;
-
 			free(ph);
 			fflush(fp);
 
@@ -483,3 +679,281 @@ void updateMetaData(SM_FileHandle *fHandle) {
 	fwrite(ph, 1, META_FIELD_SIZE, fp);
 	free(ph);
 }
+
+/**
+ *	Starts an online backup of page file fileName to backupFileName, which
+ *	is created or overwritten. The backup holds the blocks of the page file
+ *	as they are once writes in flight are done: copyBackupBlocks streams
+ *	them in order while the page file stays open for writes, and a write of
+ *	a block not yet streamed copies its pre-image to the backup first.
+ *	finishBackup completes it.
+ *
+ *	fileName = name of the page file to be backed up
+ *	backupFileName = name of the backup file
+ *	bHandle = backup handle
+ */
+RC startBackup(char *fileName, char *backupFileName,
+		SM_BackupHandle *bHandle) {
+	//Check if backup handle is init
+	if (bHandle == NULL)
+		THROW(RC_FILE_HANDLE_NOT_INIT, "Backup handle not initialized");
+
+	SM_Backup *backup = (SM_Backup *) calloc(1, sizeof(SM_Backup));
+	if (backup == NULL)
+		THROW(RC_WRITE_FAILED, "Not enough memory for backup");
+
+	backup->source = fopen(fileName, "r");
+	if (backup->source == NULL) {
+		free(backup);
+		THROW(RC_FILE_NOT_FOUND, "File not found");
+	}
+
+	//Blocks on disk now make the backup, whatever the file handles say
+	struct stat st, targetSt;
+	fstat(fileno(backup->source), &st);
+	if (stat(backupFileName, &targetSt) == 0 && targetSt.st_dev == st.st_dev
+			&& targetSt.st_ino == st.st_ino) {
+		fclose(backup->source);
+		free(backup);
+		THROW(RC_INVALID_OP, "Page file can't be backed up onto itself");
+	}
+	backup->device = st.st_dev;
+	backup->inode = st.st_ino;
+	backup->numPages = st.st_size > META_FIELD_SIZE ?
+			(st.st_size - META_FIELD_SIZE) / PAGE_SIZE : 0;
+
+	backup->blockState = (char *) calloc(
+			backup->numPages > 0 ? backup->numPages : 1, sizeof(char));
+	RC ret = backup->blockState == NULL ? RC_WRITE_FAILED : RC_OK;
+	if (ret == RC_OK)
+		ret = createPageFile(backupFileName);
+	if (ret == RC_OK)
+		ret = openPageFile(backupFileName, &backup->target);
+	if (ret == RC_OK)
+		ret = ensureCapacity(backup->numPages, &backup->target);
+	if (ret != RC_OK) {
+		fclose(backup->source);
+		free(backup->blockState);
+		free(backup);
+		THROW(ret, "Unable to create backup file");
+	}
+
+	pthread_mutex_init(&backup->lock, NULL);
+	pthread_cond_init(&backup->changed, NULL);
+
+	//One backup of a page file at a time, writes find it from now on.
+	//Writes in flight finish first, they didn't look for a backup.
+	pthread_rwlock_wrlock(&backupWritesLock);
+	pthread_mutex_lock(&backupsLock);
+	SM_Backup *other;
+	for (other = backups; other != NULL; other = other->next) {
+		if (other->device == backup->device && other->inode == backup->inode)
+			break;
+	}
+	if (other != NULL) {
+		pthread_mutex_unlock(&backupsLock);
+		pthread_rwlock_unlock(&backupWritesLock);
+		closePageFile(&backup->target);
+		destroyPageFile(backupFileName);
+		fclose(backup->source);
+		pthread_mutex_destroy(&backup->lock);
+		pthread_cond_destroy(&backup->changed);
+		free(backup->blockState);
+		free(backup);
+		THROW(RC_INVALID_OP, "Page file is already being backed up");
+	}
+	backup->next = backups;
+	backups = backup;
+	__atomic_add_fetch(&numBackups, 1, __ATOMIC_ACQ_REL);
+	pthread_mutex_unlock(&backupsLock);
+	pthread_rwlock_unlock(&backupWritesLock);
+
+	//Initialize backup handle fields
+	bHandle->fileName = fileName;
+	bHandle->backupFileName = backupFileName;
+	bHandle->totalNumPages = backup->numPages;
+	bHandle->nextPage = 0;
+	bHandle->mgmtInfo = backup;
+
+	return RC_OK;
+}
+
+/**
+ *	Streams up to numPages blocks of a running backup, starting at nextPage
+ *	of the handle, and moves nextPage past them. Blocks a writer already
+ *	copied are skipped.
+ *
+ *	bHandle = backup handle
+ *	numPages = no of blocks to be streamed
+ */
+RC copyBackupBlocks(SM_BackupHandle *bHandle, int numPages) {
+	//Check if backup handle is init
+	if (bHandle == NULL || bHandle->mgmtInfo == NULL)
+		THROW(RC_FILE_HANDLE_NOT_INIT, "Backup handle not initialized");
+
+	SM_Backup *backup = (SM_Backup *) bHandle->mgmtInfo;
+	int end = bHandle->nextPage + numPages;
+	if (end > backup->numPages)
+		end = backup->numPages;
+
+	while (bHandle->nextPage < end) {
+		int start = bHandle->nextPage, run = 0;
+
+		//Claim the next run of blocks nobody copied yet
+		pthread_mutex_lock(&backup->lock);
+		while (start < end && backup->blockState[start] != BACKUP_PENDING)
+			start++;
+		while (start + run < end && run < BACKUP_BATCH
+				&& backup->blockState[start + run] == BACKUP_PENDING) {
+			backup->blockState[start + run] = BACKUP_COPYING;
+			run++;
+		}
+		pthread_mutex_unlock(&backup->lock);
+
+		if (run > 0) {
+			RC ret = copyBlocks(backup, start, run);
+			if (ret != RC_OK)
+				THROW(ret, "Unable to copy blocks to backup file");
+		}
+		bHandle->nextPage = start + run;
+	}
+
+	return RC_OK;
+}
+
+/**
+ *	Streams the blocks of a running backup not streamed yet, then stops it
+ *	and closes the backup file. The backup handle is unusable afterwards.
+ *	If a block failed to be copied, the backup file is incomplete and
+ *	RC_WRITE_FAILED is returned.
+ *
+ *	bHandle = backup handle
+ */
+RC finishBackup(SM_BackupHandle *bHandle) {
+	//Check if backup handle is init
+	if (bHandle == NULL || bHandle->mgmtInfo == NULL)
+		THROW(RC_FILE_HANDLE_NOT_INIT, "Backup handle not initialized");
+
+	SM_Backup *backup = (SM_Backup *) bHandle->mgmtInfo;
+	RC ret = backup->error == RC_OK ?
+			copyBackupBlocks(bHandle, backup->numPages) : backup->error;
+
+	//Writes stop finding the backup, then the ones copying blocks are waited
+	pthread_mutex_lock(&backupsLock);
+	SM_Backup **prev = &backups;
+	while (*prev != backup)
+		prev = &(*prev)->next;
+	*prev = backup->next;
+	__atomic_sub_fetch(&numBackups, 1, __ATOMIC_ACQ_REL);
+	pthread_mutex_unlock(&backupsLock);
+
+	pthread_mutex_lock(&backup->lock);
+	while (backup->users > 0)
+		pthread_cond_wait(&backup->changed, &backup->lock);
+	pthread_mutex_unlock(&backup->lock);
+
+	if (ret == RC_OK)
+		ret = backup->error;
+	if (closePageFile(&backup->target) != RC_OK && ret == RC_OK)
+		ret = RC_FILE_CLOSE_FAILED;
+	fclose(backup->source);
+	pthread_mutex_destroy(&backup->lock);
+	pthread_cond_destroy(&backup->changed);
+	free(backup->blockState);
+	free(backup);
+	bHandle->mgmtInfo = NULL;
+
+	if (ret != RC_OK)
+		THROW(ret, "Backup file is incomplete");
+
+	return RC_OK;
+}
+
+/**
+ *	Private function to copy the pre-images of n blocks about to be written
+ *	to page file fp to its running backup, if there is one. Blocks the
+ *	backup already holds or doesn't cover are left alone. A block being
+ *	streamed right now is waited for, a failed copy only spoils the backup.
+ *
+ *	fp = page file about to be written
+ *	pageNums = page file block nos. to be written
+ *	n = no of blocks to be written
+ */
+PRIVATE void preserveBlocks(FILE *fp, const int *pageNums, int n) {
+	struct stat st;
+	SM_Backup *backup;
+	int i;
+
+	if (fstat(fileno(fp), &st) != 0)
+		return;
+
+	pthread_mutex_lock(&backupsLock);
+	for (backup = backups; backup != NULL; backup = backup->next) {
+		if (backup->device == st.st_dev && backup->inode == st.st_ino)
+			break;
+	}
+	if (backup != NULL) {
+		pthread_mutex_lock(&backup->lock);
+		backup->users++;
+		pthread_mutex_unlock(&backup->lock);
+	}
+	pthread_mutex_unlock(&backupsLock);
+	if (backup == NULL)
+		return;
+
+	pthread_mutex_lock(&backup->lock);
+	for (i = 0; i < n; i++) {
+		int pageNum = pageNums[i];
+		if (pageNum < 0 || pageNum >= backup->numPages)
+			continue;
+		while (backup->blockState[pageNum] == BACKUP_COPYING)
+			pthread_cond_wait(&backup->changed, &backup->lock);
+		if (backup->blockState[pageNum] == BACKUP_DONE)
+			continue;
+
+		backup->blockState[pageNum] = BACKUP_COPYING;
+		pthread_mutex_unlock(&backup->lock);
+		copyBlocks(backup, pageNum, 1);
+		pthread_mutex_lock(&backup->lock);
+	}
+	backup->users--;
+	pthread_cond_broadcast(&backup->changed);
+	pthread_mutex_unlock(&backup->lock);
+}
+
+/**
+ *	Private function to copy run consecutive blocks from start of the page
+ *	file to its backup file. The blocks must be claimed as BACKUP_COPYING,
+ *	they are BACKUP_DONE afterwards, even if copying failed.
+ *
+ *	backup = running backup
+ *	start = first block to be copied
+ *	run = no of blocks to be copied
+ */
+PRIVATE RC copyBlocks(SM_Backup *backup, int start, int run) {
+	RC ret = RC_OK;
+	int i;
+
+	char *buf = (char *) malloc((size_t) run * PAGE_SIZE);
+	off_t pos = ((off_t) start * PAGE_SIZE) + META_FIELD_SIZE;
+	if (buf == NULL) {
+		ret = RC_WRITE_FAILED;
+	} else if (pread(fileno(backup->source), buf, (size_t) run * PAGE_SIZE,
+			pos) != (ssize_t) run * PAGE_SIZE) {
+		ret = RC_READ_FAILED;
+	} else if (pwrite(fileno((FILE*) backup->target.mgmtInfo), buf,
+			(size_t) run * PAGE_SIZE, pos) != (ssize_t) run * PAGE_SIZE) {
+		ret = RC_WRITE_FAILED;
+	}
+	free(buf);
+
+	pthread_mutex_lock(&backup->lock);
+	for (i = 0; i < run; i++)
+		backup->blockState[start + i] = BACKUP_DONE;
+	if (ret != RC_OK && backup->error == RC_OK)
+		backup->error = ret;
+	pthread_cond_broadcast(&backup->changed);
+	pthread_mutex_unlock(&backup->lock);
+
+	return ret;
+}
@@ -15,6 +15,14 @@ typedef struct SM_FileHandle {
 
 typedef char* SM_PageHandle;
 
+typedef struct SM_BackupHandle {
+	char *fileName;
+	char *backupFileName;
+	int totalNumPages;	// of the page file when the backup started
+	int nextPage;	// next block streamed to the backup file
+	void *mgmtInfo;
+} SM_BackupHandle;
+
 /************************************************************
  *                    interface                             *
  ************************************************************/
@@ -27,6 +35,8 @@ extern RC destroyPageFile(char *fileName);
 
 /* reading blocks from disc */
 extern RC readBlock(int pageNum, SM_FileHandle *fHandle, SM_PageHandle memPage);
+extern RC readBlocks(const int *pageNums, int n, SM_FileHandle *fHandle,
+		SM_PageHandle *memPages, RC *results);
 extern int getBlockPos(SM_FileHandle *fHandle);
 extern RC readFirstBlock(SM_FileHandle *fHandle, SM_PageHandle memPage);
 extern RC readPreviousBlock(SM_FileHandle *fHandle, SM_PageHandle memPage);
@@ -37,10 +47,18 @@ extern RC readLastBlock(SM_FileHandle *fHandle, SM_PageHandle memPage);
 /* writing blocks to a page file */
 extern RC writeBlock(int pageNum, SM_FileHandle *fHandle,
 		SM_PageHandle memPage);
+extern RC writeBlocks(const int *pageNums, int n, SM_FileHandle *fHandle,
+		SM_PageHandle *memPages, RC *results);
 extern RC writeCurrentBlock(SM_FileHandle *fHandle, SM_PageHandle memPage);
 extern RC appendEmptyBlock(SM_FileHandle *fHandle);
 extern RC ensureCapacity(int numberOfPages, SM_FileHandle *fHandle);
 
 extern RC appendEmptyBlockData(SM_FileHandle *fHandle, SM_PageHandle memPage);
 
+/* online backup of a page file */
+extern RC startBackup(char *fileName, char *backupFileName,
+		SM_BackupHandle *bHandle);
+extern RC copyBackupBlocks(SM_BackupHandle *bHandle, int numPages);
+extern RC finishBackup(SM_BackupHandle *bHandle);
+
 #endif
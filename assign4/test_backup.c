@@ -0,0 +1,407 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+
+#include "storage_mgr.h"
+#include "buffer_mgr.h"
+#include "dberror.h"
+#include "test_helper.h"
+
+// test name
+char *testName;
+
+/* test output files */
+#define TESTPF "test_backup.bin"
+#define TESTBF "test_backup.bak"
+
+/* no of blocks in the page file and writer threads */
+#define NUM_BLOCKS 64
+#define NUM_WRITERS 4
+
+/* pool backups: pool size, blocks of the page file a pool writes to during
+ * its backup and shared memory segment of the pool that can't be backed up */
+#define NUM_FRAMES 4
+#define POOL_BLOCKS 4096
+#define TESTSHM "/test_backup"
+
+/* page file written through a pool by a thread while the pool is backed up */
+typedef struct PoolWriter {
+	BM_BufferPool *bm;
+	volatile int backupDone;
+	volatile int numWrites;	/* pages written, the last one first */
+	int writesBeforeDone;	/* of them done before the backup returned */
+} PoolWriter;
+
+/* prototypes for test functions */
+static void testBackupWithoutWrites(void);
+static void testWritesDuringBackup(void);
+static void testConcurrentWritesDuringBackup(void);
+static void testPoolBackupFlushes(void);
+static void testShmPoolRefused(void);
+static void testPoolWritesDuringBackup(void);
+
+/* helper methods */
+static void createBlocks(char *fileName, char *tag, int numBlocks);
+static void checkBlocks(char *fileName, char *tag);
+static void *writeBlocksThread(void *arg);
+static void checkBlock(SM_FileHandle *fh, int pageNum, char *tag);
+static void *writePoolPagesThread(void *arg);
+
+/* main function running all tests */
+int main(void) {
+	testName = "";
+
+	initStorageManager();
+
+	testBackupWithoutWrites();
+	testWritesDuringBackup();
+	testConcurrentWritesDuringBackup();
+	testPoolBackupFlushes();
+	testShmPoolRefused();
+	testPoolWritesDuringBackup();
+
+	return 0;
+}
+
+/* back up a page file nobody writes and compare backup with page file */
+void testBackupWithoutWrites(void) {
+	SM_BackupHandle bh;
+
+	testName = "test backup of an idle page file";
+
+	createBlocks(TESTPF, "pre", NUM_BLOCKS);
+
+	TEST_CHECK(startBackup(TESTPF, TESTBF, &bh));
+	ASSERT_EQUALS_INT(NUM_BLOCKS, bh.totalNumPages,
+			"backup covers all blocks of page file");
+	ASSERT_ERROR(startBackup(TESTPF, "test_backup2.bak", &bh),
+			"page file can only have one running backup");
+	TEST_CHECK(finishBackup(&bh));
+	ASSERT_ERROR(startBackup(TESTPF, TESTPF, &bh),
+			"page file can't be backed up onto itself");
+
+	checkBlocks(TESTBF, "pre");
+	checkBlocks(TESTPF, "pre");
+
+	TEST_CHECK(destroyPageFile(TESTPF));
+	TEST_CHECK(destroyPageFile(TESTBF));
+
+	TEST_DONE();
+}
+
+/* overwrite blocks streamed and not yet streamed while a backup runs, the
+ * backup must hold the blocks as of startBackup */
+void testWritesDuringBackup(void) {
+	SM_FileHandle fh;
+	SM_BackupHandle bh;
+	SM_PageHandle ph = (SM_PageHandle) malloc(PAGE_SIZE);
+	SM_PageHandle pages[NUM_BLOCKS];
+	int pageNums[NUM_BLOCKS];
+	RC results[NUM_BLOCKS];
+	int i, n = 0;
+
+	testName = "test writes during backup";
+
+	createBlocks(TESTPF, "pre", NUM_BLOCKS);
+	TEST_CHECK(openPageFile(TESTPF, &fh));
+
+	TEST_CHECK(startBackup(TESTPF, TESTBF, &bh));
+	TEST_CHECK(copyBackupBlocks(&bh, NUM_BLOCKS / 4));
+	ASSERT_EQUALS_INT(NUM_BLOCKS / 4, bh.nextPage,
+			"first quarter of blocks streamed");
+
+	// single block writes cover the first half, vectored writes the rest
+	for (i = 0; i < NUM_BLOCKS / 2; i++) {
+		memset(ph, 0, PAGE_SIZE);
+		sprintf(ph, "post-%i", i);
+		TEST_CHECK(writeBlock(i, &fh, ph));
+	}
+	for (i = NUM_BLOCKS / 2; i < NUM_BLOCKS; i++) {
+		pages[n] = (SM_PageHandle) calloc(1, PAGE_SIZE);
+		sprintf(pages[n], "post-%i", i);
+		pageNums[n++] = i;
+	}
+	TEST_CHECK(writeBlocks(pageNums, n, &fh, pages, results));
+
+	TEST_CHECK(finishBackup(&bh));
+	TEST_CHECK(closePageFile(&fh));
+
+	checkBlocks(TESTBF, "pre");
+	checkBlocks(TESTPF, "post");
+
+	TEST_CHECK(destroyPageFile(TESTPF));
+	TEST_CHECK(destroyPageFile(TESTBF));
+	for (i = 0; i < n; i++)
+		free(pages[i]);
+	free(ph);
+
+	TEST_DONE();
+}
+
+/* threads overwrite all blocks over and over while the backup is streamed,
+ * the backup must hold the blocks as of startBackup */
+void testConcurrentWritesDuringBackup(void) {
+	SM_FileHandle fh;
+	SM_BackupHandle bh;
+	pthread_t writers[NUM_WRITERS];
+	int i;
+
+	testName = "test concurrent writes during backup";
+
+	createBlocks(TESTPF, "pre", NUM_BLOCKS);
+	TEST_CHECK(openPageFile(TESTPF, &fh));
+
+	TEST_CHECK(startBackup(TESTPF, TESTBF, &bh));
+	for (i = 0; i < NUM_WRITERS; i++)
+		pthread_create(&writers[i], NULL, writeBlocksThread, &fh);
+	while (bh.nextPage < NUM_BLOCKS)
+		TEST_CHECK(copyBackupBlocks(&bh, 1));
+	for (i = 0; i < NUM_WRITERS; i++)
+		pthread_join(writers[i], NULL);
+	TEST_CHECK(finishBackup(&bh));
+	TEST_CHECK(closePageFile(&fh));
+
+	checkBlocks(TESTBF, "pre");
+	checkBlocks(TESTPF, "post");
+
+	TEST_CHECK(destroyPageFile(TESTPF));
+	TEST_CHECK(destroyPageFile(TESTBF));
+
+	TEST_DONE();
+}
+
+/* dirty pages of a pool are written back before the snapshot is taken,
+ * except pinned ones, which are backed up as they are on disk */
+void testPoolBackupFlushes(void) {
+	BM_BufferPool *bm = MAKE_POOL();
+	BM_PageHandle *h = MAKE_PAGE_HANDLE();
+	BM_PageHandle *pinned = MAKE_PAGE_HANDLE();
+	SM_FileHandle fh;
+	int i;
+
+	testName = "test pool backup writes back dirty pages";
+
+	createBlocks(TESTPF, "pre", NUM_BLOCKS);
+	TEST_CHECK(initBufferPool(bm, TESTPF, NUM_FRAMES, RS_FIFO, NULL));
+	TEST_CHECK(pinPage(bm, h, 1));
+	sprintf(h->data, "dirty-1");
+	TEST_CHECK(markDirty(bm, h));
+	TEST_CHECK(unpinPage(bm, h));
+	TEST_CHECK(pinPage(bm, pinned, 2));
+	sprintf(pinned->data, "dirty-2");
+	TEST_CHECK(markDirty(bm, pinned));
+
+	TEST_CHECK(backupPool(bm, TESTBF));
+	ASSERT_EQUALS_INT(1, getNumWriteIO(bm), "unpinned dirty page written");
+
+	TEST_CHECK(openPageFile(TESTBF, &fh));
+	ASSERT_EQUALS_INT(NUM_BLOCKS, fh.totalNumPages, "no of blocks");
+	for (i = 0; i < NUM_BLOCKS; i++)
+		checkBlock(&fh, i, i == 1 ? "dirty" : "pre");
+	TEST_CHECK(closePageFile(&fh));
+
+	TEST_CHECK(unpinPage(bm, pinned));
+	TEST_CHECK(shutdownBufferPool(bm));
+	TEST_CHECK(openPageFile(TESTPF, &fh));
+	checkBlock(&fh, 2, "dirty");
+	TEST_CHECK(closePageFile(&fh));
+
+	ASSERT_ERROR(backupPool(bm, TESTBF), "pool is shut down");
+
+	TEST_CHECK(destroyPageFile(TESTPF));
+	TEST_CHECK(destroyPageFile(TESTBF));
+	free(pinned);
+	free(h);
+	free(bm);
+
+	TEST_DONE();
+}
+
+/* other clients of a shared memory pool write the page file unseen, so
+ * such pools aren't backed up */
+void testShmPoolRefused(void) {
+	BM_BufferPool *bm = MAKE_POOL();
+	BM_PoolOptions options;
+
+	testName = "test shared memory pool backup refused";
+
+	createBlocks(TESTPF, "pre", NUM_BLOCKS);
+	initPoolOptions(&options);
+	options.shmName = TESTSHM;
+	TEST_CHECK(initBufferPoolWithOptions(bm, TESTPF, NUM_FRAMES, RS_CLOCK,
+			NULL, &options));
+	ASSERT_ERROR(backupPool(bm, TESTBF), "shared memory pool refused");
+	ASSERT_TRUE(access(TESTBF, F_OK) != 0, "no backup file created");
+	TEST_CHECK(shutdownBufferPool(bm));
+
+	TEST_CHECK(destroyPageFile(TESTPF));
+	free(bm);
+
+	TEST_DONE();
+}
+
+/* a thread dirties pages, the last one first, and a small pool evicts them
+ * while the pool is backed up. Pages are written in the order they were
+ * dirtied, so the snapshot holds the new content of the first ones and the
+ * pre-images of all others. */
+void testPoolWritesDuringBackup(void) {
+	BM_BufferPool *bm = MAKE_POOL();
+	SM_FileHandle fh;
+	SM_PageHandle ph = (SM_PageHandle) malloc(PAGE_SIZE);
+	PoolWriter writer;
+	pthread_t thread;
+	char expected[64];
+	int i, numNew = 0, ok = 1;
+
+	testName = "test pool writes during pool backup";
+
+	createBlocks(TESTPF, "pre", POOL_BLOCKS);
+	TEST_CHECK(initBufferPool(bm, TESTPF, NUM_FRAMES, RS_FIFO, NULL));
+	writer.bm = bm;
+	writer.backupDone = 0;
+	writer.numWrites = 0;
+	writer.writesBeforeDone = 0;
+	pthread_create(&thread, NULL, writePoolPagesThread, &writer);
+	/* let the thread fill the pool so that it evicts pages during the copy */
+	while (writer.numWrites < NUM_FRAMES)
+		sched_yield();
+	TEST_CHECK(backupPool(bm, TESTBF));
+	writer.backupDone = 1;
+	pthread_join(thread, NULL);
+	TEST_CHECK(shutdownBufferPool(bm));
+
+	/* pages as of the snapshot: new content up to some page in write order,
+	 * pre-images from there on */
+	TEST_CHECK(openPageFile(TESTBF, &fh));
+	ASSERT_EQUALS_INT(POOL_BLOCKS, fh.totalNumPages, "no of blocks");
+	for (i = POOL_BLOCKS - 1; i >= 0; i--) {
+		TEST_CHECK(readBlock(i, &fh, ph));
+		sprintf(expected, "post-%i", i);
+		if (numNew == POOL_BLOCKS - 1 - i && strcmp(expected, ph) == 0) {
+			numNew++;
+			continue;
+		}
+		sprintf(expected, "pre-%i", i);
+		if (strcmp(expected, ph) != 0) {
+			printf("block %i of %s: expected <%s> but was <%s>\n", i, TESTBF,
+					expected, ph);
+			ok = 0;
+		}
+	}
+	ASSERT_TRUE(ok, "backup holds the snapshot");
+	ASSERT_TRUE(numNew < writer.writesBeforeDone,
+			"pages written after the snapshot during the backup");
+	TEST_CHECK(closePageFile(&fh));
+
+	/* every page the thread dirtied reached the page file */
+	TEST_CHECK(openPageFile(TESTPF, &fh));
+	for (i = POOL_BLOCKS - writer.numWrites; i < POOL_BLOCKS; i++)
+		checkBlock(&fh, i, "post");
+	TEST_CHECK(closePageFile(&fh));
+
+	TEST_CHECK(destroyPageFile(TESTPF));
+	TEST_CHECK(destroyPageFile(TESTBF));
+	free(ph);
+	free(bm);
+
+	TEST_DONE();
+}
+
+/* create page file fileName with numBlocks blocks "<tag>-<block no>" */
+void createBlocks(char *fileName, char *tag, int numBlocks) {
+	SM_FileHandle fh;
+	SM_PageHandle ph = (SM_PageHandle) malloc(PAGE_SIZE);
+	int i;
+
+	TEST_CHECK(createPageFile(fileName));
+	TEST_CHECK(openPageFile(fileName, &fh));
+	TEST_CHECK(ensureCapacity(numBlocks, &fh));
+	for (i = 0; i < numBlocks; i++) {
+		memset(ph, 0, PAGE_SIZE);
+		sprintf(ph, "%s-%i", tag, i);
+		TEST_CHECK(writeBlock(i, &fh, ph));
+	}
+	TEST_CHECK(closePageFile(&fh));
+
+	free(ph);
+}
+
+/* check that all blocks of page file fileName read "<tag>-<block no>" */
+void checkBlocks(char *fileName, char *tag) {
+	SM_FileHandle fh;
+	SM_PageHandle ph = (SM_PageHandle) malloc(PAGE_SIZE);
+	char expected[64];
+	int i, ok = 1;
+
+	TEST_CHECK(openPageFile(fileName, &fh));
+	ASSERT_EQUALS_INT(NUM_BLOCKS, fh.totalNumPages, "no of blocks");
+	for (i = 0; i < NUM_BLOCKS; i++) {
+		TEST_CHECK(readBlock(i, &fh, ph));
+		sprintf(expected, "%s-%i", tag, i);
+		if (strcmp(expected, ph) != 0) {
+			printf("block %i of %s: expected <%s> but was <%s>\n", i, fileName,
+					expected, ph);
+			ok = 0;
+		}
+	}
+	ASSERT_TRUE(ok, "blocks hold expected content");
+	TEST_CHECK(closePageFile(&fh));
+
+	free(ph);
+}
+
+/* overwrite all blocks of the page file a few times, with "post" content */
+void *writeBlocksThread(void *arg) {
+	SM_FileHandle fh = *(SM_FileHandle *) arg;
+	SM_PageHandle ph = (SM_PageHandle) malloc(PAGE_SIZE);
+	int i, round;
+
+	for (round = 0; round < 8; round++) {
+		for (i = 0; i < NUM_BLOCKS; i++) {
+			memset(ph, 0, PAGE_SIZE);
+			sprintf(ph, "post-%i", i);
+			TEST_CHECK(writeBlock(i, &fh, ph));
+		}
+	}
+
+	free(ph);
+	return NULL;
+}
+
+/* check that block pageNum of open page file fh reads "<tag>-<block no>" */
+void checkBlock(SM_FileHandle *fh, int pageNum, char *tag) {
+	SM_PageHandle ph = (SM_PageHandle) malloc(PAGE_SIZE);
+	char expected[64];
+
+	TEST_CHECK(readBlock(pageNum, fh, ph));
+	sprintf(expected, "%s-%i", tag, pageNum);
+	ASSERT_EQUALS_STRING(expected, ph, "block holds expected content");
+
+	free(ph);
+}
+
+/* dirty pages of the pool with "post" content, the last one first, until
+ * the backup is done and a few more pages are written */
+void *writePoolPagesThread(void *arg) {
+	PoolWriter *writer = (PoolWriter *) arg;
+	BM_PageHandle h;
+	int i, after = 0;
+
+	for (i = POOL_BLOCKS - 1; i >= 0 && after < NUM_FRAMES; i--) {
+		TEST_CHECK(pinPage(writer->bm, &h, i));
+		memset(h.data, 0, PAGE_SIZE);
+		sprintf(h.data, "post-%i", i);
+		TEST_CHECK(markDirty(writer->bm, &h));
+		TEST_CHECK(unpinPage(writer->bm, &h));
+		writer->numWrites++;
+		if (writer->backupDone)
+			after++;
+		else
+			writer->writesBeforeDone = writer->numWrites;
+	}
+
+	return NULL;
+}
@@ -0,0 +1,118 @@
+#include "dberror.h"
+#include "test_helper.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// var to store the current test's name
+char *testName;
+
+/* short benchmark run: pins per thread and pages of its page file */
+#define BENCH "./bench_buffer 200 64"
+#define BENCH_FILE "bench_buffer.bin"
+#define FILE_PAGES 64
+
+/* workloads, strategies and pool sizes of a run */
+#define NUM_WORKLOADS 7
+#define NUM_STRATEGIES 6
+#define NUM_POOL_SIZES 3
+
+// test and helper methods
+static void testBenchRuns(void);
+static void testBenchResults(void);
+
+static int poolSizeOf(int run);
+
+// main method
+int main(void) {
+	testName = "";
+
+	testBenchRuns();
+	testBenchResults();
+
+	return 0;
+}
+
+// every workload runs against every strategy and pool size
+void testBenchRuns(void) {
+	char line[256], workload[16], strategy[16];
+	int threads, pages, rc, rows = 0, mtRows = 0;
+	double pinsPerSec, ratio, p50, p99;
+	long failed;
+	FILE *fp;
+	testName = "Benchmark runs";
+
+	fp = popen(BENCH, "r");
+	ASSERT_TRUE(fp != NULL, "bench_buffer started");
+	ASSERT_TRUE(fgets(line, sizeof(line), fp) != NULL, "settings printed");
+	line[strcspn(line, "\n")] = '\0';
+	ASSERT_EQUALS_STRING("200 pins per thread, 64 pages in page file", line,
+			"settings from the command line");
+	while (fgets(line, sizeof(line), fp) != NULL) {
+		if (sscanf(line, "%15s %d %15s %d %lf %lf %lf %lf %ld", workload,
+				&threads, strategy, &pages, &pinsPerSec, &ratio, &p50, &p99,
+				&failed) != 9) {
+			continue;
+		}
+		if (strcmp(workload, "zipf-mt") == 0) {
+			mtRows++;
+			ASSERT_TRUE(threads > 1, "zipf-mt runs several threads");
+		} else {
+			ASSERT_EQUALS_INT(1, threads, "single threaded workload");
+			ASSERT_EQUALS_INT(poolSizeOf(rows), pages,
+					"pool size in 1/1000 of page file");
+		}
+		rows++;
+	}
+	rc = pclose(fp);
+	ASSERT_EQUALS_INT(0, rc, "bench_buffer succeeded");
+	ASSERT_EQUALS_INT(NUM_WORKLOADS * NUM_STRATEGIES * NUM_POOL_SIZES, rows,
+			"a run per workload, strategy and pool size");
+	ASSERT_EQUALS_INT(3 * NUM_STRATEGIES * NUM_POOL_SIZES, mtRows,
+			"zipf-mt with 2, 4 and 8 threads");
+	ASSERT_TRUE(access(BENCH_FILE, F_OK) != 0, "scratch page file removed");
+
+	TEST_DONE();
+}
+
+// hit ratios are ratios, strategies that pick victims never fail pins
+void testBenchResults(void) {
+	char line[256], workload[16], strategy[16];
+	int threads, pages, rc;
+	double pinsPerSec, ratio, p50, p99;
+	long failed;
+	FILE *fp;
+	testName = "Benchmark results";
+
+	fp = popen(BENCH, "r");
+	ASSERT_TRUE(fp != NULL, "bench_buffer started");
+	while (fgets(line, sizeof(line), fp) != NULL) {
+		if (sscanf(line, "%15s %d %15s %d %lf %lf %lf %lf %ld", workload,
+				&threads, strategy, &pages, &pinsPerSec, &ratio, &p50, &p99,
+				&failed) != 9) {
+			continue;
+		}
+		ASSERT_TRUE(pinsPerSec > 0, "pins per second measured");
+		ASSERT_TRUE(ratio >= 0 && ratio <= 1, "hit ratio within [0, 1]");
+		ASSERT_TRUE(p50 <= p99, "p50 no more than p99");
+		if (threads == 1 && (strcmp(strategy, "FIFO") == 0
+				|| strcmp(strategy, "LRU") == 0
+				|| strcmp(strategy, "LFU") == 0)) {
+			ASSERT_EQUALS_INT(0, (int) failed, "no failed pins");
+		}
+	}
+	rc = pclose(fp);
+	ASSERT_EQUALS_INT(0, rc, "bench_buffer succeeded");
+
+	TEST_DONE();
+}
+
+// pool size of single threaded run no run, at least 2 pages
+int poolSizeOf(int run) {
+	int sizes[NUM_POOL_SIZES] = { 16, 125, 500 };
+	int pages = FILE_PAGES * sizes[run % NUM_POOL_SIZES] / 1000;
+
+	return pages < 2 ? 2 : pages;
+}
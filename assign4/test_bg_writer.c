@@ -0,0 +1,235 @@
+#include "storage_mgr.h"
+#include "buffer_mgr_stat.h"
+#include "buffer_mgr.h"
+#include "dberror.h"
+#include "test_helper.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// var to store the current test's name
+char *testName;
+
+/* page file and pool used by all tests */
+#define TESTPF "test_bg_writer.bin"
+#define NUM_FRAMES 10
+#define NUM_BLOCKS 20
+
+/* ms the writer is given to catch up, and to prove it stays idle */
+#define WRITER_TIMEOUT_MS 5000
+#define WRITER_IDLE_MS (3 * BM_WRITER_INTERVAL_MS)
+
+// test and helper methods
+static void testWriterCleansPages(void);
+static void testWriterSkipsPinnedPages(void);
+static void testWriterDirtyTarget(void);
+static void testWriterDisabled(void);
+
+static void createBlocks(void);
+static void initWriterPool(BM_BufferPool *bm, int dirtyTarget);
+static void dirtyPages(BM_BufferPool *bm, int numPages, bool keepPinned);
+static void waitForWrites(BM_BufferPool *bm, int numWrites);
+static int countDirty(BM_BufferPool *bm);
+static void checkFile(int numPages);
+
+// main method
+int main(void) {
+	initStorageManager();
+	testName = "";
+
+	testWriterCleansPages();
+	testWriterSkipsPinnedPages();
+	testWriterDirtyTarget();
+	testWriterDisabled();
+
+	return 0;
+}
+
+// dirty, unpinned pages reach the page file without any flush
+void testWriterCleansPages(void) {
+	BM_BufferPool *bm = MAKE_POOL();
+	testName = "Background writer cleans dirty pages";
+
+	createBlocks();
+	initWriterPool(bm, 0);
+
+	dirtyPages(bm, NUM_FRAMES, FALSE);
+	waitForWrites(bm, NUM_FRAMES);
+	ASSERT_EQUALS_INT(NUM_FRAMES, getNumWriterWriteIO(bm),
+			"writer wrote every dirty page");
+	ASSERT_EQUALS_INT(0, countDirty(bm), "no dirty frames left");
+	ASSERT_EQUALS_INT(NUM_FRAMES, getNumWriteIO(bm),
+			"writer writes count as pool writes");
+	checkFile(NUM_FRAMES);
+
+	TEST_CHECK(shutdownBufferPool(bm));
+	TEST_CHECK(destroyPageFile(TESTPF));
+
+	free(bm);
+	TEST_DONE();
+}
+
+// pinned pages are left alone until they are unpinned
+void testWriterSkipsPinnedPages(void) {
+	BM_BufferPool *bm = MAKE_POOL();
+	BM_PageHandle *h = MAKE_PAGE_HANDLE();
+	int i;
+	testName = "Background writer skips pinned pages";
+
+	createBlocks();
+	initWriterPool(bm, 0);
+
+	dirtyPages(bm, NUM_FRAMES, TRUE);
+	usleep(WRITER_IDLE_MS * 1000);
+	ASSERT_EQUALS_INT(0, getNumWriterWriteIO(bm), "pinned pages not written");
+	ASSERT_EQUALS_INT(NUM_FRAMES, countDirty(bm), "pinned pages stay dirty");
+
+	for (i = 0; i < NUM_FRAMES; i++) {
+		h->pageNum = i;
+		TEST_CHECK(unpinPage(bm, h));
+	}
+	waitForWrites(bm, NUM_FRAMES);
+	ASSERT_EQUALS_INT(0, countDirty(bm), "unpinned pages written");
+	checkFile(NUM_FRAMES);
+
+	TEST_CHECK(shutdownBufferPool(bm));
+	TEST_CHECK(destroyPageFile(TESTPF));
+
+	free(bm);
+	free(h);
+	TEST_DONE();
+}
+
+// writer stops once the share of dirty frames is down to its target
+void testWriterDirtyTarget(void) {
+	BM_BufferPool *bm = MAKE_POOL();
+	testName = "Background writer dirty target";
+
+	createBlocks();
+	initWriterPool(bm, 50);
+
+	dirtyPages(bm, NUM_FRAMES, FALSE);
+	waitForWrites(bm, NUM_FRAMES / 2);
+	usleep(WRITER_IDLE_MS * 1000);
+	ASSERT_EQUALS_INT(NUM_FRAMES / 2, getNumWriterWriteIO(bm),
+			"writer wrote down to target");
+	ASSERT_EQUALS_INT(NUM_FRAMES / 2, countDirty(bm),
+			"target share of frames stays dirty");
+
+	TEST_CHECK(shutdownBufferPool(bm));
+	TEST_CHECK(destroyPageFile(TESTPF));
+
+	free(bm);
+	TEST_DONE();
+}
+
+// pools without a writer keep their dirty pages until flushed
+void testWriterDisabled(void) {
+	BM_BufferPool *bm = MAKE_POOL();
+	testName = "Pool without background writer";
+
+	createBlocks();
+	TEST_CHECK(initBufferPool(bm, TESTPF, NUM_FRAMES, RS_FIFO, NULL));
+
+	dirtyPages(bm, NUM_FRAMES, FALSE);
+	usleep(WRITER_IDLE_MS * 1000);
+	ASSERT_EQUALS_INT(0, getNumWriterWriteIO(bm), "nothing written");
+	ASSERT_EQUALS_INT(NUM_FRAMES, countDirty(bm), "pages stay dirty");
+	TEST_CHECK(forceFlushPool(bm));
+	checkFile(NUM_FRAMES);
+
+	TEST_CHECK(shutdownBufferPool(bm));
+	TEST_CHECK(destroyPageFile(TESTPF));
+
+	free(bm);
+	TEST_DONE();
+}
+
+// create page file of NUM_BLOCKS pages "Page-<page no>"
+void createBlocks(void) {
+	SM_FileHandle fh;
+	SM_PageHandle ph = (SM_PageHandle) malloc(PAGE_SIZE);
+	int i;
+
+	TEST_CHECK(createPageFile(TESTPF));
+	TEST_CHECK(openPageFile(TESTPF, &fh));
+	TEST_CHECK(ensureCapacity(NUM_BLOCKS, &fh));
+	for (i = 0; i < NUM_BLOCKS; i++) {
+		memset(ph, 0, PAGE_SIZE);
+		sprintf(ph, "Page-%i", i);
+		TEST_CHECK(writeBlock(i, &fh, ph));
+	}
+	TEST_CHECK(closePageFile(&fh));
+
+	free(ph);
+}
+
+// open a pool on TESTPF with a background writer aiming at dirtyTarget %
+void initWriterPool(BM_BufferPool *bm, int dirtyTarget) {
+	BM_PoolOptions options;
+
+	initPoolOptions(&options);
+	options.backgroundWriter = TRUE;
+	options.writerDirtyTarget = dirtyTarget;
+	TEST_CHECK(initBufferPoolWithOptions(bm, TESTPF, NUM_FRAMES, RS_LRU,
+			NULL, &options));
+}
+
+// overwrite pages 0 to numPages - 1 with "Dirty-<page no>"
+void dirtyPages(BM_BufferPool *bm, int numPages, bool keepPinned) {
+	BM_PageHandle *h = MAKE_PAGE_HANDLE();
+	int i;
+
+	for (i = 0; i < numPages; i++) {
+		TEST_CHECK(pinPage(bm, h, i));
+		sprintf(h->data, "Dirty-%i", i);
+		TEST_CHECK(markDirty(bm, h));
+		if (!keepPinned) {
+			TEST_CHECK(unpinPage(bm, h));
+		}
+	}
+
+	free(h);
+}
+
+// wait until the writer wrote numWrites pages, or give up after a while
+void waitForWrites(BM_BufferPool *bm, int numWrites) {
+	int waited;
+
+	for (waited = 0; getNumWriterWriteIO(bm) < numWrites
+			&& waited < WRITER_TIMEOUT_MS; waited++) {
+		usleep(1000);
+	}
+}
+
+// number of dirty frames in the pool
+int countDirty(BM_BufferPool *bm) {
+	bool *dirty = getDirtyFlags(bm);
+	int i, count = 0;
+
+	for (i = 0; i < bm->numPages; i++) {
+		count += dirty[i];
+	}
+
+	return count;
+}
+
+// check that the first numPages pages of TESTPF hold "Dirty-<page no>"
+void checkFile(int numPages) {
+	SM_FileHandle fh;
+	SM_PageHandle ph = (SM_PageHandle) malloc(PAGE_SIZE);
+	char expected[32];
+	int i;
+
+	TEST_CHECK(openPageFile(TESTPF, &fh));
+	for (i = 0; i < numPages; i++) {
+		TEST_CHECK(readBlock(i, &fh, ph));
+		sprintf(expected, "Dirty-%i", i);
+		ASSERT_EQUALS_STRING(expected, ph, "page written to file");
+	}
+	TEST_CHECK(closePageFile(&fh));
+
+	free(ph);
+}
@@ -0,0 +1,248 @@
+#include "storage_mgr.h"
+#include "buffer_mgr_stat.h"
+#include "buffer_mgr.h"
+#include "dberror.h"
+#include "test_helper.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// var to store the current test's name
+char *testName;
+
+/* page file and pool sizes used by all tests */
+#define TESTPF "test_dirty_list.bin"
+#define NUM_FRAMES 8
+#define NUM_BLOCKS 40
+
+// test and helper methods
+static void testListFollowsDirtyFlags(void);
+static void testEvictionUnlinks(void);
+static void testResizeKeepsList(void);
+
+static void createBlocks(void);
+static void pinAndCheck(BM_BufferPool *bm, PageNumber pageNum);
+static void dirtyPage(BM_BufferPool *bm, PageNumber pageNum);
+static int checkDirtyList(BM_BufferPool *bm);
+static bool isListed(BM_BufferPool *bm, PageNumber pageNum);
+static void checkFile(PageNumber pageNum, char *prefix);
+
+// main method
+int main(void) {
+	initStorageManager();
+	testName = "";
+
+	testListFollowsDirtyFlags();
+	testEvictionUnlinks();
+	testResizeKeepsList();
+
+	return 0;
+}
+
+// frames are listed once while dirty and unlinked when written back
+void testListFollowsDirtyFlags(void) {
+	BM_BufferPool *bm = MAKE_POOL();
+	BM_PageHandle *h = MAKE_PAGE_HANDLE();
+	int i;
+	testName = "Dirty list follows dirty flags";
+
+	createBlocks();
+	TEST_CHECK(initBufferPool(bm, TESTPF, NUM_FRAMES, RS_LRU, NULL));
+	ASSERT_EQUALS_INT(0, checkDirtyList(bm), "new pool has no dirty frame");
+	for (i = 0; i < NUM_FRAMES; i += 2) {
+		dirtyPage(bm, i);
+	}
+	pinAndCheck(bm, 1);
+	ASSERT_EQUALS_INT(NUM_FRAMES / 2, checkDirtyList(bm),
+			"dirty pages listed");
+
+	//Marking a dirty page again doesn't list it twice
+	dirtyPage(bm, 0);
+	ASSERT_EQUALS_INT(NUM_FRAMES / 2, checkDirtyList(bm),
+			"page listed once");
+
+	TEST_CHECK(pinPage(bm, h, 2));
+	TEST_CHECK(forcePage(bm, h));
+	TEST_CHECK(unpinPage(bm, h));
+	ASSERT_TRUE(!isListed(bm, 2), "forced page unlinked");
+	ASSERT_EQUALS_INT(NUM_FRAMES / 2 - 1, checkDirtyList(bm),
+			"other pages stay listed");
+
+	TEST_CHECK(forceFlushPool(bm));
+	ASSERT_EQUALS_INT(0, checkDirtyList(bm), "flush empties the list");
+	for (i = 0; i < NUM_FRAMES; i += 2) {
+		checkFile(i, "Dirty");
+	}
+
+	TEST_CHECK(shutdownBufferPool(bm));
+	TEST_CHECK(destroyPageFile(TESTPF));
+
+	free(h);
+	free(bm);
+	TEST_DONE();
+}
+
+// a dirty victim leaves the list once its frame is taken for a new page
+void testEvictionUnlinks(void) {
+	BM_BufferPool *bm = MAKE_POOL();
+	int i;
+	testName = "Eviction unlinks dirty frames";
+
+	createBlocks();
+	TEST_CHECK(initBufferPool(bm, TESTPF, NUM_FRAMES, RS_FIFO, NULL));
+	dirtyPage(bm, 0);
+	dirtyPage(bm, 1);
+	for (i = 2; i < NUM_FRAMES; i++) {
+		pinAndCheck(bm, i);
+	}
+	ASSERT_EQUALS_INT(2, checkDirtyList(bm), "both pages listed");
+
+	//FIFO evicts page 0 first
+	pinAndCheck(bm, NUM_FRAMES);
+	ASSERT_TRUE(!isListed(bm, 0), "evicted page unlinked");
+	ASSERT_TRUE(isListed(bm, 1), "other dirty page still listed");
+	ASSERT_EQUALS_INT(1, checkDirtyList(bm), "one page left in list");
+	checkFile(0, "Dirty");
+
+	//Frames reused for pages dirtied later are listed again
+	dirtyPage(bm, NUM_FRAMES);
+	ASSERT_EQUALS_INT(2, checkDirtyList(bm), "reused frame listed");
+
+	TEST_CHECK(shutdownBufferPool(bm));
+	checkFile(1, "Dirty");
+	checkFile(NUM_FRAMES, "Dirty");
+	TEST_CHECK(destroyPageFile(TESTPF));
+
+	free(bm);
+	TEST_DONE();
+}
+
+// retired frames drop out of the list, new frames join it clean
+void testResizeKeepsList(void) {
+	BM_BufferPool *bm = MAKE_POOL();
+	int i;
+	testName = "Resize keeps dirty list consistent";
+
+	createBlocks();
+	TEST_CHECK(initBufferPool(bm, TESTPF, NUM_FRAMES, RS_LRU, NULL));
+	for (i = 0; i < NUM_FRAMES; i++) {
+		dirtyPage(bm, i);
+	}
+	ASSERT_EQUALS_INT(NUM_FRAMES, checkDirtyList(bm), "all frames listed");
+
+	TEST_CHECK(resizeBufferPool(bm, NUM_FRAMES / 2));
+	ASSERT_EQUALS_INT(NUM_FRAMES / 2, checkDirtyList(bm),
+			"retired frames unlinked");
+
+	TEST_CHECK(resizeBufferPool(bm, NUM_FRAMES));
+	ASSERT_EQUALS_INT(NUM_FRAMES / 2, checkDirtyList(bm),
+			"regrown frames join clean");
+	for (i = NUM_FRAMES; i < 2 * NUM_FRAMES; i++) {
+		dirtyPage(bm, i);
+	}
+	ASSERT_EQUALS_INT(NUM_FRAMES, checkDirtyList(bm),
+			"regrown frames listed once dirtied");
+
+	TEST_CHECK(shutdownBufferPool(bm));
+	for (i = 0; i < 2 * NUM_FRAMES; i++) {
+		checkFile(i, "Dirty");
+	}
+	TEST_CHECK(destroyPageFile(TESTPF));
+
+	free(bm);
+	TEST_DONE();
+}
+
+// create page file of NUM_BLOCKS pages "Page-<page no>"
+void createBlocks(void) {
+	SM_FileHandle fh;
+	SM_PageHandle ph = (SM_PageHandle) malloc(PAGE_SIZE);
+	int i;
+
+	TEST_CHECK(createPageFile(TESTPF));
+	TEST_CHECK(openPageFile(TESTPF, &fh));
+	TEST_CHECK(ensureCapacity(NUM_BLOCKS, &fh));
+	for (i = 0; i < NUM_BLOCKS; i++) {
+		memset(ph, 0, PAGE_SIZE);
+		sprintf(ph, "Page-%i", i);
+		TEST_CHECK(writeBlock(i, &fh, ph));
+	}
+	TEST_CHECK(closePageFile(&fh));
+
+	free(ph);
+}
+
+// pin page pageNum, check its content and unpin it again
+void pinAndCheck(BM_BufferPool *bm, PageNumber pageNum) {
+	BM_PageHandle *h = MAKE_PAGE_HANDLE();
+	char expected[32];
+
+	TEST_CHECK(pinPage(bm, h, pageNum));
+	sprintf(expected, "Page-%i", pageNum);
+	ASSERT_EQUALS_STRING(expected, h->data, "expected page content");
+	TEST_CHECK(unpinPage(bm, h));
+
+	free(h);
+}
+
+// pin page pageNum, overwrite it with "Dirty-<page no>" and unpin it
+void dirtyPage(BM_BufferPool *bm, PageNumber pageNum) {
+	BM_PageHandle *h = MAKE_PAGE_HANDLE();
+
+	TEST_CHECK(pinPage(bm, h, pageNum));
+	sprintf(h->data, "Dirty-%i", pageNum);
+	TEST_CHECK(markDirty(bm, h));
+	TEST_CHECK(unpinPage(bm, h));
+
+	free(h);
+}
+
+// walk the dirty list checking its links and flags, returns its length
+int checkDirtyList(BM_BufferPool *bm) {
+	BM_Data *data = (BM_Data *) bm->mgmtData;
+	int frame, prev = -1, n = 0;
+
+	for (frame = data->dirtyHead; frame != -1 && n <= data->numFramesUsed;
+			frame = data->dirtyNext[frame]) {
+		ASSERT_TRUE(frame < data->numFramesUsed, "listed frame in pool");
+		ASSERT_TRUE(data->dirtyFlags[frame] == TRUE, "listed frame is dirty");
+		ASSERT_EQUALS_INT(prev, data->dirtyPrev[frame], "back link matches");
+		prev = frame;
+		n++;
+	}
+	ASSERT_EQUALS_INT(data->numDirtyPages, n,
+			"list holds every dirty frame");
+
+	return n;
+}
+
+// whether the frame holding page pageNum is on the dirty list
+bool isListed(BM_BufferPool *bm, PageNumber pageNum) {
+	BM_Data *data = (BM_Data *) bm->mgmtData;
+	int frame;
+
+	for (frame = data->dirtyHead; frame != -1;
+			frame = data->dirtyNext[frame]) {
+		if (data->pageFrameIndexMap[frame] == pageNum) {
+			return TRUE;
+		}
+	}
+
+	return FALSE;
+}
+
+// check that page pageNum of TESTPF holds "<prefix>-<page no>"
+void checkFile(PageNumber pageNum, char *prefix) {
+	SM_FileHandle fh;
+	SM_PageHandle ph = (SM_PageHandle) malloc(PAGE_SIZE);
+	char expected[32];
+
+	TEST_CHECK(openPageFile(TESTPF, &fh));
+	TEST_CHECK(readBlock(pageNum, &fh, ph));
+	sprintf(expected, "%s-%i", prefix, pageNum);
+	ASSERT_EQUALS_STRING(expected, ph, "page file holds expected content");
+	TEST_CHECK(closePageFile(&fh));
+
+	free(ph);
+}
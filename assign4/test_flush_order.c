@@ -0,0 +1,231 @@
+#include "storage_mgr.h"
+#include "buffer_mgr_stat.h"
+#include "buffer_mgr.h"
+#include "dberror.h"
+#include "test_helper.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// var to store the current test's name
+char *testName;
+
+/* page file and pool sizes used by all tests */
+#define TESTPF "test_flush_order.bin"
+#define NUM_FRAMES 16
+#define NUM_BLOCKS 40
+
+// test and helper methods
+static void testWriteBlocks(void);
+static void testFlushCoalesced(void);
+static void testFlushSkipsPinned(void);
+static void testShutdownFlushes(void);
+
+static void createBlocks(void);
+static void dirtyPage(BM_BufferPool *bm, PageNumber pageNum);
+static void checkFile(PageNumber pageNum, char *prefix);
+static uint64_t sumOf(uint64_t *buckets);
+
+/* pages dirtied by the flush tests, deliberately out of order */
+static const PageNumber dirtyOrder[] = { 9, 3, 7, 4, 8, 20, 5, 21 };
+#define NUM_DIRTY ((int) (sizeof(dirtyOrder) / sizeof(dirtyOrder[0])))
+
+// main method
+int main(void) {
+	initStorageManager();
+	testName = "";
+
+	testWriteBlocks();
+	testFlushCoalesced();
+	testFlushSkipsPinned();
+	testShutdownFlushes();
+
+	return 0;
+}
+
+// writeBlocks writes every existing block and reports the others
+void testWriteBlocks(void) {
+	SM_FileHandle fh;
+	int pageNums[] = { 2, 3, 4, 10, NUM_BLOCKS };
+	SM_PageHandle pages[5];
+	RC results[5];
+	int i;
+	testName = "Vectored block writes";
+
+	createBlocks();
+	TEST_CHECK(openPageFile(TESTPF, &fh));
+	for (i = 0; i < 5; i++) {
+		pages[i] = (SM_PageHandle) calloc(PAGE_SIZE, 1);
+		sprintf(pages[i], "Dirty-%i", pageNums[i]);
+	}
+	ASSERT_ERROR(writeBlocks(pageNums, 5, &fh, pages, results),
+			"block past end of file fails the call");
+	for (i = 0; i < 4; i++) {
+		ASSERT_EQUALS_INT(RC_OK, results[i], "existing block written");
+	}
+	ASSERT_EQUALS_INT(RC_WRITE_NON_EXISTING_PAGE, results[4],
+			"block past end of file reported");
+	ASSERT_EQUALS_INT(NUM_BLOCKS, fh.totalNumPages, "file not extended");
+	TEST_CHECK(closePageFile(&fh));
+
+	for (i = 0; i < 4; i++) {
+		checkFile(pageNums[i], "Dirty");
+	}
+	checkFile(1, "Page");
+	checkFile(5, "Page");
+
+	for (i = 0; i < 5; i++) {
+		free(pages[i]);
+	}
+	TEST_CHECK(destroyPageFile(TESTPF));
+
+	TEST_DONE();
+}
+
+// a flush writes every dirty page once, runs of pages in one I/O
+void testFlushCoalesced(void) {
+	BM_BufferPool *bm = MAKE_POOL();
+	BM_PoolStats stats;
+	int i;
+	testName = "Flush writes sorted and coalesced";
+
+	createBlocks();
+	TEST_CHECK(initBufferPool(bm, TESTPF, NUM_FRAMES, RS_LRU, NULL));
+	for (i = 0; i < NUM_DIRTY; i++) {
+		dirtyPage(bm, dirtyOrder[i]);
+	}
+
+	TEST_CHECK(forceFlushPool(bm));
+	TEST_CHECK(getPoolStats(bm, &stats));
+	ASSERT_EQUALS_INT(NUM_DIRTY, (int) stats.writes, "each page written once");
+	ASSERT_EQUALS_INT(1, (int) sumOf(stats.writeLatency),
+			"whole batch went to disk as one I/O");
+	for (i = 0; i < NUM_DIRTY; i++) {
+		checkFile(dirtyOrder[i], "Dirty");
+	}
+
+	//Nothing is dirty any more
+	TEST_CHECK(forceFlushPool(bm));
+	ASSERT_EQUALS_INT(NUM_DIRTY, getNumWriteIO(bm), "clean pages not written");
+
+	TEST_CHECK(shutdownBufferPool(bm));
+	TEST_CHECK(destroyPageFile(TESTPF));
+
+	free(bm);
+	TEST_DONE();
+}
+
+// pinned dirty pages are left for a later flush
+void testFlushSkipsPinned(void) {
+	BM_BufferPool *bm = MAKE_POOL();
+	BM_PageHandle *h = MAKE_PAGE_HANDLE();
+	testName = "Flush skips pinned pages";
+
+	createBlocks();
+	TEST_CHECK(initBufferPool(bm, TESTPF, NUM_FRAMES, RS_LRU, NULL));
+	dirtyPage(bm, 4);
+	dirtyPage(bm, 6);
+	TEST_CHECK(pinPage(bm, h, 5));
+	sprintf(h->data, "Dirty-%i", 5);
+	TEST_CHECK(markDirty(bm, h));
+
+	TEST_CHECK(forceFlushPool(bm));
+	ASSERT_EQUALS_INT(2, getNumWriteIO(bm), "only unpinned pages written");
+	checkFile(4, "Dirty");
+	checkFile(5, "Page");
+	checkFile(6, "Dirty");
+
+	TEST_CHECK(unpinPage(bm, h));
+	TEST_CHECK(forceFlushPool(bm));
+	ASSERT_EQUALS_INT(3, getNumWriteIO(bm), "unpinned page written later");
+	checkFile(5, "Dirty");
+
+	TEST_CHECK(shutdownBufferPool(bm));
+	TEST_CHECK(destroyPageFile(TESTPF));
+
+	free(h);
+	free(bm);
+	TEST_DONE();
+}
+
+// shutdown writes dirty pages back through the same flush
+void testShutdownFlushes(void) {
+	BM_BufferPool *bm = MAKE_POOL();
+	int i;
+	testName = "Shutdown flushes dirty pages";
+
+	createBlocks();
+	TEST_CHECK(initBufferPool(bm, TESTPF, NUM_FRAMES, RS_FIFO, NULL));
+	for (i = 0; i < NUM_DIRTY; i++) {
+		dirtyPage(bm, dirtyOrder[i]);
+	}
+	TEST_CHECK(shutdownBufferPool(bm));
+
+	for (i = 0; i < NUM_DIRTY; i++) {
+		checkFile(dirtyOrder[i], "Dirty");
+	}
+	checkFile(6, "Page");
+	TEST_CHECK(destroyPageFile(TESTPF));
+
+	free(bm);
+	TEST_DONE();
+}
+
+// create page file of NUM_BLOCKS pages "Page-<page no>"
+void createBlocks(void) {
+	SM_FileHandle fh;
+	SM_PageHandle ph = (SM_PageHandle) malloc(PAGE_SIZE);
+	int i;
+
+	TEST_CHECK(createPageFile(TESTPF));
+	TEST_CHECK(openPageFile(TESTPF, &fh));
+	TEST_CHECK(ensureCapacity(NUM_BLOCKS, &fh));
+	for (i = 0; i < NUM_BLOCKS; i++) {
+		memset(ph, 0, PAGE_SIZE);
+		sprintf(ph, "Page-%i", i);
+		TEST_CHECK(writeBlock(i, &fh, ph));
+	}
+	TEST_CHECK(closePageFile(&fh));
+
+	free(ph);
+}
+
+// pin page pageNum, overwrite it with "Dirty-<page no>" and unpin it
+void dirtyPage(BM_BufferPool *bm, PageNumber pageNum) {
+	BM_PageHandle *h = MAKE_PAGE_HANDLE();
+
+	TEST_CHECK(pinPage(bm, h, pageNum));
+	sprintf(h->data, "Dirty-%i", pageNum);
+	TEST_CHECK(markDirty(bm, h));
+	TEST_CHECK(unpinPage(bm, h));
+
+	free(h);
+}
+
+// check that page pageNum of TESTPF holds "<prefix>-<page no>"
+void checkFile(PageNumber pageNum, char *prefix) {
+	SM_FileHandle fh;
+	SM_PageHandle ph = (SM_PageHandle) malloc(PAGE_SIZE);
+	char expected[32];
+
+	TEST_CHECK(openPageFile(TESTPF, &fh));
+	TEST_CHECK(readBlock(pageNum, &fh, ph));
+	sprintf(expected, "%s-%i", prefix, pageNum);
+	ASSERT_EQUALS_STRING(expected, ph, "page file holds expected content");
+	TEST_CHECK(closePageFile(&fh));
+
+	free(ph);
+}
+
+// total count of a latency histogram
+uint64_t sumOf(uint64_t *buckets) {
+	uint64_t sum = 0;
+	int i;
+
+	for (i = 0; i < BM_LATENCY_BUCKETS; i++) {
+		sum += buckets[i];
+	}
+
+	return sum;
+}
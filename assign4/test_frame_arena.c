@@ -0,0 +1,147 @@
+#include "storage_mgr.h"
+#include "buffer_mgr_stat.h"
+#include "buffer_mgr.h"
+#include "dberror.h"
+#include "test_helper.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+// var to store the current test's name
+char *testName;
+
+/* page file and pool used by all tests */
+#define TESTPF "test_frame_arena.bin"
+#define NUM_FRAMES 5
+#define NUM_BLOCKS 40
+
+// test and helper methods
+static void testFramesInArena(void);
+static void testFramesReusedInPlace(void);
+
+static void createBlocks(void);
+static int arenaSlot(BM_BufferPool *bm, char *data);
+
+// main method
+int main(void) {
+	initStorageManager();
+	testName = "";
+
+	testFramesInArena();
+	testFramesReusedInPlace();
+
+	return 0;
+}
+
+// pinned pages point into one aligned slab, a page apart from each other
+void testFramesInArena(void) {
+	BM_BufferPool *bm = MAKE_POOL();
+	BM_PageHandle *h = MAKE_PAGE_HANDLE();
+	int i, inArena = 0, aligned = 0;
+	testName = "Frame data lives in an aligned arena";
+
+	createBlocks();
+	TEST_CHECK(initBufferPool(bm, TESTPF, NUM_FRAMES, RS_FIFO, NULL));
+
+	for (i = 0; i < NUM_FRAMES; i++) {
+		TEST_CHECK(pinPage(bm, h, i));
+		inArena += arenaSlot(bm, h->data) != -1;
+		aligned += (uintptr_t) h->data % BM_FRAME_ALIGNMENT == 0;
+		TEST_CHECK(unpinPage(bm, h));
+	}
+	ASSERT_EQUALS_INT(NUM_FRAMES, inArena, "frame data within the arena");
+	ASSERT_EQUALS_INT(NUM_FRAMES, aligned, "frame data aligned");
+	ASSERT_TRUE((uintptr_t) ((BM_Data *) bm->mgmtData)->frameArena
+			% BM_FRAME_ALIGNMENT == 0, "arena aligned");
+
+	TEST_CHECK(shutdownBufferPool(bm));
+	TEST_CHECK(destroyPageFile(TESTPF));
+
+	free(bm);
+	free(h);
+	TEST_DONE();
+}
+
+// pages swapped in and out keep using the same frames, and dirty pages are
+// written back from them before the frame is reused
+void testFramesReusedInPlace(void) {
+	BM_BufferPool *bm = MAKE_POOL();
+	BM_PageHandle *h = MAKE_PAGE_HANDLE();
+	bool used[NUM_FRAMES];
+	char expected[32];
+	int i, slot, outside = 0, slots = 0;
+	testName = "Frames reused in place";
+
+	createBlocks();
+	TEST_CHECK(initBufferPool(bm, TESTPF, NUM_FRAMES, RS_LRU, NULL));
+	memset(used, 0, sizeof(used));
+
+	// dirty every page while it passes through the pool
+	for (i = 0; i < NUM_BLOCKS; i++) {
+		TEST_CHECK(pinPage(bm, h, i));
+		slot = arenaSlot(bm, h->data);
+		if (slot == -1) {
+			outside++;
+		} else {
+			used[slot] = TRUE;
+		}
+		sprintf(h->data, "Dirty-%i", i);
+		TEST_CHECK(markDirty(bm, h));
+		TEST_CHECK(unpinPage(bm, h));
+	}
+	for (i = 0; i < NUM_FRAMES; i++) {
+		slots += used[i];
+	}
+	ASSERT_EQUALS_INT(0, outside, "no frame data outside the arena");
+	ASSERT_EQUALS_INT(NUM_FRAMES, slots, "all frames used");
+	ASSERT_EQUALS_INT(NUM_BLOCKS - NUM_FRAMES, getNumWriteIO(bm),
+			"evicted pages written back");
+
+	// pages read back after eviction show what was written
+	for (i = 0; i < NUM_BLOCKS; i++) {
+		TEST_CHECK(pinPage(bm, h, i));
+		sprintf(expected, "Dirty-%i", i);
+		ASSERT_EQUALS_STRING(expected, h->data, "written back page content");
+		TEST_CHECK(unpinPage(bm, h));
+	}
+
+	TEST_CHECK(shutdownBufferPool(bm));
+	TEST_CHECK(destroyPageFile(TESTPF));
+
+	free(bm);
+	free(h);
+	TEST_DONE();
+}
+
+// create page file of NUM_BLOCKS pages "Page-<page no>"
+void createBlocks(void) {
+	SM_FileHandle fh;
+	SM_PageHandle ph = (SM_PageHandle) malloc(PAGE_SIZE);
+	int i;
+
+	TEST_CHECK(createPageFile(TESTPF));
+	TEST_CHECK(openPageFile(TESTPF, &fh));
+	TEST_CHECK(ensureCapacity(NUM_BLOCKS, &fh));
+	for (i = 0; i < NUM_BLOCKS; i++) {
+		memset(ph, 0, PAGE_SIZE);
+		sprintf(ph, "Page-%i", i);
+		TEST_CHECK(writeBlock(i, &fh, ph));
+	}
+	TEST_CHECK(closePageFile(&fh));
+
+	free(ph);
+}
+
+// index of the arena slot data points at, -1 if it's not the start of one
+int arenaSlot(BM_BufferPool *bm, char *data) {
+	char *arena = ((BM_Data *) bm->mgmtData)->frameArena;
+
+	if (data < arena || data >= arena + (size_t) PAGE_SIZE * bm->numPages
+			|| (data - arena) % PAGE_SIZE != 0) {
+		return -1;
+	}
+
+	return (data - arena) / PAGE_SIZE;
+}
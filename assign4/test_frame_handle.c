@@ -0,0 +1,291 @@
+#include "storage_mgr.h"
+#include "buffer_mgr_stat.h"
+#include "buffer_mgr.h"
+#include "record_mgr.h"
+#include "tables.h"
+#include "dberror.h"
+#include "test_helper.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// var to store the current test's name
+char *testName;
+
+/* page file and pool sizes used by the buffer pool tests */
+#define TESTPF "test_frame_handle.bin"
+#define NUM_FRAMES 4
+#define NUM_BLOCKS 20
+
+/* table used by the record manager test and its no of rows */
+#define TESTTBL "test_frame_handle_table"
+#define NUM_ROWS 600
+
+// test and helper methods
+static void testPinsFillFrame(void);
+static void testWrongFrameFallsBack(void);
+static void testRecycledFrame(void);
+static void testRecordHandles(void);
+
+static void createBlocks(void);
+static int frameOf(BM_BufferPool *bm, PageNumber pageNum);
+static Schema *rowSchema(void);
+static void setRow(Record *record, Schema *schema, int id, int v);
+static int getAttrInt(Record *record, Schema *schema, int attrNum);
+
+// main method
+int main(void) {
+	initStorageManager();
+	testName = "";
+
+	testPinsFillFrame();
+	testWrongFrameFallsBack();
+	testRecycledFrame();
+	testRecordHandles();
+
+	return 0;
+}
+
+// every way of pinning records the frame in the handle
+void testPinsFillFrame(void) {
+	BM_BufferPool *bm = MAKE_POOL();
+	BM_PageHandle h, pages[2];
+	BM_AccessRing ring;
+	PageNumber pageNums[] = { 5, 6 };
+	testName = "Pins fill in the frame";
+
+	createBlocks();
+	TEST_CHECK(initBufferPool(bm, TESTPF, NUM_FRAMES, RS_LRU, NULL));
+
+	h.frame = -1;
+	TEST_CHECK(pinPage(bm, &h, 3));
+	ASSERT_EQUALS_INT(frameOf(bm, 3), h.frame, "pinPage fills frame");
+	TEST_CHECK(unpinPage(bm, &h));
+
+	//A hit fills the frame as well
+	h.frame = -1;
+	TEST_CHECK(pinPage(bm, &h, 3));
+	ASSERT_EQUALS_INT(frameOf(bm, 3), h.frame, "pin hit fills frame");
+	TEST_CHECK(unpinPage(bm, &h));
+
+	TEST_CHECK(initAccessRing(bm, &ring, 1));
+	h.frame = -1;
+	TEST_CHECK(pinPageWithRing(bm, &ring, &h, 4));
+	ASSERT_EQUALS_INT(frameOf(bm, 4), h.frame, "ring pin fills frame");
+	TEST_CHECK(unpinPage(bm, &h));
+	freeAccessRing(&ring);
+
+	pages[0].frame = pages[1].frame = -1;
+	TEST_CHECK(pinPages(bm, pageNums, 2, pages));
+	ASSERT_EQUALS_INT(frameOf(bm, 5), pages[0].frame,
+			"pinPages fills first frame");
+	ASSERT_EQUALS_INT(frameOf(bm, 6), pages[1].frame,
+			"pinPages fills second frame");
+	TEST_CHECK(unpinPages(bm, pages, 2));
+
+	TEST_CHECK(shutdownBufferPool(bm));
+	TEST_CHECK(destroyPageFile(TESTPF));
+
+	free(bm);
+	TEST_DONE();
+}
+
+// a handle whose frame holds another page, or no frame at all, is
+// resolved through the page table
+void testWrongFrameFallsBack(void) {
+	BM_BufferPool *bm = MAKE_POOL();
+	BM_PageHandle h, other, copy;
+	testName = "Wrong frame falls back to lookup";
+
+	createBlocks();
+	TEST_CHECK(initBufferPool(bm, TESTPF, NUM_FRAMES, RS_LRU, NULL));
+	TEST_CHECK(pinPage(bm, &h, 1));
+	TEST_CHECK(pinPage(bm, &other, 2));
+
+	//Handle filled in by the caller, pointing to the frame of page 2
+	copy.pageNum = 1;
+	copy.data = h.data;
+	copy.frame = other.frame;
+	TEST_CHECK(markDirty(bm, &copy));
+	TEST_CHECK(unpinPage(bm, &copy));
+	ASSERT_EQUALS_INT(0, getFixCounts(bm)[h.frame], "page 1 unpinned");
+	ASSERT_EQUALS_INT(1, getFixCounts(bm)[other.frame], "page 2 still pinned");
+	ASSERT_TRUE(getDirtyFlags(bm)[h.frame], "page 1 dirty");
+	ASSERT_TRUE(!getDirtyFlags(bm)[other.frame], "page 2 clean");
+
+	//Frames out of range are never used
+	copy.pageNum = 2;
+	copy.frame = 1 << 20;
+	TEST_CHECK(unpinPage(bm, &copy));
+	copy.frame = -5;
+	ASSERT_EQUALS_INT(RC_PAGE_NOT_PINNED, unpinPage(bm, &copy),
+			"page 2 unpinned once only");
+
+	TEST_CHECK(shutdownBufferPool(bm));
+	TEST_CHECK(destroyPageFile(TESTPF));
+
+	free(bm);
+	TEST_DONE();
+}
+
+// a stale handle doesn't touch the page now held by its old frame
+void testRecycledFrame(void) {
+	BM_BufferPool *bm = MAKE_POOL();
+	BM_PageHandle h, stale;
+	int i;
+	testName = "Recycled frame not used";
+
+	createBlocks();
+	TEST_CHECK(initBufferPool(bm, TESTPF, NUM_FRAMES, RS_FIFO, NULL));
+	TEST_CHECK(pinPage(bm, &stale, 0));
+	TEST_CHECK(unpinPage(bm, &stale));
+
+	//FIFO gives the frame of page 0 to the fifth page pinned
+	for (i = 1; i <= NUM_FRAMES; i++) {
+		TEST_CHECK(pinPage(bm, &h, i));
+		TEST_CHECK(unpinPage(bm, &h));
+	}
+	ASSERT_EQUALS_INT(NUM_FRAMES, getFrameContents(bm)[stale.frame],
+			"frame holds another page");
+
+	TEST_CHECK(pinPage(bm, &h, NUM_FRAMES));
+	ASSERT_EQUALS_INT(RC_PAGE_NOT_PINNED, markDirty(bm, &stale),
+			"stale handle can't dirty page");
+	ASSERT_TRUE(!getDirtyFlags(bm)[stale.frame], "new page stays clean");
+	ASSERT_TRUE(unpinPage(bm, &stale) != RC_OK,
+			"stale handle can't unpin page");
+	ASSERT_EQUALS_INT(1, getFixCounts(bm)[stale.frame], "new page pinned");
+	TEST_CHECK(unpinPage(bm, &h));
+
+	TEST_CHECK(shutdownBufferPool(bm));
+	TEST_CHECK(destroyPageFile(TESTPF));
+
+	free(bm);
+	TEST_DONE();
+}
+
+// records written and read through stack handles survive eviction
+void testRecordHandles(void) {
+	RM_TableData *table = (RM_TableData *) malloc(sizeof(RM_TableData));
+	Schema *schema = rowSchema();
+	RID *rids = (RID *) malloc(NUM_ROWS * sizeof(RID));
+	BM_BufferPool *bm;
+	Record *r;
+	int i, wrong = 0;
+	testName = "Record manager with stack handles";
+
+	TEST_CHECK(initRecordManager(NULL));
+	TEST_CHECK(createTable(TESTTBL, schema));
+	TEST_CHECK(openTable(table, TESTTBL));
+	TEST_CHECK(createRecord(&r, schema));
+
+	for (i = 0; i < NUM_ROWS; i++) {
+		setRow(r, schema, i, i);
+		TEST_CHECK(insertRecord(table, r));
+		rids[i] = r->id;
+	}
+	for (i = 0; i < NUM_ROWS; i += 2) {
+		setRow(r, schema, i, -i);
+		r->id = rids[i];
+		TEST_CHECK(updateRecord(table, r));
+	}
+	for (i = 0; i < NUM_ROWS; i++) {
+		TEST_CHECK(getRecord(table, rids[i], r));
+		if (getAttrInt(r, schema, 0) != i
+				|| getAttrInt(r, schema, 1) != (i % 2 == 0 ? -i : i)) {
+			wrong++;
+		}
+	}
+	ASSERT_EQUALS_INT(0, wrong, "every row read back as written");
+	bm = ((RM_TableMgmtData *) table->mgmtData)->bPool;
+	ASSERT_EQUALS_INT(0, ((BM_Data *) bm->mgmtData)->numPinnedPages,
+			"no page left pinned");
+
+	freeRecord(r);
+	TEST_CHECK(closeTable(table));
+	TEST_CHECK(deleteTable(TESTTBL));
+	TEST_CHECK(shutdownRecordManager());
+	freeSchema(schema);
+
+	free(rids);
+	free(table);
+	TEST_DONE();
+}
+
+// create page file of NUM_BLOCKS pages "Page-<page no>"
+void createBlocks(void) {
+	SM_FileHandle fh;
+	SM_PageHandle ph = (SM_PageHandle) malloc(PAGE_SIZE);
+	int i;
+
+	TEST_CHECK(createPageFile(TESTPF));
+	TEST_CHECK(openPageFile(TESTPF, &fh));
+	TEST_CHECK(ensureCapacity(NUM_BLOCKS, &fh));
+	for (i = 0; i < NUM_BLOCKS; i++) {
+		memset(ph, 0, PAGE_SIZE);
+		sprintf(ph, "Page-%i", i);
+		TEST_CHECK(writeBlock(i, &fh, ph));
+	}
+	TEST_CHECK(closePageFile(&fh));
+
+	free(ph);
+}
+
+// index of the frame holding page pageNum, -1 if none does
+int frameOf(BM_BufferPool *bm, PageNumber pageNum) {
+	PageNumber *frames = getFrameContents(bm);
+	int i;
+
+	for (i = 0; i < ((BM_Data *) bm->mgmtData)->numFramesUsed; i++) {
+		if (frames[i] == pageNum) {
+			return i;
+		}
+	}
+
+	return -1;
+}
+
+// schema of rows (id, v), without a key so updates may change v
+Schema *rowSchema(void) {
+	char *names[] = { "id", "v" };
+	char **cpNames = (char **) malloc(sizeof(char *) * 2);
+	DataType *cpDt = (DataType *) malloc(sizeof(DataType) * 2);
+	int *cpSizes = (int *) malloc(sizeof(int) * 2);
+	int *cpKeys = (int *) malloc(sizeof(int));
+	int i;
+
+	for (i = 0; i < 2; i++) {
+		cpNames[i] = (char *) malloc(strlen(names[i]) + 1);
+		strcpy(cpNames[i], names[i]);
+		cpDt[i] = DT_INT;
+		cpSizes[i] = 0;
+	}
+	cpKeys[0] = 0;
+
+	return createSchema(2, cpNames, cpDt, cpSizes, 0, cpKeys);
+}
+
+// set attributes of record to (id, v)
+void setRow(Record *record, Schema *schema, int id, int v) {
+	Value *value;
+
+	MAKE_VALUE(value, DT_INT, id);
+	TEST_CHECK(setAttr(record, schema, 0, value));
+	freeVal(value);
+	MAKE_VALUE(value, DT_INT, v);
+	TEST_CHECK(setAttr(record, schema, 1, value));
+	freeVal(value);
+}
+
+// integer attribute attrNum of record
+int getAttrInt(Record *record, Schema *schema, int attrNum) {
+	Value *value;
+	int v;
+
+	TEST_CHECK(getAttr(record, schema, attrNum, &value));
+	v = value->v.intV;
+	freeVal(value);
+
+	return v;
+}
@@ -0,0 +1,125 @@
+#include "storage_mgr.h"
+#include "buffer_mgr_stat.h"
+#include "buffer_mgr.h"
+#include "dberror.h"
+#include "test_helper.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+// var to store the current test's name
+char *testName;
+
+/* page file and pool used by all tests */
+#define TESTPF "test_huge_pages.bin"
+#define NUM_FRAMES 10
+#define NUM_BLOCKS 30
+
+// test and helper methods
+static void testDefaultArena(void);
+static void testHugePageArena(void);
+
+static void createBlocks(void);
+static void useFrames(BM_BufferPool *bm);
+
+// main method
+int main(void) {
+	initStorageManager();
+	testName = "";
+
+	testDefaultArena();
+	testHugePageArena();
+
+	return 0;
+}
+
+// pools set up without options, or with default ones, don't use huge pages
+void testDefaultArena(void) {
+	BM_BufferPool *bm = MAKE_POOL();
+	BM_PoolOptions options;
+	testName = "Arena without huge pages";
+
+	createBlocks();
+	TEST_CHECK(initBufferPool(bm, TESTPF, NUM_FRAMES, RS_FIFO, NULL));
+	ASSERT_EQUALS_INT(BM_HUGEPAGE_OFF, getHugePageState(bm),
+			"no huge pages by default");
+	useFrames(bm);
+	TEST_CHECK(shutdownBufferPool(bm));
+
+	initPoolOptions(&options);
+	ASSERT_TRUE(!options.useHugePages, "huge pages off in default options");
+	TEST_CHECK(initBufferPoolWithOptions(bm, TESTPF, NUM_FRAMES, RS_FIFO,
+			NULL, &options));
+	ASSERT_EQUALS_INT(BM_HUGEPAGE_OFF, getHugePageState(bm),
+			"no huge pages with default options");
+	useFrames(bm);
+	TEST_CHECK(shutdownBufferPool(bm));
+	TEST_CHECK(destroyPageFile(TESTPF));
+
+	free(bm);
+	TEST_DONE();
+}
+
+// a pool asking for huge pages gets a huge page aligned arena of whole huge
+// pages, or falls back to regular pages, and works either way
+void testHugePageArena(void) {
+	BM_BufferPool *bm = MAKE_POOL();
+	BM_PoolOptions options;
+	BM_HugePageState state;
+	testName = "Arena backed by huge pages";
+
+	createBlocks();
+	initPoolOptions(&options);
+	options.useHugePages = TRUE;
+	TEST_CHECK(initBufferPoolWithOptions(bm, TESTPF, NUM_FRAMES, RS_LRU,
+			NULL, &options));
+	state = getHugePageState(bm);
+	ASSERT_TRUE(state != BM_HUGEPAGE_OFF, "huge pages were attempted");
+	ASSERT_TRUE((uintptr_t) ((BM_Data *) bm->mgmtData)->frameArena
+			% BM_HUGE_PAGE_SIZE == 0, "arena aligned to a huge page");
+	ASSERT_TRUE(((BM_Data *) bm->mgmtData)->arenaSize % BM_HUGE_PAGE_SIZE
+			== 0, "arena made of whole huge pages");
+	useFrames(bm);
+	TEST_CHECK(shutdownBufferPool(bm));
+	TEST_CHECK(destroyPageFile(TESTPF));
+
+	free(bm);
+	TEST_DONE();
+}
+
+// create page file of NUM_BLOCKS pages "Page-<page no>"
+void createBlocks(void) {
+	SM_FileHandle fh;
+	SM_PageHandle ph = (SM_PageHandle) malloc(PAGE_SIZE);
+	int i;
+
+	TEST_CHECK(createPageFile(TESTPF));
+	TEST_CHECK(openPageFile(TESTPF, &fh));
+	TEST_CHECK(ensureCapacity(NUM_BLOCKS, &fh));
+	for (i = 0; i < NUM_BLOCKS; i++) {
+		memset(ph, 0, PAGE_SIZE);
+		sprintf(ph, "Page-%i", i);
+		TEST_CHECK(writeBlock(i, &fh, ph));
+	}
+	TEST_CHECK(closePageFile(&fh));
+
+	free(ph);
+}
+
+// pin all pages of the file through the pool and check their content
+void useFrames(BM_BufferPool *bm) {
+	BM_PageHandle *h = MAKE_PAGE_HANDLE();
+	char expected[32];
+	int i;
+
+	for (i = 0; i < NUM_BLOCKS; i++) {
+		TEST_CHECK(pinPage(bm, h, i));
+		sprintf(expected, "Page-%i", i);
+		ASSERT_EQUALS_STRING(expected, h->data, "page content");
+		TEST_CHECK(unpinPage(bm, h));
+	}
+
+	free(h);
+}
@@ -0,0 +1,311 @@
+#include "storage_mgr.h"
+#include "buffer_mgr_stat.h"
+#include "buffer_mgr.h"
+#include "dberror.h"
+#include "test_helper.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+// var to store the current test's name
+char *testName;
+
+/* page file and pool used by all tests */
+#define TESTPF "test_io_states.bin"
+#define NUM_FRAMES 3
+#define NUM_BLOCKS 10
+
+/* threads pinning the same page at once */
+#define NUM_THREADS 8
+
+/* ms the writer is given to catch up, and to prove it stays idle */
+#define WRITER_TIMEOUT_MS 5000
+#define WRITER_IDLE_MS (3 * BM_WRITER_INTERVAL_MS)
+
+// pool and page a pinning thread works on and how it fared
+typedef struct PinRequest {
+	BM_BufferPool *bm;
+	PageNumber pageNum;
+	int failed;
+} PinRequest;
+
+// test and helper methods
+static void testConcurrentMissesReadOnce(void);
+static void testFailedWriteKeepsVictim(void);
+static void testFailedForcePage(void);
+static void testWriterCountsOnlyWrites(void);
+
+static void createBlocks(void);
+static int breakWrites(BM_BufferPool *bm);
+static void restoreWrites(BM_BufferPool *bm, int saved);
+static void dirtyPage(BM_BufferPool *bm, PageNumber pageNum);
+static void checkBlock(PageNumber pageNum, char *expected);
+static int frameOf(BM_BufferPool *bm, PageNumber pageNum);
+static void *pinThread(void *arg);
+
+// main method
+int main(void) {
+	initStorageManager();
+	testName = "";
+
+	testConcurrentMissesReadOnce();
+	testFailedWriteKeepsVictim();
+	testFailedForcePage();
+	testWriterCountsOnlyWrites();
+
+	return 0;
+}
+
+// threads missing on the same page wait for one read instead of each
+// reading it
+void testConcurrentMissesReadOnce(void) {
+	BM_BufferPool *bm = MAKE_POOL();
+	PinRequest reqs[NUM_THREADS];
+	pthread_t threads[NUM_THREADS];
+	int i, failed = 0;
+	testName = "Concurrent misses read a page once";
+
+	createBlocks();
+	TEST_CHECK(initBufferPool(bm, TESTPF, NUM_FRAMES, RS_LRU, NULL));
+
+	for (i = 0; i < NUM_THREADS; i++) {
+		reqs[i].bm = bm;
+		reqs[i].pageNum = 5;
+		reqs[i].failed = 0;
+		pthread_create(&threads[i], NULL, pinThread, &reqs[i]);
+	}
+	for (i = 0; i < NUM_THREADS; i++) {
+		pthread_join(threads[i], NULL);
+		failed += reqs[i].failed;
+	}
+	ASSERT_EQUALS_INT(0, failed, "pins found the page");
+	ASSERT_EQUALS_INT(1, getNumReadIO(bm), "page read once");
+	ASSERT_EQUALS_INT(0, getFixCounts(bm)[frameOf(bm, 5)], "no pins left");
+
+	TEST_CHECK(shutdownBufferPool(bm));
+	TEST_CHECK(destroyPageFile(TESTPF));
+
+	free(bm);
+	TEST_DONE();
+}
+
+// a dirty victim that can't be written back keeps its page, and the write
+// isn't counted
+void testFailedWriteKeepsVictim(void) {
+	BM_BufferPool *bm = MAKE_POOL();
+	BM_PageHandle *h = MAKE_PAGE_HANDLE();
+	int i, saved;
+	testName = "Failed write back keeps the victim";
+
+	createBlocks();
+	TEST_CHECK(initBufferPool(bm, TESTPF, NUM_FRAMES, RS_FIFO, NULL));
+
+	// page 0 is first in and dirty, the rest are clean
+	dirtyPage(bm, 0);
+	for (i = 1; i < NUM_FRAMES; i++) {
+		TEST_CHECK(pinPage(bm, h, i));
+		TEST_CHECK(unpinPage(bm, h));
+	}
+
+	saved = breakWrites(bm);
+	ASSERT_ERROR(pinPage(bm, h, NUM_FRAMES), "pin needing the victim fails");
+	restoreWrites(bm, saved);
+	ASSERT_TRUE(frameOf(bm, 0) != -1, "victim kept its page");
+	ASSERT_TRUE(getDirtyFlags(bm)[frameOf(bm, 0)], "victim still dirty");
+	ASSERT_EQUALS_INT(0, getFixCounts(bm)[frameOf(bm, 0)], "victim unpinned");
+	ASSERT_EQUALS_INT(0, getNumWriteIO(bm), "failed write not counted");
+
+	// once writes work again, the victim is written and replaced
+	TEST_CHECK(pinPage(bm, h, NUM_FRAMES));
+	TEST_CHECK(unpinPage(bm, h));
+	ASSERT_EQUALS_INT(-1, frameOf(bm, 0), "victim replaced");
+	ASSERT_EQUALS_INT(1, getNumWriteIO(bm), "victim written once");
+	checkBlock(0, "Dirty-0");
+
+	TEST_CHECK(shutdownBufferPool(bm));
+	TEST_CHECK(destroyPageFile(TESTPF));
+
+	free(bm);
+	free(h);
+	TEST_DONE();
+}
+
+// forcePage reports a failed write and leaves the page dirty
+void testFailedForcePage(void) {
+	BM_BufferPool *bm = MAKE_POOL();
+	BM_PageHandle *h = MAKE_PAGE_HANDLE();
+	int saved;
+	testName = "Failed forcePage";
+
+	createBlocks();
+	TEST_CHECK(initBufferPool(bm, TESTPF, NUM_FRAMES, RS_LRU, NULL));
+
+	TEST_CHECK(pinPage(bm, h, 2));
+	sprintf(h->data, "Dirty-%i", 2);
+	TEST_CHECK(markDirty(bm, h));
+
+	saved = breakWrites(bm);
+	ASSERT_ERROR(forcePage(bm, h), "forcePage fails");
+	restoreWrites(bm, saved);
+	ASSERT_TRUE(getDirtyFlags(bm)[frameOf(bm, 2)], "page still dirty");
+	ASSERT_EQUALS_INT(1, getFixCounts(bm)[frameOf(bm, 2)],
+			"caller's pin kept");
+	ASSERT_EQUALS_INT(0, getNumWriteIO(bm), "failed write not counted");
+
+	TEST_CHECK(forcePage(bm, h));
+	ASSERT_TRUE(!getDirtyFlags(bm)[frameOf(bm, 2)], "page clean");
+	ASSERT_EQUALS_INT(1, getNumWriteIO(bm), "write counted");
+	checkBlock(2, "Dirty-2");
+	TEST_CHECK(unpinPage(bm, h));
+
+	TEST_CHECK(shutdownBufferPool(bm));
+	TEST_CHECK(destroyPageFile(TESTPF));
+
+	free(bm);
+	free(h);
+	TEST_DONE();
+}
+
+// the background writer counts pages it did write, not ones it tried to
+void testWriterCountsOnlyWrites(void) {
+	BM_BufferPool *bm = MAKE_POOL();
+	BM_PoolOptions options;
+	int i, waited, saved;
+	testName = "Background writer counts only written pages";
+
+	createBlocks();
+	initPoolOptions(&options);
+	options.backgroundWriter = TRUE;
+	options.writerDirtyTarget = 0;
+
+	// writes are broken before any page gets dirty
+	TEST_CHECK(initBufferPoolWithOptions(bm, TESTPF, NUM_FRAMES, RS_LRU,
+			NULL, &options));
+	saved = breakWrites(bm);
+	for (i = 0; i < NUM_FRAMES; i++) {
+		dirtyPage(bm, i);
+	}
+	usleep(WRITER_IDLE_MS * 1000);
+	ASSERT_EQUALS_INT(0, getNumWriterWriteIO(bm), "failed writes not counted");
+	ASSERT_EQUALS_INT(0, getNumWriteIO(bm), "no pool writes counted");
+	ASSERT_TRUE(getDirtyFlags(bm)[frameOf(bm, 0)], "pages stay dirty");
+
+	restoreWrites(bm, saved);
+	for (waited = 0; getNumWriterWriteIO(bm) < NUM_FRAMES
+			&& waited < WRITER_TIMEOUT_MS; waited++) {
+		usleep(1000);
+	}
+	ASSERT_EQUALS_INT(NUM_FRAMES, getNumWriterWriteIO(bm),
+			"pages written once writes work");
+	for (i = 0; i < NUM_FRAMES; i++) {
+		char expected[32];
+		sprintf(expected, "Dirty-%i", i);
+		checkBlock(i, expected);
+	}
+
+	TEST_CHECK(shutdownBufferPool(bm));
+	TEST_CHECK(destroyPageFile(TESTPF));
+
+	free(bm);
+	TEST_DONE();
+}
+
+// create page file of NUM_BLOCKS pages "Page-<page no>"
+void createBlocks(void) {
+	SM_FileHandle fh;
+	SM_PageHandle ph = (SM_PageHandle) malloc(PAGE_SIZE);
+	int i;
+
+	TEST_CHECK(createPageFile(TESTPF));
+	TEST_CHECK(openPageFile(TESTPF, &fh));
+	TEST_CHECK(ensureCapacity(NUM_BLOCKS, &fh));
+	for (i = 0; i < NUM_BLOCKS; i++) {
+		memset(ph, 0, PAGE_SIZE);
+		sprintf(ph, "Page-%i", i);
+		TEST_CHECK(writeBlock(i, &fh, ph));
+	}
+	TEST_CHECK(closePageFile(&fh));
+
+	free(ph);
+}
+
+// make writes to the pool's page file fail by swapping a read-only
+// descriptor in, returns a copy of the original one
+int breakWrites(BM_BufferPool *bm) {
+	int fd = fileno((FILE *) ((BM_Data *) bm->mgmtData)->files[
+			bm->fileId]->smFH.mgmtInfo);
+	int saved = dup(fd);
+	int readOnly = open(TESTPF, O_RDONLY);
+
+	dup2(readOnly, fd);
+	close(readOnly);
+
+	return saved;
+}
+
+// undo breakWrites
+void restoreWrites(BM_BufferPool *bm, int saved) {
+	int fd = fileno((FILE *) ((BM_Data *) bm->mgmtData)->files[
+			bm->fileId]->smFH.mgmtInfo);
+
+	dup2(saved, fd);
+	close(saved);
+}
+
+// pin page pageNum, overwrite it with "Dirty-<page no>" and unpin it
+void dirtyPage(BM_BufferPool *bm, PageNumber pageNum) {
+	BM_PageHandle h;
+
+	TEST_CHECK(pinPage(bm, &h, pageNum));
+	sprintf(h.data, "Dirty-%i", pageNum);
+	TEST_CHECK(markDirty(bm, &h));
+	TEST_CHECK(unpinPage(bm, &h));
+}
+
+// check that block pageNum of TESTPF holds expected
+void checkBlock(PageNumber pageNum, char *expected) {
+	SM_FileHandle fh;
+	SM_PageHandle ph = (SM_PageHandle) malloc(PAGE_SIZE);
+
+	TEST_CHECK(openPageFile(TESTPF, &fh));
+	TEST_CHECK(readBlock(pageNum, &fh, ph));
+	ASSERT_EQUALS_STRING(expected, ph, "block content");
+	TEST_CHECK(closePageFile(&fh));
+
+	free(ph);
+}
+
+// index of the frame holding page pageNum, -1 if none does
+int frameOf(BM_BufferPool *bm, PageNumber pageNum) {
+	PageNumber *frames = getFrameContents(bm);
+	int i;
+
+	for (i = 0; i < bm->numPages; i++) {
+		if (frames[i] == pageNum) {
+			return i;
+		}
+	}
+
+	return -1;
+}
+
+// body of a thread pinning a page, checking its content and unpinning it
+void *pinThread(void *arg) {
+	PinRequest *req = (PinRequest *) arg;
+	char expected[32];
+	BM_PageHandle h;
+
+	if (pinPage(req->bm, &h, req->pageNum) != RC_OK) {
+		req->failed++;
+		return NULL;
+	}
+	sprintf(expected, "Page-%i", req->pageNum);
+	req->failed += strcmp(expected, h.data) != 0;
+	req->failed += unpinPage(req->bm, &h) != RC_OK;
+
+	return NULL;
+}
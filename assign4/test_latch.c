@@ -0,0 +1,433 @@
+#include "storage_mgr.h"
+#include "buffer_mgr_stat.h"
+#include "buffer_mgr.h"
+#include "record_mgr.h"
+#include "tables.h"
+#include "dberror.h"
+#include "test_helper.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+
+// var to store the current test's name
+char *testName;
+
+/* page file and pool used by all tests */
+#define TESTPF "test_latch.bin"
+#define NUM_FRAMES 4
+#define LATCHED_PAGE 1
+
+/* table used by the record manager test */
+#define TESTTBL "test_latch_table"
+
+// pool and latch request handed to a latching thread
+typedef struct LatchRequest {
+	BM_BufferPool *bm;
+	BM_PageHandle *page;
+	BM_LatchMode mode;	// BM_LATCH_NONE to upgrade a shared latch
+	RC ret;
+	volatile int done;
+} LatchRequest;
+
+// table and record handed to a thread reading or updating the record
+typedef struct RecordRequest {
+	RM_TableData *table;
+	Record *record;
+	bool update;
+	RC ret;
+	volatile int done;
+} RecordRequest;
+
+// test and helper methods
+static void testSharedShared(void);
+static void testSharedExclusive(void);
+static void testUpgradeConflict(void);
+static void testLatchErrors(void);
+static void testRecordLatches(void);
+
+static void pinHandles(BM_BufferPool *bm, BM_PageHandle *pages, int n);
+static void unpinHandles(BM_BufferPool *bm, BM_PageHandle *pages, int n);
+static void startLatching(LatchRequest *req, pthread_t *thread,
+		BM_BufferPool *bm, BM_PageHandle *page, BM_LatchMode mode);
+static void *latchThread(void *arg);
+static void waitForWaiter(BM_BufferPool *bm, BM_PageHandle *probe);
+static int frameOf(BM_BufferPool *bm, PageNumber pageNum);
+static Schema *valueSchema(void);
+static void setValue(Record *record, Schema *schema, int v);
+static int getValue(Record *record, Schema *schema);
+static void startRecordAccess(RecordRequest *req, pthread_t *thread,
+		RM_TableData *table, Record *record, bool update);
+static void *recordThread(void *arg);
+
+// main method
+int main(void) {
+	initStorageManager();
+	testName = "";
+
+	testSharedShared();
+	testSharedExclusive();
+	testUpgradeConflict();
+	testLatchErrors();
+	testRecordLatches();
+
+	return 0;
+}
+
+// shared latches on a page don't exclude each other
+void testSharedShared(void) {
+	BM_BufferPool *bm = MAKE_POOL();
+	BM_PageHandle pages[3];
+	testName = "Shared latches are compatible";
+
+	TEST_CHECK(createPageFile(TESTPF));
+	TEST_CHECK(initBufferPool(bm, TESTPF, NUM_FRAMES, RS_LRU, NULL));
+	pinHandles(bm, pages, 3);
+
+	TEST_CHECK(latchPage(bm, &pages[0], BM_LATCH_SHARED));
+	TEST_CHECK(tryLatchPage(bm, &pages[1], BM_LATCH_SHARED));
+	TEST_CHECK(latchPage(bm, &pages[2], BM_LATCH_SHARED));
+	ASSERT_EQUALS_INT(RC_PAGE_LATCH_BUSY,
+			tryLatchPage(bm, &pages[2], BM_LATCH_EXCLUSIVE),
+			"exclusive latch excluded by shared ones");
+
+	TEST_CHECK(unlatchPage(bm, &pages[0]));
+	TEST_CHECK(unlatchPage(bm, &pages[1]));
+	TEST_CHECK(unlatchPage(bm, &pages[2]));
+	TEST_CHECK(tryLatchPage(bm, &pages[0], BM_LATCH_EXCLUSIVE));
+	TEST_CHECK(unlatchPage(bm, &pages[0]));
+
+	unpinHandles(bm, pages, 3);
+	TEST_CHECK(shutdownBufferPool(bm));
+	TEST_CHECK(destroyPageFile(TESTPF));
+
+	free(bm);
+	TEST_DONE();
+}
+
+// an exclusive latch excludes shared ones and the other way round, a
+// blocked latcher goes on once the conflicting latch is released
+void testSharedExclusive(void) {
+	BM_BufferPool *bm = MAKE_POOL();
+	BM_PageHandle pages[3];
+	LatchRequest req;
+	pthread_t thread;
+	testName = "Shared and exclusive latches exclude each other";
+
+	TEST_CHECK(createPageFile(TESTPF));
+	TEST_CHECK(initBufferPool(bm, TESTPF, NUM_FRAMES, RS_LRU, NULL));
+	pinHandles(bm, pages, 3);
+
+	// exclusive holder keeps shared latchers out
+	TEST_CHECK(latchPage(bm, &pages[0], BM_LATCH_EXCLUSIVE));
+	ASSERT_EQUALS_INT(RC_PAGE_LATCH_BUSY,
+			tryLatchPage(bm, &pages[1], BM_LATCH_SHARED),
+			"shared latch excluded by exclusive one");
+	ASSERT_EQUALS_INT(RC_PAGE_LATCH_BUSY,
+			tryLatchPage(bm, &pages[1], BM_LATCH_EXCLUSIVE),
+			"exclusive latch excluded by exclusive one");
+	startLatching(&req, &thread, bm, &pages[1], BM_LATCH_SHARED);
+	sched_yield();
+	ASSERT_TRUE(!req.done, "shared latcher waits for exclusive holder");
+	TEST_CHECK(unlatchPage(bm, &pages[0]));
+	pthread_join(thread, NULL);
+	TEST_CHECK(req.ret);
+
+	// shared holder keeps exclusive latchers out, a waiting exclusive
+	// latcher keeps new shared latchers out
+	startLatching(&req, &thread, bm, &pages[0], BM_LATCH_EXCLUSIVE);
+	waitForWaiter(bm, &pages[2]);
+	ASSERT_TRUE(!req.done, "exclusive latcher waits for shared holder");
+	TEST_CHECK(unlatchPage(bm, &pages[1]));
+	pthread_join(thread, NULL);
+	TEST_CHECK(req.ret);
+	TEST_CHECK(unlatchPage(bm, &pages[0]));
+
+	unpinHandles(bm, pages, 3);
+	TEST_CHECK(shutdownBufferPool(bm));
+	TEST_CHECK(destroyPageFile(TESTPF));
+
+	free(bm);
+	TEST_DONE();
+}
+
+// only one upgrade of a shared latch may be pending, a second upgrader
+// fails and keeps its shared latch
+void testUpgradeConflict(void) {
+	BM_BufferPool *bm = MAKE_POOL();
+	BM_PageHandle pages[3];
+	LatchRequest req;
+	pthread_t thread;
+	testName = "Conflicting latch upgrades";
+
+	TEST_CHECK(createPageFile(TESTPF));
+	TEST_CHECK(initBufferPool(bm, TESTPF, NUM_FRAMES, RS_LRU, NULL));
+	pinHandles(bm, pages, 3);
+
+	// sole shared holder upgrades right away
+	TEST_CHECK(latchPage(bm, &pages[0], BM_LATCH_SHARED));
+	TEST_CHECK(upgradePageLatch(bm, &pages[0]));
+	ASSERT_EQUALS_INT(RC_PAGE_LATCH_BUSY,
+			tryLatchPage(bm, &pages[1], BM_LATCH_SHARED),
+			"upgraded latch is exclusive");
+	TEST_CHECK(unlatchPage(bm, &pages[0]));
+
+	// first upgrader waits for the other shared holder
+	TEST_CHECK(latchPage(bm, &pages[0], BM_LATCH_SHARED));
+	TEST_CHECK(latchPage(bm, &pages[1], BM_LATCH_SHARED));
+	startLatching(&req, &thread, bm, &pages[0], BM_LATCH_NONE);
+	waitForWaiter(bm, &pages[2]);
+	ASSERT_TRUE(!req.done, "upgrader waits for other shared holder");
+
+	// second upgrader would wait for the first forever
+	ASSERT_EQUALS_INT(RC_PAGE_LATCH_BUSY, upgradePageLatch(bm, &pages[1]),
+			"second upgrade fails");
+	ASSERT_TRUE(!req.done, "first upgrader still waits");
+
+	// second upgrader still holds its shared latch, releasing it lets the
+	// first one through
+	TEST_CHECK(unlatchPage(bm, &pages[1]));
+	pthread_join(thread, NULL);
+	TEST_CHECK(req.ret);
+	ASSERT_EQUALS_INT(RC_PAGE_LATCH_BUSY,
+			tryLatchPage(bm, &pages[1], BM_LATCH_SHARED),
+			"first upgrader holds exclusive latch");
+	TEST_CHECK(unlatchPage(bm, &pages[0]));
+
+	unpinHandles(bm, pages, 3);
+	TEST_CHECK(shutdownBufferPool(bm));
+	TEST_CHECK(destroyPageFile(TESTPF));
+
+	free(bm);
+	TEST_DONE();
+}
+
+// latch calls on pages not pinned or not latched fail
+void testLatchErrors(void) {
+	BM_BufferPool *bm = MAKE_POOL();
+	BM_PageHandle *h = MAKE_PAGE_HANDLE();
+	testName = "Latch errors";
+
+	TEST_CHECK(createPageFile(TESTPF));
+	TEST_CHECK(initBufferPool(bm, TESTPF, NUM_FRAMES, RS_LRU, NULL));
+
+	TEST_CHECK(pinPage(bm, h, LATCHED_PAGE));
+	ASSERT_EQUALS_INT(RC_INVALID_OP, unlatchPage(bm, h),
+			"unlatching a page not latched");
+	ASSERT_EQUALS_INT(RC_INVALID_OP, upgradePageLatch(bm, h),
+			"upgrading a page not latched");
+	TEST_CHECK(latchPage(bm, h, BM_LATCH_EXCLUSIVE));
+	ASSERT_EQUALS_INT(RC_INVALID_OP, upgradePageLatch(bm, h),
+			"upgrading an exclusive latch");
+	ASSERT_EQUALS_INT(RC_INVALID_OP, latchPage(bm, h, BM_LATCH_NONE),
+			"latching in no mode");
+	TEST_CHECK(unpinPageLatched(bm, h));
+	ASSERT_EQUALS_INT(RC_PAGE_NOT_PINNED, latchPage(bm, h, BM_LATCH_SHARED),
+			"latching a page not pinned");
+
+	TEST_CHECK(pinPageLatched(bm, h, LATCHED_PAGE, BM_LATCH_SHARED));
+	TEST_CHECK(unpinPageLatched(bm, h));
+
+	TEST_CHECK(shutdownBufferPool(bm));
+	TEST_CHECK(destroyPageFile(TESTPF));
+
+	free(bm);
+	free(h);
+	TEST_DONE();
+}
+
+// getRecord latches the record's page shared and updateRecord exclusive,
+// both release latch and pin when done
+void testRecordLatches(void) {
+	RM_TableData *table = (RM_TableData *) malloc(sizeof(RM_TableData));
+	Schema *schema = valueSchema();
+	BM_PageHandle probe;
+	BM_BufferPool *bm;
+	RecordRequest req;
+	pthread_t thread;
+	Record *r;
+	RID id;
+	testName = "Record manager latches its pages";
+
+	TEST_CHECK(initRecordManager(NULL));
+	TEST_CHECK(createTable(TESTTBL, schema));
+	TEST_CHECK(openTable(table, TESTTBL));
+	bm = ((RM_TableMgmtData *) table->mgmtData)->bPool;
+
+	TEST_CHECK(createRecord(&r, schema));
+	setValue(r, schema, 1);
+	TEST_CHECK(insertRecord(table, r));
+	id = r->id;
+
+	// reader waits while the page is latched exclusive
+	TEST_CHECK(pinPageLatched(bm, &probe, id.page, BM_LATCH_EXCLUSIVE));
+	startRecordAccess(&req, &thread, table, r, FALSE);
+	usleep(20 * 1000);
+	ASSERT_TRUE(!req.done, "getRecord waits for exclusive latch");
+	TEST_CHECK(unpinPageLatched(bm, &probe));
+	pthread_join(thread, NULL);
+	TEST_CHECK(req.ret);
+	ASSERT_EQUALS_INT(1, getValue(r, schema), "record read after latch");
+
+	// writer waits while the page is latched shared
+	TEST_CHECK(pinPageLatched(bm, &probe, id.page, BM_LATCH_SHARED));
+	setValue(r, schema, 2);
+	startRecordAccess(&req, &thread, table, r, TRUE);
+	TEST_CHECK(pinPage(bm, &probe, id.page));
+	waitForWaiter(bm, &probe);
+	TEST_CHECK(unpinPage(bm, &probe));
+	ASSERT_TRUE(!req.done, "updateRecord waits for shared latch");
+	TEST_CHECK(unpinPageLatched(bm, &probe));
+	pthread_join(thread, NULL);
+	TEST_CHECK(req.ret);
+
+	setValue(r, schema, 0);
+	TEST_CHECK(getRecord(table, id, r));
+	ASSERT_EQUALS_INT(2, getValue(r, schema), "update written under latch");
+
+	// nothing is left latched or pinned
+	TEST_CHECK(pinPage(bm, &probe, id.page));
+	TEST_CHECK(tryLatchPage(bm, &probe, BM_LATCH_EXCLUSIVE));
+	TEST_CHECK(unpinPageLatched(bm, &probe));
+	ASSERT_EQUALS_INT(0, getFixCounts(bm)[frameOf(bm, id.page)],
+			"record calls left no pins");
+
+	freeRecord(r);
+	TEST_CHECK(closeTable(table));
+	TEST_CHECK(deleteTable(TESTTBL));
+	TEST_CHECK(shutdownRecordManager());
+	freeSchema(schema);
+
+	free(table);
+	TEST_DONE();
+}
+
+// pin LATCHED_PAGE once for each of n page handles
+void pinHandles(BM_BufferPool *bm, BM_PageHandle *pages, int n) {
+	int i;
+
+	for (i = 0; i < n; i++) {
+		TEST_CHECK(pinPage(bm, &pages[i], LATCHED_PAGE));
+	}
+}
+
+// unpin the n page handles pinned by pinHandles
+void unpinHandles(BM_BufferPool *bm, BM_PageHandle *pages, int n) {
+	int i;
+
+	for (i = 0; i < n; i++) {
+		TEST_CHECK(unpinPage(bm, &pages[i]));
+	}
+	ASSERT_EQUALS_INT(0, getFixCounts(bm)[frameOf(bm, LATCHED_PAGE)],
+			"no pins left");
+}
+
+// start a thread latching page in mode, or upgrading its shared latch
+void startLatching(LatchRequest *req, pthread_t *thread, BM_BufferPool *bm,
+		BM_PageHandle *page, BM_LatchMode mode) {
+	req->bm = bm;
+	req->page = page;
+	req->mode = mode;
+	req->ret = RC_OK;
+	req->done = 0;
+	pthread_create(thread, NULL, latchThread, req);
+}
+
+// body of a latching thread
+void *latchThread(void *arg) {
+	LatchRequest *req = (LatchRequest *) arg;
+
+	req->ret = req->mode == BM_LATCH_NONE ?
+			upgradePageLatch(req->bm, req->page) :
+			latchPage(req->bm, req->page, req->mode);
+	__atomic_store_n(&req->done, 1, __ATOMIC_RELEASE);
+
+	return NULL;
+}
+
+// wait until a thread waits for an exclusive latch or an upgrade: then new
+// shared latchers are kept out, which probe tells
+void waitForWaiter(BM_BufferPool *bm, BM_PageHandle *probe) {
+	while (tryLatchPage(bm, probe, BM_LATCH_SHARED) == RC_OK) {
+		TEST_CHECK(unlatchPage(bm, probe));
+		sched_yield();
+	}
+}
+
+// index of the frame holding page pageNum, -1 if none does
+int frameOf(BM_BufferPool *bm, PageNumber pageNum) {
+	PageNumber *frames = getFrameContents(bm);
+	int i;
+
+	for (i = 0; i < ((BM_Data *) bm->mgmtData)->numFramesUsed; i++) {
+		if (frames[i] == pageNum) {
+			return i;
+		}
+	}
+
+	return -1;
+}
+
+// schema of rows (v), without a key so updates may change v
+Schema *valueSchema(void) {
+	char **cpNames = (char **) malloc(sizeof(char *));
+	DataType *cpDt = (DataType *) malloc(sizeof(DataType));
+	int *cpSizes = (int *) malloc(sizeof(int));
+	int *cpKeys = (int *) malloc(sizeof(int));
+
+	cpNames[0] = (char *) malloc(2);
+	strcpy(cpNames[0], "v");
+	cpDt[0] = DT_INT;
+	cpSizes[0] = 0;
+	cpKeys[0] = 0;
+
+	return createSchema(1, cpNames, cpDt, cpSizes, 0, cpKeys);
+}
+
+// set attribute v of record to v
+void setValue(Record *record, Schema *schema, int v) {
+	Value *value;
+
+	MAKE_VALUE(value, DT_INT, v);
+	TEST_CHECK(setAttr(record, schema, 0, value));
+	freeVal(value);
+}
+
+// attribute v of record
+int getValue(Record *record, Schema *schema) {
+	Value *value;
+	int v;
+
+	TEST_CHECK(getAttr(record, schema, 0, &value));
+	v = value->v.intV;
+	freeVal(value);
+
+	return v;
+}
+
+// start a thread reading record with getRecord, or writing it back with
+// updateRecord
+void startRecordAccess(RecordRequest *req, pthread_t *thread,
+		RM_TableData *table, Record *record, bool update) {
+	req->table = table;
+	req->record = record;
+	req->update = update;
+	req->ret = RC_OK;
+	req->done = 0;
+	pthread_create(thread, NULL, recordThread, req);
+}
+
+// body of a record reading or updating thread
+void *recordThread(void *arg) {
+	RecordRequest *req = (RecordRequest *) arg;
+
+	req->ret = req->update ?
+			updateRecord(req->table, req->record) :
+			getRecord(req->table, req->record->id, req->record);
+	__atomic_store_n(&req->done, 1, __ATOMIC_RELEASE);
+
+	return NULL;
+}
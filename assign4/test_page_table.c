@@ -0,0 +1,218 @@
+#include "storage_mgr.h"
+#include "buffer_mgr_stat.h"
+#include "buffer_mgr.h"
+#include "dberror.h"
+#include "test_helper.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+// var to store the current test's name
+char *testName;
+
+/* page files and pool sizes used by all tests */
+#define TESTPF "test_page_table.bin"
+#define OTHERPF "test_page_table2.bin"
+#define NUM_FRAMES 40
+#define SMALL_FRAMES 3
+#define NUM_BLOCKS 1280
+
+/* pins of the pool a thread keeps busy and pools opened meanwhile */
+#define NUM_PINS 20000
+#define NUM_OPENS 50
+
+// pool a thread pins pages of, and pages it found wrong
+typedef struct PinRequest {
+	BM_BufferPool *bm;
+	int failed;
+} PinRequest;
+
+// test and helper methods
+static void testLookupsInOneShard(void);
+static void testPoolSmallerThanShards(void);
+static void testIndependentPools(void);
+
+static void createBlocks(char *fileName);
+static void checkPage(BM_BufferPool *bm, PageNumber pageNum);
+static bool holdsPage(BM_BufferPool *bm, PageNumber pageNum);
+static void *pinThread(void *arg);
+
+// main method
+int main(void) {
+	initStorageManager();
+	testName = "";
+
+	testLookupsInOneShard();
+	testPoolSmallerThanShards();
+	testIndependentPools();
+
+	return 0;
+}
+
+// pages that all fall in one shard are found again, and only while they
+// are held by a frame
+void testLookupsInOneShard(void) {
+	BM_BufferPool *bm = MAKE_POOL();
+	int i;
+	testName = "Page table lookups within one shard";
+
+	createBlocks(TESTPF);
+	TEST_CHECK(initBufferPool(bm, TESTPF, NUM_FRAMES, RS_FIFO, NULL));
+
+	for (i = 0; i < NUM_FRAMES; i++) {
+		checkPage(bm, i * BM_PAGE_TABLE_SHARDS);
+	}
+	ASSERT_EQUALS_INT(NUM_FRAMES, getNumReadIO(bm), "each page read once");
+	for (i = 0; i < NUM_FRAMES; i++) {
+		ASSERT_TRUE(holdsPage(bm, i * BM_PAGE_TABLE_SHARDS), "page is held");
+		checkPage(bm, i * BM_PAGE_TABLE_SHARDS);
+	}
+	ASSERT_EQUALS_INT(NUM_FRAMES, getNumReadIO(bm), "pins of held pages hit");
+
+	// replace all pages by ones of the same shard
+	for (i = NUM_FRAMES; i < 2 * NUM_FRAMES; i++) {
+		checkPage(bm, i * BM_PAGE_TABLE_SHARDS);
+	}
+	ASSERT_TRUE(!holdsPage(bm, 0), "first page replaced");
+	checkPage(bm, 0);
+	ASSERT_EQUALS_INT(2 * NUM_FRAMES + 1, getNumReadIO(bm),
+			"replaced page read again");
+
+	TEST_CHECK(shutdownBufferPool(bm));
+	TEST_CHECK(destroyPageFile(TESTPF));
+
+	free(bm);
+	TEST_DONE();
+}
+
+// a pool with fewer frames than the page table has shards
+void testPoolSmallerThanShards(void) {
+	BM_BufferPool *bm = MAKE_POOL();
+	BM_PageHandle *h = MAKE_PAGE_HANDLE();
+	int i;
+	testName = "Pool with fewer frames than shards";
+
+	createBlocks(TESTPF);
+	TEST_CHECK(initBufferPool(bm, TESTPF, SMALL_FRAMES, RS_LRU, NULL));
+
+	for (i = 0; i < 4 * BM_PAGE_TABLE_SHARDS; i++) {
+		checkPage(bm, i);
+	}
+	TEST_CHECK(pinPage(bm, h, 7));
+	TEST_CHECK(pinPage(bm, h, 7));
+	ASSERT_TRUE(holdsPage(bm, 7), "pinned page is held");
+	TEST_CHECK(unpinPage(bm, h));
+	TEST_CHECK(unpinPage(bm, h));
+	ASSERT_EQUALS_INT(4 * BM_PAGE_TABLE_SHARDS + 1, getNumReadIO(bm),
+			"second pin hits");
+
+	TEST_CHECK(shutdownBufferPool(bm));
+	TEST_CHECK(destroyPageFile(TESTPF));
+
+	free(bm);
+	free(h);
+	TEST_DONE();
+}
+
+// a pool is used by a thread while another pool is opened and shut down
+// over and over, each pool has a latch of its own
+void testIndependentPools(void) {
+	BM_BufferPool *bm = MAKE_POOL();
+	BM_BufferPool *other = MAKE_POOL();
+	PinRequest req;
+	pthread_t thread;
+	int i;
+	testName = "Pools latched independently";
+
+	createBlocks(TESTPF);
+	createBlocks(OTHERPF);
+	TEST_CHECK(initBufferPool(bm, TESTPF, NUM_FRAMES, RS_LRU, NULL));
+
+	req.bm = bm;
+	req.failed = 0;
+	pthread_create(&thread, NULL, pinThread, &req);
+	for (i = 0; i < NUM_OPENS; i++) {
+		TEST_CHECK(initBufferPool(other, OTHERPF, SMALL_FRAMES, RS_FIFO, NULL));
+		checkPage(other, i);
+		TEST_CHECK(shutdownBufferPool(other));
+	}
+	pthread_join(thread, NULL);
+	ASSERT_EQUALS_INT(0, req.failed, "thread found its pages");
+
+	TEST_CHECK(shutdownBufferPool(bm));
+	TEST_CHECK(destroyPageFile(TESTPF));
+	TEST_CHECK(destroyPageFile(OTHERPF));
+
+	free(bm);
+	free(other);
+	TEST_DONE();
+}
+
+// create page file fileName of NUM_BLOCKS pages "Page-<page no>"
+void createBlocks(char *fileName) {
+	SM_FileHandle fh;
+	SM_PageHandle ph = (SM_PageHandle) malloc(PAGE_SIZE);
+	int i;
+
+	TEST_CHECK(createPageFile(fileName));
+	TEST_CHECK(openPageFile(fileName, &fh));
+	TEST_CHECK(ensureCapacity(NUM_BLOCKS, &fh));
+	for (i = 0; i < NUM_BLOCKS; i++) {
+		memset(ph, 0, PAGE_SIZE);
+		sprintf(ph, "Page-%i", i);
+		TEST_CHECK(writeBlock(i, &fh, ph));
+	}
+	TEST_CHECK(closePageFile(&fh));
+
+	free(ph);
+}
+
+// pin page pageNum, check its content and unpin it
+void checkPage(BM_BufferPool *bm, PageNumber pageNum) {
+	BM_PageHandle h;
+	char expected[32];
+
+	TEST_CHECK(pinPage(bm, &h, pageNum));
+	sprintf(expected, "Page-%i", pageNum);
+	if (h.pageNum != pageNum || strcmp(expected, h.data) != 0) {
+		ASSERT_EQUALS_STRING(expected, h.data, "pinned page content");
+	}
+	TEST_CHECK(unpinPage(bm, &h));
+}
+
+// tell whether a frame of the pool holds page pageNum
+bool holdsPage(BM_BufferPool *bm, PageNumber pageNum) {
+	PageNumber *frames = getFrameContents(bm);
+	bool found = FALSE;
+	int i;
+
+	for (i = 0; i < bm->numPages; i++) {
+		found |= frames[i] == pageNum;
+	}
+
+	return found;
+}
+
+// body of a thread pinning pages of a pool and checking their content
+void *pinThread(void *arg) {
+	PinRequest *req = (PinRequest *) arg;
+	unsigned int seed = 1;
+	char expected[32];
+	BM_PageHandle h;
+	int i;
+
+	for (i = 0; i < NUM_PINS; i++) {
+		PageNumber pageNum = rand_r(&seed) % (2 * NUM_FRAMES);
+		if (pinPage(req->bm, &h, pageNum) != RC_OK) {
+			req->failed++;
+			continue;
+		}
+		sprintf(expected, "Page-%i", pageNum);
+		req->failed += h.pageNum != pageNum || strcmp(expected, h.data) != 0;
+		req->failed += unpinPage(req->bm, &h) != RC_OK;
+	}
+
+	return NULL;
+}
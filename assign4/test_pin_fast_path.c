@@ -0,0 +1,266 @@
+#include "storage_mgr.h"
+#include "buffer_mgr_stat.h"
+#include "buffer_mgr.h"
+#include "dberror.h"
+#include "test_helper.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+
+// var to store the current test's name
+char *testName;
+
+/* page file and pool used by all tests */
+#define TESTPF "test_pin_fast_path.bin"
+#define NUM_FRAMES 8
+#define NUM_BLOCKS 32
+#define RESIDENT_PAGE 3
+
+/* threads pinning pages at a time and pins each of them makes */
+#define NUM_THREADS 4
+#define NUM_PINS 50000
+
+/* ms a latch-free pin may take before it's considered blocked */
+#define PIN_TIMEOUT_MS 5000
+
+// pool a pinning thread works on, its seed and how it fared
+typedef struct PinRequest {
+	BM_BufferPool *bm;
+	unsigned int seed;
+	int failed;
+	volatile int done;
+} PinRequest;
+
+// test and helper methods
+static void testPinWithoutLatches(void);
+static void testConcurrentPins(void);
+static void testUnpinErrors(void);
+
+static void createBlocks(void);
+static void lockPool(BM_BufferPool *bm);
+static void unlockPool(BM_BufferPool *bm);
+static int frameOf(BM_BufferPool *bm, PageNumber pageNum);
+static void *pinResidentThread(void *arg);
+static void *pinRandomThread(void *arg);
+
+// main method
+int main(void) {
+	initStorageManager();
+	testName = "";
+
+	testPinWithoutLatches();
+	testConcurrentPins();
+	testUnpinErrors();
+
+	return 0;
+}
+
+// a resident page is pinned, dirtied and unpinned while the pool latch and
+// all page table latches are held by someone else
+void testPinWithoutLatches(void) {
+	BM_BufferPool *bm = MAKE_POOL();
+	BM_PageHandle *h = MAKE_PAGE_HANDLE();
+	PinRequest req;
+	pthread_t thread;
+	int waited;
+	testName = "Pins of resident pages take no latch";
+
+	createBlocks();
+	TEST_CHECK(initBufferPool(bm, TESTPF, NUM_FRAMES, RS_LRU, NULL));
+	TEST_CHECK(pinPage(bm, h, RESIDENT_PAGE));
+	TEST_CHECK(unpinPage(bm, h));
+
+	lockPool(bm);
+	req.bm = bm;
+	req.failed = 0;
+	req.done = 0;
+	pthread_create(&thread, NULL, pinResidentThread, &req);
+	for (waited = 0; !req.done && waited < PIN_TIMEOUT_MS; waited++) {
+		usleep(1000);
+	}
+	ASSERT_TRUE(req.done, "pin finished while latches were held");
+	unlockPool(bm);
+	pthread_join(thread, NULL);
+	ASSERT_EQUALS_INT(0, req.failed, "pin, markDirty and unpin succeeded");
+
+	TEST_CHECK(pinPage(bm, h, RESIDENT_PAGE));
+	ASSERT_EQUALS_INT(1, getFixCounts(bm)[frameOf(bm, RESIDENT_PAGE)],
+			"unpin took effect");
+	ASSERT_TRUE(getDirtyFlags(bm)[frameOf(bm, RESIDENT_PAGE)],
+			"markDirty took effect");
+	ASSERT_EQUALS_INT(1, getNumReadIO(bm), "page was read once");
+	TEST_CHECK(unpinPage(bm, h));
+
+	TEST_CHECK(shutdownBufferPool(bm));
+	TEST_CHECK(destroyPageFile(TESTPF));
+
+	free(bm);
+	free(h);
+	TEST_DONE();
+}
+
+// threads pin pages of a pool too small to hold all of them, each page must
+// show up in one frame at most and all pins must be gone at the end
+void testConcurrentPins(void) {
+	BM_BufferPool *bm = MAKE_POOL();
+	PinRequest reqs[NUM_THREADS];
+	pthread_t threads[NUM_THREADS];
+	PageNumber *frames;
+	int i, j, failed = 0, duplicates = 0, pinned = 0;
+	testName = "Concurrent latch-free pins";
+
+	createBlocks();
+	TEST_CHECK(initBufferPool(bm, TESTPF, NUM_FRAMES, RS_LRU, NULL));
+
+	for (i = 0; i < NUM_THREADS; i++) {
+		reqs[i].bm = bm;
+		reqs[i].seed = i + 1;
+		reqs[i].failed = 0;
+		reqs[i].done = 0;
+		pthread_create(&threads[i], NULL, pinRandomThread, &reqs[i]);
+	}
+	for (i = 0; i < NUM_THREADS; i++) {
+		pthread_join(threads[i], NULL);
+		failed += reqs[i].failed;
+	}
+	ASSERT_EQUALS_INT(0, failed, "pins found their pages");
+
+	frames = getFrameContents(bm);
+	for (i = 0; i < NUM_FRAMES; i++) {
+		pinned += getFixCounts(bm)[i];
+		for (j = i + 1; j < NUM_FRAMES; j++) {
+			duplicates += frames[i] != NO_PAGE && frames[i] == frames[j];
+		}
+	}
+	ASSERT_EQUALS_INT(0, pinned, "no pins left");
+	ASSERT_EQUALS_INT(0, duplicates, "no page held by two frames");
+
+	TEST_CHECK(shutdownBufferPool(bm));
+	TEST_CHECK(destroyPageFile(TESTPF));
+
+	free(bm);
+	TEST_DONE();
+}
+
+// unpins of pages not pinned fail and leave fix counts alone
+void testUnpinErrors(void) {
+	BM_BufferPool *bm = MAKE_POOL();
+	BM_PageHandle *h = MAKE_PAGE_HANDLE();
+	testName = "Unpins of pages not pinned";
+
+	createBlocks();
+	TEST_CHECK(initBufferPool(bm, TESTPF, NUM_FRAMES, RS_FIFO, NULL));
+
+	TEST_CHECK(pinPage(bm, h, RESIDENT_PAGE));
+	TEST_CHECK(unpinPage(bm, h));
+	ASSERT_EQUALS_INT(RC_PAGE_NOT_PINNED, unpinPage(bm, h),
+			"unpin of a resident page not pinned");
+	ASSERT_EQUALS_INT(0, getFixCounts(bm)[frameOf(bm, RESIDENT_PAGE)],
+			"fix count stays 0");
+	h->pageNum = RESIDENT_PAGE + 1;
+	ASSERT_ERROR(unpinPage(bm, h), "unpin of a page not in the pool");
+	ASSERT_EQUALS_INT(RC_PAGE_NOT_PINNED, markDirty(bm, h),
+			"markDirty of a page not in the pool");
+
+	TEST_CHECK(shutdownBufferPool(bm));
+	TEST_CHECK(destroyPageFile(TESTPF));
+
+	free(bm);
+	free(h);
+	TEST_DONE();
+}
+
+// create page file of NUM_BLOCKS pages "Page-<page no>"
+void createBlocks(void) {
+	SM_FileHandle fh;
+	SM_PageHandle ph = (SM_PageHandle) malloc(PAGE_SIZE);
+	int i;
+
+	TEST_CHECK(createPageFile(TESTPF));
+	TEST_CHECK(openPageFile(TESTPF, &fh));
+	TEST_CHECK(ensureCapacity(NUM_BLOCKS, &fh));
+	for (i = 0; i < NUM_BLOCKS; i++) {
+		memset(ph, 0, PAGE_SIZE);
+		sprintf(ph, "Page-%i", i);
+		TEST_CHECK(writeBlock(i, &fh, ph));
+	}
+	TEST_CHECK(closePageFile(&fh));
+
+	free(ph);
+}
+
+// take the pool latch and the latches of all page table shards
+void lockPool(BM_BufferPool *bm) {
+	BM_Data *data = (BM_Data *) bm->mgmtData;
+	int i;
+
+	pthread_mutex_lock(&data->poolLock);
+	for (i = 0; i < data->numShards; i++) {
+		pthread_mutex_lock(&data->shards[i].lock);
+	}
+}
+
+// release the latches taken by lockPool
+void unlockPool(BM_BufferPool *bm) {
+	BM_Data *data = (BM_Data *) bm->mgmtData;
+	int i;
+
+	for (i = 0; i < data->numShards; i++) {
+		pthread_mutex_unlock(&data->shards[i].lock);
+	}
+	pthread_mutex_unlock(&data->poolLock);
+}
+
+// index of the frame holding page pageNum, -1 if none does
+int frameOf(BM_BufferPool *bm, PageNumber pageNum) {
+	PageNumber *frames = getFrameContents(bm);
+	int i;
+
+	for (i = 0; i < bm->numPages; i++) {
+		if (frames[i] == pageNum) {
+			return i;
+		}
+	}
+
+	return -1;
+}
+
+// body of a thread pinning, dirtying and unpinning RESIDENT_PAGE once
+void *pinResidentThread(void *arg) {
+	PinRequest *req = (PinRequest *) arg;
+	BM_PageHandle h;
+
+	req->failed += pinPage(req->bm, &h, RESIDENT_PAGE) != RC_OK;
+	req->failed += markDirty(req->bm, &h) != RC_OK;
+	req->failed += unpinPage(req->bm, &h) != RC_OK;
+	__atomic_store_n(&req->done, 1, __ATOMIC_RELEASE);
+
+	return NULL;
+}
+
+// body of a thread pinning random pages and checking their content
+void *pinRandomThread(void *arg) {
+	PinRequest *req = (PinRequest *) arg;
+	char expected[32];
+	BM_PageHandle h;
+	int i;
+
+	for (i = 0; i < NUM_PINS; i++) {
+		//Mostly pins of the first few pages, which should stay resident
+		PageNumber pageNum = rand_r(&req->seed) % 4 != 0 ?
+				rand_r(&req->seed) % (NUM_FRAMES / 2) :
+				rand_r(&req->seed) % NUM_BLOCKS;
+		if (pinPage(req->bm, &h, pageNum) != RC_OK) {
+			req->failed++;
+			continue;
+		}
+		sprintf(expected, "Page-%i", pageNum);
+		req->failed += h.pageNum != pageNum || strcmp(expected, h.data) != 0;
+		req->failed += unpinPage(req->bm, &h) != RC_OK;
+	}
+
+	return NULL;
+}
@@ -0,0 +1,252 @@
+#include "storage_mgr.h"
+#include "buffer_mgr_stat.h"
+#include "buffer_mgr.h"
+#include "dberror.h"
+#include "test_helper.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// var to store the current test's name
+char *testName;
+
+/* page file and pool used by all tests */
+#define TESTPF "test_pin_pages.bin"
+#define NUM_FRAMES 10
+#define SMALL_FRAMES 3
+#define NUM_BLOCKS 20
+
+// test and helper methods
+static void testPinBatch(void);
+static void testRepeatedPages(void);
+static void testAllOrNone(void);
+static void testNewBlocks(void);
+static void testInvalidBatches(void);
+
+static void createBlocks(void);
+static void checkPages(PageNumber *pageNums, int n, BM_PageHandle *pages);
+static int frameOf(BM_BufferPool *bm, PageNumber pageNum);
+static int countPins(BM_BufferPool *bm);
+
+// main method
+int main(void) {
+	initStorageManager();
+	testName = "";
+
+	testPinBatch();
+	testRepeatedPages();
+	testAllOrNone();
+	testNewBlocks();
+	testInvalidBatches();
+
+	return 0;
+}
+
+// a batch pins all its pages, reading only the ones that miss
+void testPinBatch(void) {
+	BM_BufferPool *bm = MAKE_POOL();
+	PageNumber run[] = { 0, 1, 2, 3, 4, 5, 6, 7 };
+	PageNumber mixed[] = { 9, 2, 8, 3 };
+	BM_PageHandle pages[8];
+	testName = "Pinning a batch of pages";
+
+	createBlocks();
+	TEST_CHECK(initBufferPool(bm, TESTPF, NUM_FRAMES, RS_LRU, NULL));
+
+	TEST_CHECK(pinPages(bm, run, 8, pages));
+	checkPages(run, 8, pages);
+	ASSERT_EQUALS_INT(8, getNumReadIO(bm), "every page of the run read");
+	ASSERT_EQUALS_INT(8, countPins(bm), "every page pinned");
+	ASSERT_EQUALS_INT(1, getFixCounts(bm)[frameOf(bm, 5)], "pinned once");
+	TEST_CHECK(unpinPages(bm, pages, 8));
+	ASSERT_EQUALS_INT(0, countPins(bm), "batch unpinned");
+
+	TEST_CHECK(pinPages(bm, mixed, 4, pages));
+	checkPages(mixed, 4, pages);
+	ASSERT_EQUALS_INT(10, getNumReadIO(bm), "only misses read");
+	TEST_CHECK(unpinPages(bm, pages, 4));
+
+	TEST_CHECK(shutdownBufferPool(bm));
+	TEST_CHECK(destroyPageFile(TESTPF));
+
+	free(bm);
+	TEST_DONE();
+}
+
+// a page listed twice is read once and pinned twice
+void testRepeatedPages(void) {
+	BM_BufferPool *bm = MAKE_POOL();
+	PageNumber pageNums[] = { 4, 5, 4 };
+	BM_PageHandle pages[3];
+	testName = "Repeated pages in a batch";
+
+	createBlocks();
+	TEST_CHECK(initBufferPool(bm, TESTPF, NUM_FRAMES, RS_FIFO, NULL));
+
+	TEST_CHECK(pinPages(bm, pageNums, 3, pages));
+	checkPages(pageNums, 3, pages);
+	ASSERT_EQUALS_INT(2, getNumReadIO(bm), "repeated page read once");
+	ASSERT_EQUALS_INT(2, getFixCounts(bm)[frameOf(bm, 4)],
+			"repeated page pinned twice");
+	ASSERT_TRUE(pages[0].data == pages[2].data, "handles share the frame");
+	TEST_CHECK(unpinPages(bm, pages, 3));
+	ASSERT_EQUALS_INT(0, countPins(bm), "batch unpinned");
+
+	TEST_CHECK(shutdownBufferPool(bm));
+	TEST_CHECK(destroyPageFile(TESTPF));
+
+	free(bm);
+	TEST_DONE();
+}
+
+// a batch that doesn't fit in the frames left pins nothing
+void testAllOrNone(void) {
+	BM_BufferPool *bm = MAKE_POOL();
+	BM_PageHandle *h0 = MAKE_PAGE_HANDLE();
+	BM_PageHandle *h1 = MAKE_PAGE_HANDLE();
+	PageNumber pageNums[] = { 0, 2, 3 };
+	BM_PageHandle pages[3];
+	testName = "Batches pin all pages or none";
+
+	createBlocks();
+	TEST_CHECK(initBufferPool(bm, TESTPF, SMALL_FRAMES, RS_FIFO, NULL));
+
+	// two of three frames stay pinned, the batch needs two more
+	TEST_CHECK(pinPage(bm, h0, 0));
+	TEST_CHECK(pinPage(bm, h1, 1));
+	ASSERT_ERROR(pinPages(bm, pageNums, 3, pages), "batch doesn't fit");
+	ASSERT_EQUALS_INT(2, countPins(bm), "no pins left by the batch");
+	ASSERT_EQUALS_INT(1, getFixCounts(bm)[frameOf(bm, 0)],
+			"hit of the batch dropped");
+
+	// with one more frame free it fits
+	TEST_CHECK(unpinPage(bm, h1));
+	TEST_CHECK(pinPages(bm, pageNums, 3, pages));
+	checkPages(pageNums, 3, pages);
+	ASSERT_EQUALS_INT(2, getFixCounts(bm)[frameOf(bm, 0)],
+			"hit of the batch pinned");
+	TEST_CHECK(unpinPages(bm, pages, 3));
+	TEST_CHECK(unpinPage(bm, h0));
+
+	TEST_CHECK(shutdownBufferPool(bm));
+	TEST_CHECK(destroyPageFile(TESTPF));
+
+	free(bm);
+	free(h0);
+	free(h1);
+	TEST_DONE();
+}
+
+// pages past the end of the page file come back empty and get appended
+void testNewBlocks(void) {
+	BM_BufferPool *bm = MAKE_POOL();
+	PageNumber pageNums[] = { NUM_BLOCKS + 1, NUM_BLOCKS };
+	BM_PageHandle pages[2];
+	SM_FileHandle fh;
+	SM_PageHandle ph = (SM_PageHandle) malloc(PAGE_SIZE);
+	testName = "Batches past the end of the page file";
+
+	createBlocks();
+	TEST_CHECK(initBufferPool(bm, TESTPF, NUM_FRAMES, RS_LRU, NULL));
+
+	TEST_CHECK(pinPages(bm, pageNums, 2, pages));
+	ASSERT_EQUALS_INT(0, getNumReadIO(bm), "new pages not read");
+	ASSERT_EQUALS_STRING("", pages[0].data, "new page empty");
+	sprintf(pages[0].data, "New-%i", NUM_BLOCKS + 1);
+	TEST_CHECK(markDirty(bm, &pages[0]));
+	TEST_CHECK(unpinPages(bm, pages, 2));
+	TEST_CHECK(shutdownBufferPool(bm));
+
+	TEST_CHECK(openPageFile(TESTPF, &fh));
+	ASSERT_EQUALS_INT(NUM_BLOCKS + 2, fh.totalNumPages, "blocks appended");
+	TEST_CHECK(readBlock(NUM_BLOCKS + 1, &fh, ph));
+	ASSERT_EQUALS_STRING("New-21", ph, "new page written");
+	TEST_CHECK(closePageFile(&fh));
+	TEST_CHECK(destroyPageFile(TESTPF));
+
+	free(bm);
+	free(ph);
+	TEST_DONE();
+}
+
+// empty batches are fine, bad page numbers fail before anything is pinned
+void testInvalidBatches(void) {
+	BM_BufferPool *bm = MAKE_POOL();
+	PageNumber pageNums[] = { 1, -1 };
+	BM_PageHandle pages[2];
+	testName = "Invalid batches";
+
+	createBlocks();
+	TEST_CHECK(initBufferPool(bm, TESTPF, NUM_FRAMES, RS_LRU, NULL));
+
+	TEST_CHECK(pinPages(bm, pageNums, 0, pages));
+	ASSERT_EQUALS_INT(RC_INVALID_PAGE_REQUESTED,
+			pinPages(bm, pageNums, 2, pages), "negative page number");
+	ASSERT_EQUALS_INT(0, countPins(bm), "nothing pinned");
+	ASSERT_EQUALS_INT(0, getNumReadIO(bm), "nothing read");
+	TEST_CHECK(unpinPages(bm, pages, 0));
+
+	TEST_CHECK(shutdownBufferPool(bm));
+	TEST_CHECK(destroyPageFile(TESTPF));
+
+	free(bm);
+	TEST_DONE();
+}
+
+// create page file of NUM_BLOCKS pages "Page-<page no>"
+void createBlocks(void) {
+	SM_FileHandle fh;
+	SM_PageHandle ph = (SM_PageHandle) malloc(PAGE_SIZE);
+	int i;
+
+	TEST_CHECK(createPageFile(TESTPF));
+	TEST_CHECK(openPageFile(TESTPF, &fh));
+	TEST_CHECK(ensureCapacity(NUM_BLOCKS, &fh));
+	for (i = 0; i < NUM_BLOCKS; i++) {
+		memset(ph, 0, PAGE_SIZE);
+		sprintf(ph, "Page-%i", i);
+		TEST_CHECK(writeBlock(i, &fh, ph));
+	}
+	TEST_CHECK(closePageFile(&fh));
+
+	free(ph);
+}
+
+// check that pinned pages hold "Page-<page no>"
+void checkPages(PageNumber *pageNums, int n, BM_PageHandle *pages) {
+	char expected[32];
+	int i;
+
+	for (i = 0; i < n; i++) {
+		sprintf(expected, "Page-%i", pageNums[i]);
+		ASSERT_EQUALS_INT(pageNums[i], pages[i].pageNum, "page number");
+		ASSERT_EQUALS_STRING(expected, pages[i].data, "page content");
+	}
+}
+
+// index of the frame holding page pageNum, -1 if none does
+int frameOf(BM_BufferPool *bm, PageNumber pageNum) {
+	PageNumber *frames = getFrameContents(bm);
+	int i;
+
+	for (i = 0; i < bm->numPages; i++) {
+		if (frames[i] == pageNum) {
+			return i;
+		}
+	}
+
+	return -1;
+}
+
+// sum of fix counts of all frames
+int countPins(BM_BufferPool *bm) {
+	int *fixCounts = getFixCounts(bm);
+	int i, pins = 0;
+
+	for (i = 0; i < bm->numPages; i++) {
+		pins += fixCounts[i];
+	}
+
+	return pins;
+}
@@ -0,0 +1,315 @@
+#include "storage_mgr.h"
+#include "buffer_mgr_stat.h"
+#include "buffer_mgr.h"
+#include "dberror.h"
+#include "test_helper.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// var to store the current test's name
+char *testName;
+
+/* page file and pool sizes used by all tests */
+#define TESTPF "test_policy.bin"
+#define NUM_FRAMES 3
+#define NUM_BLOCKS 10
+
+/* pins of a victim test, the last one has to evict a page */
+#define MAX_PINS 8
+
+// calls of the callbacks of the counting policy, kept in its state
+typedef struct PolicyCounts {
+	int access;
+	int load;
+	int unpin;
+	int evict;
+} PolicyCounts;
+
+// set up and released counting policies, state of the last one set up
+static int numInit, numDestroy;
+static PolicyCounts *counts;
+
+// pins of a strategy and the page they evict
+typedef struct VictimCase {
+	ReplacementStrategy strategy;
+	int numPins;
+	PageNumber pins[MAX_PINS];
+	PageNumber victim;
+} VictimCase;
+
+// test and helper methods
+static void testStrategyVictims(void);
+static void testFullPool(void);
+static void testCustomPolicy(void);
+static void testInvalidPolicy(void);
+
+static void createBlocks(void);
+static void pinAndCheck(BM_BufferPool *bm, PageNumber pageNum);
+static bool isResident(BM_BufferPool *bm, PageNumber pageNum);
+
+static RC initCounting(struct BM_Data * const data, void ** const state);
+static void destroyCounting(struct BM_Data * const data, void * const state);
+static void accessCounting(struct BM_Data * const data, void * const state,
+		const int frame);
+static void loadCounting(struct BM_Data * const data, void * const state,
+		const int frame);
+static void unpinCounting(struct BM_Data * const data, void * const state,
+		const int frame);
+static void evictCounting(struct BM_Data * const data, void * const state,
+		const int frame);
+static int chooseNewestVictim(struct BM_Data * const data,
+		void * const state);
+
+// policy evicting the page loaded last, counting its callbacks
+static const BM_Policy countingPolicy = { "counting", initCounting,
+		destroyCounting, accessCounting, loadCounting, unpinCounting,
+		evictCounting, chooseNewestVictim };
+
+// main method
+int main(void) {
+	initStorageManager();
+	testName = "";
+
+	testStrategyVictims();
+	testFullPool();
+	testCustomPolicy();
+	testInvalidPolicy();
+
+	return 0;
+}
+
+// each built-in policy evicts the page its strategy picks
+void testStrategyVictims(void) {
+	VictimCase cases[] = {
+		//First in goes first, even though it was used again
+		{ RS_FIFO, 5, { 0, 1, 2, 0, 3 }, 0 },
+		//Least recently used goes
+		{ RS_LRU, 5, { 0, 1, 2, 0, 3 }, 1 },
+		//Least used goes
+		{ RS_LFU, 6, { 0, 1, 2, 0, 2, 3 }, 1 },
+		//Page 1 used again gets its second chance, page 2 doesn't
+		{ RS_CLOCK, 6, { 0, 1, 2, 3, 1, 4 }, 2 },
+		//Page 0 is the only one used twice, others go first in LRU order
+		{ RS_LRU_K, 5, { 0, 0, 1, 2, 3 }, 1 }
+	};
+	int c, i;
+	testName = "Victims of built-in policies";
+
+	createBlocks();
+	for (c = 0; c < sizeof(cases) / sizeof(cases[0]); c++) {
+		BM_BufferPool *bm = MAKE_POOL();
+		VictimCase *vc = &cases[c];
+
+		TEST_CHECK(initBufferPool(bm, TESTPF, NUM_FRAMES, vc->strategy, NULL));
+		for (i = 0; i < vc->numPins; i++) {
+			pinAndCheck(bm, vc->pins[i]);
+		}
+		ASSERT_TRUE(!isResident(bm, vc->victim), "expected page evicted");
+		ASSERT_TRUE(isResident(bm, vc->pins[vc->numPins - 1]),
+				"page pinned last loaded");
+		TEST_CHECK(shutdownBufferPool(bm));
+		free(bm);
+	}
+	TEST_CHECK(destroyPageFile(TESTPF));
+
+	TEST_DONE();
+}
+
+// no policy evicts a pinned page, pins fail until one is unpinned
+void testFullPool(void) {
+	BM_PageHandle h[NUM_FRAMES + 1];
+	int s, i;
+	testName = "Full pool";
+
+	createBlocks();
+	for (s = 0; s < BM_NUM_STRATEGIES; s++) {
+		BM_BufferPool *bm = MAKE_POOL();
+
+		TEST_CHECK(initBufferPool(bm, TESTPF, NUM_FRAMES,
+				(ReplacementStrategy) s, NULL));
+		for (i = 0; i < NUM_FRAMES; i++) {
+			TEST_CHECK(pinPage(bm, &h[i], i));
+		}
+		ASSERT_ERROR(pinPage(bm, &h[NUM_FRAMES], NUM_FRAMES),
+				"no victim while all pages are pinned");
+		TEST_CHECK(unpinPage(bm, &h[1]));
+		TEST_CHECK(pinPage(bm, &h[NUM_FRAMES], NUM_FRAMES));
+		ASSERT_TRUE(!isResident(bm, 1), "unpinned page evicted");
+		TEST_CHECK(unpinPage(bm, &h[NUM_FRAMES]));
+		TEST_CHECK(unpinPage(bm, &h[0]));
+		TEST_CHECK(unpinPage(bm, &h[2]));
+		TEST_CHECK(shutdownBufferPool(bm));
+		free(bm);
+	}
+	TEST_CHECK(destroyPageFile(TESTPF));
+
+	TEST_DONE();
+}
+
+// a policy of the options replaces the one of the strategy
+void testCustomPolicy(void) {
+	BM_BufferPool *bm = MAKE_POOL();
+	BM_PageHandle *h = MAKE_PAGE_HANDLE();
+	BM_PoolOptions options;
+	int i;
+	testName = "Custom policy";
+
+	createBlocks();
+	initPoolOptions(&options);
+	options.policy = &countingPolicy;
+	numInit = numDestroy = 0;
+	TEST_CHECK(initBufferPoolWithOptions(bm, TESTPF, NUM_FRAMES, RS_FIFO,
+			NULL, &options));
+	ASSERT_EQUALS_INT(1, numInit, "policy set up");
+
+	for (i = 0; i <= NUM_FRAMES; i++) {
+		pinAndCheck(bm, i);
+	}
+	ASSERT_TRUE(!isResident(bm, NUM_FRAMES - 1), "newest page evicted");
+	ASSERT_TRUE(isResident(bm, 0), "oldest page kept");
+	pinAndCheck(bm, 0);
+	ASSERT_EQUALS_INT(NUM_FRAMES + 2, counts->access, "every pin noted");
+	ASSERT_EQUALS_INT(NUM_FRAMES + 1, counts->load, "every load noted");
+	ASSERT_EQUALS_INT(NUM_FRAMES + 2, counts->unpin, "every unpin noted");
+	ASSERT_EQUALS_INT(1, counts->evict, "eviction noted");
+
+	//Unpin rejected for a page that isn't pinned never gets to the policy
+	TEST_CHECK(pinPage(bm, h, 0));
+	TEST_CHECK(unpinPage(bm, h));
+	ASSERT_ERROR(unpinPage(bm, h), "page isn't pinned anymore");
+	ASSERT_EQUALS_INT(NUM_FRAMES + 3, counts->unpin, "only the unpin noted");
+
+	TEST_CHECK(shutdownBufferPool(bm));
+	ASSERT_EQUALS_INT(1, numDestroy, "policy released");
+	TEST_CHECK(destroyPageFile(TESTPF));
+
+	free(h);
+	free(bm);
+	TEST_DONE();
+}
+
+// a policy that can't choose victims is refused
+void testInvalidPolicy(void) {
+	BM_BufferPool *bm = MAKE_POOL();
+	BM_PoolOptions options;
+	BM_Policy policy = countingPolicy;
+	testName = "Invalid policy";
+
+	createBlocks();
+	initPoolOptions(&options);
+	policy.chooseVictim = NULL;
+	options.policy = &policy;
+	numInit = 0;
+	ASSERT_ERROR(initBufferPoolWithOptions(bm, TESTPF, NUM_FRAMES, RS_FIFO,
+			NULL, &options), "policy without chooseVictim");
+	ASSERT_EQUALS_INT(0, numInit, "policy never set up");
+	ASSERT_ERROR(initBufferPool(bm, TESTPF, NUM_FRAMES,
+			(ReplacementStrategy) BM_NUM_STRATEGIES, NULL),
+			"unknown strategy");
+	TEST_CHECK(destroyPageFile(TESTPF));
+
+	free(bm);
+	TEST_DONE();
+}
+
+// create page file of NUM_BLOCKS pages "Page-<page no>"
+void createBlocks(void) {
+	SM_FileHandle fh;
+	SM_PageHandle ph = (SM_PageHandle) malloc(PAGE_SIZE);
+	int i;
+
+	TEST_CHECK(createPageFile(TESTPF));
+	TEST_CHECK(openPageFile(TESTPF, &fh));
+	TEST_CHECK(ensureCapacity(NUM_BLOCKS, &fh));
+	for (i = 0; i < NUM_BLOCKS; i++) {
+		memset(ph, 0, PAGE_SIZE);
+		sprintf(ph, "Page-%i", i);
+		TEST_CHECK(writeBlock(i, &fh, ph));
+	}
+	TEST_CHECK(closePageFile(&fh));
+
+	free(ph);
+}
+
+// pin page pageNum, check its content and unpin it again
+void pinAndCheck(BM_BufferPool *bm, PageNumber pageNum) {
+	BM_PageHandle *h = MAKE_PAGE_HANDLE();
+	char expected[32];
+
+	TEST_CHECK(pinPage(bm, h, pageNum));
+	sprintf(expected, "Page-%i", pageNum);
+	ASSERT_EQUALS_STRING(expected, h->data, "expected page content");
+	TEST_CHECK(unpinPage(bm, h));
+
+	free(h);
+}
+
+// TRUE if a frame of the pool holds page pageNum
+bool isResident(BM_BufferPool *bm, PageNumber pageNum) {
+	PageNumber *frames = getFrameContents(bm);
+	int i;
+
+	for (i = 0; i < bm->numPages; i++) {
+		if (frames[i] == pageNum) {
+			return TRUE;
+		}
+	}
+
+	return FALSE;
+}
+
+// set up counting policy with zero counts as its state
+RC initCounting(struct BM_Data * const data, void ** const state) {
+	counts = (PolicyCounts *) calloc(1, sizeof(PolicyCounts));
+	*state = counts;
+	numInit++;
+	return RC_OK;
+}
+
+// release counting policy
+void destroyCounting(struct BM_Data * const data, void * const state) {
+	free(state);
+	counts = NULL;
+	numDestroy++;
+}
+
+// count a pin
+void accessCounting(struct BM_Data * const data, void * const state,
+		const int frame) {
+	((PolicyCounts *) state)->access++;
+}
+
+// count a load
+void loadCounting(struct BM_Data * const data, void * const state,
+		const int frame) {
+	((PolicyCounts *) state)->load++;
+}
+
+// count an unpin
+void unpinCounting(struct BM_Data * const data, void * const state,
+		const int frame) {
+	((PolicyCounts *) state)->unpin++;
+}
+
+// count an eviction
+void evictCounting(struct BM_Data * const data, void * const state,
+		const int frame) {
+	((PolicyCounts *) state)->evict++;
+}
+
+// unpinned resident frame loaded last, -1 if none
+int chooseNewestVictim(struct BM_Data * const data, void * const state) {
+	int i, victim = -1;
+
+	for (i = 0; i < data->numFrames; i++) {
+		if (data->pageFrameIndexMap[i] != NO_PAGE && data->fixCount[i] == 0
+				&& (victim == -1
+						|| data->pageInTime[i] > data->pageInTime[victim])) {
+			victim = i;
+		}
+	}
+
+	return victim;
+}
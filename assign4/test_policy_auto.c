@@ -0,0 +1,155 @@
+#include "storage_mgr.h"
+#include "buffer_mgr_stat.h"
+#include "buffer_mgr.h"
+#include "dberror.h"
+#include "test_helper.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// var to store the current test's name
+char *testName;
+
+/* page file and pool used by all tests */
+#define TESTPF "test_policy_auto.bin"
+#define NUM_FRAMES 16
+
+/* pins per phase, enough for AUTO to confirm a switch several times over */
+#define PHASE_PINS 16384
+
+/* pages scanned over and over, hot pages pinned between scanned pages and
+ * loop of pages pinned between pages used briefly, the latter two fewer than
+ * the pool holds */
+#define SCAN_PAGES 1024
+#define HOT_PAGES 12
+#define LOOP_PAGES 12
+#define BRIEF_EVERY 4
+
+/* first page of each workload, so they don't share pages */
+#define HOT_BASE SCAN_PAGES
+#define LOOP_BASE (HOT_BASE + HOT_PAGES)
+
+// test and helper methods
+static void testScanKeepsLru(void);
+static void testHotPagesThenLoop(void);
+
+static void scanPages(BM_BufferPool *bm, int numPins);
+static void scanWithHotPages(BM_BufferPool *bm, int numPins);
+static void loopWithBriefPages(BM_BufferPool *bm, int numPins);
+static void pinAndUnpin(BM_BufferPool *bm, PageNumber pageNum);
+static void checkSwitches(BM_BufferPool *bm, int fifo, int lru, int clock,
+		int lfu, char *message);
+
+// main method
+int main(void) {
+	initStorageManager();
+	testName = "";
+
+	testScanKeepsLru();
+	testHotPagesThenLoop();
+
+	return 0;
+}
+
+// a scan hits in none of the candidates, AUTO stays with LRU
+void testScanKeepsLru(void) {
+	BM_BufferPool *bm = MAKE_POOL();
+	testName = "AUTO keeps LRU during a scan";
+
+	TEST_CHECK(createPageFile(TESTPF));
+	TEST_CHECK(initBufferPool(bm, TESTPF, NUM_FRAMES, RS_AUTO, NULL));
+
+	scanPages(bm, PHASE_PINS);
+	checkSwitches(bm, 0, 0, 0, 0, "no switch during scan");
+
+	TEST_CHECK(shutdownBufferPool(bm));
+	TEST_CHECK(destroyPageFile(TESTPF));
+
+	free(bm);
+	TEST_DONE();
+}
+
+// a scan pushes hot pages out of FIFO, LRU and CLOCK but not out of LFU, and
+// AUTO settles on LFU. A loop then leaves LFU with stale counts and CLOCK
+// and FIFO with pages used briefly, and AUTO settles on LRU again.
+void testHotPagesThenLoop(void) {
+	BM_BufferPool *bm = MAKE_POOL();
+	testName = "AUTO switches to LFU for hot pages and back to LRU for a loop";
+
+	TEST_CHECK(createPageFile(TESTPF));
+	TEST_CHECK(initBufferPool(bm, TESTPF, NUM_FRAMES, RS_AUTO, NULL));
+
+	scanWithHotPages(bm, PHASE_PINS);
+	checkSwitches(bm, 0, 0, 0, 1, "switched to LFU for hot pages");
+
+	loopWithBriefPages(bm, PHASE_PINS);
+	checkSwitches(bm, 0, 1, 0, 1, "switched back to LRU for loop");
+
+	TEST_CHECK(shutdownBufferPool(bm));
+	TEST_CHECK(destroyPageFile(TESTPF));
+
+	free(bm);
+	TEST_DONE();
+}
+
+// pin numPins pages of the SCAN_PAGES one after the other
+void scanPages(BM_BufferPool *bm, int numPins) {
+	int i;
+
+	for (i = 0; i < numPins; i++) {
+		pinAndUnpin(bm, i % SCAN_PAGES);
+	}
+}
+
+// pin each of the HOT_PAGES twice in a row, then a scanned page, over and
+// over
+void scanWithHotPages(BM_BufferPool *bm, int numPins) {
+	int i;
+
+	for (i = 0; i < numPins; i++) {
+		if (i % 3 == 2) {
+			pinAndUnpin(bm, (i / 3) % SCAN_PAGES);
+		} else {
+			pinAndUnpin(bm, HOT_BASE + (i / 3) % HOT_PAGES);
+		}
+	}
+}
+
+// pin the LOOP_PAGES over and over, after every BRIEF_EVERY th of them a
+// scanned page twice in a row
+void loopWithBriefPages(BM_BufferPool *bm, int numPins) {
+	int i = 0, loop = 0, brief = 0;
+
+	while (i < numPins) {
+		pinAndUnpin(bm, LOOP_BASE + loop);
+		i++;
+		if (loop % BRIEF_EVERY == 0) {
+			pinAndUnpin(bm, brief);
+			pinAndUnpin(bm, brief);
+			brief = (brief + 1) % SCAN_PAGES;
+			i += 2;
+		}
+		loop = (loop + 1) % LOOP_PAGES;
+	}
+}
+
+// pin page pageNum and unpin it right away
+void pinAndUnpin(BM_BufferPool *bm, PageNumber pageNum) {
+	BM_PageHandle h;
+
+	TEST_CHECK(pinPage(bm, &h, pageNum));
+	TEST_CHECK(unpinPage(bm, &h));
+}
+
+// check the no of switches AUTO made to each candidate so far
+void checkSwitches(BM_BufferPool *bm, int fifo, int lru, int clock, int lfu,
+		char *message) {
+	BM_PoolStats stats;
+
+	TEST_CHECK(getPoolStats(bm, &stats));
+	ASSERT_EQUALS_INT(fifo, (int) stats.autoSwitches[RS_FIFO], message);
+	ASSERT_EQUALS_INT(lru, (int) stats.autoSwitches[RS_LRU], message);
+	ASSERT_EQUALS_INT(clock, (int) stats.autoSwitches[RS_CLOCK], message);
+	ASSERT_EQUALS_INT(lfu, (int) stats.autoSwitches[RS_LFU], message);
+}
@@ -0,0 +1,239 @@
+#include "storage_mgr.h"
+#include "buffer_mgr_stat.h"
+#include "buffer_mgr.h"
+#include "dberror.h"
+#include "test_helper.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// var to store the current test's name
+char *testName;
+
+/* page file and pool sizes used by all tests */
+#define TESTPF "test_pool_stats.bin"
+#define NUM_FRAMES 3
+#define NUM_BLOCKS 10
+
+// test and helper methods
+static void testPinCounters(void);
+static void testEvictionCounters(void);
+static void testNewBlocks(void);
+static void testStatsDump(void);
+
+static void createBlocks(void);
+static void pinAndCheck(BM_BufferPool *bm, PageNumber pageNum);
+static void dirtyPage(BM_BufferPool *bm, PageNumber pageNum);
+static uint64_t sumOf(uint64_t *buckets);
+
+// main method
+int main(void) {
+	initStorageManager();
+	testName = "";
+
+	testPinCounters();
+	testEvictionCounters();
+	testNewBlocks();
+	testStatsDump();
+
+	return 0;
+}
+
+// pins are counted as hits or misses, each miss reads its page once
+void testPinCounters(void) {
+	BM_BufferPool *bm = MAKE_POOL();
+	BM_PoolStats stats;
+	int i;
+	testName = "Pin counters";
+
+	createBlocks();
+	TEST_CHECK(initBufferPool(bm, TESTPF, NUM_FRAMES, RS_FIFO, NULL));
+	for (i = 0; i < NUM_FRAMES; i++) {
+		pinAndCheck(bm, i);
+	}
+	pinAndCheck(bm, 0);
+
+	TEST_CHECK(getPoolStats(bm, &stats));
+	ASSERT_EQUALS_INT(NUM_FRAMES + 1, (int) stats.pinRequests,
+			"every pin is a request");
+	ASSERT_EQUALS_INT(1, (int) stats.hits, "second pin of page 0 hit");
+	ASSERT_EQUALS_INT(NUM_FRAMES, (int) stats.misses, "first pins missed");
+	ASSERT_EQUALS_INT(NUM_FRAMES, (int) stats.reads, "each miss read a page");
+	ASSERT_EQUALS_INT(0, (int) stats.writes, "nothing written");
+	ASSERT_EQUALS_INT((int) stats.reads, (int) sumOf(stats.readLatency),
+			"every read is in the latency histogram");
+	ASSERT_EQUALS_INT((int) stats.reads, getNumReadIO(bm),
+			"getNumReadIO agrees with snapshot");
+	ASSERT_TRUE(getPageHitRatio(bm) == 0.25f, "hit ratio from counters");
+	ASSERT_ERROR(getPoolStats(bm, NULL), "snapshot needs a target");
+
+	TEST_CHECK(shutdownBufferPool(bm));
+	TEST_CHECK(destroyPageFile(TESTPF));
+
+	free(bm);
+	TEST_DONE();
+}
+
+// evictions are counted by reason, dirty victims also as writes
+void testEvictionCounters(void) {
+	BM_BufferPool *bm = MAKE_POOL();
+	BM_PoolStats stats;
+	int i;
+	testName = "Eviction counters";
+
+	createBlocks();
+	TEST_CHECK(initBufferPool(bm, TESTPF, NUM_FRAMES, RS_LRU, NULL));
+	dirtyPage(bm, 0);
+	for (i = 1; i < 2 * NUM_FRAMES; i++) {
+		pinAndCheck(bm, i);
+	}
+
+	TEST_CHECK(getPoolStats(bm, &stats));
+	ASSERT_EQUALS_INT(NUM_FRAMES, (int) stats.evictions[BM_EVICT_REPLACE],
+			"misses on a full pool evicted a page each");
+	ASSERT_EQUALS_INT(NUM_FRAMES, (int) stats.strategyVictims[RS_LRU],
+			"victims counted for LRU");
+	ASSERT_EQUALS_INT(0, (int) stats.strategyVictims[RS_FIFO],
+			"no victims counted for FIFO");
+	ASSERT_EQUALS_INT(1, (int) stats.dirtyEvictions,
+			"only page 0 was dirty");
+	ASSERT_EQUALS_INT(1, (int) stats.writes, "dirty victim was written");
+	ASSERT_EQUALS_INT((int) stats.writes, (int) sumOf(stats.writeLatency),
+			"every write is in the latency histogram");
+
+	//Shrinking retires the frames past the new size
+	TEST_CHECK(resizeBufferPool(bm, 1));
+	TEST_CHECK(getPoolStats(bm, &stats));
+	ASSERT_EQUALS_INT(NUM_FRAMES - 1, (int) stats.evictions[BM_EVICT_RESIZE],
+			"retired frames counted as resize evictions");
+	ASSERT_EQUALS_INT(NUM_FRAMES, (int) stats.evictions[BM_EVICT_REPLACE],
+			"replace evictions unchanged");
+
+	TEST_CHECK(shutdownBufferPool(bm));
+	TEST_CHECK(destroyPageFile(TESTPF));
+
+	free(bm);
+	TEST_DONE();
+}
+
+// a page past the end of the file appends blocks when written
+void testNewBlocks(void) {
+	BM_BufferPool *bm = MAKE_POOL();
+	BM_PageHandle *h = MAKE_PAGE_HANDLE();
+	BM_PoolStats stats;
+	testName = "New block counter";
+
+	createBlocks();
+	TEST_CHECK(initBufferPool(bm, TESTPF, NUM_FRAMES, RS_FIFO, NULL));
+	TEST_CHECK(pinPage(bm, h, NUM_BLOCKS));
+	sprintf(h->data, "Dirty-%i", NUM_BLOCKS);
+	TEST_CHECK(markDirty(bm, h));
+	TEST_CHECK(forcePage(bm, h));
+	TEST_CHECK(unpinPage(bm, h));
+
+	TEST_CHECK(getPoolStats(bm, &stats));
+	ASSERT_EQUALS_INT(1, (int) stats.newBlocks, "one block appended");
+	ASSERT_EQUALS_INT(getNumWriteIO(bm), (int) stats.writes,
+			"getNumWriteIO agrees with snapshot");
+
+	TEST_CHECK(shutdownBufferPool(bm));
+	TEST_CHECK(destroyPageFile(TESTPF));
+
+	free(h);
+	free(bm);
+	TEST_DONE();
+}
+
+// text and JSON dumps show the counters of the snapshot
+void testStatsDump(void) {
+	BM_BufferPool *bm = MAKE_POOL();
+	char *dump;
+	testName = "Statistics dumps";
+
+	createBlocks();
+	TEST_CHECK(initBufferPool(bm, TESTPF, NUM_FRAMES, RS_FIFO, NULL));
+	pinAndCheck(bm, 0);
+	pinAndCheck(bm, 0);
+
+	dump = sprintPoolStats(bm, BM_STATS_JSON);
+	ASSERT_TRUE(dump != NULL, "JSON dump made");
+	ASSERT_TRUE(dump[0] == '{', "JSON dump is an object");
+	ASSERT_TRUE(strstr(dump, "\"pinRequests\":2,\"hits\":1,\"misses\":1")
+			!= NULL, "JSON dump holds pin counters");
+	ASSERT_TRUE(strstr(dump, "\"evictions\":{\"replace\":0") != NULL,
+			"JSON dump holds evictions by reason");
+	ASSERT_TRUE(strstr(dump, "\"strategyVictims\":{\"FIFO\":0") != NULL,
+			"JSON dump holds victims by strategy");
+	free(dump);
+
+	dump = sprintPoolStats(bm, BM_STATS_TEXT);
+	ASSERT_TRUE(dump != NULL, "text dump made");
+	ASSERT_TRUE(strstr(dump, "## Pin Requests: 2 (hits 1, misses 1") != NULL,
+			"text dump holds pin counters");
+	ASSERT_TRUE(strstr(dump, "## Reads: 1 (") != NULL,
+			"text dump holds reads");
+	free(dump);
+
+	TEST_CHECK(shutdownBufferPool(bm));
+	TEST_CHECK(destroyPageFile(TESTPF));
+
+	free(bm);
+	TEST_DONE();
+}
+
+// create page file of NUM_BLOCKS pages "Page-<page no>"
+void createBlocks(void) {
+	SM_FileHandle fh;
+	SM_PageHandle ph = (SM_PageHandle) malloc(PAGE_SIZE);
+	int i;
+
+	TEST_CHECK(createPageFile(TESTPF));
+	TEST_CHECK(openPageFile(TESTPF, &fh));
+	TEST_CHECK(ensureCapacity(NUM_BLOCKS, &fh));
+	for (i = 0; i < NUM_BLOCKS; i++) {
+		memset(ph, 0, PAGE_SIZE);
+		sprintf(ph, "Page-%i", i);
+		TEST_CHECK(writeBlock(i, &fh, ph));
+	}
+	TEST_CHECK(closePageFile(&fh));
+
+	free(ph);
+}
+
+// pin page pageNum, check its content and unpin it again
+void pinAndCheck(BM_BufferPool *bm, PageNumber pageNum) {
+	BM_PageHandle *h = MAKE_PAGE_HANDLE();
+	char expected[32];
+
+	TEST_CHECK(pinPage(bm, h, pageNum));
+	sprintf(expected, "Page-%i", pageNum);
+	ASSERT_EQUALS_STRING(expected, h->data, "expected page content");
+	TEST_CHECK(unpinPage(bm, h));
+
+	free(h);
+}
+
+// pin page pageNum, overwrite it with "Dirty-<page no>" and unpin it
+void dirtyPage(BM_BufferPool *bm, PageNumber pageNum) {
+	BM_PageHandle *h = MAKE_PAGE_HANDLE();
+
+	TEST_CHECK(pinPage(bm, h, pageNum));
+	sprintf(h->data, "Dirty-%i", pageNum);
+	TEST_CHECK(markDirty(bm, h));
+	TEST_CHECK(unpinPage(bm, h));
+
+	free(h);
+}
+
+// total count of a latency histogram
+uint64_t sumOf(uint64_t *buckets) {
+	uint64_t sum = 0;
+	int i;
+
+	for (i = 0; i < BM_LATENCY_BUCKETS; i++) {
+		sum += buckets[i];
+	}
+
+	return sum;
+}
@@ -0,0 +1,262 @@
+#include "storage_mgr.h"
+#include "buffer_mgr_stat.h"
+#include "buffer_mgr.h"
+#include "dberror.h"
+#include "test_helper.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// var to store the current test's name
+char *testName;
+
+/* page file and pool used by all tests */
+#define TESTPF "test_prefetch.bin"
+#define NUM_FRAMES 16
+#define NUM_BLOCKS 320
+
+/* first page of the second of two interleaved scans */
+#define SECOND_SCAN (NUM_BLOCKS / 2)
+
+/* ms the prefetcher is given to load what was queued */
+#define PREFETCH_TIMEOUT_MS 5000
+
+// test and helper methods
+static void testSequentialScan(void);
+static void testStridedScan(void);
+static void testWastedPrefetch(void);
+static void testInterleavedScans(void);
+static void testPrefetchDisabled(void);
+
+static void createBlocks(void);
+static void initPrefetchPool(BM_BufferPool *bm, bool prefetch);
+static void pinAndCheck(BM_BufferPool *bm, PageNumber pageNum);
+static void waitForPrefetch(BM_BufferPool *bm, long numPages);
+static int frameOf(BM_BufferPool *bm, PageNumber pageNum);
+
+// main method
+int main(void) {
+	initStorageManager();
+	testName = "";
+
+	testSequentialScan();
+	testStridedScan();
+	testWastedPrefetch();
+	testInterleavedScans();
+	testPrefetchDisabled();
+
+	return 0;
+}
+
+// a sequential scan finds most of its pages read ahead, and the window grows
+void testSequentialScan(void) {
+	BM_BufferPool *bm = MAKE_POOL();
+	int i;
+	testName = "Sequential scan is prefetched";
+
+	createBlocks();
+	initPrefetchPool(bm, TRUE);
+
+	for (i = 0; i < NUM_BLOCKS; i++) {
+		pinAndCheck(bm, i);
+		//Let the worker keep up, so the test doesn't depend on its speed.
+		//Nothing is left to read ahead of the last page.
+		if (i + 1 < NUM_BLOCKS) {
+			waitForPrefetch(bm, i - 1);
+		}
+	}
+	ASSERT_TRUE(getPrefetchCount(bm) > 0, "pages were prefetched");
+	ASSERT_TRUE(getPrefetchHitCount(bm) > NUM_BLOCKS / 2,
+			"most pages were prefetched before their pin");
+	ASSERT_EQUALS_INT(0, (int) getPrefetchWasteCount(bm),
+			"no prefetch was wasted");
+	ASSERT_TRUE(((BM_Data *) bm->mgmtData)->prefetchWindow
+			> BM_PREFETCH_MIN_WINDOW, "window grew");
+	ASSERT_TRUE(getPrefetchHitRatio(bm) > 0.5, "hit ratio reported");
+
+	TEST_CHECK(shutdownBufferPool(bm));
+	TEST_CHECK(destroyPageFile(TESTPF));
+
+	free(bm);
+	TEST_DONE();
+}
+
+// pins every third page from the end backwards still form a stream
+void testStridedScan(void) {
+	BM_BufferPool *bm = MAKE_POOL();
+	PageNumber pageNum = NUM_BLOCKS - 1;
+	testName = "Strided backward scan is prefetched";
+
+	createBlocks();
+	initPrefetchPool(bm, TRUE);
+
+	pinAndCheck(bm, pageNum);
+	pinAndCheck(bm, pageNum - 3);
+	pinAndCheck(bm, pageNum - 6);
+	waitForPrefetch(bm, BM_PREFETCH_MIN_WINDOW);
+	ASSERT_TRUE(frameOf(bm, pageNum - 9) != -1, "next page read ahead");
+	ASSERT_TRUE(frameOf(bm, pageNum - 12) != -1, "page after read ahead");
+	ASSERT_EQUALS_INT(-1, frameOf(bm, pageNum - 7),
+			"pages off the stride are not read");
+
+	TEST_CHECK(shutdownBufferPool(bm));
+	TEST_CHECK(destroyPageFile(TESTPF));
+
+	free(bm);
+	TEST_DONE();
+}
+
+// prefetched pages evicted before their pin count as waste
+void testWastedPrefetch(void) {
+	BM_BufferPool *bm = MAKE_POOL();
+	int i;
+	testName = "Unused prefetched pages are wasted";
+
+	createBlocks();
+	initPrefetchPool(bm, TRUE);
+
+	pinAndCheck(bm, 0);
+	pinAndCheck(bm, 1);
+	pinAndCheck(bm, 2);
+	waitForPrefetch(bm, BM_PREFETCH_MIN_WINDOW);
+	ASSERT_TRUE(frameOf(bm, 3) != -1, "page 3 read ahead");
+
+	//Pins from far away, too wide apart to be taken for a stream
+	for (i = 0; i < NUM_FRAMES; i++) {
+		pinAndCheck(bm, 30 + i * (BM_PREFETCH_MAX_STRIDE + 1));
+	}
+	ASSERT_EQUALS_INT(-1, frameOf(bm, 3), "page 3 evicted");
+	ASSERT_TRUE(getPrefetchWasteCount(bm) >= BM_PREFETCH_MIN_WINDOW,
+			"evicted prefetches counted as waste");
+	ASSERT_EQUALS_INT(0, (int) getPrefetchHitCount(bm), "no prefetch was used");
+
+	TEST_CHECK(shutdownBufferPool(bm));
+	TEST_CHECK(destroyPageFile(TESTPF));
+
+	free(bm);
+	TEST_DONE();
+}
+
+// two scans taking turns are both followed
+void testInterleavedScans(void) {
+	BM_BufferPool *bm = MAKE_POOL();
+	int i;
+	testName = "Interleaved scans are both prefetched";
+
+	createBlocks();
+	initPrefetchPool(bm, TRUE);
+
+	for (i = 0; i < 3; i++) {
+		pinAndCheck(bm, i);
+		pinAndCheck(bm, SECOND_SCAN + i);
+	}
+	waitForPrefetch(bm, 2 * BM_PREFETCH_MIN_WINDOW);
+	ASSERT_TRUE(frameOf(bm, 3) != -1, "first scan read ahead");
+	ASSERT_TRUE(frameOf(bm, SECOND_SCAN + 3) != -1, "second scan read ahead");
+
+	for (i = 3; i < SECOND_SCAN / 2; i++) {
+		pinAndCheck(bm, i);
+		pinAndCheck(bm, SECOND_SCAN + i);
+		waitForPrefetch(bm, 2 * (i - 2));
+	}
+	ASSERT_TRUE(getPrefetchHitCount(bm) > SECOND_SCAN / 2,
+			"most pages of both scans were prefetched");
+
+	TEST_CHECK(shutdownBufferPool(bm));
+	TEST_CHECK(destroyPageFile(TESTPF));
+
+	free(bm);
+	TEST_DONE();
+}
+
+// without the option nothing is read ahead
+void testPrefetchDisabled(void) {
+	BM_BufferPool *bm = MAKE_POOL();
+	int i;
+	testName = "Prefetch disabled";
+
+	createBlocks();
+	initPrefetchPool(bm, FALSE);
+
+	for (i = 0; i < NUM_FRAMES; i++) {
+		pinAndCheck(bm, i);
+	}
+	usleep(100 * 1000);
+	ASSERT_EQUALS_INT(NUM_FRAMES, getNumReadIO(bm), "only pinned pages read");
+	ASSERT_EQUALS_INT(0, (int) getPrefetchCount(bm), "nothing prefetched");
+	ASSERT_EQUALS_INT(0, (int) getPrefetchHitCount(bm), "no prefetch hits");
+
+	TEST_CHECK(shutdownBufferPool(bm));
+	TEST_CHECK(destroyPageFile(TESTPF));
+
+	free(bm);
+	TEST_DONE();
+}
+
+// create page file of NUM_BLOCKS pages "Page-<page no>"
+void createBlocks(void) {
+	SM_FileHandle fh;
+	SM_PageHandle ph = (SM_PageHandle) malloc(PAGE_SIZE);
+	int i;
+
+	TEST_CHECK(createPageFile(TESTPF));
+	TEST_CHECK(openPageFile(TESTPF, &fh));
+	TEST_CHECK(ensureCapacity(NUM_BLOCKS, &fh));
+	for (i = 0; i < NUM_BLOCKS; i++) {
+		memset(ph, 0, PAGE_SIZE);
+		sprintf(ph, "Page-%i", i);
+		TEST_CHECK(writeBlock(i, &fh, ph));
+	}
+	TEST_CHECK(closePageFile(&fh));
+
+	free(ph);
+}
+
+// open an LRU pool on TESTPF with the prefetcher on or off
+void initPrefetchPool(BM_BufferPool *bm, bool prefetch) {
+	BM_PoolOptions options;
+
+	initPoolOptions(&options);
+	options.prefetch = prefetch;
+	TEST_CHECK(initBufferPoolWithOptions(bm, TESTPF, NUM_FRAMES, RS_LRU, NULL,
+			&options));
+}
+
+// pin page pageNum, check its content and unpin it again
+void pinAndCheck(BM_BufferPool *bm, PageNumber pageNum) {
+	BM_PageHandle *h = MAKE_PAGE_HANDLE();
+	char expected[32];
+
+	TEST_CHECK(pinPage(bm, h, pageNum));
+	sprintf(expected, "Page-%i", pageNum);
+	ASSERT_EQUALS_STRING(expected, h->data, "expected page content");
+	TEST_CHECK(unpinPage(bm, h));
+
+	free(h);
+}
+
+// wait until at least numPages pages have been prefetched
+void waitForPrefetch(BM_BufferPool *bm, long numPages) {
+	int waited;
+
+	for (waited = 0; getPrefetchCount(bm) < numPages
+			&& waited < PREFETCH_TIMEOUT_MS; waited++) {
+		usleep(1000);
+	}
+}
+
+// index of the frame holding page pageNum, -1 if none does
+int frameOf(BM_BufferPool *bm, PageNumber pageNum) {
+	PageNumber *frames = getFrameContents(bm);
+	int i;
+
+	for (i = 0; i < bm->numPages; i++) {
+		if (frames[i] == pageNum) {
+			return i;
+		}
+	}
+
+	return -1;
+}
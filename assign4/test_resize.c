@@ -0,0 +1,317 @@
+#include "storage_mgr.h"
+#include "buffer_mgr_stat.h"
+#include "buffer_mgr.h"
+#include "dberror.h"
+#include "test_helper.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// var to store the current test's name
+char *testName;
+
+/* page file and pool sizes used by all tests */
+#define TESTPF "test_resize.bin"
+#define NUM_FRAMES 4
+#define NUM_BLOCKS 40
+
+// test and helper methods
+static void testGrow(void);
+static void testShrinkWritesBack(void);
+static void testShrinkPinnedFrame(void);
+static void testGrowthLimits(void);
+static void testHugePagePoolHeadroom(void);
+static void testResizeSharedPool(void);
+
+static void createBlocks(void);
+static void pinAndCheck(BM_BufferPool *bm, PageNumber pageNum);
+static void dirtyPage(BM_BufferPool *bm, PageNumber pageNum);
+static int frameOf(BM_BufferPool *bm, PageNumber pageNum);
+static void checkFile(PageNumber pageNum, char *prefix);
+
+// main method
+int main(void) {
+	initStorageManager();
+	testName = "";
+
+	testGrow();
+	testShrinkWritesBack();
+	testShrinkPinnedFrame();
+	testGrowthLimits();
+	testHugePagePoolHeadroom();
+	testResizeSharedPool();
+
+	return 0;
+}
+
+// a grown pool holds more pages without evicting any
+void testGrow(void) {
+	BM_BufferPool *bm = MAKE_POOL();
+	int i;
+	testName = "Growing a pool";
+
+	createBlocks();
+	TEST_CHECK(initBufferPool(bm, TESTPF, NUM_FRAMES, RS_LRU, NULL));
+	for (i = 0; i < NUM_FRAMES; i++) {
+		pinAndCheck(bm, i);
+	}
+
+	TEST_CHECK(resizeBufferPool(bm, 2 * NUM_FRAMES));
+	ASSERT_EQUALS_INT(2 * NUM_FRAMES, bm->numPages, "pool reports new size");
+	for (i = 0; i < 2 * NUM_FRAMES; i++) {
+		pinAndCheck(bm, i);
+	}
+	ASSERT_EQUALS_INT(2 * NUM_FRAMES, getNumReadIO(bm),
+			"old pages stayed, new pages got new frames");
+	for (i = 0; i < 2 * NUM_FRAMES; i++) {
+		ASSERT_TRUE(frameOf(bm, i) != -1, "page is resident");
+	}
+
+	TEST_CHECK(shutdownBufferPool(bm));
+	TEST_CHECK(destroyPageFile(TESTPF));
+
+	free(bm);
+	TEST_DONE();
+}
+
+// shrinking evicts the pages of retired frames, dirty ones written back
+void testShrinkWritesBack(void) {
+	BM_BufferPool *bm = MAKE_POOL();
+	PageNumber *frames;
+	int i, resident = 0;
+	testName = "Shrinking a pool writes back retired frames";
+
+	createBlocks();
+	TEST_CHECK(initBufferPool(bm, TESTPF, 2 * NUM_FRAMES, RS_LRU, NULL));
+	for (i = 0; i < 2 * NUM_FRAMES; i++) {
+		dirtyPage(bm, i);
+	}
+
+	TEST_CHECK(resizeBufferPool(bm, NUM_FRAMES));
+	ASSERT_EQUALS_INT(NUM_FRAMES, bm->numPages, "pool reports new size");
+	ASSERT_EQUALS_INT(NUM_FRAMES, getNumWriteIO(bm),
+			"pages of retired frames written back");
+	frames = getFrameContents(bm);
+	for (i = 0; i < 2 * NUM_FRAMES; i++) {
+		resident += frames[i] != NO_PAGE;
+	}
+	ASSERT_EQUALS_INT(NUM_FRAMES, resident, "retired frames are empty");
+	for (i = NUM_FRAMES; i < 2 * NUM_FRAMES; i++) {
+		checkFile(i, "Dirty");
+	}
+
+	//Misses now recycle the remaining frames only
+	for (i = 2 * NUM_FRAMES; i < 3 * NUM_FRAMES; i++) {
+		pinAndCheck(bm, i);
+		ASSERT_TRUE(frameOf(bm, i) < NUM_FRAMES, "page got an active frame");
+	}
+
+	TEST_CHECK(shutdownBufferPool(bm));
+	for (i = 0; i < NUM_FRAMES; i++) {
+		checkFile(i, "Dirty");
+	}
+	TEST_CHECK(destroyPageFile(TESTPF));
+
+	free(bm);
+	TEST_DONE();
+}
+
+// a retired frame still pinned keeps its page until it's unpinned
+void testShrinkPinnedFrame(void) {
+	BM_BufferPool *bm = MAKE_POOL();
+	BM_PageHandle *h = MAKE_PAGE_HANDLE();
+	PageNumber last = 2 * NUM_FRAMES - 1;
+	int i;
+	testName = "Shrinking a pool with a pinned retired frame";
+
+	createBlocks();
+	TEST_CHECK(initBufferPool(bm, TESTPF, 2 * NUM_FRAMES, RS_LRU, NULL));
+	for (i = 0; i < last; i++) {
+		pinAndCheck(bm, i);
+	}
+	TEST_CHECK(pinPage(bm, h, last));
+	ASSERT_EQUALS_INT(last, frameOf(bm, last), "page sits in the last frame");
+
+	TEST_CHECK(resizeBufferPool(bm, NUM_FRAMES));
+	ASSERT_EQUALS_INT(last, frameOf(bm, last), "pinned page stays");
+	sprintf(h->data, "Dirty-%i", last);
+	TEST_CHECK(markDirty(bm, h));
+	TEST_CHECK(unpinPage(bm, h));
+
+	//Next miss evicts what's left in retired frames
+	pinAndCheck(bm, 3 * NUM_FRAMES);
+	ASSERT_EQUALS_INT(-1, frameOf(bm, last), "retired frame emptied");
+	checkFile(last, "Dirty");
+
+	TEST_CHECK(shutdownBufferPool(bm));
+	TEST_CHECK(destroyPageFile(TESTPF));
+
+	free(bm);
+	free(h);
+	TEST_DONE();
+}
+
+// pools grow up to maxPages, or BM_DEFAULT_GROWTH times without it
+void testGrowthLimits(void) {
+	BM_BufferPool *bm = MAKE_POOL();
+	BM_PoolOptions options;
+	testName = "Limits of resizing";
+
+	createBlocks();
+	TEST_CHECK(initBufferPool(bm, TESTPF, NUM_FRAMES, RS_LRU, NULL));
+	ASSERT_EQUALS_INT(RC_INVALID_PAGE_NUM, resizeBufferPool(bm, 0),
+			"pool can't shrink to nothing");
+	ASSERT_EQUALS_INT(RC_INVALID_PAGE_NUM,
+			resizeBufferPool(bm, BM_DEFAULT_GROWTH * NUM_FRAMES + 1),
+			"default pool can't grow past its headroom");
+	TEST_CHECK(resizeBufferPool(bm, BM_DEFAULT_GROWTH * NUM_FRAMES));
+	TEST_CHECK(resizeBufferPool(bm, 1));
+	pinAndCheck(bm, 0);
+	pinAndCheck(bm, 1);
+	ASSERT_EQUALS_INT(-1, frameOf(bm, 0), "one frame left");
+	TEST_CHECK(shutdownBufferPool(bm));
+
+	initPoolOptions(&options);
+	options.maxPages = NUM_FRAMES + 1;
+	TEST_CHECK(initBufferPoolWithOptions(bm, TESTPF, NUM_FRAMES, RS_LRU, NULL,
+			&options));
+	ASSERT_EQUALS_INT(RC_INVALID_PAGE_NUM,
+			resizeBufferPool(bm, NUM_FRAMES + 2), "maxPages is the limit");
+	TEST_CHECK(resizeBufferPool(bm, NUM_FRAMES + 1));
+	TEST_CHECK(shutdownBufferPool(bm));
+	TEST_CHECK(destroyPageFile(TESTPF));
+
+	free(bm);
+	TEST_DONE();
+}
+
+// huge page pools reserve no growth room unless maxPages asks for it, so
+// they get huge pages as often as before resizing existed
+void testHugePagePoolHeadroom(void) {
+	BM_BufferPool *bm = MAKE_POOL();
+	BM_PoolOptions options;
+	testName = "Huge page pools reserve no default headroom";
+
+	createBlocks();
+	initPoolOptions(&options);
+	options.useHugePages = TRUE;
+	TEST_CHECK(initBufferPoolWithOptions(bm, TESTPF, NUM_FRAMES, RS_LRU, NULL,
+			&options));
+	ASSERT_EQUALS_INT(NUM_FRAMES, ((BM_Data *) bm->mgmtData)->maxFrames,
+			"frames reserved for numPages only");
+	ASSERT_EQUALS_INT(RC_INVALID_PAGE_NUM, resizeBufferPool(bm, NUM_FRAMES + 1),
+			"no room to grow");
+	TEST_CHECK(resizeBufferPool(bm, NUM_FRAMES - 1));
+	TEST_CHECK(shutdownBufferPool(bm));
+
+	options.maxPages = 2 * NUM_FRAMES;
+	TEST_CHECK(initBufferPoolWithOptions(bm, TESTPF, NUM_FRAMES, RS_LRU, NULL,
+			&options));
+	TEST_CHECK(resizeBufferPool(bm, 2 * NUM_FRAMES));
+	pinAndCheck(bm, 2 * NUM_FRAMES - 1);
+	TEST_CHECK(shutdownBufferPool(bm));
+	TEST_CHECK(destroyPageFile(TESTPF));
+
+	free(bm);
+	TEST_DONE();
+}
+
+// resizing a view resizes the shared pool, later views see the new size
+void testResizeSharedPool(void) {
+	BM_BufferPool *a = MAKE_POOL();
+	BM_BufferPool *b = MAKE_POOL();
+	testName = "Resizing the shared pool through a view";
+
+	createBlocks();
+	TEST_CHECK(initSharedBufferPool(NUM_FRAMES, RS_LRU, NULL, NULL));
+	TEST_CHECK(initBufferPool(a, TESTPF, 3, RS_FIFO, NULL));
+	TEST_CHECK(resizeBufferPool(a, 2 * NUM_FRAMES));
+	ASSERT_EQUALS_INT(2 * NUM_FRAMES, a->numPages, "view reports new size");
+
+	TEST_CHECK(initBufferPool(b, TESTPF, 3, RS_FIFO, NULL));
+	ASSERT_EQUALS_INT(2 * NUM_FRAMES, b->numPages, "new view gets new size");
+	pinAndCheck(b, 2 * NUM_FRAMES - 1);
+
+	TEST_CHECK(shutdownBufferPool(a));
+	TEST_CHECK(shutdownBufferPool(b));
+	TEST_CHECK(shutdownSharedBufferPool());
+	TEST_CHECK(destroyPageFile(TESTPF));
+
+	free(a);
+	free(b);
+	TEST_DONE();
+}
+
+// create page file of NUM_BLOCKS pages "Page-<page no>"
+void createBlocks(void) {
+	SM_FileHandle fh;
+	SM_PageHandle ph = (SM_PageHandle) malloc(PAGE_SIZE);
+	int i;
+
+	TEST_CHECK(createPageFile(TESTPF));
+	TEST_CHECK(openPageFile(TESTPF, &fh));
+	TEST_CHECK(ensureCapacity(NUM_BLOCKS, &fh));
+	for (i = 0; i < NUM_BLOCKS; i++) {
+		memset(ph, 0, PAGE_SIZE);
+		sprintf(ph, "Page-%i", i);
+		TEST_CHECK(writeBlock(i, &fh, ph));
+	}
+	TEST_CHECK(closePageFile(&fh));
+
+	free(ph);
+}
+
+// pin page pageNum, check its content and unpin it again
+void pinAndCheck(BM_BufferPool *bm, PageNumber pageNum) {
+	BM_PageHandle *h = MAKE_PAGE_HANDLE();
+	char expected[32];
+
+	TEST_CHECK(pinPage(bm, h, pageNum));
+	sprintf(expected, "Page-%i", pageNum);
+	ASSERT_EQUALS_STRING(expected, h->data, "expected page content");
+	TEST_CHECK(unpinPage(bm, h));
+
+	free(h);
+}
+
+// pin page pageNum, overwrite it with "Dirty-<page no>" and unpin it
+void dirtyPage(BM_BufferPool *bm, PageNumber pageNum) {
+	BM_PageHandle *h = MAKE_PAGE_HANDLE();
+
+	TEST_CHECK(pinPage(bm, h, pageNum));
+	sprintf(h->data, "Dirty-%i", pageNum);
+	TEST_CHECK(markDirty(bm, h));
+	TEST_CHECK(unpinPage(bm, h));
+
+	free(h);
+}
+
+// index of the frame holding page pageNum, -1 if none does
+int frameOf(BM_BufferPool *bm, PageNumber pageNum) {
+	PageNumber *frames = getFrameContents(bm);
+	int i;
+
+	for (i = 0; i < ((BM_Data *) bm->mgmtData)->numFramesUsed; i++) {
+		if (frames[i] == pageNum) {
+			return i;
+		}
+	}
+
+	return -1;
+}
+
+// check that page pageNum of TESTPF holds "<prefix>-<page no>"
+void checkFile(PageNumber pageNum, char *prefix) {
+	SM_FileHandle fh;
+	SM_PageHandle ph = (SM_PageHandle) malloc(PAGE_SIZE);
+	char expected[32];
+
+	TEST_CHECK(openPageFile(TESTPF, &fh));
+	TEST_CHECK(readBlock(pageNum, &fh, ph));
+	sprintf(expected, "%s-%i", prefix, pageNum);
+	ASSERT_EQUALS_STRING(expected, ph, "page file holds expected content");
+	TEST_CHECK(closePageFile(&fh));
+
+	free(ph);
+}
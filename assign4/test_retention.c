@@ -0,0 +1,298 @@
+#include "storage_mgr.h"
+#include "buffer_mgr_stat.h"
+#include "buffer_mgr.h"
+#include "record_mgr.h"
+#include "tables.h"
+#include "dberror.h"
+#include "test_helper.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// var to store the current test's name
+char *testName;
+
+/* page file and pool sizes used by all tests */
+#define TESTPF "test_retention.bin"
+#define NUM_FRAMES 3
+#define NUM_BLOCKS 10
+
+/* table used by the record manager test and rows filling several pages */
+#define TESTTBL "test_retention_table"
+#define NUM_ROWS 5000
+
+// strategies whose policies pass over sticky frames
+static const ReplacementStrategy strategies[] = { RS_FIFO, RS_LRU, RS_LFU,
+		RS_CLOCK, RS_LRU_K, RS_AUTO };
+
+// test and helper methods
+static void testStickyPage(void);
+static void testOnlyStickyLeft(void);
+static void testEvictFirst(void);
+static void testNormalPinKeepsPage(void);
+static void testInvalidHint(void);
+static void testTableInfoPage(void);
+
+static void createBlocks(void);
+static void pinAndCheck(BM_BufferPool *bm, PageNumber pageNum);
+static void pinHinted(BM_BufferPool *bm, PageNumber pageNum,
+		BM_RetentionHint hint);
+static bool isResident(BM_BufferPool *bm, PageNumber pageNum);
+static Schema *valueSchema(void);
+
+// main method
+int main(void) {
+	initStorageManager();
+	testName = "";
+
+	testStickyPage();
+	testOnlyStickyLeft();
+	testEvictFirst();
+	testNormalPinKeepsPage();
+	testInvalidHint();
+	testTableInfoPage();
+
+	return 0;
+}
+
+// a sticky page outlives pages pinned after it with every built-in policy
+void testStickyPage(void) {
+	int s, i;
+	testName = "Sticky page stays";
+
+	createBlocks();
+	for (s = 0; s < sizeof(strategies) / sizeof(strategies[0]); s++) {
+		BM_BufferPool *bm = MAKE_POOL();
+
+		TEST_CHECK(initBufferPool(bm, TESTPF, NUM_FRAMES, strategies[s],
+				NULL));
+		pinHinted(bm, 0, BM_RETAIN_STICKY);
+		for (i = 1; i < NUM_BLOCKS; i++) {
+			pinAndCheck(bm, i);
+		}
+		ASSERT_TRUE(isResident(bm, 0), "sticky page kept");
+		ASSERT_TRUE(isResident(bm, NUM_BLOCKS - 1), "page pinned last loaded");
+		TEST_CHECK(shutdownBufferPool(bm));
+		free(bm);
+	}
+	TEST_CHECK(destroyPageFile(TESTPF));
+
+	TEST_DONE();
+}
+
+// sticky pages are still evicted once nothing else is left
+void testOnlyStickyLeft(void) {
+	int s, i;
+	testName = "Only sticky pages left";
+
+	createBlocks();
+	for (s = 0; s < sizeof(strategies) / sizeof(strategies[0]); s++) {
+		BM_BufferPool *bm = MAKE_POOL();
+
+		TEST_CHECK(initBufferPool(bm, TESTPF, NUM_FRAMES, strategies[s],
+				NULL));
+		for (i = 0; i < NUM_FRAMES; i++) {
+			pinHinted(bm, i, BM_RETAIN_STICKY);
+		}
+		pinAndCheck(bm, NUM_FRAMES);
+		ASSERT_TRUE(isResident(bm, NUM_FRAMES), "page loaded over sticky one");
+		TEST_CHECK(shutdownBufferPool(bm));
+		free(bm);
+	}
+	TEST_CHECK(destroyPageFile(TESTPF));
+
+	TEST_DONE();
+}
+
+// an evict-first page goes before the policy's own victim
+void testEvictFirst(void) {
+	BM_BufferPool *bm = MAKE_POOL();
+	testName = "Evict-first page goes first";
+
+	createBlocks();
+	TEST_CHECK(initBufferPool(bm, TESTPF, NUM_FRAMES, RS_LRU, NULL));
+	pinAndCheck(bm, 0);
+	pinAndCheck(bm, 1);
+	pinHinted(bm, 2, BM_RETAIN_EVICT_FIRST);
+	ASSERT_EQUALS_INT(1, ((BM_Data *) bm->mgmtData)->numEvictFirst,
+			"evict-first page counted");
+
+	pinAndCheck(bm, 3);
+	ASSERT_TRUE(!isResident(bm, 2), "evict-first page evicted");
+	ASSERT_TRUE(isResident(bm, 0), "least recently used page kept");
+	ASSERT_EQUALS_INT(0, ((BM_Data *) bm->mgmtData)->numEvictFirst,
+			"evicted page no longer counted");
+
+	//Without evict-first pages LRU picks again
+	pinAndCheck(bm, 4);
+	ASSERT_TRUE(!isResident(bm, 0), "least recently used page evicted");
+
+	TEST_CHECK(shutdownBufferPool(bm));
+	TEST_CHECK(destroyPageFile(TESTPF));
+
+	free(bm);
+	TEST_DONE();
+}
+
+// evict-first applies only to the pin loading the page, a normal pin ends it
+void testNormalPinKeepsPage(void) {
+	BM_BufferPool *bm = MAKE_POOL();
+	testName = "Normal pin ends evict-first";
+
+	createBlocks();
+	TEST_CHECK(initBufferPool(bm, TESTPF, NUM_FRAMES, RS_LRU, NULL));
+	pinAndCheck(bm, 0);
+	pinAndCheck(bm, 1);
+	pinHinted(bm, 2, BM_RETAIN_EVICT_FIRST);
+	pinAndCheck(bm, 2);
+	ASSERT_EQUALS_INT(0, ((BM_Data *) bm->mgmtData)->numEvictFirst,
+			"page back to normal");
+
+	//Resident page keeps its class on an evict-first pin
+	pinHinted(bm, 0, BM_RETAIN_EVICT_FIRST);
+	ASSERT_EQUALS_INT(0, ((BM_Data *) bm->mgmtData)->numEvictFirst,
+			"hint of a hit ignored");
+
+	pinAndCheck(bm, 3);
+	ASSERT_TRUE(!isResident(bm, 1), "least recently used page evicted");
+	ASSERT_TRUE(isResident(bm, 2), "page used again kept");
+
+	TEST_CHECK(shutdownBufferPool(bm));
+	TEST_CHECK(destroyPageFile(TESTPF));
+
+	free(bm);
+	TEST_DONE();
+}
+
+// unknown retention classes are refused
+void testInvalidHint(void) {
+	BM_BufferPool *bm = MAKE_POOL();
+	BM_PageHandle *h = MAKE_PAGE_HANDLE();
+	testName = "Invalid retention hint";
+
+	createBlocks();
+	TEST_CHECK(initBufferPool(bm, TESTPF, NUM_FRAMES, RS_FIFO, NULL));
+	ASSERT_ERROR(pinPageHint(bm, h, 0, (BM_RetentionHint) 3),
+			"unknown retention class");
+	ASSERT_EQUALS_INT(0, getFixCounts(bm)[0], "nothing pinned");
+	TEST_CHECK(shutdownBufferPool(bm));
+	TEST_CHECK(destroyPageFile(TESTPF));
+
+	free(h);
+	free(bm);
+	TEST_DONE();
+}
+
+// table info page stays in the pool of the table while rows fill pages
+void testTableInfoPage(void) {
+	RM_TableData *table = (RM_TableData *) malloc(sizeof(RM_TableData));
+	Schema *schema = valueSchema();
+	BM_BufferPool *bm;
+	PageNumber *frames;
+	Record *r;
+	Value *value;
+	int i, frame = -1;
+	testName = "Table info page is sticky";
+
+	TEST_CHECK(initRecordManager(NULL));
+	TEST_CHECK(createTable(TESTTBL, schema));
+	TEST_CHECK(openTable(table, TESTTBL));
+	bm = ((RM_TableMgmtData *) table->mgmtData)->bPool;
+
+	TEST_CHECK(createRecord(&r, schema));
+	for (i = 0; i < NUM_ROWS; i++) {
+		MAKE_VALUE(value, DT_INT, i);
+		TEST_CHECK(setAttr(r, schema, 0, value));
+		freeVal(value);
+		TEST_CHECK(insertRecord(table, r));
+	}
+	ASSERT_TRUE(r->id.page > bm->numPages, "rows fill more pages than pool");
+
+	frames = getFrameContents(bm);
+	for (i = 0; i < bm->numPages; i++) {
+		if (frames[i] == 0) {
+			frame = i;
+		}
+	}
+	ASSERT_TRUE(frame != -1, "table info page kept");
+	ASSERT_EQUALS_INT(BM_RETAIN_STICKY,
+			((BM_Data *) bm->mgmtData)->retention[frame],
+			"table info page is sticky");
+
+	freeRecord(r);
+	TEST_CHECK(closeTable(table));
+	TEST_CHECK(deleteTable(TESTTBL));
+	TEST_CHECK(shutdownRecordManager());
+	freeSchema(schema);
+
+	free(table);
+	TEST_DONE();
+}
+
+// create page file of NUM_BLOCKS pages "Page-<page no>"
+void createBlocks(void) {
+	SM_FileHandle fh;
+	SM_PageHandle ph = (SM_PageHandle) malloc(PAGE_SIZE);
+	int i;
+
+	TEST_CHECK(createPageFile(TESTPF));
+	TEST_CHECK(openPageFile(TESTPF, &fh));
+	TEST_CHECK(ensureCapacity(NUM_BLOCKS, &fh));
+	for (i = 0; i < NUM_BLOCKS; i++) {
+		memset(ph, 0, PAGE_SIZE);
+		sprintf(ph, "Page-%i", i);
+		TEST_CHECK(writeBlock(i, &fh, ph));
+	}
+	TEST_CHECK(closePageFile(&fh));
+
+	free(ph);
+}
+
+// pin page pageNum, check its content and unpin it again
+void pinAndCheck(BM_BufferPool *bm, PageNumber pageNum) {
+	pinHinted(bm, pageNum, BM_RETAIN_NORMAL);
+}
+
+// pin page pageNum with retention hint, check its content and unpin it
+void pinHinted(BM_BufferPool *bm, PageNumber pageNum, BM_RetentionHint hint) {
+	BM_PageHandle *h = MAKE_PAGE_HANDLE();
+	char expected[32];
+
+	TEST_CHECK(pinPageHint(bm, h, pageNum, hint));
+	sprintf(expected, "Page-%i", pageNum);
+	ASSERT_EQUALS_STRING(expected, h->data, "expected page content");
+	TEST_CHECK(unpinPage(bm, h));
+
+	free(h);
+}
+
+// TRUE if a frame of the pool holds page pageNum
+bool isResident(BM_BufferPool *bm, PageNumber pageNum) {
+	PageNumber *frames = getFrameContents(bm);
+	int i;
+
+	for (i = 0; i < bm->numPages; i++) {
+		if (frames[i] == pageNum) {
+			return TRUE;
+		}
+	}
+
+	return FALSE;
+}
+
+// schema of rows (v), without a key so inserts needn't look for duplicates
+Schema *valueSchema(void) {
+	char **cpNames = (char **) malloc(sizeof(char *));
+	DataType *cpDt = (DataType *) malloc(sizeof(DataType));
+	int *cpSizes = (int *) malloc(sizeof(int));
+	int *cpKeys = (int *) malloc(sizeof(int));
+
+	cpNames[0] = (char *) malloc(2);
+	strcpy(cpNames[0], "v");
+	cpDt[0] = DT_INT;
+	cpSizes[0] = 0;
+	cpKeys[0] = 0;
+
+	return createSchema(1, cpNames, cpDt, cpSizes, 0, cpKeys);
+}
@@ -0,0 +1,353 @@
+#include "storage_mgr.h"
+#include "buffer_mgr_stat.h"
+#include "buffer_mgr.h"
+#include "record_mgr.h"
+#include "expr.h"
+#include "tables.h"
+#include "dberror.h"
+#include "test_helper.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// var to store the current test's name
+char *testName;
+
+/* page file and pool used by the buffer pool tests */
+#define TESTPF "test_scan_ring.bin"
+#define NUM_FRAMES 40
+#define NUM_HOT 20
+#define NUM_BLOCKS 400
+#define RING_SIZE 8
+
+/* table used by the scan tests, its no of rows and of groups 1..NUM_GROUPS
+ * they fall in. Free slots read as group 0, so no row is put there. */
+#define TESTTBL "test_scan_ring_table"
+#define NUM_ROWS 500
+#define NUM_GROUPS 5
+
+// test and helper methods
+static void testRingKeepsHotPages(void);
+static void testRingHits(void);
+static void testRingSize(void);
+static void testRingSkipsPinnedFrames(void);
+static void testTableScans(void);
+
+static void createBlocks(void);
+static void checkPage(BM_BufferPool *bm, BM_AccessRing *ring,
+		PageNumber pageNum);
+static int frameOf(BM_BufferPool *bm, PageNumber pageNum);
+static Schema *groupSchema(void);
+static Expr *groupIs(int group);
+static int countRows(RM_TableData *table, int group);
+static void moveToLastGroup(Schema *schema, Record *record);
+
+// main method
+int main(void) {
+	initStorageManager();
+	testName = "";
+
+	testRingKeepsHotPages();
+	testRingHits();
+	testRingSize();
+	testRingSkipsPinnedFrames();
+	testTableScans();
+
+	return 0;
+}
+
+// a pass over many pages through a ring leaves the rest of the pool alone
+void testRingKeepsHotPages(void) {
+	BM_BufferPool *bm = MAKE_POOL();
+	BM_AccessRing ring;
+	int i, hot = 0, scanned = 0;
+	testName = "Ring keeps hot pages in pool";
+
+	createBlocks();
+	TEST_CHECK(initBufferPool(bm, TESTPF, NUM_FRAMES, RS_LRU, NULL));
+
+	for (i = 0; i < NUM_HOT; i++) {
+		checkPage(bm, NULL, i);
+	}
+	TEST_CHECK(initAccessRing(bm, &ring, RING_SIZE));
+	for (i = NUM_HOT; i < NUM_BLOCKS; i++) {
+		checkPage(bm, &ring, i);
+	}
+	freeAccessRing(&ring);
+
+	for (i = 0; i < NUM_BLOCKS; i++) {
+		if (frameOf(bm, i) != -1) {
+			hot += i < NUM_HOT;
+			scanned += i >= NUM_HOT;
+		}
+	}
+	ASSERT_EQUALS_INT(NUM_HOT, hot, "hot pages survived the pass");
+	ASSERT_EQUALS_INT(RING_SIZE, scanned, "pass kept to its ring");
+	ASSERT_EQUALS_INT(NUM_BLOCKS, getNumReadIO(bm), "each page read once");
+
+	// the same pass through plain pins flushes the hot pages out
+	for (i = NUM_HOT; i < NUM_BLOCKS; i++) {
+		checkPage(bm, NULL, i);
+	}
+	ASSERT_EQUALS_INT(-1, frameOf(bm, 0), "plain pass evicted hot pages");
+
+	TEST_CHECK(shutdownBufferPool(bm));
+	TEST_CHECK(destroyPageFile(TESTPF));
+
+	free(bm);
+	TEST_DONE();
+}
+
+// pins through a ring of resident pages behave like plain pins
+void testRingHits(void) {
+	BM_BufferPool *bm = MAKE_POOL();
+	BM_PageHandle *h = MAKE_PAGE_HANDLE();
+	BM_AccessRing ring;
+	testName = "Ring pins of resident pages";
+
+	createBlocks();
+	TEST_CHECK(initBufferPool(bm, TESTPF, NUM_FRAMES, RS_FIFO, NULL));
+	TEST_CHECK(initAccessRing(bm, &ring, RING_SIZE));
+
+	TEST_CHECK(pinPage(bm, h, 7));
+	checkPage(bm, &ring, 7);
+	ASSERT_EQUALS_INT(1, getNumReadIO(bm), "ring pin hit");
+	ASSERT_EQUALS_INT(1, getFixCounts(bm)[frameOf(bm, 7)],
+			"ring pin dropped");
+	TEST_CHECK(unpinPage(bm, h));
+	ASSERT_EQUALS_INT(-1, ring.frames[0], "hit took no ring frame");
+
+	ASSERT_ERROR(pinPageWithRing(bm, NULL, h, 7), "pin without ring");
+
+	freeAccessRing(&ring);
+	TEST_CHECK(shutdownBufferPool(bm));
+	TEST_CHECK(destroyPageFile(TESTPF));
+
+	free(bm);
+	free(h);
+	TEST_DONE();
+}
+
+// rings are capped at a quarter of the pool, but hold a frame at least
+void testRingSize(void) {
+	BM_BufferPool *bm = MAKE_POOL();
+	BM_AccessRing ring;
+	testName = "Ring size";
+
+	createBlocks();
+	TEST_CHECK(initBufferPool(bm, TESTPF, NUM_FRAMES, RS_FIFO, NULL));
+	TEST_CHECK(initAccessRing(bm, &ring, NUM_FRAMES));
+	ASSERT_EQUALS_INT(NUM_FRAMES / 4, ring.size, "ring capped");
+	freeAccessRing(&ring);
+	TEST_CHECK(initAccessRing(bm, &ring, RING_SIZE));
+	ASSERT_EQUALS_INT(RING_SIZE, ring.size, "ring of requested size");
+	freeAccessRing(&ring);
+	TEST_CHECK(shutdownBufferPool(bm));
+
+	TEST_CHECK(initBufferPool(bm, TESTPF, 3, RS_FIFO, NULL));
+	TEST_CHECK(initAccessRing(bm, &ring, RING_SIZE));
+	ASSERT_EQUALS_INT(1, ring.size, "ring of a tiny pool");
+	freeAccessRing(&ring);
+	TEST_CHECK(shutdownBufferPool(bm));
+	TEST_CHECK(destroyPageFile(TESTPF));
+
+	free(bm);
+	TEST_DONE();
+}
+
+// a ring frame someone else pinned meanwhile is left alone
+void testRingSkipsPinnedFrames(void) {
+	BM_BufferPool *bm = MAKE_POOL();
+	BM_PageHandle *h = MAKE_PAGE_HANDLE();
+	BM_AccessRing ring;
+	int i;
+	testName = "Ring skips pinned frames";
+
+	createBlocks();
+	TEST_CHECK(initBufferPool(bm, TESTPF, 4, RS_FIFO, NULL));
+	TEST_CHECK(initAccessRing(bm, &ring, 1));
+
+	checkPage(bm, &ring, 10);
+	TEST_CHECK(pinPage(bm, h, 10));
+	checkPage(bm, &ring, 11);
+	ASSERT_TRUE(frameOf(bm, 10) != -1, "pinned page stays");
+	ASSERT_TRUE(ring.frames[0] != frameOf(bm, 10), "ring took another frame");
+	TEST_CHECK(unpinPage(bm, h));
+
+	// once the ring owns an unpinned frame, it keeps recycling it
+	for (i = 12; i < 20; i++) {
+		checkPage(bm, &ring, i);
+	}
+	ASSERT_TRUE(frameOf(bm, 10) != -1, "page left by the ring stays");
+	ASSERT_EQUALS_INT(ring.frames[0], frameOf(bm, 19), "ring frame recycled");
+
+	freeAccessRing(&ring);
+	TEST_CHECK(shutdownBufferPool(bm));
+	TEST_CHECK(destroyPageFile(TESTPF));
+
+	free(bm);
+	free(h);
+	TEST_DONE();
+}
+
+// table scans and update scans read their records through a ring
+void testTableScans(void) {
+	RM_TableData *table = (RM_TableData *) malloc(sizeof(RM_TableData));
+	Schema *schema = groupSchema();
+	Record *r;
+	Value *value;
+	int i, rows;
+	testName = "Table scans through a ring";
+
+	TEST_CHECK(initRecordManager(NULL));
+	TEST_CHECK(createTable(TESTTBL, schema));
+	TEST_CHECK(openTable(table, TESTTBL));
+
+	for (i = 0; i < NUM_ROWS; i++) {
+		TEST_CHECK(createRecord(&r, schema));
+		MAKE_VALUE(value, DT_INT, i);
+		TEST_CHECK(setAttr(r, schema, 0, value));
+		freeVal(value);
+		MAKE_VALUE(value, DT_INT, i % NUM_GROUPS + 1);
+		TEST_CHECK(setAttr(r, schema, 1, value));
+		freeVal(value);
+		TEST_CHECK(insertRecord(table, r));
+		freeRecord(r);
+	}
+
+	for (i = 1; i <= NUM_GROUPS; i++) {
+		ASSERT_EQUALS_INT(NUM_ROWS / NUM_GROUPS, countRows(table, i),
+				"scan found its group");
+	}
+
+	Expr *cond = groupIs(1);
+	TEST_CHECK(updateScan(table, cond, moveToLastGroup));
+	freeExpr(cond);
+	for (i = 1, rows = 0; i <= NUM_GROUPS; i++) {
+		rows += countRows(table, i);
+	}
+	ASSERT_EQUALS_INT(NUM_ROWS, rows, "update scan kept all rows");
+	ASSERT_TRUE(countRows(table, NUM_GROUPS) > NUM_ROWS / NUM_GROUPS,
+			"update scan moved rows");
+
+	TEST_CHECK(closeTable(table));
+	TEST_CHECK(deleteTable(TESTTBL));
+	TEST_CHECK(shutdownRecordManager());
+	freeSchema(schema);
+
+	free(table);
+	TEST_DONE();
+}
+
+// create page file of NUM_BLOCKS pages "Page-<page no>"
+void createBlocks(void) {
+	SM_FileHandle fh;
+	SM_PageHandle ph = (SM_PageHandle) malloc(PAGE_SIZE);
+	int i;
+
+	TEST_CHECK(createPageFile(TESTPF));
+	TEST_CHECK(openPageFile(TESTPF, &fh));
+	TEST_CHECK(ensureCapacity(NUM_BLOCKS, &fh));
+	for (i = 0; i < NUM_BLOCKS; i++) {
+		memset(ph, 0, PAGE_SIZE);
+		sprintf(ph, "Page-%i", i);
+		TEST_CHECK(writeBlock(i, &fh, ph));
+	}
+	TEST_CHECK(closePageFile(&fh));
+
+	free(ph);
+}
+
+// pin page pageNum through ring, or plainly if ring is NULL, check its
+// content and unpin it
+void checkPage(BM_BufferPool *bm, BM_AccessRing *ring, PageNumber pageNum) {
+	BM_PageHandle h;
+	char expected[32];
+
+	if (ring != NULL) {
+		TEST_CHECK(pinPageWithRing(bm, ring, &h, pageNum));
+	} else {
+		TEST_CHECK(pinPage(bm, &h, pageNum));
+	}
+	sprintf(expected, "Page-%i", pageNum);
+	if (strcmp(expected, h.data) != 0) {
+		ASSERT_EQUALS_STRING(expected, h.data, "pinned page content");
+	}
+	TEST_CHECK(unpinPage(bm, &h));
+}
+
+// index of the frame holding page pageNum, -1 if none does
+int frameOf(BM_BufferPool *bm, PageNumber pageNum) {
+	PageNumber *frames = getFrameContents(bm);
+	int i;
+
+	for (i = 0; i < bm->numPages; i++) {
+		if (frames[i] == pageNum) {
+			return i;
+		}
+	}
+
+	return -1;
+}
+
+// schema of rows (id, group)
+Schema *groupSchema(void) {
+	char *names[] = { "id", "grp" };
+	char **cpNames = (char **) malloc(sizeof(char *) * 2);
+	DataType *cpDt = (DataType *) malloc(sizeof(DataType) * 2);
+	int *cpSizes = (int *) malloc(sizeof(int) * 2);
+	int *cpKeys = (int *) malloc(sizeof(int));
+	int i;
+
+	for (i = 0; i < 2; i++) {
+		cpNames[i] = (char *) malloc(strlen(names[i]) + 1);
+		strcpy(cpNames[i], names[i]);
+		cpDt[i] = DT_INT;
+		cpSizes[i] = 0;
+	}
+	cpKeys[0] = 0;
+
+	return createSchema(2, cpNames, cpDt, cpSizes, 1, cpKeys);
+}
+
+// condition grp = group
+Expr *groupIs(int group) {
+	Expr *cond, *left, *right;
+	Value *value;
+
+	MAKE_VALUE(value, DT_INT, group);
+	MAKE_CONS(left, value);
+	MAKE_ATTRREF(right, 1);
+	MAKE_BINOP_EXPR(cond, left, right, OP_COMP_EQUAL);
+
+	return cond;
+}
+
+// number of rows of group found by a scan
+int countRows(RM_TableData *table, int group) {
+	RM_ScanHandle scan;
+	Expr *cond = groupIs(group);
+	Record *r;
+	int rows = 0;
+
+	TEST_CHECK(createRecord(&r, table->schema));
+	TEST_CHECK(startScan(table, &scan, cond));
+	while (next(&scan, r) == RC_OK) {
+		rows++;
+	}
+	TEST_CHECK(closeScan(&scan));
+	freeRecord(r);
+	freeExpr(cond);
+
+	return rows;
+}
+
+// update scan operation moving a row to the last group
+void moveToLastGroup(Schema *schema, Record *record) {
+	Value *value;
+
+	MAKE_VALUE(value, DT_INT, NUM_GROUPS);
+	setAttr(record, schema, 1, value);
+	freeVal(value);
+}
@@ -0,0 +1,316 @@
+#include "storage_mgr.h"
+#include "buffer_mgr_stat.h"
+#include "buffer_mgr.h"
+#include "dberror.h"
+#include "test_helper.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// var to store the current test's name
+char *testName;
+
+/* page files and shared pool used by all tests */
+#define TESTPF "test_shared_pool.bin"
+#define OTHERPF "test_shared_pool2.bin"
+#define NUM_FRAMES 6
+#define NUM_BLOCKS 10
+
+// test and helper methods
+static void testViewsShareFrames(void);
+static void testCloseDropsOwnPages(void);
+static void testFlushOwnFile(void);
+static void testSharedPoolLifecycle(void);
+static void testPageCountsOfTwoFiles(void);
+
+static void createBlocks(char *fileName);
+static void pinAndCheck(BM_BufferPool *bm, PageNumber pageNum);
+static void dirtyPage(BM_BufferPool *bm, PageNumber pageNum);
+static int countFilePages(BM_BufferPool *bm);
+static void checkFile(char *fileName, PageNumber pageNum, char *prefix);
+
+// main method
+int main(void) {
+	initStorageManager();
+	testName = "";
+
+	testViewsShareFrames();
+	testCloseDropsOwnPages();
+	testFlushOwnFile();
+	testSharedPoolLifecycle();
+	testPageCountsOfTwoFiles();
+
+	return 0;
+}
+
+// views on two page files use the frames of the shared pool and keep the
+// same page numbers of both files apart
+void testViewsShareFrames(void) {
+	BM_BufferPool *a = MAKE_POOL();
+	BM_BufferPool *b = MAKE_POOL();
+	int i;
+	testName = "Views share the frames of the shared pool";
+
+	createBlocks(TESTPF);
+	createBlocks(OTHERPF);
+	TEST_CHECK(initSharedBufferPool(NUM_FRAMES, RS_LRU, NULL, NULL));
+	TEST_CHECK(initBufferPool(a, TESTPF, 3, RS_FIFO, NULL));
+	TEST_CHECK(initBufferPool(b, OTHERPF, 3, RS_FIFO, NULL));
+
+	ASSERT_TRUE(a->mgmtData == b->mgmtData, "views share the pool");
+	ASSERT_EQUALS_INT(NUM_FRAMES, a->numPages, "size of the shared pool");
+	ASSERT_EQUALS_INT(RS_LRU, b->strategy, "strategy of the shared pool");
+	ASSERT_TRUE(a->fileId != b->fileId, "page files have their own slots");
+
+	for (i = 0; i < NUM_FRAMES / 2; i++) {
+		pinAndCheck(a, i);
+	}
+	for (i = 0; i < NUM_FRAMES / 2; i++) {
+		pinAndCheck(b, i);
+	}
+	ASSERT_EQUALS_INT(NUM_FRAMES / 2, countFilePages(a),
+			"first file holds half the frames");
+	ASSERT_EQUALS_INT(NUM_FRAMES / 2, countFilePages(b),
+			"second file holds the other half");
+	ASSERT_EQUALS_INT(NUM_FRAMES, getNumReadIO(a), "each page read once");
+
+	//Pages of the first file are now the least recently used ones
+	for (i = NUM_FRAMES / 2; i < NUM_FRAMES; i++) {
+		pinAndCheck(b, i);
+	}
+	ASSERT_EQUALS_INT(0, countFilePages(a), "busy file took all frames");
+	ASSERT_EQUALS_INT(NUM_FRAMES, countFilePages(b), "all frames in use");
+
+	TEST_CHECK(shutdownBufferPool(a));
+	TEST_CHECK(shutdownBufferPool(b));
+	TEST_CHECK(shutdownSharedBufferPool());
+	TEST_CHECK(destroyPageFile(TESTPF));
+	TEST_CHECK(destroyPageFile(OTHERPF));
+
+	free(a);
+	free(b);
+	TEST_DONE();
+}
+
+// closing the last view on a page file writes back and drops its pages
+// only, closing one of two views on it drops nothing
+void testCloseDropsOwnPages(void) {
+	BM_BufferPool *a = MAKE_POOL();
+	BM_BufferPool *a2 = MAKE_POOL();
+	BM_BufferPool *b = MAKE_POOL();
+	int reads;
+	testName = "Closing a view drops only its page file";
+
+	createBlocks(TESTPF);
+	createBlocks(OTHERPF);
+	TEST_CHECK(initSharedBufferPool(NUM_FRAMES, RS_LRU, NULL, NULL));
+	TEST_CHECK(initBufferPool(a, TESTPF, 3, RS_FIFO, NULL));
+	TEST_CHECK(initBufferPool(a2, TESTPF, 3, RS_FIFO, NULL));
+	TEST_CHECK(initBufferPool(b, OTHERPF, 3, RS_FIFO, NULL));
+	ASSERT_EQUALS_INT(a->fileId, a2->fileId, "views on a file share a slot");
+
+	dirtyPage(a, 0);
+	dirtyPage(a, 1);
+	pinAndCheck(b, 0);
+	pinAndCheck(b, 1);
+
+	TEST_CHECK(shutdownBufferPool(a2));
+	ASSERT_EQUALS_INT(2, countFilePages(a), "other view keeps the pages");
+	ASSERT_EQUALS_INT(0, getNumWriteIO(a), "nothing written yet");
+
+	TEST_CHECK(shutdownBufferPool(a));
+	ASSERT_EQUALS_INT(2, getNumWriteIO(b), "dirty pages written on close");
+	ASSERT_EQUALS_INT(2, countFilePages(b), "pages of other file stay");
+	checkFile(TESTPF, 0, "Dirty");
+	checkFile(TESTPF, 1, "Dirty");
+
+	reads = getNumReadIO(b);
+	pinAndCheck(b, 0);
+	pinAndCheck(b, 1);
+	ASSERT_EQUALS_INT(reads, getNumReadIO(b), "pages of other file cached");
+
+	TEST_CHECK(shutdownBufferPool(b));
+	TEST_CHECK(shutdownSharedBufferPool());
+	TEST_CHECK(destroyPageFile(TESTPF));
+	TEST_CHECK(destroyPageFile(OTHERPF));
+
+	free(a);
+	free(a2);
+	free(b);
+	TEST_DONE();
+}
+
+// forceFlushPool on a view writes only the pages of its page file
+void testFlushOwnFile(void) {
+	BM_BufferPool *a = MAKE_POOL();
+	BM_BufferPool *b = MAKE_POOL();
+	BM_Data *data;
+	int i, dirtyA = 0, dirtyB = 0;
+	testName = "Flushing a view writes only its page file";
+
+	createBlocks(TESTPF);
+	createBlocks(OTHERPF);
+	TEST_CHECK(initSharedBufferPool(NUM_FRAMES, RS_LRU, NULL, NULL));
+	TEST_CHECK(initBufferPool(a, TESTPF, 3, RS_FIFO, NULL));
+	TEST_CHECK(initBufferPool(b, OTHERPF, 3, RS_FIFO, NULL));
+
+	for (i = 0; i < NUM_FRAMES / 2; i++) {
+		dirtyPage(a, i);
+		dirtyPage(b, i);
+	}
+	TEST_CHECK(forceFlushPool(a));
+
+	data = (BM_Data *) a->mgmtData;
+	for (i = 0; i < NUM_FRAMES; i++) {
+		dirtyA += data->frameFile[i] == a->fileId && getDirtyFlags(a)[i];
+		dirtyB += data->frameFile[i] == b->fileId && getDirtyFlags(b)[i];
+	}
+	ASSERT_EQUALS_INT(0, dirtyA, "pages of flushed file are clean");
+	ASSERT_EQUALS_INT(NUM_FRAMES / 2, dirtyB, "pages of other file stay dirty");
+	ASSERT_EQUALS_INT(NUM_FRAMES / 2, getNumWriteIO(a), "one write per page");
+	checkFile(TESTPF, 0, "Dirty");
+	checkFile(OTHERPF, 0, "Page");
+
+	TEST_CHECK(shutdownBufferPool(a));
+	TEST_CHECK(shutdownBufferPool(b));
+	TEST_CHECK(shutdownSharedBufferPool());
+	checkFile(OTHERPF, 0, "Dirty");
+	TEST_CHECK(destroyPageFile(TESTPF));
+	TEST_CHECK(destroyPageFile(OTHERPF));
+
+	free(a);
+	free(b);
+	TEST_DONE();
+}
+
+// the shared pool exists once, stays while views are open and pools are
+// private again once it is gone
+void testSharedPoolLifecycle(void) {
+	BM_BufferPool *a = MAKE_POOL();
+	testName = "Shared pool lifecycle";
+
+	createBlocks(TESTPF);
+	ASSERT_ERROR(shutdownSharedBufferPool(), "no shared pool to shut down");
+	ASSERT_ERROR(initSharedBufferPool(0, RS_LRU, NULL, NULL),
+			"shared pool needs frames");
+	TEST_CHECK(initSharedBufferPool(NUM_FRAMES, RS_LRU, NULL, NULL));
+	ASSERT_EQUALS_INT(RC_SHARED_POOL_EXISTS,
+			initSharedBufferPool(NUM_FRAMES, RS_LRU, NULL, NULL),
+			"only one shared pool");
+
+	TEST_CHECK(initBufferPool(a, TESTPF, 3, RS_FIFO, NULL));
+	ASSERT_TRUE(((BM_Data *) a->mgmtData)->shared, "view on shared pool");
+	ASSERT_EQUALS_INT(RC_SHUTDOWN_FAIL, shutdownSharedBufferPool(),
+			"shared pool stays while views are open");
+	TEST_CHECK(shutdownBufferPool(a));
+	TEST_CHECK(shutdownSharedBufferPool());
+
+	TEST_CHECK(initBufferPool(a, TESTPF, 3, RS_FIFO, NULL));
+	ASSERT_TRUE(!((BM_Data *) a->mgmtData)->shared, "private pool again");
+	ASSERT_EQUALS_INT(3, a->numPages, "private pool has its own size");
+	pinAndCheck(a, 0);
+	TEST_CHECK(shutdownBufferPool(a));
+	TEST_CHECK(destroyPageFile(TESTPF));
+
+	free(a);
+	TEST_DONE();
+}
+
+// page counts of two page files grown while both are open survive closing
+void testPageCountsOfTwoFiles(void) {
+	SM_FileHandle fa, fb;
+	testName = "Page counts of two open page files";
+
+	TEST_CHECK(createPageFile(TESTPF));
+	TEST_CHECK(createPageFile(OTHERPF));
+	TEST_CHECK(openPageFile(TESTPF, &fa));
+	TEST_CHECK(openPageFile(OTHERPF, &fb));
+	TEST_CHECK(ensureCapacity(4, &fa));
+	TEST_CHECK(appendEmptyBlock(&fb));
+	TEST_CHECK(closePageFile(&fa));
+	TEST_CHECK(closePageFile(&fb));
+
+	TEST_CHECK(openPageFile(TESTPF, &fa));
+	TEST_CHECK(openPageFile(OTHERPF, &fb));
+	ASSERT_EQUALS_INT(4, fa.totalNumPages, "first file grew to 4 pages");
+	ASSERT_EQUALS_INT(2, fb.totalNumPages, "second file grew to 2 pages");
+	TEST_CHECK(closePageFile(&fa));
+	TEST_CHECK(closePageFile(&fb));
+
+	TEST_CHECK(destroyPageFile(TESTPF));
+	TEST_CHECK(destroyPageFile(OTHERPF));
+	TEST_DONE();
+}
+
+// create page file fileName of NUM_BLOCKS pages "Page-<page no>"
+void createBlocks(char *fileName) {
+	SM_FileHandle fh;
+	SM_PageHandle ph = (SM_PageHandle) malloc(PAGE_SIZE);
+	int i;
+
+	TEST_CHECK(createPageFile(fileName));
+	TEST_CHECK(openPageFile(fileName, &fh));
+	TEST_CHECK(ensureCapacity(NUM_BLOCKS, &fh));
+	for (i = 0; i < NUM_BLOCKS; i++) {
+		memset(ph, 0, PAGE_SIZE);
+		sprintf(ph, "Page-%i", i);
+		TEST_CHECK(writeBlock(i, &fh, ph));
+	}
+	TEST_CHECK(closePageFile(&fh));
+
+	free(ph);
+}
+
+// pin page pageNum, check its content and unpin it again
+void pinAndCheck(BM_BufferPool *bm, PageNumber pageNum) {
+	BM_PageHandle *h = MAKE_PAGE_HANDLE();
+	char expected[32];
+
+	TEST_CHECK(pinPage(bm, h, pageNum));
+	sprintf(expected, "Page-%i", pageNum);
+	ASSERT_EQUALS_STRING(expected, h->data, "expected page content");
+	TEST_CHECK(unpinPage(bm, h));
+
+	free(h);
+}
+
+// pin page pageNum, overwrite it with "Dirty-<page no>" and unpin it
+void dirtyPage(BM_BufferPool *bm, PageNumber pageNum) {
+	BM_PageHandle *h = MAKE_PAGE_HANDLE();
+
+	TEST_CHECK(pinPage(bm, h, pageNum));
+	sprintf(h->data, "Dirty-%i", pageNum);
+	TEST_CHECK(markDirty(bm, h));
+	TEST_CHECK(unpinPage(bm, h));
+
+	free(h);
+}
+
+// number of frames holding a page of the page file of view bm
+int countFilePages(BM_BufferPool *bm) {
+	BM_Data *data = (BM_Data *) bm->mgmtData;
+	int i, count = 0;
+
+	for (i = 0; i < bm->numPages; i++) {
+		count += data->frameFile[i] == bm->fileId
+				&& getFrameContents(bm)[i] != NO_PAGE;
+	}
+
+	return count;
+}
+
+// check that page pageNum of page file fileName holds "<prefix>-<page no>"
+void checkFile(char *fileName, PageNumber pageNum, char *prefix) {
+	SM_FileHandle fh;
+	SM_PageHandle ph = (SM_PageHandle) malloc(PAGE_SIZE);
+	char expected[32];
+
+	TEST_CHECK(openPageFile(fileName, &fh));
+	TEST_CHECK(readBlock(pageNum, &fh, ph));
+	sprintf(expected, "%s-%i", prefix, pageNum);
+	ASSERT_EQUALS_STRING(expected, ph, "page file holds expected content");
+	TEST_CHECK(closePageFile(&fh));
+
+	free(ph);
+}
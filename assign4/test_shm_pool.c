@@ -0,0 +1,237 @@
+#include "storage_mgr.h"
+#include "buffer_mgr_stat.h"
+#include "buffer_mgr.h"
+#include "dberror.h"
+#include "test_helper.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+// var to store the current test's name
+char *testName;
+
+/* page file, shared memory segment and pool size used by all tests */
+#define TESTPF "test_shm_pool.bin"
+#define TESTSHM "/test_shm_pool"
+#define NUM_FRAMES 8
+#define NUM_BLOCKS 32
+
+/* clients forked and updates each of them makes */
+#define NUM_CLIENTS 4
+#define NUM_UPDATES 500
+
+// test and helper methods
+static void testSharedPinsAndDirtyPages(void);
+static void testForkedClients(void);
+static void testDeadClientRecovery(void);
+
+static void createBlocks(void);
+static void attachPool(BM_BufferPool *bm);
+static int updatePages(int client);
+
+// main method
+int main(void) {
+	initStorageManager();
+	testName = "";
+
+	testSharedPinsAndDirtyPages();
+	testForkedClients();
+	testDeadClientRecovery();
+
+	return 0;
+}
+
+// two pools attached to the segment see each other's pins, dirty pages and
+// page content
+void testSharedPinsAndDirtyPages(void) {
+	BM_BufferPool *a = MAKE_POOL();
+	BM_BufferPool *b = MAKE_POOL();
+	BM_PageHandle *ha = MAKE_PAGE_HANDLE();
+	BM_PageHandle *hb = MAKE_PAGE_HANDLE();
+	testName = "Pins and dirty pages shared by two pools";
+
+	createBlocks();
+	attachPool(a);
+	attachPool(b);
+	ASSERT_EQUALS_INT(NUM_FRAMES, b->numPages, "pools share frames");
+
+	TEST_CHECK(pinPage(a, ha, 3));
+	TEST_CHECK(pinPage(b, hb, 3));
+	ASSERT_EQUALS_INT(ha->frame, hb->frame, "page is held in one frame");
+	ASSERT_EQUALS_INT(2, getFixCounts(a)[ha->frame], "pins of both pools");
+	ASSERT_EQUALS_INT(2, getFixCounts(b)[hb->frame], "pins of both pools");
+
+	sprintf(ha->data, "%s", "updated-3");
+	TEST_CHECK(markDirty(a, ha));
+	ASSERT_TRUE(getDirtyFlags(b)[hb->frame], "dirty page seen by other pool");
+	ASSERT_EQUALS_STRING("updated-3", hb->data, "update seen by other pool");
+
+	TEST_CHECK(unpinPage(a, ha));
+	ASSERT_EQUALS_INT(1, getFixCounts(b)[hb->frame], "pin of other pool left");
+	ASSERT_ERROR(shutdownBufferPool(b), "pool with pinned page can't detach");
+	TEST_CHECK(unpinPage(b, hb));
+	ASSERT_EQUALS_INT(0, getFixCounts(a)[ha->frame], "no pins left");
+
+	TEST_CHECK(forcePage(b, hb));
+	ASSERT_TRUE(!getDirtyFlags(a)[ha->frame], "page written by other pool");
+
+	TEST_CHECK(shutdownBufferPool(a));
+	TEST_CHECK(shutdownBufferPool(b));
+	ASSERT_TRUE(access("/dev/shm" TESTSHM, F_OK) != 0,
+			"segment removed with last pool");
+
+	TEST_CHECK(destroyPageFile(TESTPF));
+
+	free(a);
+	free(b);
+	free(ha);
+	free(hb);
+	TEST_DONE();
+}
+
+// processes update pages under exclusive latches through the segment, no
+// update may get lost
+void testForkedClients(void) {
+	SM_FileHandle fh;
+	char *buf = (char *) malloc(PAGE_SIZE);
+	pid_t clients[NUM_CLIENTS];
+	int i, status, failed = 0, total = 0;
+	testName = "Forked clients updating shared pages";
+
+	createBlocks();
+
+	//Clients mustn't print what's buffered so far once more
+	fflush(stdout);
+	for (i = 0; i < NUM_CLIENTS; i++) {
+		clients[i] = fork();
+		if (clients[i] == 0) {
+			exit(updatePages(i));
+		}
+	}
+	for (i = 0; i < NUM_CLIENTS; i++) {
+		waitpid(clients[i], &status, 0);
+		failed += !WIFEXITED(status) || WEXITSTATUS(status) != 0;
+	}
+	ASSERT_EQUALS_INT(0, failed, "clients finished");
+
+	TEST_CHECK(openPageFile(TESTPF, &fh));
+	for (i = 0; i < NUM_BLOCKS; i++) {
+		TEST_CHECK(readBlock(i, &fh, buf));
+		total += ((int *) buf)[1];
+	}
+	TEST_CHECK(closePageFile(&fh));
+	ASSERT_EQUALS_INT(NUM_CLIENTS * NUM_UPDATES, total,
+			"all updates written");
+
+	TEST_CHECK(destroyPageFile(TESTPF));
+
+	free(buf);
+	TEST_DONE();
+}
+
+// a client dying with a pinned, latched page doesn't keep it from others
+void testDeadClientRecovery(void) {
+	BM_BufferPool *bm = MAKE_POOL();
+	BM_PageHandle *h = MAKE_PAGE_HANDLE();
+	pid_t client;
+	int status;
+	testName = "Recovery of a dead client";
+
+	createBlocks();
+	attachPool(bm);
+
+	fflush(stdout);
+	client = fork();
+	if (client == 0) {
+		BM_BufferPool dead;
+		BM_PageHandle page;
+		attachPool(&dead);
+		if (pinPageLatched(&dead, &page, 5, BM_LATCH_EXCLUSIVE) != RC_OK) {
+			_exit(1);
+		}
+		//Die without unpinning or detaching
+		_exit(0);
+	}
+	waitpid(client, &status, 0);
+	ASSERT_TRUE(WIFEXITED(status) && WEXITSTATUS(status) == 0,
+			"client pinned page and died");
+
+	TEST_CHECK(pinPage(bm, h, 5));
+	ASSERT_EQUALS_INT(2, getFixCounts(bm)[h->frame],
+			"pin of dead client left");
+	TEST_CHECK(unpinPage(bm, h));
+
+	//Attaching looks for dead clients
+	BM_BufferPool *other = MAKE_POOL();
+	attachPool(other);
+	ASSERT_EQUALS_INT(0, getFixCounts(bm)[h->frame],
+			"pin of dead client dropped");
+	TEST_CHECK(pinPageLatched(other, h, 5, BM_LATCH_EXCLUSIVE));
+	TEST_CHECK(unpinPageLatched(other, h));
+
+	TEST_CHECK(shutdownBufferPool(other));
+	TEST_CHECK(shutdownBufferPool(bm));
+	ASSERT_TRUE(access("/dev/shm" TESTSHM, F_OK) != 0,
+			"segment removed with last pool");
+	TEST_CHECK(destroyPageFile(TESTPF));
+
+	free(other);
+	free(bm);
+	free(h);
+	TEST_DONE();
+}
+
+// create page file of NUM_BLOCKS pages, page i starting with int i and an
+// update count of 0
+void createBlocks(void) {
+	SM_FileHandle fh;
+	char *buf = (char *) calloc(1, PAGE_SIZE);
+	int i;
+
+	TEST_CHECK(createPageFile(TESTPF));
+	TEST_CHECK(openPageFile(TESTPF, &fh));
+	TEST_CHECK(ensureCapacity(NUM_BLOCKS, &fh));
+	for (i = 0; i < NUM_BLOCKS; i++) {
+		((int *) buf)[0] = i;
+		TEST_CHECK(writeBlock(i, &fh, buf));
+	}
+	TEST_CHECK(closePageFile(&fh));
+
+	free(buf);
+}
+
+// attach pool bm to the test segment
+void attachPool(BM_BufferPool *bm) {
+	BM_PoolOptions options;
+
+	initPoolOptions(&options);
+	options.shmName = TESTSHM;
+	TEST_CHECK(initBufferPoolWithOptions(bm, TESTPF, NUM_FRAMES, RS_CLOCK,
+			NULL, &options));
+}
+
+// bump the update count of random pages, run by a forked client
+int updatePages(int client) {
+	BM_BufferPool bm;
+	BM_PageHandle h;
+	unsigned int seed = client + 1;
+	int i;
+
+	attachPool(&bm);
+	for (i = 0; i < NUM_UPDATES; i++) {
+		PageNumber pageNum = rand_r(&seed) % NUM_BLOCKS;
+		TEST_CHECK(pinPageLatched(&bm, &h, pageNum, BM_LATCH_EXCLUSIVE));
+		if (((int *) h.data)[0] != pageNum) {
+			return 1;
+		}
+		((int *) h.data)[1]++;
+		TEST_CHECK(markDirty(&bm, &h));
+		TEST_CHECK(unpinPageLatched(&bm, &h));
+	}
+	TEST_CHECK(shutdownBufferPool(&bm));
+
+	return 0;
+}
@@ -0,0 +1,243 @@
+#include "storage_mgr.h"
+#include "buffer_mgr_stat.h"
+#include "buffer_mgr.h"
+#include "dberror.h"
+#include "test_helper.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// var to store the current test's name
+char *testName;
+
+/* page file and pool sizes used by all tests */
+#define TESTPF "test_tier.bin"
+#define NUM_FRAMES 3
+#define NUM_BLOCKS 10
+
+/* tier budgets: one holding every page, one holding about two of them */
+#define LARGE_TIER (64 * 1024)
+#define SMALL_TIER 256
+
+// test and helper methods
+static void testTierHits(void);
+static void testDirtyPages(void);
+static void testTierBudget(void);
+static void testIncompressiblePage(void);
+
+static void createBlocks(void);
+static void openTiered(BM_BufferPool *bm, size_t tierBytes);
+static void pinAndCheck(BM_BufferPool *bm, PageNumber pageNum);
+
+// main method
+int main(void) {
+	initStorageManager();
+	testName = "";
+
+	testTierHits();
+	testDirtyPages();
+	testTierBudget();
+	testIncompressiblePage();
+
+	return 0;
+}
+
+// evicted pages come back from the tier instead of the page file
+void testTierHits(void) {
+	BM_BufferPool *bm = MAKE_POOL();
+	BM_PoolStats stats;
+	int i;
+	testName = "Misses served by the tier";
+
+	createBlocks();
+	openTiered(bm, LARGE_TIER);
+	for (i = 0; i < NUM_BLOCKS; i++) {
+		pinAndCheck(bm, i);
+	}
+	TEST_CHECK(getPoolStats(bm, &stats));
+	ASSERT_EQUALS_INT(NUM_BLOCKS - NUM_FRAMES, (int) stats.tierStores,
+			"every evicted page kept");
+	ASSERT_EQUALS_INT(0, (int) stats.tierHits, "nothing taken back yet");
+
+	//Pages 0 .. 6 are in the tier, pinning them keeps evicting into it
+	for (i = 0; i < NUM_BLOCKS - NUM_FRAMES; i++) {
+		pinAndCheck(bm, i);
+	}
+	TEST_CHECK(getPoolStats(bm, &stats));
+	ASSERT_EQUALS_INT(NUM_BLOCKS - NUM_FRAMES, (int) stats.tierHits,
+			"pages taken back from the tier");
+	ASSERT_EQUALS_INT(NUM_BLOCKS, (int) stats.reads,
+			"each page read from page file once");
+	ASSERT_EQUALS_INT(2 * NUM_BLOCKS - NUM_FRAMES, (int) stats.misses,
+			"tier hits are still misses");
+
+	TEST_CHECK(shutdownBufferPool(bm));
+	TEST_CHECK(destroyPageFile(TESTPF));
+
+	free(bm);
+	TEST_DONE();
+}
+
+// a dirty page is written back before it's kept, its copy is the new page
+void testDirtyPages(void) {
+	BM_BufferPool *bm = MAKE_POOL();
+	BM_PageHandle *h = MAKE_PAGE_HANDLE();
+	BM_PoolStats stats;
+	SM_FileHandle fh;
+	SM_PageHandle ph = (SM_PageHandle) malloc(PAGE_SIZE);
+	int i;
+	testName = "Dirty pages in the tier";
+
+	createBlocks();
+	openTiered(bm, LARGE_TIER);
+	TEST_CHECK(pinPage(bm, h, 0));
+	sprintf(h->data, "Changed-0");
+	TEST_CHECK(markDirty(bm, h));
+	TEST_CHECK(unpinPage(bm, h));
+	for (i = 1; i <= NUM_FRAMES; i++) {
+		pinAndCheck(bm, i);
+	}
+
+	TEST_CHECK(getPoolStats(bm, &stats));
+	ASSERT_EQUALS_INT(1, (int) stats.writes, "dirty victim written");
+	ASSERT_EQUALS_INT(1, (int) stats.tierStores, "written page kept");
+	TEST_CHECK(openPageFile(TESTPF, &fh));
+	TEST_CHECK(readBlock(0, &fh, ph));
+	ASSERT_EQUALS_STRING("Changed-0", ph, "page file has the change");
+	TEST_CHECK(closePageFile(&fh));
+
+	TEST_CHECK(pinPage(bm, h, 0));
+	ASSERT_EQUALS_STRING("Changed-0", h->data, "tier copy has the change");
+	TEST_CHECK(unpinPage(bm, h));
+	TEST_CHECK(getPoolStats(bm, &stats));
+	ASSERT_EQUALS_INT(1, (int) stats.tierHits, "page came from the tier");
+	ASSERT_EQUALS_INT(NUM_FRAMES + 1, (int) stats.reads,
+			"page not read again");
+
+	TEST_CHECK(shutdownBufferPool(bm));
+	TEST_CHECK(destroyPageFile(TESTPF));
+
+	free(ph);
+	free(h);
+	free(bm);
+	TEST_DONE();
+}
+
+// a full tier drops its oldest pages to make room for new ones
+void testTierBudget(void) {
+	BM_BufferPool *bm = MAKE_POOL();
+	BM_PoolStats stats;
+	int i;
+	testName = "Tier budget";
+
+	createBlocks();
+	openTiered(bm, SMALL_TIER);
+	for (i = 0; i < NUM_BLOCKS; i++) {
+		pinAndCheck(bm, i);
+	}
+	TEST_CHECK(getPoolStats(bm, &stats));
+	ASSERT_EQUALS_INT(NUM_BLOCKS - NUM_FRAMES, (int) stats.tierStores,
+			"every evicted page stored");
+	ASSERT_TRUE(((BM_Data *) bm->mgmtData)->tier->usedBytes <= SMALL_TIER,
+			"tier within its budget");
+
+	//Page evicted last is still there, the one evicted first is gone
+	pinAndCheck(bm, NUM_BLOCKS - NUM_FRAMES - 1);
+	TEST_CHECK(getPoolStats(bm, &stats));
+	ASSERT_EQUALS_INT(1, (int) stats.tierHits, "newest page kept");
+	pinAndCheck(bm, 0);
+	TEST_CHECK(getPoolStats(bm, &stats));
+	ASSERT_EQUALS_INT(1, (int) stats.tierHits, "oldest page dropped");
+	ASSERT_EQUALS_INT(NUM_BLOCKS + 1, (int) stats.reads,
+			"oldest page read again");
+
+	TEST_CHECK(shutdownBufferPool(bm));
+	TEST_CHECK(destroyPageFile(TESTPF));
+
+	free(bm);
+	TEST_DONE();
+}
+
+// a page that doesn't compress to half a page isn't kept
+void testIncompressiblePage(void) {
+	BM_BufferPool *bm = MAKE_POOL();
+	BM_PageHandle *h = MAKE_PAGE_HANDLE();
+	BM_PoolStats stats;
+	char *expected = (char *) malloc(PAGE_SIZE);
+	int i;
+	testName = "Incompressible page";
+
+	createBlocks();
+	openTiered(bm, LARGE_TIER);
+	srand(42);
+	for (i = 0; i < PAGE_SIZE; i++) {
+		expected[i] = (char) (rand() & 0xff);
+	}
+	TEST_CHECK(pinPage(bm, h, 0));
+	memcpy(h->data, expected, PAGE_SIZE);
+	TEST_CHECK(markDirty(bm, h));
+	TEST_CHECK(unpinPage(bm, h));
+	for (i = 1; i <= NUM_FRAMES; i++) {
+		pinAndCheck(bm, i);
+	}
+	TEST_CHECK(getPoolStats(bm, &stats));
+	ASSERT_EQUALS_INT(0, (int) stats.tierStores, "page not kept");
+
+	TEST_CHECK(pinPage(bm, h, 0));
+	ASSERT_TRUE(memcmp(expected, h->data, PAGE_SIZE) == 0,
+			"page read back from page file");
+	TEST_CHECK(unpinPage(bm, h));
+	TEST_CHECK(getPoolStats(bm, &stats));
+	ASSERT_EQUALS_INT(0, (int) stats.tierHits, "no tier hit");
+
+	TEST_CHECK(shutdownBufferPool(bm));
+	TEST_CHECK(destroyPageFile(TESTPF));
+
+	free(expected);
+	free(h);
+	free(bm);
+	TEST_DONE();
+}
+
+// create page file of NUM_BLOCKS pages "Page-<page no>"
+void createBlocks(void) {
+	SM_FileHandle fh;
+	SM_PageHandle ph = (SM_PageHandle) malloc(PAGE_SIZE);
+	int i;
+
+	TEST_CHECK(createPageFile(TESTPF));
+	TEST_CHECK(openPageFile(TESTPF, &fh));
+	TEST_CHECK(ensureCapacity(NUM_BLOCKS, &fh));
+	for (i = 0; i < NUM_BLOCKS; i++) {
+		memset(ph, 0, PAGE_SIZE);
+		sprintf(ph, "Page-%i", i);
+		TEST_CHECK(writeBlock(i, &fh, ph));
+	}
+	TEST_CHECK(closePageFile(&fh));
+
+	free(ph);
+}
+
+// open a FIFO pool on TESTPF with a tier of tierBytes
+void openTiered(BM_BufferPool *bm, size_t tierBytes) {
+	BM_PoolOptions options;
+
+	initPoolOptions(&options);
+	options.tierBytes = tierBytes;
+	TEST_CHECK(initBufferPoolWithOptions(bm, TESTPF, NUM_FRAMES, RS_FIFO,
+			NULL, &options));
+}
+
+// pin page pageNum, check its content and unpin it again
+void pinAndCheck(BM_BufferPool *bm, PageNumber pageNum) {
+	BM_PageHandle *h = MAKE_PAGE_HANDLE();
+	char expected[32];
+
+	TEST_CHECK(pinPage(bm, h, pageNum));
+	sprintf(expected, "Page-%i", pageNum);
+	ASSERT_EQUALS_STRING(expected, h->data, "expected page content");
+	TEST_CHECK(unpinPage(bm, h));
+
+	free(h);
+}
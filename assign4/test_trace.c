@@ -0,0 +1,269 @@
+#include "storage_mgr.h"
+#include "buffer_mgr_stat.h"
+#include "buffer_mgr.h"
+#include "dberror.h"
+#include "test_helper.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// var to store the current test's name
+char *testName;
+
+/* page file, trace file and pool sizes used by all tests */
+#define TESTPF "test_trace.bin"
+#define TESTTRACE "test_trace.trace"
+#define NUM_FRAMES 3
+#define NUM_BLOCKS 10
+
+/* pages pinned by the replayed trace and a pool size that holds them all */
+#define NUM_PINS 12
+#define DISTINCT_PAGES 6
+#define LARGE_POOL 16
+
+// test and helper methods
+static void testTraceEvents(void);
+static void testTraceWraps(void);
+static void testNoTrace(void);
+static void testReplay(void);
+
+static void createBlocks(void);
+static void openTraced(BM_BufferPool *bm, const char *traceFile,
+		int maxEvents);
+static void pinAndCheck(BM_BufferPool *bm, PageNumber pageNum);
+static BM_TraceEvent *readEvents(BM_TraceHeader *header);
+
+// main method
+int main(void) {
+	initStorageManager();
+	testName = "";
+
+	testTraceEvents();
+	testTraceWraps();
+	testNoTrace();
+	testReplay();
+
+	return 0;
+}
+
+// pins, markDirty and unpins are recorded in order of the calls
+void testTraceEvents(void) {
+	BM_BufferPool *bm = MAKE_POOL();
+	BM_PageHandle *h = MAKE_PAGE_HANDLE();
+	BM_TraceHeader header;
+	BM_TraceEvent *events;
+	uint8_t ops[] = { BM_TRACE_PIN, BM_TRACE_DIRTY, BM_TRACE_UNPIN,
+			BM_TRACE_PIN, BM_TRACE_UNPIN };
+	PageNumber pageNums[] = { 2, 2, 2, 7, 7 };
+	int i;
+	testName = "Trace events";
+
+	createBlocks();
+	openTraced(bm, TESTTRACE, 100);
+	TEST_CHECK(pinPage(bm, h, 2));
+	TEST_CHECK(markDirty(bm, h));
+	TEST_CHECK(unpinPage(bm, h));
+	pinAndCheck(bm, 7);
+	TEST_CHECK(shutdownBufferPool(bm));
+
+	events = readEvents(&header);
+	ASSERT_TRUE(header.magic == BM_TRACE_MAGIC, "trace file header");
+	ASSERT_EQUALS_INT(5, (int) header.numEvents, "every access recorded");
+	ASSERT_EQUALS_INT(100, (int) header.capacity, "capacity from options");
+	for (i = 0; i < 5; i++) {
+		ASSERT_EQUALS_INT(ops[i], events[i].op, "op of event");
+		ASSERT_EQUALS_INT(pageNums[i], events[i].pageNum, "page of event");
+		ASSERT_EQUALS_INT(0, events[i].file, "file slot of event");
+		ASSERT_TRUE(i == 0 || events[i].time >= events[i - 1].time,
+				"events in time order");
+	}
+
+	TEST_CHECK(destroyPageFile(TESTPF));
+	unlink(TESTTRACE);
+
+	free(events);
+	free(h);
+	free(bm);
+	TEST_DONE();
+}
+
+// a full trace file keeps only the most recent events
+void testTraceWraps(void) {
+	BM_BufferPool *bm = MAKE_POOL();
+	BM_TraceHeader header;
+	BM_TraceEvent *events;
+	uint64_t first;
+	int i;
+	testName = "Trace file wraps";
+
+	createBlocks();
+	openTraced(bm, TESTTRACE, 5);
+	for (i = 0; i < NUM_BLOCKS; i++) {
+		pinAndCheck(bm, i);
+	}
+	TEST_CHECK(shutdownBufferPool(bm));
+
+	events = readEvents(&header);
+	ASSERT_EQUALS_INT(2 * NUM_BLOCKS, (int) header.numEvents,
+			"wrapped events still counted");
+	ASSERT_EQUALS_INT(5, (int) header.capacity, "ring holds 5 events");
+
+	//Oldest event kept is the unpin of the third last page
+	first = header.numEvents % header.capacity;
+	for (i = 0; i < 5; i++) {
+		BM_TraceEvent *event = &events[(first + i) % header.capacity];
+		ASSERT_EQUALS_INT(NUM_BLOCKS - 3 + (i + 1) / 2, event->pageNum,
+				"page of recent event");
+		ASSERT_EQUALS_INT(i % 2 == 0 ? BM_TRACE_UNPIN : BM_TRACE_PIN,
+				event->op, "op of recent event");
+	}
+
+	TEST_CHECK(destroyPageFile(TESTPF));
+	unlink(TESTTRACE);
+
+	free(events);
+	free(bm);
+	TEST_DONE();
+}
+
+// pools aren't traced unless asked for
+void testNoTrace(void) {
+	BM_BufferPool *bm = MAKE_POOL();
+	testName = "No trace by default";
+
+	createBlocks();
+	unlink(TESTTRACE);
+	openTraced(bm, NULL, 100);
+	ASSERT_TRUE(((BM_Data *) bm->mgmtData)->trace == NULL, "pool not traced");
+	pinAndCheck(bm, 0);
+	TEST_CHECK(shutdownBufferPool(bm));
+	ASSERT_TRUE(access(TESTTRACE, F_OK) != 0, "no trace file written");
+
+	TEST_CHECK(destroyPageFile(TESTPF));
+
+	free(bm);
+	TEST_DONE();
+}
+
+// bm_replay replays a trace on every strategy and removes its scratch files
+void testReplay(void) {
+	BM_BufferPool *bm = MAKE_POOL();
+	char line[256], name[16];
+	unsigned long long pins, hits, reads, writes;
+	double ratio;
+	long failed;
+	int i, pages, rc, rows = 0, fullRows = 0;
+	FILE *fp;
+	testName = "Replay of a trace";
+
+	createBlocks();
+	openTraced(bm, TESTTRACE, 100);
+	for (i = 0; i < NUM_PINS; i++) {
+		pinAndCheck(bm, i % DISTINCT_PAGES);
+	}
+	TEST_CHECK(shutdownBufferPool(bm));
+
+	fp = popen("./bm_replay " TESTTRACE " 2 16", "r");
+	ASSERT_TRUE(fp != NULL, "bm_replay started");
+	while (fgets(line, sizeof(line), fp) != NULL) {
+		if (sscanf(line, "%15s %d %llu %llu %lf %llu %llu %ld", name, &pages,
+				&pins, &hits, &ratio, &reads, &writes, &failed) != 8) {
+			continue;
+		}
+		rows++;
+		ASSERT_EQUALS_INT(NUM_PINS, (int) pins, "every pin replayed");
+		if (pages == LARGE_POOL) {
+			fullRows++;
+			ASSERT_EQUALS_INT(DISTINCT_PAGES, (int) reads,
+					"each page read once");
+			ASSERT_EQUALS_INT(NUM_PINS - DISTINCT_PAGES, (int) hits,
+					"later pins hit");
+		}
+	}
+	rc = pclose(fp);
+	ASSERT_EQUALS_INT(0, rc, "bm_replay succeeded");
+	ASSERT_EQUALS_INT(2 * BM_NUM_STRATEGIES, rows,
+			"a run per strategy and pool size");
+	ASSERT_EQUALS_INT(BM_NUM_STRATEGIES, fullRows, "runs on large pool");
+	ASSERT_TRUE(access(TESTTRACE ".replay0", F_OK) != 0,
+			"scratch page file removed");
+
+	//Anything but a trace file is refused
+	fp = popen("./bm_replay " TESTPF " 2>/dev/null", "r");
+	ASSERT_TRUE(fp != NULL, "bm_replay started");
+	while (fgets(line, sizeof(line), fp) != NULL) {
+		//Only the exit status matters
+	}
+	rc = pclose(fp);
+	ASSERT_TRUE(rc != 0, "page file isn't replayed");
+
+	TEST_CHECK(destroyPageFile(TESTPF));
+	unlink(TESTTRACE);
+
+	free(bm);
+	TEST_DONE();
+}
+
+// create page file of NUM_BLOCKS pages "Page-<page no>"
+void createBlocks(void) {
+	SM_FileHandle fh;
+	SM_PageHandle ph = (SM_PageHandle) malloc(PAGE_SIZE);
+	int i;
+
+	TEST_CHECK(createPageFile(TESTPF));
+	TEST_CHECK(openPageFile(TESTPF, &fh));
+	TEST_CHECK(ensureCapacity(NUM_BLOCKS, &fh));
+	for (i = 0; i < NUM_BLOCKS; i++) {
+		memset(ph, 0, PAGE_SIZE);
+		sprintf(ph, "Page-%i", i);
+		TEST_CHECK(writeBlock(i, &fh, ph));
+	}
+	TEST_CHECK(closePageFile(&fh));
+
+	free(ph);
+}
+
+// open a LRU pool on TESTPF tracing to traceFile, if any
+void openTraced(BM_BufferPool *bm, const char *traceFile, int maxEvents) {
+	BM_PoolOptions options;
+
+	initPoolOptions(&options);
+	options.traceFile = traceFile;
+	options.traceMaxEvents = maxEvents;
+	TEST_CHECK(initBufferPoolWithOptions(bm, TESTPF, NUM_FRAMES, RS_LRU, NULL,
+			&options));
+}
+
+// pin page pageNum, check its content and unpin it again
+void pinAndCheck(BM_BufferPool *bm, PageNumber pageNum) {
+	BM_PageHandle *h = MAKE_PAGE_HANDLE();
+	char expected[32];
+
+	TEST_CHECK(pinPage(bm, h, pageNum));
+	sprintf(expected, "Page-%i", pageNum);
+	ASSERT_EQUALS_STRING(expected, h->data, "expected page content");
+	TEST_CHECK(unpinPage(bm, h));
+
+	free(h);
+}
+
+// header and ring of events of TESTTRACE, in file order
+BM_TraceEvent *readEvents(BM_TraceHeader *header) {
+	BM_TraceEvent *events;
+	uint64_t n;
+	FILE *fp = fopen(TESTTRACE, "rb");
+
+	ASSERT_TRUE(fp != NULL, "trace file written");
+	ASSERT_TRUE(fread(header, sizeof(BM_TraceHeader), 1, fp) == 1,
+			"trace file header read");
+	n = header->numEvents < header->capacity ? header->numEvents
+			: header->capacity;
+	events = (BM_TraceEvent *) malloc((n + 1) * sizeof(BM_TraceEvent));
+	ASSERT_TRUE(fread(events, sizeof(BM_TraceEvent), n, fp) == n,
+			"trace file events read");
+	fclose(fp);
+
+	return events;
+}
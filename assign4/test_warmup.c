@@ -0,0 +1,270 @@
+#include "storage_mgr.h"
+#include "buffer_mgr_stat.h"
+#include "buffer_mgr.h"
+#include "dberror.h"
+#include "test_helper.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// var to store the current test's name
+char *testName;
+
+/* page file, its sidecar and pool sizes used by all tests */
+#define TESTPF "test_warmup.bin"
+#define SIDECAR TESTPF BM_WARMUP_SUFFIX
+#define NUM_FRAMES 8
+#define NUM_BLOCKS 40
+
+/* first page kept hot, and how long to wait for the warm-up worker */
+#define FIRST_HOT 10
+#define WARMUP_TIMEOUT_MS 5000
+
+// test and helper methods
+static void testSaveAndWarmup(void);
+static void testHottestPagesKept(void);
+static void testWarmupDisabled(void);
+static void testBrokenSidecar(void);
+
+static void createBlocks(void);
+static void initWarmupPool(BM_BufferPool *bm, int numPages, bool warmup);
+static void heatPages(BM_BufferPool *bm);
+static void pinAndCheck(BM_BufferPool *bm, PageNumber pageNum);
+static bool waitForPages(BM_BufferPool *bm, PageNumber *pages, int n);
+static bool sidecarExists(void);
+static int frameOf(BM_BufferPool *bm, PageNumber pageNum);
+
+// main method
+int main(void) {
+	initStorageManager();
+	testName = "";
+
+	testSaveAndWarmup();
+	testHottestPagesKept();
+	testWarmupDisabled();
+	testBrokenSidecar();
+
+	return 0;
+}
+
+// pages resident at close are loaded again when the file is opened
+void testSaveAndWarmup(void) {
+	BM_BufferPool *bm = MAKE_POOL();
+	PageNumber pages[NUM_FRAMES];
+	int i;
+	testName = "Saving and warming up hot pages";
+
+	createBlocks();
+	remove(SIDECAR);
+	initWarmupPool(bm, NUM_FRAMES, TRUE);
+	heatPages(bm);
+	TEST_CHECK(shutdownBufferPool(bm));
+	ASSERT_TRUE(sidecarExists(), "sidecar written on close");
+
+	initWarmupPool(bm, NUM_FRAMES, TRUE);
+	for (i = 0; i < NUM_FRAMES; i++) {
+		pages[i] = FIRST_HOT + i;
+	}
+	ASSERT_TRUE(waitForPages(bm, pages, NUM_FRAMES),
+			"saved pages loaded by warm-up");
+	for (i = 0; i < NUM_FRAMES; i++) {
+		pinAndCheck(bm, FIRST_HOT + i);
+	}
+	ASSERT_EQUALS_INT(NUM_FRAMES, getNumReadIO(bm),
+			"pins found their pages, no read of their own");
+	ASSERT_EQUALS_INT(NUM_FRAMES, (int) getPageHitCount(bm),
+			"every pin was a hit");
+
+	TEST_CHECK(shutdownBufferPool(bm));
+	TEST_CHECK(destroyPageFile(TESTPF));
+	remove(SIDECAR);
+
+	free(bm);
+	TEST_DONE();
+}
+
+// a smaller pool loads only the most used pages of the sidecar
+void testHottestPagesKept(void) {
+	BM_BufferPool *bm = MAKE_POOL();
+	PageNumber pages[NUM_FRAMES / 2];
+	int i;
+	testName = "Hottest pages warmed up first";
+
+	createBlocks();
+	remove(SIDECAR);
+	initWarmupPool(bm, NUM_FRAMES, TRUE);
+	heatPages(bm);
+	TEST_CHECK(shutdownBufferPool(bm));
+
+	//heatPages() uses every other page more often
+	initWarmupPool(bm, NUM_FRAMES / 2, TRUE);
+	for (i = 0; i < NUM_FRAMES / 2; i++) {
+		pages[i] = FIRST_HOT + 2 * i;
+	}
+	ASSERT_TRUE(waitForPages(bm, pages, NUM_FRAMES / 2),
+			"most used pages loaded");
+	for (i = 0; i < NUM_FRAMES / 2; i++) {
+		ASSERT_TRUE(frameOf(bm, FIRST_HOT + 2 * i + 1) == -1,
+				"less used page left out");
+	}
+	ASSERT_EQUALS_INT(NUM_FRAMES / 2, getNumReadIO(bm),
+			"no page beyond the pool size read");
+
+	TEST_CHECK(shutdownBufferPool(bm));
+	TEST_CHECK(destroyPageFile(TESTPF));
+	remove(SIDECAR);
+
+	free(bm);
+	TEST_DONE();
+}
+
+// pools without warm-up neither save nor load a sidecar
+void testWarmupDisabled(void) {
+	BM_BufferPool *bm = MAKE_POOL();
+	testName = "Warm-up disabled";
+
+	createBlocks();
+	remove(SIDECAR);
+	initWarmupPool(bm, NUM_FRAMES, FALSE);
+	heatPages(bm);
+	TEST_CHECK(shutdownBufferPool(bm));
+	ASSERT_TRUE(!sidecarExists(), "no sidecar written");
+
+	//A sidecar saved by another pool is ignored
+	initWarmupPool(bm, NUM_FRAMES, TRUE);
+	heatPages(bm);
+	TEST_CHECK(shutdownBufferPool(bm));
+	initWarmupPool(bm, NUM_FRAMES, FALSE);
+	usleep(50 * 1000);
+	ASSERT_EQUALS_INT(0, getNumReadIO(bm), "nothing loaded");
+	ASSERT_TRUE(frameOf(bm, FIRST_HOT) == -1, "hot page not resident");
+
+	TEST_CHECK(shutdownBufferPool(bm));
+	TEST_CHECK(destroyPageFile(TESTPF));
+	remove(SIDECAR);
+
+	free(bm);
+	TEST_DONE();
+}
+
+// a sidecar that isn't a page list is skipped, the pool works as usual
+void testBrokenSidecar(void) {
+	BM_BufferPool *bm = MAKE_POOL();
+	FILE *out;
+	testName = "Broken sidecar";
+
+	createBlocks();
+	out = fopen(SIDECAR, "wb");
+	ASSERT_TRUE(out != NULL, "sidecar created");
+	fputs("not a page list", out);
+	fclose(out);
+
+	initWarmupPool(bm, NUM_FRAMES, TRUE);
+	usleep(50 * 1000);
+	ASSERT_EQUALS_INT(0, getNumReadIO(bm), "nothing loaded");
+	pinAndCheck(bm, 0);
+	TEST_CHECK(shutdownBufferPool(bm));
+	ASSERT_TRUE(sidecarExists(), "sidecar replaced on close");
+
+	//Replaced sidecar is a valid list again
+	initWarmupPool(bm, NUM_FRAMES, TRUE);
+	PageNumber page = 0;
+	ASSERT_TRUE(waitForPages(bm, &page, 1), "page 0 warmed up");
+
+	TEST_CHECK(shutdownBufferPool(bm));
+	TEST_CHECK(destroyPageFile(TESTPF));
+	remove(SIDECAR);
+
+	free(bm);
+	TEST_DONE();
+}
+
+// create page file of NUM_BLOCKS pages "Page-<page no>"
+void createBlocks(void) {
+	SM_FileHandle fh;
+	SM_PageHandle ph = (SM_PageHandle) malloc(PAGE_SIZE);
+	int i;
+
+	TEST_CHECK(createPageFile(TESTPF));
+	TEST_CHECK(openPageFile(TESTPF, &fh));
+	TEST_CHECK(ensureCapacity(NUM_BLOCKS, &fh));
+	for (i = 0; i < NUM_BLOCKS; i++) {
+		memset(ph, 0, PAGE_SIZE);
+		sprintf(ph, "Page-%i", i);
+		TEST_CHECK(writeBlock(i, &fh, ph));
+	}
+	TEST_CHECK(closePageFile(&fh));
+
+	free(ph);
+}
+
+// open an LFU pool of numPages frames on TESTPF with warm-up on or off
+void initWarmupPool(BM_BufferPool *bm, int numPages, bool warmup) {
+	BM_PoolOptions options;
+
+	initPoolOptions(&options);
+	options.warmup = warmup;
+	TEST_CHECK(initBufferPoolWithOptions(bm, TESTPF, numPages, RS_LFU, NULL,
+			&options));
+}
+
+// fill the pool with pages FIRST_HOT.., every other one used more often
+void heatPages(BM_BufferPool *bm) {
+	int i, j;
+
+	for (i = 0; i < NUM_FRAMES; i++) {
+		for (j = 0; j < (i % 2 == 0 ? 4 : 1); j++) {
+			pinAndCheck(bm, FIRST_HOT + i);
+		}
+	}
+}
+
+// pin page pageNum, check its content and unpin it again
+void pinAndCheck(BM_BufferPool *bm, PageNumber pageNum) {
+	BM_PageHandle *h = MAKE_PAGE_HANDLE();
+	char expected[32];
+
+	TEST_CHECK(pinPage(bm, h, pageNum));
+	sprintf(expected, "Page-%i", pageNum);
+	ASSERT_EQUALS_STRING(expected, h->data, "expected page content");
+	TEST_CHECK(unpinPage(bm, h));
+
+	free(h);
+}
+
+// wait until all n pages are resident, FALSE if they never got there
+bool waitForPages(BM_BufferPool *bm, PageNumber *pages, int n) {
+	int i, waited;
+
+	for (waited = 0; waited < WARMUP_TIMEOUT_MS; waited++) {
+		for (i = 0; i < n && frameOf(bm, pages[i]) != -1; i++)
+			;
+		if (i == n) {
+			return TRUE;
+		}
+		usleep(1000);
+	}
+
+	return FALSE;
+}
+
+// whether the sidecar of TESTPF exists
+bool sidecarExists(void) {
+	return access(SIDECAR, F_OK) == 0;
+}
+
+// index of the frame holding page pageNum, -1 if none does
+int frameOf(BM_BufferPool *bm, PageNumber pageNum) {
+	PageNumber *frames = getFrameContents(bm);
+	int i;
+
+	for (i = 0; i < ((BM_Data *) bm->mgmtData)->numFramesUsed; i++) {
+		if (frames[i] == pageNum) {
+			return i;
+		}
+	}
+
+	return -1;
+}